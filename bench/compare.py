@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Compare two mini_dl_bench result files and flag regressions.
+
+    python3 bench/compare.py BASELINE CURRENT [--threshold 0.05]
+
+Both files may be the JSON (--json) or CSV (--csv) output of mini_dl_bench.
+Cases are matched by (name, params) and compared on median time per
+iteration, so throughput and per-node metrics move in step with it.
+A case whose median time grew by more than the threshold is a regression;
+the script exits with status 1 if there is at least one.
+
+Save a baseline on the machine that runs the comparison, for example:
+
+    build/bench/mini_dl_bench --json bench_baseline.json
+    ... make the change and rebuild ...
+    build/bench/mini_dl_bench --json bench_current.json
+    python3 bench/compare.py bench_baseline.json bench_current.json
+"""
+
+import argparse
+import csv
+import json
+import sys
+
+# Machine fields that make timings incomparable when they differ.
+MACHINE_KEYS = ("cpu", "logical_cpus", "threads", "compiler", "build_type", "optimized", "mode")
+
+
+def load(path):
+    """Returns (machine info dict, {(name, params): result dict})."""
+    with open(path, newline="") as f:
+        text = f.read()
+    if text.lstrip().startswith("{"):
+        doc = json.loads(text)
+        machine = doc.get("machine", {})
+        rows = doc.get("results", [])
+    else:
+        machine = {}
+        body = []
+        for line in text.splitlines():
+            if line.startswith("#"):
+                key, _, value = line[1:].partition(":")
+                machine[key.strip()] = value.strip()
+            elif line.strip():
+                body.append(line)
+        rows = list(csv.DictReader(body))
+    results = {}
+    for r in rows:
+        results[(r["name"], r["params"])] = {k: float(v) for k, v in r.items() if k not in ("name", "params")}
+    return machine, results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.05,
+                        help="relative slowdown that counts as a regression (default 0.05 = 5%%)")
+    args = parser.parse_args()
+
+    base_machine, base = load(args.baseline)
+    cur_machine, cur = load(args.current)
+
+    for key in MACHINE_KEYS:
+        a, b = base_machine.get(key), cur_machine.get(key)
+        if a != b:
+            print(f"warning: machine field '{key}' differs: {a!r} vs {b!r}", file=sys.stderr)
+    if cur_machine.get("optimized") == "false":
+        print("warning: current results come from an unoptimized build", file=sys.stderr)
+
+    regressions = improvements = 0
+    print(f"{'Name':<16} {'Params':<30} {'Base(us)':>12} {'Current(us)':>12} {'Change':>9}")
+    for key in sorted(base.keys() & cur.keys()):
+        b = base[key]["median_ns"]
+        c = cur[key]["median_ns"]
+        change = c / b - 1.0 if b > 0 else 0.0
+        if change > args.threshold:
+            status = "REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            status = "improved"
+            improvements += 1
+        else:
+            status = ""
+        name, params = key
+        print(f"{name:<16} {params[:30]:<30} {b / 1e3:>12.2f} {c / 1e3:>12.2f} {change * 100:>+8.1f}% {status}")
+
+    for key in sorted(base.keys() - cur.keys()):
+        print(f"missing in current: {key[0]} {key[1]}")
+    for key in sorted(cur.keys() - base.keys()):
+        print(f"new in current: {key[0]} {key[1]}")
+
+    print(f"\n{regressions} regression(s), {improvements} improvement(s) beyond {args.threshold * 100:.1f}%")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
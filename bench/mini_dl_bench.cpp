@@ -0,0 +1,491 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "broadcast.hpp"
+#include "kernels.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// --- 内核微基准 ---
+// 对 matmul、带广播的逐元素算子、转置、归约与 Tensor::backward() 的逐节点开销按尺寸扫描计时，
+// 结果以表格打印，并可写成 JSON / CSV (带机器信息)，用 bench/compare.py 与保存的基线比较。
+//
+//   mini_dl_bench [--quick] [--filter SUBSTR] [--min-time SEC] [--samples N]
+//                 [--json PATH] [--csv PATH] [--list]
+//
+// 每个用例先预热一次，再把迭代次数翻倍直到一个样本耗时达到 min-time / samples，
+// 然后取 samples 个样本的每次迭代时间，报告中位数与最小值。
+
+#ifndef MINIDL_BUILD_TYPE
+#define MINIDL_BUILD_TYPE ""
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    bool quick{false};
+    bool list{false};
+    std::string filter;
+    double min_time{0.25}; // 每个用例的计时总时长 (秒)
+    size_t samples{5};
+    std::string json_path, csv_path;
+};
+
+// 返回执行 iters 次所用的纳秒数。计时范围由用例自己决定，以便把建图等准备工作排除在外
+using BenchFn = std::function<double(size_t iters)>;
+
+struct BenchCase {
+    std::string name;   // 用例族，如 "matmul"
+    std::string params; // 参数，如 "m=256,k=256,n=256"
+    double flops{0};    // 以下均为每次迭代的量，0 表示不适用
+    double bytes{0};
+    double items{0};    // 计数类用例的单位数 (如反向图的节点数)
+    BenchFn fn;
+};
+
+struct BenchResult {
+    std::string name, params;
+    size_t iters{0}, samples{0};
+    double median_ns{0}, min_ns{0};
+    double flops{0}, bytes{0}, items{0};
+
+    double gflops() const { return flops > 0 ? flops / median_ns : 0.0; }
+    double gbps() const { return bytes > 0 ? bytes / median_ns : 0.0; }
+    double ns_per_item() const { return items > 0 ? median_ns / items : 0.0; }
+};
+
+volatile const void* g_sink = nullptr; // 防止结果被当作无用计算消掉
+
+void keep(const Tensor& t) { g_sink = t.data().raw(); }
+
+double elapsed_ns(Clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+template <typename F>
+double time_loop(size_t iters, F&& body) {
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < iters; ++i) body();
+    return elapsed_ns(t0);
+}
+
+Tensor random_tensor(const std::vector<size_t>& shape, uint32_t seed, bool requires_grad = false) {
+    size_t n = 1;
+    for (size_t d : shape) n *= d;
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> v(n);
+    for (auto& x : v) x = dist(gen);
+    return Tensor(shape, Storage(std::move(v)), requires_grad);
+}
+
+std::string shape_str(const std::vector<size_t>& shape) {
+    std::string s;
+    for (size_t i = 0; i < shape.size(); ++i) s += (i ? "x" : "") + std::to_string(shape[i]);
+    return s;
+}
+
+size_t numel_of(const std::vector<size_t>& shape) {
+    size_t n = 1;
+    for (size_t d : shape) n *= d;
+    return n;
+}
+
+// ---------------- 用例 ----------------
+
+void add_matmul_cases(std::vector<BenchCase>& cases, bool quick) {
+    std::vector<std::vector<size_t>> mkn;
+    for (size_t s : quick ? std::vector<size_t>{64, 256} : std::vector<size_t>{64, 128, 256, 512, 1024}) {
+        mkn.push_back({s, s, s});
+    }
+    // 非方阵：瘦高、矩阵乘向量、大 k
+    mkn.push_back({4096, 64, 64});
+    mkn.push_back({1, 1024, 1024});
+    mkn.push_back({64, 4096, 64});
+    for (const auto& d : mkn) {
+        const size_t m = d[0], k = d[1], n = d[2];
+        Tensor a = random_tensor({m, k}, 1), b = random_tensor({k, n}, 2);
+        cases.push_back({"matmul", "m=" + std::to_string(m) + ",k=" + std::to_string(k) + ",n=" + std::to_string(n),
+                         2.0 * m * k * n, 4.0 * (m * k + k * n + m * n), 0,
+                         [a, b](size_t iters) { return time_loop(iters, [&] { keep(matmul(a, b)); }); }});
+    }
+    // 半精度输入走 fp32 累加的混合路径
+    const size_t s = quick ? 128 : 256;
+    Tensor a = cast(random_tensor({s, s}, 3), DType::Float16), b = cast(random_tensor({s, s}, 4), DType::Float16);
+    cases.push_back({"matmul_f16", "m=" + std::to_string(s) + ",k=" + std::to_string(s) + ",n=" + std::to_string(s),
+                     2.0 * s * s * s, 2.0 * 3 * s * s, 0,
+                     [a, b](size_t iters) { return time_loop(iters, [&] { keep(matmul(a, b)); }); }});
+}
+
+void add_elementwise_cases(std::vector<BenchCase>& cases, bool quick) {
+    const size_t r = quick ? 256 : 1024, c = quick ? 256 : 1024;
+    struct Shapes {
+        const char* pattern;
+        std::vector<size_t> a, b;
+    };
+    const std::vector<Shapes> shapes = {
+        {"same", {r, c}, {r, c}},
+        {"row", {r, c}, {c}},          // 每行加同一个向量
+        {"col", {r, c}, {r, 1}},       // 每列加同一个向量
+        {"outer", {r, 1}, {1, c}},     // 两个向量的外和
+        {"3d", {64, 1, quick ? size_t(64) : size_t(256)}, {1, 128, quick ? size_t(64) : size_t(256)}},
+        {"scalar", {r, c}, {1}},
+    };
+    using BinaryOp = Tensor (*)(const Tensor&, const Tensor&);
+    const std::vector<std::pair<const char*, BinaryOp>> ops = {{"add", &add}, {"mul", &mul}, {"div", &div}};
+    for (const auto& op : ops) {
+        for (const auto& s : shapes) {
+            if (std::string(op.first) != "add" && std::string(s.pattern) != "same" && std::string(s.pattern) != "row") {
+                continue; // 广播模式的差别只用 add 扫一遍
+            }
+            Tensor a = random_tensor(s.a, 5), b = random_tensor(s.b, 6);
+            std::vector<size_t> out = s.a.size() >= s.b.size() ? s.a : s.b;
+            for (size_t i = 0; i < std::min(s.a.size(), s.b.size()); ++i) {
+                out[out.size() - 1 - i] = std::max(s.a[s.a.size() - 1 - i], s.b[s.b.size() - 1 - i]);
+            }
+            const size_t n = numel_of(out);
+            BinaryOp f = op.second;
+            cases.push_back({std::string(op.first), std::string(s.pattern) + ":" + shape_str(s.a) + "," + shape_str(s.b),
+                             double(n), 4.0 * (a.numel() + b.numel() + n), 0,
+                             [a, b, f](size_t iters) { return time_loop(iters, [&] { keep(f(a, b)); }); }});
+        }
+    }
+    Tensor x = random_tensor({r, c}, 7);
+    cases.push_back({"relu", shape_str({r, c}), double(r * c), 8.0 * r * c, 0,
+                     [x](size_t iters) { return time_loop(iters, [&] { keep(relu(x)); }); }});
+    cases.push_back({"mul_scalar", shape_str({r, c}), double(r * c), 8.0 * r * c, 0,
+                     [x](size_t iters) { return time_loop(iters, [&] { keep(mul(x, 1.5f)); }); }});
+}
+
+void add_transpose_cases(std::vector<BenchCase>& cases, bool quick) {
+    std::vector<std::vector<size_t>> shapes;
+    for (size_t s : quick ? std::vector<size_t>{256, 1024} : std::vector<size_t>{256, 1024, 2048}) shapes.push_back({s, s});
+    shapes.push_back({64, 16384});
+    shapes.push_back({16384, 64});
+    for (const auto& s : shapes) {
+        Tensor x = random_tensor(s, 8);
+        cases.push_back({"transpose", shape_str(s), 0, 8.0 * x.numel(), 0,
+                         [x](size_t iters) { return time_loop(iters, [&] { keep(transpose(x)); }); }});
+    }
+}
+
+// 仓库里没有独立的归约算子：归约发生在广播算子的反向 (broadcast_reduce_sum) 和
+// 偏置梯度 (sum_rows) 里，这里直接测这两个内核
+void add_reduction_cases(std::vector<BenchCase>& cases, bool quick) {
+    const size_t r = quick ? 256 : 1024, c = quick ? 256 : 1024;
+    const std::vector<std::pair<const char*, std::vector<size_t>>> targets = {
+        {"rows", {c}},     // [r, c] -> [c]，内层连续
+        {"cols", {r, 1}},  // [r, c] -> [r, 1]，每行求和
+        {"all", {1}},
+    };
+    for (const auto& t : targets) {
+        Tensor src = random_tensor({r, c}, 9);
+        std::vector<size_t> src_shape{r, c}, dst_shape = t.second;
+        auto dst = std::make_shared<std::vector<float>>(numel_of(dst_shape), 0.0f);
+        cases.push_back({"reduce_sum", std::string(t.first) + ":" + shape_str(src_shape) + "->" + shape_str(dst_shape),
+                         double(r * c), 4.0 * (r * c + dst->size()), 0, [src, src_shape, dst_shape, dst](size_t iters) {
+                             const float* s = src.data().data();
+                             return time_loop(iters, [&] {
+                                 broadcast_reduce_sum(s, src_shape, dst->data(), dst_shape);
+                                 g_sink = dst->data();
+                             });
+                         }});
+    }
+    Tensor src = random_tensor({r, c}, 10);
+    auto out = std::make_shared<std::vector<float>>(c, 0.0f);
+    cases.push_back({"sum_rows", shape_str({r, c}), double(r * c), 4.0 * (r * c + c), 0, [src, r, c, out](size_t iters) {
+                         const float* s = src.data().data();
+                         return time_loop(iters, [&] {
+                             sum_rows(s, r, c, out->data());
+                             g_sink = out->data();
+                         });
+                     }});
+}
+
+// 反向开销：每次迭代重新建图 (不计时)，只对 backward() 计时，按图中节点数折算
+void add_backward_cases(std::vector<BenchCase>& cases, bool quick) {
+    const std::vector<size_t> sizes = quick ? std::vector<size_t>{64, 256} : std::vector<size_t>{64, 256, 1024};
+    for (size_t numel : {size_t(1), size_t(4096)}) {
+        for (size_t nodes : sizes) {
+            // 一条链：y = x + c + c + ...，每个节点一个 AddGradFn
+            cases.push_back({"backward_chain", "nodes=" + std::to_string(nodes) + ",numel=" + std::to_string(numel), 0, 0,
+                             double(nodes), [numel, nodes](size_t iters) {
+                                 Tensor c({numel}, 0.5f);
+                                 double ns = 0;
+                                 for (size_t i = 0; i < iters; ++i) {
+                                     Tensor x({numel}, 1.0f, true);
+                                     Tensor y = x;
+                                     for (size_t j = 0; j < nodes; ++j) y = add(y, c);
+                                     auto t0 = Clock::now();
+                                     y.backward();
+                                     ns += elapsed_ns(t0);
+                                 }
+                                 return ns;
+                             }});
+        }
+    }
+    for (size_t fan : sizes) {
+        // 扇入：x 被 fan 个乘法共用，再逐个加起来 (2 * fan - 1 个节点)
+        cases.push_back({"backward_fanin", "fan=" + std::to_string(fan) + ",numel=1", 0, 0, double(2 * fan - 1),
+                         [fan](size_t iters) {
+                             Tensor c({1}, 0.5f);
+                             double ns = 0;
+                             for (size_t i = 0; i < iters; ++i) {
+                                 Tensor x({1}, 1.0f, true);
+                                 Tensor y = mul(x, c);
+                                 for (size_t j = 1; j < fan; ++j) y = add(y, mul(x, c));
+                                 auto t0 = Clock::now();
+                                 y.backward();
+                                 ns += elapsed_ns(t0);
+                             }
+                             return ns;
+                         }});
+    }
+}
+
+// ---------------- 计时 ----------------
+
+BenchResult run_case(const BenchCase& c, const Options& opt) {
+    const double target = opt.min_time * 1e9 / double(opt.samples);
+    c.fn(1); // 预热：首次分配、线程池启动等
+    size_t iters = 1;
+    double t = c.fn(iters);
+    while (t < target && iters < (size_t(1) << 30)) {
+        // 按比例放大，至少翻倍，避免在很快的用例上反复试探
+        const double scale = t > 0 ? target / t : 16.0;
+        iters = std::max(iters * 2, size_t(double(iters) * std::min(scale * 1.2, 16.0)));
+        t = c.fn(iters);
+    }
+    std::vector<double> per_iter{t / double(iters)};
+    while (per_iter.size() < opt.samples) per_iter.push_back(c.fn(iters) / double(iters));
+    std::sort(per_iter.begin(), per_iter.end());
+
+    BenchResult r;
+    r.name = c.name;
+    r.params = c.params;
+    r.iters = iters;
+    r.samples = per_iter.size();
+    r.median_ns = per_iter[per_iter.size() / 2];
+    r.min_ns = per_iter.front();
+    r.flops = c.flops;
+    r.bytes = c.bytes;
+    r.items = c.items;
+    return r;
+}
+
+// ---------------- 机器信息与输出 ----------------
+
+std::vector<std::pair<std::string, std::string>> machine_info(const Options& opt) {
+    std::vector<std::pair<std::string, std::string>> info;
+    std::string cpu = "unknown";
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    for (std::string line; std::getline(cpuinfo, line);) {
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t p = line.find(':');
+            if (p != std::string::npos) cpu = line.substr(line.find_first_not_of(' ', p + 1));
+            break;
+        }
+    }
+    info.emplace_back("cpu", cpu);
+    info.emplace_back("logical_cpus", std::to_string(std::thread::hardware_concurrency()));
+    info.emplace_back("threads", std::to_string(get_num_threads()));
+#if defined(__linux__)
+    info.emplace_back("os", "linux");
+#elif defined(__APPLE__)
+    info.emplace_back("os", "macos");
+#elif defined(_WIN32)
+    info.emplace_back("os", "windows");
+#else
+    info.emplace_back("os", "unknown");
+#endif
+#if defined(__clang__)
+    info.emplace_back("compiler", std::string("clang ") + __clang_version__);
+#elif defined(__GNUC__)
+    info.emplace_back("compiler", std::string("gcc ") + __VERSION__);
+#elif defined(_MSC_VER)
+    info.emplace_back("compiler", "msvc " + std::to_string(_MSC_VER));
+#else
+    info.emplace_back("compiler", "unknown");
+#endif
+    const std::string build_type = MINIDL_BUILD_TYPE;
+    info.emplace_back("build_type", build_type.empty() ? "unspecified" : build_type);
+#if defined(__OPTIMIZE__) || (defined(_MSC_VER) && !defined(_DEBUG))
+    info.emplace_back("optimized", "true");
+#else
+    info.emplace_back("optimized", "false");
+#endif
+    info.emplace_back("mode", opt.quick ? "quick" : "full");
+    char ts[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    info.emplace_back("timestamp", ts);
+    return info;
+}
+
+std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out += ' ';
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+std::string fmt(double v) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.6g", v);
+    return buf;
+}
+
+void write_json(const std::string& path, const std::vector<std::pair<std::string, std::string>>& info,
+                const std::vector<BenchResult>& results) {
+    std::ofstream f(path, std::ios::binary);
+    if (!f) throw std::runtime_error("Cannot open " + path);
+    f << "{\n  \"machine\": {";
+    for (size_t i = 0; i < info.size(); ++i) {
+        f << (i ? ", " : "") << "\"" << info[i].first << "\": \"" << json_escape(info[i].second) << "\"";
+    }
+    f << "},\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        f << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "\", \"params\": \"" << r.params
+          << "\", \"iters\": " << r.iters << ", \"samples\": " << r.samples << ", \"median_ns\": " << fmt(r.median_ns)
+          << ", \"min_ns\": " << fmt(r.min_ns) << ", \"flops\": " << fmt(r.flops) << ", \"bytes\": " << fmt(r.bytes)
+          << ", \"items\": " << fmt(r.items) << ", \"gflops\": " << fmt(r.gflops()) << ", \"gbps\": " << fmt(r.gbps())
+          << ", \"ns_per_item\": " << fmt(r.ns_per_item()) << "}";
+    }
+    f << "\n  ]\n}\n";
+    if (!f) throw std::runtime_error("Cannot write " + path);
+}
+
+// 机器信息写成开头的 "# key: value" 注释行
+void write_csv(const std::string& path, const std::vector<std::pair<std::string, std::string>>& info,
+               const std::vector<BenchResult>& results) {
+    std::ofstream f(path, std::ios::binary);
+    if (!f) throw std::runtime_error("Cannot open " + path);
+    for (const auto& kv : info) f << "# " << kv.first << ": " << kv.second << "\n";
+    f << "name,params,iters,samples,median_ns,min_ns,flops,bytes,items,gflops,gbps,ns_per_item\n";
+    for (const BenchResult& r : results) {
+        f << r.name << ",\"" << r.params << "\"," << r.iters << "," << r.samples << "," << fmt(r.median_ns) << ","
+          << fmt(r.min_ns) << "," << fmt(r.flops) << "," << fmt(r.bytes) << "," << fmt(r.items) << "," << fmt(r.gflops())
+          << "," << fmt(r.gbps()) << "," << fmt(r.ns_per_item()) << "\n";
+    }
+    if (!f) throw std::runtime_error("Cannot write " + path);
+}
+
+// 表格中不适用的量显示为 "-"
+std::string cell(double v, bool applicable) {
+    if (!applicable) return "-";
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f", v);
+    return buf;
+}
+
+void print_row(const BenchResult& r) {
+    char buf[256];
+    std::snprintf(buf, sizeof(buf), "%-16s %-30s %12.2f %10s %10s %10s\n", r.name.c_str(), r.params.substr(0, 30).c_str(),
+                  r.median_ns / 1e3, cell(r.gflops(), r.flops > 0).c_str(), cell(r.gbps(), r.bytes > 0).c_str(),
+                  cell(r.ns_per_item(), r.items > 0).c_str());
+    std::cout << buf << std::flush;
+}
+
+void usage() {
+    std::cerr << "usage: mini_dl_bench [--quick] [--filter SUBSTR] [--min-time SEC] [--samples N]\n"
+                 "                     [--json PATH] [--csv PATH] [--list]\n";
+}
+
+bool parse_args(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        if (a == "--quick") {
+            opt.quick = true;
+            opt.min_time = 0.05;
+        } else if (a == "--list") {
+            opt.list = true;
+        } else if (a == "--filter" || a == "--json" || a == "--csv" || a == "--min-time" || a == "--samples") {
+            const char* v = value();
+            if (!v) return false;
+            if (a == "--filter") opt.filter = v;
+            if (a == "--json") opt.json_path = v;
+            if (a == "--csv") opt.csv_path = v;
+            if (a == "--min-time") opt.min_time = std::atof(v);
+            if (a == "--samples") opt.samples = size_t(std::atoi(v));
+        } else {
+            return false;
+        }
+    }
+    return opt.min_time > 0 && opt.samples > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        usage();
+        return 2;
+    }
+    try {
+        std::vector<BenchCase> cases;
+        add_matmul_cases(cases, opt.quick);
+        add_elementwise_cases(cases, opt.quick);
+        add_transpose_cases(cases, opt.quick);
+        add_reduction_cases(cases, opt.quick);
+        add_backward_cases(cases, opt.quick);
+        if (!opt.filter.empty()) {
+            cases.erase(std::remove_if(cases.begin(), cases.end(), [&](const BenchCase& c) {
+                            return (c.name + " " + c.params).find(opt.filter) == std::string::npos;
+                        }),
+                        cases.end());
+        }
+        if (opt.list) {
+            for (const BenchCase& c : cases) std::cout << c.name << " " << c.params << "\n";
+            return 0;
+        }
+
+        auto info = machine_info(opt);
+        for (const auto& kv : info) std::cout << "# " << kv.first << ": " << kv.second << "\n";
+        for (const auto& kv : info) {
+            if (kv.first == "optimized" && kv.second != "true") {
+                std::cout << "# warning: benchmark built without optimization, numbers are not representative\n";
+            }
+        }
+        char buf[256];
+        std::snprintf(buf, sizeof(buf), "%-16s %-30s %12s %10s %10s %10s\n", "Name", "Params", "Median(us)", "GFLOP/s",
+                      "GB/s", "ns/item");
+        std::cout << buf;
+
+        std::vector<BenchResult> results;
+        for (const BenchCase& c : cases) {
+            results.push_back(run_case(c, opt));
+            print_row(results.back());
+        }
+        if (!opt.json_path.empty()) write_json(opt.json_path, info, results);
+        if (!opt.csv_path.empty()) write_csv(opt.csv_path, info, results);
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
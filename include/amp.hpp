@@ -0,0 +1,44 @@
+#pragma once
+#include "tensor.hpp"
+#include "optim.hpp"
+#include <cstddef>
+
+// --- 自动混合精度 ---
+
+// 当前线程的 autocast 类型，未开启时为 Float32
+DType autocast_dtype();
+
+// 作用域内 matmul (以及 Linear) 把输入转成 dtype 计算，输出保持 dtype；
+// 逐元素运算仍按 promote_types 决定结果类型。参数本身保持 fp32，梯度经 cast 回到 fp32。
+class AutocastGuard {
+public:
+    explicit AutocastGuard(DType dtype = DType::BFloat16);
+    ~AutocastGuard();
+    AutocastGuard(const AutocastGuard&) = delete;
+    AutocastGuard& operator=(const AutocastGuard&) = delete;
+
+private:
+    DType prev_;
+};
+
+// --- GradScaler：动态 loss scaling，防止 fp16 梯度下溢 ---
+//   Tensor l = scaler.scale(loss); l.backward();
+//   scaler.step(opt);   // 梯度除以 scale，出现 inf/nan 时跳过本次更新
+//   scaler.update();    // 溢出则 scale *= backoff，连续 growth_interval 步正常则 scale *= growth
+class GradScaler {
+public:
+    explicit GradScaler(float init_scale = 65536.0f, float growth_factor = 2.0f,
+                        float backoff_factor = 0.5f, size_t growth_interval = 2000);
+
+    Tensor scale(const Tensor& loss) const;
+    bool step(Optimizer& opt); // 返回是否真正执行了 opt.step()
+    void update();
+
+    float get_scale() const { return scale_; }
+    bool found_inf() const { return found_inf_; }
+
+private:
+    float scale_, growth_factor_, backoff_factor_;
+    size_t growth_interval_, good_steps_{0};
+    bool found_inf_{false};
+};
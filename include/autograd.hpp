@@ -1,19 +1,65 @@
 #pragma once
 //#include "tensor.hpp"
+#include <cstdint>
 #include <vector>
 #include <memory>
+#include "storage.hpp"
 
 class Tensor;
 
 struct GradFn {
     virtual ~GradFn() = default;
-    virtual void backward(const std::vector<float>& grad_out) = 0;
+    virtual void backward(const Storage& grad_out) = 0;
     virtual std::vector<Tensor*> parents() = 0;
+    // 性能剖析用：节点名与反向的浮点运算量估计 (0 表示按梯度元素数 × 输入数估计)
+    virtual const char* name() const { return "GradFn"; }
+    virtual uint64_t flops() const { return 0; }
+    // backward 里会对另一张图再调用 Tensor::backward (检查点重算)：它执行完之前，
+    // 外层反向不触发叶子的梯度就绪钩子
+    virtual bool reenters_backward() const { return false; }
 
 protected:
     void accumulate(Tensor* t, const std::vector<float>& g);
+    void accumulate(Tensor* t, const Storage& g);
+    void accumulate_rows(Tensor* t, const std::vector<size_t>& rows, const Storage& values);
 };
 
+// --- 梯度模式 ---
+// 关闭时算子照常计算，但不挂 grad_fn：输出不需要梯度，也不保留输入。线程局部，默认开启
+bool is_grad_enabled();
+void set_grad_enabled(bool enabled);
+
+// 构造时设置梯度模式，析构时恢复
+class GradModeGuard {
+public:
+    explicit GradModeGuard(bool enabled);
+    ~GradModeGuard();
+    GradModeGuard(const GradModeGuard&) = delete;
+    GradModeGuard& operator=(const GradModeGuard&) = delete;
+
+private:
+    bool saved_;
+};
+
+class NoGradGuard : public GradModeGuard {
+public:
+    NoGradGuard() : GradModeGuard(false) {}
+};
+
+// 梯度模式关闭期间被丢弃的 grad_fn 个数 (本线程累计)，即本该建立的反向边数
+size_t dropped_grad_fn_count();
+void note_dropped_grad_fn(); // any_requires_grad / Tensor::set_grad_fn 在梯度模式关闭时调用
+
+// 算子据此决定输出是否需要梯度：任一输入需要梯度且梯度模式开启。
+// 梯度模式关闭时返回 false，算子不分配梯度缓冲、不构造 GradFn，只把这条反向边记入 dropped_grad_fn_count
+template <typename... Ts>
+bool any_requires_grad(const Ts&... ts) {
+    if (!(ts.requires_grad() || ...)) return false;
+    if (is_grad_enabled()) return true;
+    note_dropped_grad_fn();
+    return false;
+}
+
 // // --- Add ---
 // struct AddGradFn : public GradFn {
 //     Tensor a_, b_;
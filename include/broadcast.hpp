@@ -0,0 +1,223 @@
+#pragma once
+#include "parallel.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// --- 按秩特化的广播 / 逐元素循环 ---
+// 输出 (操作数 0) 与各输入 (操作数 1..N) 先整理成 BroadcastLayout：去掉长度为 1 的维，
+// 把对所有操作数都连续的相邻维合并，广播维的步长记为 0。合并后最内层维上每个输入的步长
+// 只可能是 1 (连续) 或 0 (沿该维广播)。
+// 循环嵌套按合并后的秩 (1..6) 在编译期展开：外层维只做指针加步长，最内层是一整行，
+// 逐元素不再做下标展开 / 折叠。broadcast_map 还把最内层各输入的连续 / 广播模式作为模板参数，
+// 每个 (秩, 算子, 广播模式) 组合各自实例化成可自动向量化的内层循环，运行时只按 layout 选一次。
+// 合并后仍超过 6 维时，多出的前导维用计数器推进，后 6 维照常走展开的循环。
+
+constexpr size_t kMaxBroadcastRank = 6;
+constexpr size_t kBroadcastGrain = 1 << 14;
+
+struct BroadcastLayout {
+    size_t rank{0};
+    std::vector<size_t> shape;   // 合并后的输出形状
+    std::vector<size_t> strides; // strides[k * rank + d]：操作数 k 在第 d 维的步长 (元素)
+
+    size_t num_operands() const { return strides.size() / rank; }
+    size_t stride(size_t k, size_t d) const { return strides[k * rank + d]; }
+    // 操作数 k 在最内层维上连续 (否则沿最内层广播)
+    bool inner_contiguous(size_t k) const { return stride(k, rank - 1) == 1; }
+    // 第 0 维之后每个下标覆盖的元素数
+    size_t inner_numel() const {
+        size_t n = 1;
+        for (size_t d = 1; d < rank; ++d) n *= shape[d];
+        return n;
+    }
+};
+
+// in_shapes 按右对齐规则广播到 out_shape；不可广播时抛异常
+inline BroadcastLayout make_broadcast_layout(const std::vector<size_t>& out_shape,
+                                             const std::vector<const std::vector<size_t>*>& in_shapes) {
+    const size_t ndim = out_shape.size();
+    const size_t nops = in_shapes.size() + 1;
+    // 1. 各操作数在输出每一维上的步长
+    std::vector<std::vector<size_t>> st(nops, std::vector<size_t>(ndim, 0));
+    size_t s = 1;
+    for (size_t d = ndim; d-- > 0;) {
+        st[0][d] = s;
+        s *= out_shape[d];
+    }
+    for (size_t k = 1; k < nops; ++k) {
+        const auto& in = *in_shapes[k - 1];
+        if (in.size() > ndim) throw std::runtime_error("broadcast shape mismatch");
+        size_t stride = 1;
+        for (size_t j = in.size(); j-- > 0;) {
+            size_t d = ndim - in.size() + j;
+            if (in[j] != 1 && in[j] != out_shape[d]) throw std::runtime_error("broadcast shape mismatch");
+            st[k][d] = in[j] == 1 ? 0 : stride;
+            stride *= in[j];
+        }
+    }
+
+    // 2. 去掉长度为 1 的维，外层维对所有操作数都能接上内层维时合并
+    std::vector<size_t> shape;
+    std::vector<std::vector<size_t>> merged(nops);
+    for (size_t d = 0; d < ndim; ++d) {
+        if (out_shape[d] == 1) continue;
+        bool mergeable = !shape.empty();
+        for (size_t k = 0; k < nops && mergeable; ++k) mergeable = merged[k].back() == st[k][d] * out_shape[d];
+        if (mergeable) {
+            shape.back() *= out_shape[d];
+            for (size_t k = 0; k < nops; ++k) merged[k].back() = st[k][d];
+            continue;
+        }
+        shape.push_back(out_shape[d]);
+        for (size_t k = 0; k < nops; ++k) merged[k].push_back(st[k][d]);
+    }
+    if (shape.empty()) { // 单元素输出
+        shape.push_back(1);
+        for (size_t k = 0; k < nops; ++k) merged[k].push_back(1);
+    }
+
+    BroadcastLayout l;
+    l.rank = shape.size();
+    l.shape = std::move(shape);
+    l.strides.reserve(nops * l.rank);
+    for (const auto& m : merged) l.strides.insert(l.strides.end(), m.begin(), m.end());
+    return l;
+}
+
+// 第 first + D 维的循环；off 为各操作数的当前偏移，循环结束后恢复原值
+template <size_t R, size_t D, typename Row>
+void broadcast_nest(const BroadcastLayout& l, size_t first, size_t lo, size_t hi, size_t* off, Row& row) {
+    if constexpr (D + 1 == R) {
+        row(static_cast<const size_t*>(off), hi - lo);
+    } else {
+        const size_t nops = l.num_operands();
+        const size_t dim = first + D;
+        for (size_t i = lo; i < hi; ++i) {
+            broadcast_nest<R, D + 1>(l, first, 0, l.shape[dim + 1], off, row);
+            for (size_t k = 0; k < nops; ++k) off[k] += l.stride(k, dim);
+        }
+        for (size_t k = 0; k < nops; ++k) off[k] -= (hi - lo) * l.stride(k, dim);
+    }
+}
+
+// 运行时 p 选出编译期的 P，调用 fn(std::integral_constant<unsigned, P>)
+template <unsigned P, unsigned Count, typename Fn>
+void broadcast_dispatch_pattern(unsigned p, Fn& fn) {
+    if constexpr (P < Count) {
+        if (p == P) fn(std::integral_constant<unsigned, P>{});
+        else broadcast_dispatch_pattern<P + 1, Count>(p, fn);
+    }
+}
+
+// 一行：o[i] = f(in_k[i] 或 in_k[0])，P 的第 k 位表示第 k 个输入沿这一行连续
+template <unsigned P, typename O, typename F, size_t... K, typename... In>
+inline void broadcast_map_row(O* o, size_t n, F& f, std::index_sequence<K...>, const In*... in) {
+    for (size_t i = 0; i < n; ++i) o[i] = f(in[((P >> K) & 1u) ? i : 0]...);
+}
+
+// 对 layout 第 0 维的 [lo, hi) 逐行调用 row(off, n)：off[k] 为操作数 k 在行首的偏移，n 为行长。
+// 秩 1 时整段 [lo, hi) 就是一行
+template <typename Row>
+void for_each_row(const BroadcastLayout& l, size_t lo, size_t hi, Row&& row) {
+    if (lo >= hi) return;
+    const size_t nops = l.num_operands();
+    std::vector<size_t> off(nops);
+    for (size_t k = 0; k < nops; ++k) off[k] = lo * l.stride(k, 0);
+    switch (l.rank) {
+    case 1: broadcast_nest<1, 0>(l, 0, lo, hi, off.data(), row); return;
+    case 2: broadcast_nest<2, 0>(l, 0, lo, hi, off.data(), row); return;
+    case 3: broadcast_nest<3, 0>(l, 0, lo, hi, off.data(), row); return;
+    case 4: broadcast_nest<4, 0>(l, 0, lo, hi, off.data(), row); return;
+    case 5: broadcast_nest<5, 0>(l, 0, lo, hi, off.data(), row); return;
+    case 6: broadcast_nest<6, 0>(l, 0, lo, hi, off.data(), row); return;
+    default: break;
+    }
+    // 前导维用计数器推进，每个位置跑一遍后 6 维
+    const size_t first = l.rank - kMaxBroadcastRank;
+    std::vector<size_t> idx(first, 0);
+    idx[0] = lo;
+    for (;;) {
+        broadcast_nest<kMaxBroadcastRank, 0>(l, first, 0, l.shape[first], off.data(), row);
+        size_t d = first;
+        while (d-- > 0) {
+            ++idx[d];
+            for (size_t k = 0; k < nops; ++k) off[k] += l.stride(k, d);
+            if (d == 0) {
+                if (idx[0] == hi) return;
+                break;
+            }
+            if (idx[d] < l.shape[d]) break;
+            for (size_t k = 0; k < nops; ++k) off[k] -= idx[d] * l.stride(k, d);
+            idx[d] = 0;
+        }
+    }
+}
+
+// broadcast_map 的一个输入：数据与形状 (形状按右对齐规则广播到输出)
+template <typename T>
+struct BroadcastInput {
+    const T* data;
+    const std::vector<size_t>* shape;
+};
+
+template <typename T>
+BroadcastInput<T> broadcast_input(const T* data, const std::vector<size_t>& shape) { return {data, &shape}; }
+
+template <unsigned P, typename O, typename F, size_t... K, typename... In>
+void broadcast_map_rows(const BroadcastLayout& l, size_t lo, size_t hi, O* out, F& f, std::index_sequence<K...> seq,
+              const In*... in) {
+    for_each_row(l, lo, hi, [&](const size_t* off, size_t n) {
+        broadcast_map_row<P>(out + off[0], n, f, seq, (in + off[K + 1])...);
+    });
+}
+
+// out[i] = f(各输入在 i 处的广播值)，按第 0 维并行。f 的返回值转成 O
+template <typename O, typename F, typename... In>
+void broadcast_map(const std::vector<size_t>& out_shape, O* out, F f, BroadcastInput<In>... in) {
+    static_assert(sizeof...(In) >= 1 && sizeof...(In) <= 4, "broadcast_map supports 1 to 4 inputs");
+    size_t numel = 1;
+    for (size_t d : out_shape) numel *= d;
+    if (numel == 0) return;
+    const BroadcastLayout l = make_broadcast_layout(out_shape, {in.shape...});
+    unsigned pattern = 0;
+    for (size_t k = 0; k < sizeof...(In); ++k) {
+        if (l.inner_contiguous(k + 1)) pattern |= 1u << k;
+    }
+    const size_t grain = std::max<size_t>(1, kBroadcastGrain / l.inner_numel());
+
+    auto run = [&](auto p) {
+        constexpr unsigned P = decltype(p)::value;
+        parallel_for(0, l.shape[0], grain, [&](size_t lo, size_t hi) {
+            broadcast_map_rows<P>(l, lo, hi, out, f, std::index_sequence_for<In...>{}, in.data...);
+        });
+    };
+    broadcast_dispatch_pattern<0, (1u << sizeof...(In))>(pattern, run);
+}
+
+// dst (dst_shape) += src (src_shape) 按广播规则求和；src_shape 为广播后的形状。串行执行
+template <typename T>
+void broadcast_reduce_sum(const T* src, const std::vector<size_t>& src_shape, T* dst,
+                          const std::vector<size_t>& dst_shape) {
+    size_t numel = 1;
+    for (size_t d : src_shape) numel *= d;
+    if (numel == 0) return;
+    const BroadcastLayout l = make_broadcast_layout(src_shape, {&dst_shape});
+    if (l.inner_contiguous(1)) {
+        for_each_row(l, 0, l.shape[0], [&](const size_t* off, size_t n) {
+            const T* s = src + off[0];
+            T* d = dst + off[1];
+            for (size_t i = 0; i < n; ++i) d[i] += s[i];
+        });
+    } else {
+        for_each_row(l, 0, l.shape[0], [&](const size_t* off, size_t n) {
+            const T* s = src + off[0];
+            T acc = T(0);
+            for (size_t i = 0; i < n; ++i) acc += s[i];
+            dst[off[1]] += acc;
+        });
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "serialize.hpp"
+#include "module.hpp"
+#include "optim.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// --- AsyncCheckpointer：训练循环只付出一次 memcpy 的异步检查点 ---
+// save() 在调用线程上把参数 (以及优化器状态) 拷进暂存缓冲后立即返回；
+// 后台线程把快照写到 path + ".tmp"，fsync 后原子 rename 为 path，再 fsync 所在目录，
+// 因此 path 要么是旧的完整文件，要么是新的完整文件。
+// 同时未落盘的快照最多 max_in_flight 个，超过时 save() 阻塞到最早的一个写完；暂存缓冲循环复用。
+// 文件格式与 save_tensors 相同，优化器状态以 "optim.<name>" 与 "optim.step" (int64) 保存。
+class AsyncCheckpointer {
+public:
+    explicit AsyncCheckpointer(size_t max_in_flight = 2);
+    ~AsyncCheckpointer(); // 等待已提交的快照全部落盘
+    AsyncCheckpointer(const AsyncCheckpointer&) = delete;
+    AsyncCheckpointer& operator=(const AsyncCheckpointer&) = delete;
+
+    void save(const std::string& path, const NamedTensors& tensors, Optimizer* opt = nullptr);
+    void save(const std::string& path, const Module& m, Optimizer* opt = nullptr);
+
+    // 阻塞到全部快照落盘；后台写盘的异常在这里 (或下一次 save) 重新抛出
+    void wait();
+    size_t in_flight() const;
+    size_t completed() const;
+
+private:
+    struct Job {
+        std::string path;
+        Storage staging;
+        NamedTensors views; // staging 中各张量的视图
+    };
+
+    void writer_loop();
+    void rethrow_error(); // 需持有 mu_
+
+    size_t max_in_flight_;
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<std::unique_ptr<Job>> queue_;
+    std::vector<Storage> pool_; // 写完归还的暂存缓冲
+    size_t in_flight_{0};
+    size_t completed_{0};
+    bool stop_{false};
+    std::exception_ptr error_;
+    std::thread thread_;
+};
+
+// 读取 AsyncCheckpointer / save_tensors 写出的文件：参数按名字拷回模块，
+// opt 非空时恢复其状态缓冲与步数
+void load_checkpoint(const std::string& path, Module& m, Optimizer* opt = nullptr);
@@ -0,0 +1,90 @@
+#pragma once
+#include "tensor.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// --- Dataset：按下标取样本 ---
+// 每个样本由若干个定长字段组成 (如 input、label)，sample_shapes() 给出每个字段的形状。
+// get(index, out) 把第 index 个样本的第 f 个字段写进 out[f]（长度为该字段元素数），
+// DataLoader 让 out 直接指向预分配 batch 张量中的对应行，不为单个样本构造 Tensor。
+// get 会被多个 worker 线程同时调用，实现必须是线程安全的。
+class Dataset {
+public:
+    virtual ~Dataset() = default;
+    virtual size_t size() const = 0;
+    virtual std::vector<std::vector<size_t>> sample_shapes() const = 0;
+    virtual void get(size_t index, const std::vector<float*>& out) const = 0;
+};
+
+// --- TensorDataset：若干个首维对齐的张量，第 i 个样本是它们各自的第 i 行 ---
+class TensorDataset : public Dataset {
+public:
+    explicit TensorDataset(std::vector<Tensor> tensors);
+    size_t size() const override;
+    std::vector<std::vector<size_t>> sample_shapes() const override;
+    void get(size_t index, const std::vector<float*>& out) const override;
+
+private:
+    std::vector<Tensor> tensors_;
+};
+
+struct DataLoaderOptions {
+    size_t batch_size = 1;
+    bool shuffle = false;
+    bool drop_last = false;
+    size_t num_workers = 2;  // 0 表示在调用 next() 的线程里同步加载
+    size_t prefetch = 4;     // 环形缓冲中的 batch 槽数，即最多提前准备好的 batch 数
+    uint64_t seed = 0;       // 第 e 个 epoch 的顺序由 (seed, e) 决定，与线程数无关
+};
+
+struct DataLoaderState;
+
+// --- Batch：环形缓冲中一个槽的租约 ---
+// fields[f] 形状为 [n, sample_shapes()[f]...]，是槽内预分配内存的视图。
+// Batch 析构 (或传给下一次 next()) 时槽被归还并会被后续 batch 覆盖，
+// 需要保留数据时请自行拷贝。
+class Batch {
+public:
+    Batch() = default;
+    Batch(Batch&& other) noexcept;
+    Batch& operator=(Batch&& other) noexcept;
+    Batch(const Batch&) = delete;
+    Batch& operator=(const Batch&) = delete;
+    ~Batch();
+
+    void release();
+    size_t size() const { return indices.size(); }
+
+    std::vector<Tensor> fields;
+    std::vector<size_t> indices; // 本 batch 的样本下标
+
+private:
+    friend class DataLoader;
+    std::shared_ptr<DataLoaderState> state_;
+    size_t slot_{0};
+};
+
+// --- DataLoader ---
+// batch 张量在构造时一次性分配 (prefetch 个槽)，之后循环复用。
+// worker 线程按 batch 编号顺序认领空槽并填充；第 k 个 batch 固定写入槽 k % prefetch，
+// 主线程只按顺序等待槽就绪，因此输出顺序是确定的。worker 会跨 epoch 边界继续预取。
+//
+//   for (Batch b; loader.next(b);) { ... }   // 一个 epoch，结束时返回 false，再调用即进入下一个 epoch
+class DataLoader {
+public:
+    DataLoader(std::shared_ptr<Dataset> dataset, DataLoaderOptions options);
+    ~DataLoader();
+    DataLoader(const DataLoader&) = delete;
+    DataLoader& operator=(const DataLoader&) = delete;
+
+    // 取下一个 batch，out 原来持有的槽先被归还。当前 epoch 结束时返回 false
+    bool next(Batch& out);
+
+    size_t num_batches() const; // 每个 epoch 的 batch 数
+    size_t epoch() const;       // 当前 epoch (从 0 开始)
+
+private:
+    std::shared_ptr<DataLoaderState> state_;
+};
@@ -0,0 +1,198 @@
+#pragma once
+#include "module.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// --- 集合通信 ---
+// ProcessGroup 是一组 rank 之间的集合操作接口：组内每个 rank 必须以相同的顺序、相同长度的缓冲
+// 调用同一串集合操作。缓冲为 Float32 或 Float64 的 Storage (梯度、参数、arena 均可直接传入)。
+enum class ReduceOp { Sum, Mean };
+
+class ProcessGroup {
+public:
+    virtual ~ProcessGroup() = default;
+
+    virtual size_t rank() const = 0;
+    virtual size_t size() const = 0;
+
+    virtual void barrier() = 0;
+    // 各 rank 的 buf 逐元素归约 (Mean 为求和后除以 size())，结果写回每个 rank 的 buf
+    virtual void all_reduce(Storage& buf, ReduceOp op = ReduceOp::Sum) = 0;
+    // 把 root 的 buf 拷到其余 rank 的 buf
+    virtual void broadcast(Storage& buf, size_t root) = 0;
+    // out 长度为 size() * in.size()，第 r 段为 rank r 的 in
+    virtual void all_gather(const Storage& in, Storage& out) = 0;
+};
+
+// --- 进程内 (线程) 后端 ---
+// world_size 个线程各用 handle(r) 拿到自己的 rank，集合操作直接读写彼此的缓冲，不经过中间拷贝。
+// all_reduce = reduce-scatter + all-gather：缓冲切成 world_size 段，rank r 负责第 r 段，
+// 按块 (留在 L1/L2 里) 把其余 rank 的同一段累加进自己的缓冲；同步后各 rank 从负责者那里拷回其余段。
+// 所有 rank 同时工作，每个元素只被读写常数次，结果在各 rank 上逐位一致。
+class ThreadGroup {
+public:
+    explicit ThreadGroup(size_t world_size);
+    ~ThreadGroup();
+    ThreadGroup(const ThreadGroup&) = delete;
+    ThreadGroup& operator=(const ThreadGroup&) = delete;
+
+    size_t size() const { return handles_.size(); }
+    ProcessGroup& handle(size_t rank);
+
+    struct Shared; // 各 rank 共享的同步状态与缓冲地址
+
+private:
+    std::shared_ptr<Shared> shared_;
+    std::vector<std::unique_ptr<ProcessGroup>> handles_;
+};
+
+// --- 多进程共享内存后端 ---
+// 同一台机器上的 world_size 个进程 (例如每个 socket 一个) 用相同的 name / world_size / capacity_bytes
+// 构造，各自传入自己的 rank。rank 0 用 shm_open 创建共享内存段，其余 rank 等段就绪后映射；
+// 全部连上后 rank 0 立即 shm_unlink，段随最后一个进程解除映射而释放，之后 name 可以复用
+// (同一时刻一个 name 只能有一个组在用)。
+// 段内每个 rank 有 capacity_bytes 的暂存区，分成两格环形使用：缓冲按格大小分片，第 k 片写进
+// 第 k % 2 格，写下一片前不必等其余 rank 读完上一片。all_reduce 的每片先拷进暂存区，再按
+// ThreadGroup 的方式 reduce-scatter + all-gather，结果在各进程上逐位一致。
+// 同步用段内的计数器 + futex：短暂自旋后睡眠，由最后到达的 rank 唤醒。等待超过 timeout_ms
+// (对端进程退出、各 rank 调用顺序不一致) 时抛异常，此后该组不可再用。
+// 以后的跨机 (TCP 等) 后端同样实现 ProcessGroup 即可替换，上层代码不变。
+class ShmGroup : public ProcessGroup {
+public:
+    ShmGroup(const std::string& name, size_t rank, size_t world_size,
+             size_t capacity_bytes = size_t(8) << 20, int timeout_ms = 60000);
+    ~ShmGroup() override;
+    ShmGroup(const ShmGroup&) = delete;
+    ShmGroup& operator=(const ShmGroup&) = delete;
+
+    size_t rank() const override { return rank_; }
+    size_t size() const override { return world_; }
+
+    void barrier() override;
+    void all_reduce(Storage& buf, ReduceOp op = ReduceOp::Sum) override;
+    void broadcast(Storage& buf, size_t root) override;
+    void all_gather(const Storage& in, Storage& out) override;
+
+    struct Header; // 段头：同步计数器
+    struct Meta;   // 每个 rank 本次集合操作的描述
+
+private:
+    // 写入本 rank 的描述并等齐所有 rank；描述不一致或任一 rank 给出 invalid 时所有 rank 一起抛异常
+    void publish(const Meta& m, const char* op, const char* invalid);
+    // rank q 当前环形格的暂存区
+    char* slot(size_t q) const;
+    void advance() { ring_ ^= 1; }
+
+    std::string name_;
+    size_t rank_, world_;
+    int timeout_ms_;
+    char* base_{nullptr};
+    size_t map_bytes_{0};
+    size_t slot_bytes_{0};
+    size_t ring_{0};
+    Header* header_{nullptr};
+    Meta* metas_{nullptr};
+    char* slots_{nullptr};
+};
+
+// --- DataParallel：进程内数据并行 ---
+// make_replica 每次返回一个新的模型副本；构造时各副本打包参数 (flatten_parameters)，
+// 并把副本 0 的参数拷给其余副本。每个副本由一个常驻线程驱动，线程内的 parallel_for 串行执行，
+// 与算子内并行互补 (适合单个 batch 太小、算子内并行扩展不上去的模型)。
+// run(step, after_reduce)：
+//   1. 每个线程执行 step(rank, replica)，通常是对自己那一份 batch 做前向 + backward；
+//   2. 全部成功后对各副本的梯度 arena 做 all_reduce 求平均；
+//   3. 每个线程执行 after_reduce(rank, replica) (可为空)，通常是各自的优化器 step。
+// 梯度平均后各副本完全一致，各自更新即可保持参数同步。任一线程抛出的异常在 run 中重新抛出。
+// 不支持行稀疏梯度的参数。
+class DataParallel {
+public:
+    using ReplicaFn = std::function<void(size_t, Module&)>;
+
+    DataParallel(size_t num_replicas, const std::function<std::shared_ptr<Module>()>& make_replica);
+    ~DataParallel();
+    DataParallel(const DataParallel&) = delete;
+    DataParallel& operator=(const DataParallel&) = delete;
+
+    size_t size() const { return replicas_.size(); }
+    Module& replica(size_t r) { return *replicas_.at(r); }
+
+    void run(const ReplicaFn& step, const ReplicaFn& after_reduce = nullptr);
+
+private:
+    // 在每个副本线程上执行 job(rank)，等全部结束；返回第一个异常 (没有则为空)
+    std::exception_ptr dispatch(const std::function<void(size_t)>& job);
+    void worker_loop(size_t rank);
+
+    std::vector<std::shared_ptr<Module>> replicas_;
+    ThreadGroup group_;
+    std::vector<std::thread> workers_;
+    std::mutex mu_;
+    std::condition_variable cv_, done_cv_;
+    const std::function<void(size_t)>* job_{nullptr};
+    size_t generation_{0};
+    size_t pending_{0};
+    std::exception_ptr error_;
+    bool stop_{false};
+};
+
+// --- BucketReducer：与 backward 重叠的分桶梯度 all_reduce ---
+// 参数按 params 的逆序装进约 bucket_bytes 的桶：对按前向顺序注册参数的模型 (Module::parameters())，
+// 这就是反向拓扑序，也是 backward 中梯度就绪的顺序。构造时给每个参数注册梯度就绪钩子，
+// 一个桶的参数全部就绪后立即交给后台通信线程做 all_reduce，backward 同时继续计算前面的层。
+// 通信线程严格按桶的编号依次归约，各 rank 的集合操作顺序因此总是一致。
+// 桶内梯度在 arena 中首尾相接时 (flatten_parameters 之后) 直接对 arena 的切片做 all_reduce，
+// 否则先拷进桶自己的缓冲，归约后再拷回。
+// 每次 backward 之后调用 finish()：本轮没有就绪的参数 (没参与计算) 所在的桶此时补发，
+// 等所有桶归约完成后为下一轮复位，并重新抛出通信中的异常 (之后 pg 的状态不再可靠)。
+// 各 rank 必须用相同的参数列表与 bucket_bytes 构造；reducer 存活期间 pg 只由它的通信线程使用。
+// 不支持行稀疏梯度；同一轮里一个参数的钩子触发两次 (如一轮里调用了两次 backward) 时抛异常。
+class BucketReducer {
+public:
+    BucketReducer(const std::vector<Tensor>& params, ProcessGroup& pg, ReduceOp op = ReduceOp::Mean,
+                  size_t bucket_bytes = size_t(25) << 20);
+    ~BucketReducer();
+    BucketReducer(const BucketReducer&) = delete;
+    BucketReducer& operator=(const BucketReducer&) = delete;
+
+    size_t num_buckets() const { return buckets_.size(); }
+    size_t launched() const; // 本轮已交给通信线程的桶数
+    void finish();
+
+private:
+    struct Bucket {
+        std::vector<size_t> params; // params_ 中的下标
+        Storage buffer;             // 零拷贝时为 arena 梯度切片的视图
+        bool zero_copy{false};
+        size_t pending{0};          // 本轮尚未就绪的参数数
+        bool launched{false};
+    };
+
+    void mark_ready(size_t param);
+    void launch(Bucket& b); // 调用方持有 mu_
+    void comm_loop();
+
+    std::vector<Tensor> params_;
+    std::vector<size_t> hook_ids_;
+    std::vector<size_t> bucket_of_;
+    std::vector<bool> ready_;
+    std::vector<Bucket> buckets_;
+    ProcessGroup& pg_;
+    ReduceOp op_;
+    mutable std::mutex mu_;
+    std::condition_variable cv_, done_cv_;
+    size_t launched_{0}, completed_{0};
+    std::exception_ptr error_;
+    bool stop_{false};
+    std::thread comm_;
+};
+
+// batch 按第 0 维切成 parts 份，返回第 part 份的拷贝；前 rows % parts 份各多一行
+Tensor shard_rows(const Tensor& batch, size_t part, size_t parts);
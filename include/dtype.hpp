@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// --- 元素类型 ---
+// Float16 为 IEEE binary16，BFloat16 为 fp32 的高 16 位；二者只用于存储，
+// 参与计算时先转成 fp32，累加也在 fp32 中完成。
+// Float64 主要用于梯度检查；整数类型用于下标 / 标签，UInt8 同时作为比较运算产生的 0/1 掩码。
+enum class DType : uint8_t { Float32, Float16, BFloat16, Float64, Int32, Int64, UInt8 };
+
+size_t dtype_size(DType dtype);
+const char* dtype_name(DType dtype);
+
+inline bool is_floating_point(DType d) { return d != DType::Int32 && d != DType::Int64 && d != DType::UInt8; }
+inline bool is_half(DType d) { return d == DType::Float16 || d == DType::BFloat16; }
+
+// 逐元素运算的结果类型：
+// 相同则不变；有 Float64 则为 Float64；浮点与整数混合取浮点那一方；两种不同的浮点提升为 Float32；
+// 两种整数取更宽的一方 (UInt8 < Int32 < Int64)
+DType promote_types(DType a, DType b);
+
+// 梯度的存储类型：Float64 张量的梯度也是 Float64，其余浮点类型的梯度都是 Float32
+inline DType grad_dtype(DType d) { return d == DType::Float64 ? DType::Float64 : DType::Float32; }
+
+// --- C++ 类型与 DType 的对应 (半精度没有对应的算术类型，不在其中) ---
+template <typename T> struct DTypeOf;
+template <> struct DTypeOf<float> { static constexpr DType value = DType::Float32; };
+template <> struct DTypeOf<double> { static constexpr DType value = DType::Float64; };
+template <> struct DTypeOf<int32_t> { static constexpr DType value = DType::Int32; };
+template <> struct DTypeOf<int64_t> { static constexpr DType value = DType::Int64; };
+template <> struct DTypeOf<uint8_t> { static constexpr DType value = DType::UInt8; };
+template <typename T> constexpr DType dtype_of() { return DTypeOf<T>::value; }
+
+// 按运行时 dtype 实例化模板内核：传入的 [&] lambda 里用 scalar_t 指代元素类型。
+// 只覆盖有算术类型的 dtype，半精度输入应先在 fp32 中计算 (见 ops.cpp 的 binary_mixed)
+#define MINIDL_DISPATCH_CASE(DT, TYPE, ...) \
+    case DT: {                              \
+        using scalar_t = TYPE;              \
+        return __VA_ARGS__();               \
+    }
+
+#define MINIDL_DISPATCH_ALL_TYPES(DTYPE, NAME, ...)                                       \
+    [&] {                                                                                 \
+        switch (DTYPE) {                                                                  \
+            MINIDL_DISPATCH_CASE(DType::Float32, float, __VA_ARGS__)                      \
+            MINIDL_DISPATCH_CASE(DType::Float64, double, __VA_ARGS__)                     \
+            MINIDL_DISPATCH_CASE(DType::Int32, int32_t, __VA_ARGS__)                      \
+            MINIDL_DISPATCH_CASE(DType::Int64, int64_t, __VA_ARGS__)                      \
+            MINIDL_DISPATCH_CASE(DType::UInt8, uint8_t, __VA_ARGS__)                      \
+        default:                                                                          \
+            throw std::runtime_error(std::string(NAME) + ": unsupported dtype " + dtype_name(DTYPE)); \
+        }                                                                                 \
+    }()
+
+#define MINIDL_DISPATCH_FLOATING_TYPES(DTYPE, NAME, ...)                                  \
+    [&] {                                                                                 \
+        switch (DTYPE) {                                                                  \
+            MINIDL_DISPATCH_CASE(DType::Float32, float, __VA_ARGS__)                      \
+            MINIDL_DISPATCH_CASE(DType::Float64, double, __VA_ARGS__)                     \
+        default:                                                                          \
+            throw std::runtime_error(std::string(NAME) + ": unsupported dtype " + dtype_name(DTYPE)); \
+        }                                                                                 \
+    }()
+
+// 标量转换，fp32 -> 半精度均为 round-to-nearest-even，NaN/Inf 保持
+uint16_t float_to_half(float f);
+float half_to_float(uint16_t h);
+uint16_t float_to_bf16(float f);
+float bf16_to_float(uint16_t h);
+
+// 批量转换 n 个元素，任意两种 dtype 之间都可以。fp32 <-> 半精度在 x86 上按 CPU 运行时选择
+// F16C / AVX-512 BF16 / AVX2 内核，否则走标量路径；浮点转整数按 C++ 规则截断。
+// 不并行，调用方自己切块 (数据量大时用 convert_parallel)
+void convert(const void* src, DType src_dtype, void* dst, DType dst_dtype, size_t n);
+void convert_parallel(const void* src, DType src_dtype, void* dst, DType dst_dtype, size_t n);
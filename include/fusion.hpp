@@ -0,0 +1,48 @@
+#pragma once
+#include "graph.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// --- 图级算子融合 ---
+// fuse_graph 改写录制好的图 (应在 plan_memory 之前调用)：
+//   1. matmul 后面紧跟的 bias 加法 ([n] 或 [1, n]) 和 / 或 relu 折进 matmul 的 epilogue，
+//      每行算完直接加 bias、过激活再写出；反向由一个 FusedLinearGradFn 完成，只保存 relu 的 1 字节掩码。
+//   2. 连续的逐元素算子 (张量 × 张量可广播、张量 × 标量、neg、relu) 合成一个 kernel，一遍读输入写输出；
+//      反向由 FusedElementwiseGradFn 逐元素重算中间值，一遍得到所有外部输入的梯度，不保存中间结果。
+// 被融合掉的中间张量只能被链上的下一个算子使用，且不能是图的输出。输出 requires_grad 但没有
+// grad_fn 的算子 (张量 × 标量) 会截断梯度，只有在不需要梯度时才参与融合。
+// 融合后的输出张量换上融合的 GradFn，原来每个算子的 GradFn 与被跳过的反向步骤一起删除。
+struct FusionStats {
+    size_t nodes_before{0};
+    size_t nodes_after{0};
+    size_t elementwise_chains{0}; // 融合出的逐元素链数量
+    size_t matmul_epilogues{0};   // 折进 matmul 的 bias / 激活组合数量
+};
+
+FusionStats fuse_graph(CapturedGraph& g);
+
+// --- 融合 kernel (同时供融合节点与其 GradFn 使用) ---
+
+constexpr size_t kNoSide = static_cast<size_t>(-1);
+
+// 逐元素链上的一步：v = op(v, inputs[side]) (chain_lhs 为 false 时为 op(inputs[side], v))，
+// 标量运算用 scalar，单目运算 side 为 kNoSide
+struct FusedStep {
+    OpKind kind;
+    size_t side{kNoSide};
+    bool chain_lhs{true};
+    float scalar{0.0f};
+};
+
+// 链从 inputs[0] (广播到 out 的形状) 开始，依次应用 steps，结果写入 out。所有张量为 Float32
+void fused_elementwise_forward(const std::vector<Tensor>& inputs, const std::vector<FusedStep>& steps,
+                               Tensor& out);
+// grads[i] 为空表示不需要 inputs[i] 的梯度，否则为 inputs[i] 形状的 0 初值缓冲，结果累加进去
+void fused_elementwise_backward(const std::vector<Tensor>& inputs, const std::vector<FusedStep>& steps,
+                                const std::vector<size_t>& out_shape, const Storage& grad_out,
+                                std::vector<Storage>& grads);
+
+// out = act(x w + bias)，bias 可为空句柄；relu 时 mask (可为空) 记下 x w + bias > 0 的位置
+void fused_linear_forward(const Tensor& x, const Tensor& w, const Tensor& bias, bool relu,
+                          Tensor& out, uint8_t* mask);
@@ -4,29 +4,44 @@
 #include <memory>
 #include "autograd.hpp"
 #include "tensor.hpp" // 这里必须包含完整的 Tensor 定义
+#include "sparse.hpp"
+#include "fusion.hpp"
+#include "ops.hpp"
 
 // --- Add ---
 struct AddGradFn : public GradFn {
     Tensor a_, b_;
     AddGradFn(Tensor a, Tensor b) : a_(a), b_(b) {}
-    void backward(const std::vector<float>& grad_out) override; // 只留声明，去掉花括号实现
+    void backward(const Storage& grad_out) override; // 只留声明，去掉花括号实现
     std::vector<Tensor*> parents() override;
+    const char* name() const override { return "AddBackward"; }
 };
 
 // --- Sub ---
 struct SubGradFn : public GradFn {
     Tensor a_, b_;
     SubGradFn(Tensor a, Tensor b) : a_(a), b_(b) {}
-    void backward(const std::vector<float>& grad_out) override;
+    void backward(const Storage& grad_out) override;
     std::vector<Tensor*> parents() override;
+    const char* name() const override { return "SubBackward"; }
 };
 
 // --- Neg ---
 struct NegGradFn : public GradFn {
     Tensor a_;
     explicit NegGradFn(Tensor a) : a_(a) {}
-    void backward(const std::vector<float>& grad_out) override;
+    void backward(const Storage& grad_out) override;
     std::vector<Tensor*> parents() override;
+    const char* name() const override { return "NegBackward"; }
+};
+
+// --- ReLU ---
+struct ReluGradFn : public GradFn {
+    Tensor a_;
+    explicit ReluGradFn(Tensor a) : a_(a) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "ReluBackward"; }
 };
 
 // --- Mul ---
@@ -34,22 +49,221 @@ struct MulGradFn : public GradFn {
     Tensor a_, b_;
     MulGradFn(Tensor a, Tensor b) : a_(a), b_(b) {}
 
-    void backward(const std::vector<float>& grad_out) override;
+    void backward(const Storage& grad_out) override;
     std::vector<Tensor*> parents() override;
+    const char* name() const override { return "MulBackward"; }
 };
 
 // --- Div ---
 struct DivGradFn : public GradFn {
     Tensor a_, b_;
     DivGradFn(Tensor a, Tensor b) : a_(a), b_(b) {}
-    void backward(const std::vector<float>& grad_out) override;
+    void backward(const Storage& grad_out) override;
     std::vector<Tensor*> parents() override; // 仅声明
+    const char* name() const override { return "DivBackward"; }
 };
 
 // --- MatMul ---
 struct MatMulGradFn : public GradFn {
     Tensor a_, b_;
     MatMulGradFn(Tensor a, Tensor b) : a_(a), b_(b) {}
-    void backward(const std::vector<float>& grad_out) override;
+    void backward(const Storage& grad_out) override;
     std::vector<Tensor*> parents() override; // 仅声明
+    const char* name() const override { return "MatMulBackward"; }
+    uint64_t flops() const override { return 4 * uint64_t(a_.numel()) * b_.shape().back(); }
+};
+
+// --- Cast ---
+// 梯度始终是 fp32，直接传回输入
+struct CastGradFn : public GradFn {
+    Tensor src_;
+    explicit CastGradFn(Tensor src) : src_(src) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "CastBackward"; }
+};
+
+// --- Where ---
+struct WhereGradFn : public GradFn {
+    Tensor mask_, a_, b_;
+    WhereGradFn(Tensor mask, Tensor a, Tensor b) : mask_(mask), a_(a), b_(b) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "WhereBackward"; }
+};
+
+// --- LayerNorm ---
+// 只保存每行的 mean 与 rstd，反向时由 x 重算 x_hat
+struct LayerNormGradFn : public GradFn {
+    Tensor x_, gamma_, beta_;
+    std::vector<float> mean_, rstd_;
+    LayerNormGradFn(Tensor x, Tensor gamma, Tensor beta,
+                    std::vector<float> mean, std::vector<float> rstd)
+        : x_(x), gamma_(gamma), beta_(beta), mean_(std::move(mean)), rstd_(std::move(rstd)) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "LayerNormBackward"; }
+};
+
+// --- RMSNorm ---
+struct RMSNormGradFn : public GradFn {
+    Tensor x_, gamma_;
+    std::vector<float> rstd_;
+    RMSNormGradFn(Tensor x, Tensor gamma, std::vector<float> rstd)
+        : x_(x), gamma_(gamma), rstd_(std::move(rstd)) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "RMSNormBackward"; }
+};
+
+// --- BatchNorm ---
+// training_ 为 false 时 mean_/rstd_ 是 running 统计量（常数），反向只剩逐元素缩放
+struct BatchNormGradFn : public GradFn {
+    Tensor x_, gamma_, beta_;
+    std::vector<float> mean_, rstd_;
+    bool training_;
+    BatchNormGradFn(Tensor x, Tensor gamma, Tensor beta,
+                    std::vector<float> mean, std::vector<float> rstd, bool training)
+        : x_(x), gamma_(gamma), beta_(beta), mean_(std::move(mean)), rstd_(std::move(rstd)),
+          training_(training) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "BatchNormBackward"; }
+};
+
+// --- Embedding / EmbeddingBag ---
+// 反向把重复的 index 合并成唯一行，再交给 weight（稀疏或稠密）累加
+struct EmbeddingGradFn : public GradFn {
+    Tensor weight_;
+    std::vector<size_t> indices_;
+    std::vector<size_t> offsets_; // 为空表示普通 embedding，否则为 bag 起点
+    bool mean_;
+    EmbeddingGradFn(Tensor weight, std::vector<size_t> indices,
+                    std::vector<size_t> offsets, bool mean)
+        : weight_(weight), indices_(std::move(indices)), offsets_(std::move(offsets)), mean_(mean) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "EmbeddingBackward"; }
+};
+
+// --- Slice ---
+// 输出是 src_ 扁平内存 [offset_, offset_ + n) 的视图，反向把梯度放回对应区间
+struct SliceGradFn : public GradFn {
+    Tensor src_;
+    size_t offset_;
+    SliceGradFn(Tensor src, size_t offset) : src_(src), offset_(offset) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "SliceBackward"; }
+};
+
+// --- LSTM (整段序列一个节点) ---
+// 只保存激活后的门 [T, B, 4H]、各步 cell 状态 [T+1, B, H] 和隐状态 [T, B, H]
+// 挂在 [T+1, B, H] 的内部张量上：前 T 块是 output，最后一块是 c_n
+struct LSTMGradFn : public GradFn {
+    Tensor x_, h0_, c0_, w_ih_, w_hh_, bias_;
+    Storage acts_, cs_, hs_;
+    size_t T_, B_, I_, H_;
+    LSTMGradFn(Tensor x, Tensor h0, Tensor c0, Tensor w_ih, Tensor w_hh, Tensor bias,
+               Storage acts, Storage cs, Storage hs, size_t T, size_t B, size_t I, size_t H)
+        : x_(x), h0_(h0), c0_(c0), w_ih_(w_ih), w_hh_(w_hh), bias_(bias),
+          acts_(std::move(acts)), cs_(std::move(cs)), hs_(std::move(hs)), T_(T), B_(B), I_(I), H_(H) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "LSTMBackward"; }
+};
+
+// --- GRU (整段序列一个节点) ---
+// 每步保存 r, z, n 以及 h W_hn + b_hn，共 [T, B, 4H]，外加隐状态 [T, B, H]
+struct GRUGradFn : public GradFn {
+    Tensor x_, h0_, w_ih_, w_hh_, b_ih_, b_hh_;
+    Storage acts_, hs_;
+    size_t T_, B_, I_, H_;
+    GRUGradFn(Tensor x, Tensor h0, Tensor w_ih, Tensor w_hh, Tensor b_ih, Tensor b_hh,
+              Storage acts, Storage hs, size_t T, size_t B, size_t I, size_t H)
+        : x_(x), h0_(h0), w_ih_(w_ih), w_hh_(w_hh), b_ih_(b_ih), b_hh_(b_hh),
+          acts_(std::move(acts)), hs_(std::move(hs)), T_(T), B_(B), I_(I), H_(H) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "GRUBackward"; }
+};
+
+// --- SpMM ---
+// dX = A^T dY (用缓存的转置结构)，dvalues[e] = dot(dY[i], X[j])
+struct SpMMGradFn : public GradFn {
+    std::shared_ptr<const CSRPattern> pattern_;
+    Tensor values_, x_;
+    SpMMGradFn(std::shared_ptr<const CSRPattern> pattern, Tensor values, Tensor x)
+        : pattern_(std::move(pattern)), values_(values), x_(x) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "SpMMBackward"; }
+};
+
+// --- SDDMM ---
+// 把 grad_out [nnz] 当作同一结构的稀疏矩阵 G：dA = G B，dB = G^T A
+struct SDDMMGradFn : public GradFn {
+    std::shared_ptr<const CSRPattern> pattern_;
+    Tensor a_, b_;
+    SDDMMGradFn(std::shared_ptr<const CSRPattern> pattern, Tensor a, Tensor b)
+        : pattern_(std::move(pattern)), a_(a), b_(b) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "SDDMMBackward"; }
+};
+
+// --- Scaled dot-product attention ---
+// 只保存输出 out_ [BH, T, Dv] 与每行 logsumexp lse_ [BH, T]，反向按块重算 P = exp(s - lse)
+struct AttentionGradFn : public GradFn {
+    Tensor q_, k_, v_;
+    Storage out_, lse_;
+    size_t BH_, T_, S_, D_, Dv_;
+    bool causal_;
+    AttentionGradFn(Tensor q, Tensor k, Tensor v, Storage out, Storage lse,
+                    size_t BH, size_t T, size_t S, size_t D, size_t Dv, bool causal)
+        : q_(q), k_(k), v_(v), out_(std::move(out)), lse_(std::move(lse)),
+          BH_(BH), T_(T), S_(S), D_(D), Dv_(Dv), causal_(causal) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "AttentionBackward"; }
+    uint64_t flops() const override { return 2 * uint64_t(BH_) * T_ * S_ * (3 * D_ + 2 * Dv_); }
+};
+
+// --- 融合的逐元素链 ---
+// 只保存链的外部输入，反向逐元素重算链上的中间值，一遍得到全部输入的梯度
+struct FusedElementwiseGradFn : public GradFn {
+    std::vector<Tensor> inputs_;
+    std::vector<FusedStep> steps_;
+    std::vector<size_t> out_shape_;
+    FusedElementwiseGradFn(std::vector<Tensor> inputs, std::vector<FusedStep> steps, std::vector<size_t> out_shape)
+        : inputs_(std::move(inputs)), steps_(std::move(steps)), out_shape_(std::move(out_shape)) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "FusedElementwiseBackward"; }
+};
+
+// --- 融合的 matmul + bias + relu ---
+// relu 时只保存 1 字节掩码 mask_ (由融合节点每次前向刷新)，不保存 matmul / bias 加法的中间结果
+struct FusedLinearGradFn : public GradFn {
+    Tensor x_, w_, bias_; // bias_ 可为空句柄
+    bool relu_;
+    std::vector<uint8_t> mask_;
+    FusedLinearGradFn(Tensor x, Tensor w, Tensor bias, bool relu, std::vector<uint8_t> mask)
+        : x_(x), w_(w), bias_(bias), relu_(relu), mask_(std::move(mask)) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "FusedLinearBackward"; }
+    uint64_t flops() const override { return 4 * uint64_t(x_.numel()) * w_.shape().back(); }
+};
+
+// --- 激活重算 ---
+// 只保存片段的输入 inputs_，反向时重新执行 fn_ 并对重算出的图做一次反向
+struct CheckpointGradFn : public GradFn {
+    CheckpointFn fn_;
+    std::vector<Tensor> inputs_;
+    CheckpointGradFn(CheckpointFn fn, std::vector<Tensor> inputs) : fn_(std::move(fn)), inputs_(std::move(inputs)) {}
+    void backward(const Storage& grad_out) override;
+    std::vector<Tensor*> parents() override;
+    const char* name() const override { return "CheckpointBackward"; }
+    bool reenters_backward() const override { return true; }
 };
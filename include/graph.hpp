@@ -0,0 +1,97 @@
+#pragma once
+#include "tensor.hpp"
+#include <functional>
+#include <vector>
+
+// --- 图录制与重放 ---
+// 形状固定的训练步每次都执行同样的算子序列。capture_graph 在执行一次 fn 的同时把每个算子
+// 记录成 GraphNode (输入 / 输出张量 + 把结果重新算进输出现有缓冲的 kernel)，并把 fn 内
+// output.backward() 的执行顺序记录成 BackwardStep。replay() 只按顺序调用这些 kernel 和
+// 已有 GradFn 的 backward：不 new GradFn、不做拓扑排序、前向不分配输出。
+//
+// 用法与静态图相同：输入张量的缓冲在录制时固定，重放前把新 batch 写进去
+// (x.data() = batch，Storage 赋值是原地写入)。录制本身会真实执行一次前向 / 反向，
+// 因此录制后通常需要先 zero_grad。录制期间调用不支持录制的算子 (见 check_capturable) 会抛异常。
+
+enum class OpKind {
+    Add, Sub, Mul, Div, Neg,                                   // 张量 × 张量 (广播)
+    AddScalar, SubScalar, RSubScalar, MulScalar, DivScalar, RDivScalar,
+    Relu, MatMul, Transpose, Cast, LayerNorm, RMSNorm,
+    FusedElementwise, FusedMatMul,                             // 融合节点 (见 fusion.hpp)
+};
+
+const char* op_name(OpKind kind);
+
+struct GraphNode {
+    OpKind kind;
+    std::vector<Tensor> inputs;
+    Tensor output;
+    float scalar{0.0f};           // 标量运算的操作数 / 归一化的 eps
+    std::function<void()> kernel; // 重新计算 output，并刷新反向需要的保存量 (如 LayerNorm 的 mean / rstd)
+    std::vector<OpKind> fused;    // 融合节点包含的原算子，按执行顺序
+};
+
+struct BackwardStep {
+    Tensor tensor; // 调用 tensor.grad_fn()->backward(tensor.grad())
+};
+
+struct MemoryPlan;
+struct FusionStats;
+class GraphRecorder;
+
+class CapturedGraph {
+public:
+    // 重新执行前向；录制时调用过 backward 的话再清零中间梯度、重放反向
+    void replay();
+    void replay_forward();
+    void replay_backward();
+
+    const Tensor& output() const { return output_; }
+    const std::vector<GraphNode>& nodes() const { return nodes_; }
+    const std::vector<BackwardStep>& backward_steps() const { return backward_; }
+    bool has_backward() const { return backward_root_.defined(); }
+    bool is_memory_planned() const { return memory_planned_; }
+
+private:
+    friend class GraphRecorder;
+    friend MemoryPlan plan_memory(CapturedGraph& g, bool allow_inplace);
+    friend FusionStats fuse_graph(CapturedGraph& g);
+
+    // 由 nodes_ / backward_ 重新计算 zero_before_ (录制结束或改写图之后调用)
+    void index_backward();
+
+    std::vector<GraphNode> nodes_;
+    std::vector<BackwardStep> backward_;
+    // zero_before_[i]：第 i 步之前清零的中间梯度 (即第 i 步第一次写入的那些)。
+    // 按需清零而不是重放开始时全部清零，内存规划后梯度缓冲才能在不同时段复用
+    std::vector<std::vector<Tensor>> zero_before_;
+    Tensor backward_root_;
+    Tensor output_;
+    bool memory_planned_{false};
+};
+
+// 执行并录制 fn，fn 的返回值作为图的输出。fn 内可以对某个张量调用一次 backward()。
+// 同一线程内不能嵌套录制
+CapturedGraph capture_graph(const std::function<Tensor()>& fn);
+
+// --- 算子侧的钩子 ---
+bool is_capturing();
+// 支持录制的算子在构造输出后调用；不在录制中时什么也不做
+void record_op(OpKind kind, std::vector<Tensor> inputs, const Tensor& output,
+               std::function<void()> kernel, float scalar = 0.0f);
+// 不支持录制的算子 (或某个算子不支持录制的分支) 在入口处调用，录制中时抛异常
+void check_capturable(const char* op);
+// Tensor::backward() 结束时调用，order 为实际执行 grad_fn 的顺序
+void record_backward(const Tensor& root, const std::vector<Tensor>& order);
+
+// 作用域内暂停录制：反向中 GradFn 内部调用的算子不是图节点 (由重放 GradFn 本身覆盖)
+class RecordingPause {
+public:
+    RecordingPause();
+    ~RecordingPause();
+    RecordingPause(const RecordingPause&) = delete;
+    RecordingPause& operator=(const RecordingPause&) = delete;
+
+private:
+    GraphRecorder* saved_;
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// --- 底层计算内核 (直接操作裸指针，不建图) ---
+
+// 行主序 GEMM：C[m, n] = alpha * op(A) * op(B) + beta * C
+// op(A) 为 [m, k]：trans_a=false 时 A 按 [m, k] 存放 (lda >= k)，否则按 [k, m] 存放 (lda >= m)
+// op(B) 为 [k, n]：trans_b=false 时 B 按 [k, n] 存放 (ldb >= n)，否则按 [n, k] 存放 (ldb >= k)
+// 按 C 的行分块并行
+void sgemm(bool trans_a, bool trans_b, size_t m, size_t n, size_t k,
+           float alpha, const float* a, size_t lda, const float* b, size_t ldb,
+           float beta, float* c, size_t ldc);
+
+// out[j] += sum_i x[i * n + j]，把 [rows, n] 按列求和累加到 out
+void sum_rows(const float* x, size_t rows, size_t n, float* out);
+
+// --- INT8 GEMM ---
+// acc[i, j] = sum_p A[i, p] * B[j, p]：A [m, k]、B [n, k] 都是行主序的对称量化 int8 (取值 [-127, 127])，
+// k 必须是 kInt8PadK 的倍数 (不足的部分补 0)。int32 累加结果不落地，直接在 epilogue 中变换后写出。
+// 运行时按 CPU 选择 VNNI (vpdpbusd) / AVX2 (vpmaddubsw) / 标量内核
+constexpr size_t kInt8PadK = 32;
+
+// 反量化：C[i, j] = acc * a_scale[i] * b_scale[j] + bias[j] (bias 可为 nullptr)
+void qgemm_s8_dequant(size_t m, size_t n, size_t k,
+                      const int8_t* a, size_t lda, const float* a_scale,
+                      const int8_t* b, size_t ldb, const float* b_scale,
+                      const float* bias, float* c, size_t ldc);
+
+// 重量化：C[i, j] = clamp(round((acc * a_scale[i] * b_scale[j] + bias[j]) / out_scale), -127, 127)
+void qgemm_s8_requant(size_t m, size_t n, size_t k,
+                      const int8_t* a, size_t lda, const float* a_scale,
+                      const int8_t* b, size_t ldb, const float* b_scale,
+                      const float* bias, float out_scale, int8_t* c, size_t ldc);
+
+// 当前使用的 int8 内核名 ("vnni" / "avx2" / "scalar")
+const char* qgemm_s8_kernel_name();
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// --- MappedFile：整个文件的私有只读映射 (MAP_PRIVATE) ---
+// 写入映射内存会触发写时复制，不影响文件；多个进程映射同一文件时共享 page cache。
+// 通过 shared_ptr 持有，作为 Storage::view 的 owner 时映射随最后一个视图释放。
+// 非 POSIX 平台退化为把整个文件读进内存。
+class MappedFile {
+public:
+    enum class Advice { Normal, Sequential, Random, WillNeed };
+
+    static std::shared_ptr<MappedFile> open(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    char* data() { return data_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // madvise 提示：区间会向外对齐到页边界；len = 0 表示到文件末尾
+    void advise(Advice advice, size_t offset = 0, size_t len = 0) const;
+
+private:
+    MappedFile() = default;
+    char* data_{nullptr};
+    size_t size_{0};
+    bool mapped_{false};
+};
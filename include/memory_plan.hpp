@@ -0,0 +1,25 @@
+#pragma once
+#include "graph.hpp"
+#include <cstddef>
+
+// --- 静态内存规划 ---
+// 对录制好的图做一次活跃区间分析：算子序列 (前向节点 0..N-1，接着反向第 k 步记为 N+k)
+// 给出每个中间张量数据 / 梯度缓冲的 [产生, 最后一次使用] 区间，再把它们按大小从大到小
+// 放进一整块 arena 的最低可用偏移 (区间重叠的缓冲不能重叠)，生命周期不相交的张量共用内存。
+//
+// 数据缓冲的"使用"包括作为后续节点的输入，以及反向需要读取它的那一步 (MatMul / Mul / Div /
+// LayerNorm / RMSNorm 的反向读输入，Add / Sub / Neg / Cast 只用形状)。
+// 梯度缓冲从第一次被写入 (那一步之前清零) 活到自己那一步反向执行完。
+// allow_inplace 时，逐元素算子与逐行归一化在输入恰好于此处死亡且形状 / 类型相同时直接写回输入的缓冲。
+//
+// 图的输出与反向起点不参与规划；输入、参数及其梯度也不参与。规划后中间张量被改为指向 arena 的视图，
+// 原来的内容作废 (需要 replay() 一次)，且中间张量只在重放过程中有意义。每张图只能规划一次。
+struct MemoryPlan {
+    size_t naive_bytes{0};   // 每个中间缓冲各自一块内存 (现状) 时的峰值
+    size_t planned_bytes{0}; // arena 大小
+    size_t live_bytes{0};    // 任一时刻同时活跃的缓冲总量的最大值，planned_bytes 的下界
+    size_t num_buffers{0};   // 参与规划的缓冲 (数据与梯度) 数量
+    size_t num_inplace{0};   // 直接复用输入缓冲的算子数量
+};
+
+MemoryPlan plan_memory(CapturedGraph& g, bool allow_inplace = true);
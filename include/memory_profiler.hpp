@@ -0,0 +1,147 @@
+#pragma once
+#include "dtype.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Storage;
+struct TensorImpl;
+
+// --- 内存剖析 ---
+// MemoryProfiler 存活期间记录进程内 (所有线程) 每一块自有 Storage 内存的分配与释放：字节数、
+// 分配它的算子 (ops.cpp 的前向算子或反向节点名，见 profiler.hpp 的 ProfileScope)、用途，
+// 以及这期间新建的每个 TensorImpl。由此得到当前 / 峰值字节数、分配时间线和活跃张量快照。
+// 开启之前就已存在的内存与张量不计入。未开启时每次分配 / 释放只多读一次原子标志。
+//
+// 用途按分配时的上下文确定，张量登记时再改判：
+//   Data    张量的数据缓冲
+//   Grad    张量的稠密梯度缓冲
+//   Scratch 反向节点执行期间的其余分配 (临时梯度、中间结果)
+//   Other   其余分配 (前向算子内的临时缓冲、GradFn 保存的缓冲、arena 等)
+enum class MemoryKind : uint8_t { Data, Grad, Scratch, Other };
+constexpr size_t kNumMemoryKinds = 4;
+const char* memory_kind_name(MemoryKind kind);
+
+// 各用途的字节数
+struct MemoryUsage {
+    size_t total{0};
+    size_t by_kind[kNumMemoryKinds]{};
+    size_t bytes(MemoryKind kind) const { return by_kind[static_cast<size_t>(kind)]; }
+};
+
+// 时间线上的一次分配 (delta > 0) 或释放 (delta < 0)
+struct MemoryEvent {
+    uint64_t time_ns{0}; // 相对 MemoryProfiler 构造时刻
+    int64_t delta{0};
+    MemoryKind kind{MemoryKind::Other};
+    std::string op;      // 分配该块的算子，算子之外为空
+    MemoryUsage usage;   // 事件之后的各用途字节数
+};
+
+// 快照中的一个活跃张量。字节数只计本张量自有的缓冲 (视图不计，多个张量共享同一块时只计给第一个)
+struct LiveTensor {
+    uint64_t id{0};      // 登记顺序
+    std::vector<size_t> shape;
+    DType dtype{DType::Float32};
+    size_t data_bytes{0};
+    size_t grad_bytes{0};
+    std::string data_op; // 分配数据 / 梯度缓冲的算子
+    std::string grad_op;
+    std::string grad_fn; // 产生它的反向节点名，叶子为空
+    bool requires_grad{false};
+    bool data_is_view{false};
+    // 只被反向图 (某个活跃张量的 grad_fn 的 parents()) 引用：backward 或丢弃输出之前不会释放
+    bool graph_retained{false};
+    size_t bytes() const { return data_bytes + grad_bytes; }
+};
+
+// 不属于任何活跃张量的内存块 (反向临时缓冲、GradFn 保存的 Storage、开启前张量的新梯度等)
+struct LiveBlock {
+    size_t bytes{0};
+    MemoryKind kind{MemoryKind::Other};
+    std::string op;
+};
+
+struct MemorySnapshot {
+    uint64_t time_ns{0};
+    MemoryUsage current;
+    MemoryUsage peak;            // 峰值时刻的各用途字节数
+    size_t graph_retained_bytes{0};
+    size_t user_held_bytes{0};   // 活跃张量中被图以外的句柄持有的部分
+    std::vector<LiveTensor> tensors; // 按字节数降序
+    std::vector<LiveBlock> blocks;   // 按字节数降序
+
+    // 汇总 + 按分配算子分组 + 最大的 top 个张量 (0 表示全部)
+    std::string to_string(size_t top = 20) const;
+    std::string to_json() const;
+};
+
+class MemoryProfiler {
+public:
+    MemoryProfiler();  // 开始记录；同一时刻只能有一个 MemoryProfiler 在记录
+    ~MemoryProfiler(); // 等同 stop()
+    MemoryProfiler(const MemoryProfiler&) = delete;
+    MemoryProfiler& operator=(const MemoryProfiler&) = delete;
+
+    void stop(); // 停止记录，已有时间线与统计保留
+
+    size_t current_bytes() const;
+    size_t peak_bytes() const;
+    MemoryUsage current_usage() const;
+    MemoryUsage peak_usage() const;
+    void reset_peak(); // 峰值重置为当前值，用于分段观察
+
+    // 活跃集合。读取各张量的状态，调用时不应有其它线程在修改这些张量
+    MemorySnapshot snapshot() const;
+    std::vector<MemoryEvent> timeline() const;
+    // Chrome trace_event 计数器事件 ("ph":"C")，各用途一条曲线，可与 Profiler 的 trace 一起查看
+    std::string timeline_trace() const;
+    void save_timeline_trace(const std::string& path) const;
+
+private:
+    struct Block {
+        size_t bytes{0};
+        MemoryKind kind{MemoryKind::Other};
+        const char* op{nullptr};
+    };
+    struct TensorRecord {
+        std::weak_ptr<TensorImpl> impl;
+        uint64_t id{0};
+    };
+
+    friend void memory_on_alloc(const void* key, size_t bytes);
+    friend void memory_on_free(const void* key);
+    friend void memory_tag(const Storage& s, MemoryKind kind);
+    friend void memory_on_tensor_created(const std::shared_ptr<TensorImpl>& impl);
+    friend void memory_on_tensor_destroyed(const TensorImpl* impl);
+
+    uint64_t now_ns() const;
+    void record(int64_t delta, MemoryKind kind, const char* op); // 调用者持有 mu_
+    void retag(Block& b, MemoryKind kind);
+
+    std::chrono::steady_clock::time_point start_;
+    mutable std::mutex mu_;
+    std::unordered_map<const void*, Block> blocks_; // 键为 Storage::owner().get()
+    std::unordered_map<const TensorImpl*, TensorRecord> tensors_;
+    std::vector<MemoryEvent> events_;
+    MemoryUsage current_;
+    MemoryUsage peak_;
+    uint64_t next_tensor_id_{1};
+};
+
+// --- 钩子 (Storage / Tensor 内部调用) ---
+extern std::atomic<bool> g_memory_profiling;
+inline bool memory_profiling_enabled() { return g_memory_profiling.load(std::memory_order_relaxed); }
+
+// key 为新分配的自有内存块 (Storage::owner().get())
+void memory_on_alloc(const void* key, size_t bytes);
+void memory_on_free(const void* key);
+// 把 s 的自有内存块改判为 kind (视图与未记录的块忽略)
+void memory_tag(const Storage& s, MemoryKind kind);
+void memory_on_tensor_created(const std::shared_ptr<TensorImpl>& impl);
+void memory_on_tensor_destroyed(const TensorImpl* impl);
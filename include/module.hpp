@@ -0,0 +1,141 @@
+#pragma once
+#include "tensor.hpp"
+#include "ops.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// --- ParamArena：把一组参数 (以及梯度) 打包进两段连续内存 ---
+// 打包后每个参数的 data()/grad() 都是 arena 中对应区间的视图，
+// 因此 zero_grad 只是一次 memset，优化器/通信可以把整个模型当成一个大向量处理。
+// 每个参数的起点按 16 个 float (64 字节) 对齐，空隙填 0。
+// 开启行稀疏梯度的参数 (Embedding(sparse=true)) 不参与打包。
+struct ParamArena {
+    Storage data;
+    Storage grad;
+    std::vector<Tensor> params;
+    std::vector<size_t> offsets; // 每个参数在 arena 中的起点
+
+    explicit ParamArena(const std::vector<Tensor>& ps);
+
+    size_t size() const { return data.size(); }
+    void zero_grad();
+};
+
+// --- Module：参数容器基类 ---
+// 子类在构造函数里 register_parameter / register_module，各自定义 forward
+class Module {
+public:
+    virtual ~Module() = default;
+
+    // 按注册顺序递归收集 (子模块在自身参数之后)
+    std::vector<Tensor> parameters() const;
+    std::vector<std::pair<std::string, Tensor>> named_parameters() const;
+
+    // 把全部参数打包进一个 ParamArena，参数数据原样保留
+    void flatten_parameters();
+    bool is_flattened() const { return arena_ != nullptr; }
+    ParamArena* arena() const { return arena_.get(); }
+
+    void zero_grad();
+
+protected:
+    Tensor& register_parameter(const std::string& name, Tensor t);
+    void register_module(const std::string& name, std::shared_ptr<Module> m);
+
+private:
+    void collect(const std::string& prefix, std::vector<std::pair<std::string, Tensor>>& out) const;
+
+    std::vector<std::pair<std::string, Tensor>> params_;
+    std::vector<std::pair<std::string, std::shared_ptr<Module>>> children_;
+    std::shared_ptr<ParamArena> arena_;
+    std::vector<Tensor> sparse_params_; // 行稀疏梯度的参数不进 arena，避免为整张表分配梯度
+};
+
+// --- Linear: y = x W + b，W 形状为 [in, out] ---
+class Linear : public Module {
+public:
+    Linear(size_t in_features, size_t out_features, bool bias = true, uint32_t seed = 0);
+    Tensor forward(const Tensor& x) const;
+
+    Tensor weight;
+    Tensor bias; // bias=false 时为空句柄
+    size_t in_features, out_features;
+};
+
+// --- 量化校准：在代表性数据上前向，记录激活的 max|x|，得到静态量化 scale ---
+// momentum > 0 时按滑动平均更新，减小个别离群 batch 的影响
+class MinMaxObserver {
+public:
+    explicit MinMaxObserver(float momentum = 0.0f) : momentum_(momentum) {}
+    void observe(const Tensor& x);
+    float max_abs() const { return max_abs_; }
+    float scale() const { return max_abs_ > 0.0f ? max_abs_ / 127.0f : 1.0f; }
+    size_t num_batches() const { return count_; }
+
+private:
+    float momentum_;
+    float max_abs_{0.0f};
+    size_t count_{0};
+};
+
+// --- QuantizedLinear: 由训练好的 Linear 转换而来的 int8 推理层 ---
+// 权重按输出通道量化 (内存为 fp32 的 1/4)；input_scale > 0 时激活使用该静态 scale，
+// 否则每次前向逐行动态量化。只用于推理，没有可训练参数
+class QuantizedLinear {
+public:
+    explicit QuantizedLinear(const Linear& linear, float input_scale = 0.0f);
+    Tensor forward(const Tensor& x) const; // x [m, in] fp32 -> [m, out] fp32
+
+    QuantizedMatrix weight;
+    Tensor bias; // fp32，在 epilogue 中加上
+    float input_scale;
+    size_t in_features, out_features;
+};
+
+// --- Embedding: 按 index 取 weight [num_embeddings, dim] 的行 ---
+// sparse=true 时 weight 的梯度是行稀疏的，配合 SparseSGD / SparseAdagrad / SparseAdam 使用
+class Embedding : public Module {
+public:
+    Embedding(size_t num_embeddings, size_t embedding_dim, bool sparse = false, uint32_t seed = 0);
+    Tensor forward(const std::vector<size_t>& indices) const;
+
+    Tensor weight;
+};
+
+// --- EmbeddingBag: 每个 bag 内的行求和 / 求均值 ---
+class EmbeddingBag : public Module {
+public:
+    EmbeddingBag(size_t num_embeddings, size_t embedding_dim, BagMode mode = BagMode::Sum,
+                 bool sparse = false, uint32_t seed = 0);
+    Tensor forward(const std::vector<size_t>& indices, const std::vector<size_t>& offsets) const;
+
+    Tensor weight;
+    BagMode mode;
+};
+
+// --- LSTM: 单层，forward 处理整段序列，step 处理单个时间步 ---
+class LSTM : public Module {
+public:
+    LSTM(size_t input_size, size_t hidden_size, uint32_t seed = 0);
+    // x [T, B, I]，h0/c0 [B, H]；返回 {output [T, B, H], c_n [B, H]}
+    std::pair<Tensor, Tensor> forward(const Tensor& x, const Tensor& h0, const Tensor& c0) const;
+    // x [B, I]；返回 {h', c'}
+    std::pair<Tensor, Tensor> step(const Tensor& x, const Tensor& h, const Tensor& c) const;
+
+    Tensor w_ih, w_hh, bias;
+    size_t input_size, hidden_size;
+};
+
+// --- GRU: 单层 ---
+class GRU : public Module {
+public:
+    GRU(size_t input_size, size_t hidden_size, uint32_t seed = 0);
+    Tensor forward(const Tensor& x, const Tensor& h0) const; // [T, B, I] -> [T, B, H]
+    Tensor step(const Tensor& x, const Tensor& h) const;     // [B, I] -> [B, H]
+
+    Tensor w_ih, w_hh, b_ih, b_hh;
+    size_t input_size, hidden_size;
+};
@@ -2,8 +2,14 @@
 #include "tensor.hpp"
 #include "tensor_utils.hpp"
 #include <stdexcept>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
 
 // --- Tensor × Tensor (广播机制) ---
+// 结果类型为 promote_types(a, b)。任一输入为半精度时分块转成 fp32 计算；
+// 结果为 Float64 或整数时按结果类型计算 (整数除法向 0 截断)
 Tensor add(const Tensor& a, const Tensor& b);
 Tensor sub(const Tensor& a, const Tensor& b);
 Tensor mul(const Tensor& a, const Tensor& b);
@@ -20,10 +26,106 @@ Tensor mul(float scalar, const Tensor& t);
 Tensor div(const Tensor& t, float scalar);
 Tensor div(float scalar, const Tensor& t);
 
+// --- 激活函数 (Float32 / Float64) ---
+Tensor relu(const Tensor& a);
+
+// --- 存储类型转换 (转成浮点类型时可求导) ---
+Tensor cast(const Tensor& t, DType dtype);
+
+// --- 比较与选择 (广播机制) ---
+// 比较结果为 UInt8 掩码 (0/1)，不可求导
+Tensor eq(const Tensor& a, const Tensor& b);
+Tensor ne(const Tensor& a, const Tensor& b);
+Tensor lt(const Tensor& a, const Tensor& b);
+Tensor le(const Tensor& a, const Tensor& b);
+Tensor gt(const Tensor& a, const Tensor& b);
+Tensor ge(const Tensor& a, const Tensor& b);
+// mask 为 UInt8：out = mask ? a : b，对 a、b 求导
+Tensor where(const Tensor& mask, const Tensor& a, const Tensor& b);
+
 // --- 矩阵与转置 ---
+// 半精度输入：加载半精度、在 fp32 中累加；autocast 作用域内 matmul 先把输入转成 autocast 类型
 Tensor matmul(const Tensor& a, const Tensor& b);
 Tensor transpose(const Tensor& t);
 
+// --- INT8 量化推理 (只有前向，不建图) ---
+// 对称量化：q = clamp(round(x / scale), -127, 127)，x ≈ q * scale，每行一个 scale。
+// 每行长度补 0 到 kInt8PadK 的倍数，直接作为 int8 GEMM 的操作数
+struct QuantizedMatrix {
+    std::vector<int8_t> data;  // [rows, k_padded]
+    std::vector<float> scales; // [rows]
+    size_t rows{0}, cols{0}, k_padded{0};
+};
+// w 为 Linear 布局 [in, out]：按输出通道量化并转置为 [out, k_padded]
+QuantizedMatrix quantize_weight(const Tensor& w);
+// x [m, k]：scale > 0 时所有行使用该静态 scale (通常来自校准)，否则逐行取 max|x| / 127
+QuantizedMatrix quantize_activations(const Tensor& x, float scale = 0.0f);
+Tensor dequantize(const QuantizedMatrix& q); // -> [rows, cols]
+// y = x W + bias -> fp32 [m, out]；x 为 fp32 时先量化 (input_scale 含义同 quantize_activations)
+Tensor quantized_matmul(const Tensor& x, const QuantizedMatrix& w, const Tensor& bias = Tensor(),
+                        float input_scale = 0.0f);
+Tensor quantized_matmul(const QuantizedMatrix& x, const QuantizedMatrix& w, const Tensor& bias = Tensor());
+// 输出直接按 output_scale 重量化成 int8，可作为下一层 quantized_matmul 的输入
+QuantizedMatrix quantized_matmul_requant(const QuantizedMatrix& x, const QuantizedMatrix& w,
+                                         const Tensor& bias, float output_scale);
+
+// --- 归一化 (单遍 Welford 前向 + 融合反向) ---
+// layer_norm / rms_norm 在最后一维上归一化，gamma/beta 形状为 [D]
+Tensor layer_norm(const Tensor& x, const Tensor& gamma, const Tensor& beta, float eps = 1e-5f);
+Tensor rms_norm(const Tensor& x, const Tensor& gamma, float eps = 1e-6f);
+// batch_norm 输入为 [N, C] 或 [N, C, L...]，在 N 与 L 上统计，gamma/beta/running_* 形状为 [C]
+// training=true 时使用 batch 统计量并原地更新 running_mean/running_var；false 时使用 running 统计量
+Tensor batch_norm(const Tensor& x, const Tensor& gamma, const Tensor& beta,
+                  Tensor& running_mean, Tensor& running_var,
+                  bool training, float momentum = 0.1f, float eps = 1e-5f);
+
+// --- Embedding ---
+// weight 为 [num_embeddings, dim]；weight.set_sparse_grad(true) 时反向产生行稀疏梯度
+Tensor embedding(const Tensor& weight, const std::vector<size_t>& indices); // -> [L, dim]
+Tensor embedding(const Tensor& weight, const Tensor& indices); // indices 为整数张量
+
+enum class BagMode { Sum, Mean };
+// offsets[b] 是第 b 个 bag 在 indices 中的起点，最后一个 bag 到 indices 末尾；
+// offsets[0] 必须为 0 且单调不减、不超过 indices.size()，indices 非空时 offsets 不能为空
+Tensor embedding_bag(const Tensor& weight, const std::vector<size_t>& indices,
+                     const std::vector<size_t>& offsets, BagMode mode = BagMode::Sum); // -> [B, dim]
+Tensor embedding_bag(const Tensor& weight, const Tensor& indices, const Tensor& offsets,
+                     BagMode mode = BagMode::Sum);
+
+// --- 循环网络 (融合单元) ---
+// LSTM 门顺序 i, f, g, o：w_ih [I, 4H]，w_hh [H, 4H]，bias [4H]
+// 序列版本 x 为 [T, B, I]，输入投影对全部时间步一次 GEMM 完成，整段序列只建一个反向节点
+// 返回 {output [T, B, H], c_n [B, H]}，两者都可以参与求导
+std::pair<Tensor, Tensor> lstm(const Tensor& x, const Tensor& h0, const Tensor& c0,
+                               const Tensor& w_ih, const Tensor& w_hh, const Tensor& bias);
+// 单步：x [B, I]，返回 {h', c'}
+std::pair<Tensor, Tensor> lstm_cell(const Tensor& x, const Tensor& h, const Tensor& c,
+                                    const Tensor& w_ih, const Tensor& w_hh, const Tensor& bias);
+
+// GRU 门顺序 r, z, n：w_ih [I, 3H]，w_hh [H, 3H]，b_ih/b_hh [3H]
+// n = tanh(x W_in + b_in + r * (h W_hn + b_hn))，h' = (1 - z) * n + z * h
+Tensor gru(const Tensor& x, const Tensor& h0, const Tensor& w_ih, const Tensor& w_hh,
+           const Tensor& b_ih, const Tensor& b_hh);        // x [T, B, I] -> [T, B, H]
+Tensor gru_cell(const Tensor& x, const Tensor& h, const Tensor& w_ih, const Tensor& w_hh,
+                const Tensor& b_ih, const Tensor& b_hh);   // x [B, I] -> [B, H]
+
+// --- 注意力 ---
+// q [..., T, D]，k [..., S, D]，v [..., S, Dv]，前导维度 (如 [B, H]) 必须一致 -> [..., T, Dv]
+// softmax(q k^T / sqrt(D)) v；causal=true 时第 i 个 query 只看 key j <= i
+// 前向按 K/V 分块做在线 softmax，不生成 [T, S] 分数矩阵，额外内存只有每行的 logsumexp；
+// 反向按块重算分数。按 (batch*heads, query 块) 并行
+Tensor scaled_dot_product_attention(const Tensor& q, const Tensor& k, const Tensor& v,
+                                    bool causal = false);
+
+// --- 激活重算 (activation checkpointing) ---
+// 在梯度模式关闭下执行 fn(inputs)，片段内部不建图、不保留中间结果，只保存 inputs；
+// 反向时以开启梯度的模式用 inputs 的副本重新执行 fn，再从重算的输出反向传播。
+// fn 必须是确定性的；闭包中用到的张量只能是叶子 (参数)，它们的梯度在重算的反向里直接累加。
+// 这些参数也可以在片段外使用：重算的反向嵌套在外层反向中，它们的梯度就绪钩子等外层所有检查点节点执行完才触发。
+// 片段内没有任何需要梯度的输入 / 参数时输出不需要梯度。不支持图录制
+using CheckpointFn = std::function<Tensor(const std::vector<Tensor>&)>;
+Tensor checkpoint(const CheckpointFn& fn, const std::vector<Tensor>& inputs);
+
 // --- 运算符重载 (保持原样即可) ---
 inline Tensor operator+(const Tensor& a, const Tensor& b) { return add(a, b); }
 inline Tensor operator-(const Tensor& a, const Tensor& b) { return sub(a, b); }
@@ -0,0 +1,141 @@
+#pragma once
+#include "tensor.hpp"
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// --- 优化器基类 ---
+// 所有参数视为一个参数组：状态量 (momentum / exp_avg / ...) 放在与参数总元素数等长的
+// 连续缓冲中，offsets_ 记录每个参数的起始位置。step() 对整个参数组只启动一次融合内核，
+// 按元素区间切块并行，每个元素只读一次 param / grad / state 并原地写回。
+class Optimizer {
+public:
+    explicit Optimizer(const std::vector<Tensor>& params);
+    virtual ~Optimizer() = default;
+
+    virtual void step() = 0;
+    void zero_grad();
+
+    // max_norm > 0 时启用全局 L2 范数裁剪，裁剪系数在 step 的更新内核里融合乘上
+    void set_max_grad_norm(float max_norm) { max_grad_norm_ = max_norm; }
+    float last_grad_norm() const { return last_grad_norm_; }
+
+    const std::vector<Tensor>& params() const { return params_; }
+    size_t step_count() const { return step_; }
+    void set_step_count(size_t step) { step_ = step; }
+
+    // 检查点用：按名字列出状态缓冲，每个都与参数组等长、按 offsets_ 排布
+    virtual std::vector<std::pair<std::string, std::vector<float>*>> state_buffers() { return {}; }
+
+protected:
+    // 对参数组里的每段连续区间调用 fn(param, grad, state_offset, n)，区间按元素数均分给线程
+    template <typename F>
+    void for_each_chunk(F&& fn);
+
+    // 稀疏优化器使用：对行稀疏梯度的参数，按本步出现的行调用 fn(param_row, grad_row, state_offset, n)；
+    // 稠密梯度的参数整体当成一段处理
+    template <typename F>
+    void for_each_touched_row(F&& fn);
+
+    // 计算全局梯度范数并返回裁剪系数 (未启用裁剪时为 1)
+    float grad_clip_coef();
+
+    std::vector<Tensor> params_;
+    std::vector<size_t> offsets_; // 长度 params_.size() + 1
+    size_t total_numel_{0};
+    size_t step_{0};
+    float max_grad_norm_{0.0f};
+    float last_grad_norm_{0.0f};
+};
+
+// --- SGD (momentum / Nesterov / weight decay) ---
+class SGD : public Optimizer {
+public:
+    SGD(const std::vector<Tensor>& params, float lr, float momentum = 0.0f,
+        float weight_decay = 0.0f, bool nesterov = false, float dampening = 0.0f);
+    void step() override;
+    std::vector<std::pair<std::string, std::vector<float>*>> state_buffers() override {
+        if (momentum_buf_.empty()) return {};
+        return {{"momentum_buf", &momentum_buf_}};
+    }
+
+    float lr;
+
+private:
+    float momentum_, weight_decay_, dampening_;
+    bool nesterov_;
+    std::vector<float> momentum_buf_;
+};
+
+// --- Adam / AdamW ---
+// decoupled_weight_decay=false 时 weight decay 以 L2 形式加到梯度上 (Adam)，
+// 为 true 时直接衰减参数 (AdamW)
+class Adam : public Optimizer {
+public:
+    Adam(const std::vector<Tensor>& params, float lr = 1e-3f, float beta1 = 0.9f,
+         float beta2 = 0.999f, float eps = 1e-8f, float weight_decay = 0.0f,
+         bool decoupled_weight_decay = false);
+    void step() override;
+    std::vector<std::pair<std::string, std::vector<float>*>> state_buffers() override {
+        return {{"exp_avg", &exp_avg_}, {"exp_avg_sq", &exp_avg_sq_}};
+    }
+
+    float lr;
+
+protected:
+    float beta1_, beta2_, eps_, weight_decay_;
+    bool decoupled_;
+    std::vector<float> exp_avg_, exp_avg_sq_;
+};
+
+class AdamW : public Adam {
+public:
+    AdamW(const std::vector<Tensor>& params, float lr = 1e-3f, float beta1 = 0.9f,
+          float beta2 = 0.999f, float eps = 1e-8f, float weight_decay = 1e-2f)
+        : Adam(params, lr, beta1, beta2, eps, weight_decay, true) {}
+};
+
+// --- 稀疏优化器 ---
+// 面向 Embedding(sparse=true)：每步只读写 sparse_grad() 中出现的行，
+// 状态缓冲虽然覆盖整张表，但内存流量只与本步触及的行数成正比。
+class SparseSGD : public Optimizer {
+public:
+    SparseSGD(const std::vector<Tensor>& params, float lr);
+    void step() override;
+
+    float lr;
+};
+
+class SparseAdagrad : public Optimizer {
+public:
+    SparseAdagrad(const std::vector<Tensor>& params, float lr = 1e-2f, float eps = 1e-10f,
+                  float initial_accumulator_value = 0.0f);
+    void step() override;
+    std::vector<std::pair<std::string, std::vector<float>*>> state_buffers() override {
+        return {{"sum", &sum_}};
+    }
+
+    float lr;
+
+private:
+    float eps_;
+    std::vector<float> sum_;
+};
+
+// Lazy Adam：只更新出现的行的一阶/二阶矩，偏差修正使用全局步数 (与 PyTorch SparseAdam 一致)
+class SparseAdam : public Optimizer {
+public:
+    SparseAdam(const std::vector<Tensor>& params, float lr = 1e-3f, float beta1 = 0.9f,
+               float beta2 = 0.999f, float eps = 1e-8f);
+    void step() override;
+    std::vector<std::pair<std::string, std::vector<float>*>> state_buffers() override {
+        return {{"exp_avg", &exp_avg_}, {"exp_avg_sq", &exp_avg_sq_}};
+    }
+
+    float lr;
+
+private:
+    float beta1_, beta2_, eps_;
+    std::vector<float> exp_avg_, exp_avg_sq_;
+};
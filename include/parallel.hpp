@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+// --- 线程池并行工具 ---
+// parallel_for 把 [begin, end) 按 grain 切块，分发给全局线程池执行。
+// fn(chunk_begin, chunk_end) 在各个线程上被调用；调用线程自己也参与计算。
+// 在并行区域内部再次调用 parallel_for 时会直接串行执行，避免嵌套死锁。
+
+size_t get_num_threads();
+void set_num_threads(size_t n); // 线程数，默认 hardware_concurrency，可用环境变量 MINIDL_NUM_THREADS 覆盖
+
+void parallel_for(size_t begin, size_t end, size_t grain,
+                  const std::function<void(size_t, size_t)>& fn);
+
+// 作用域内当前线程的 parallel_for 全部串行执行 (如数据并行的副本线程，避免与算子内并行争抢线程池)
+class SerialRegion {
+public:
+    SerialRegion();
+    ~SerialRegion();
+    SerialRegion(const SerialRegion&) = delete;
+    SerialRegion& operator=(const SerialRegion&) = delete;
+
+private:
+    bool saved_;
+};
@@ -0,0 +1,144 @@
+#pragma once
+#include "tensor.hpp"
+#include "memory_profiler.hpp"
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct GradFn;
+
+// --- 算子级性能剖析 ---
+// Profiler 存活期间，构造它的线程 (以及用 ProfilerThreadScope 加入的线程) 上 ops.hpp 的每个前向算子、
+// 反向引擎执行的每个 GradFn::backward 各记录一条 ProfileEvent。未开启时每个算子多两次判断：
+// 线程局部 Profiler 指针判空，以及内存剖析原子标志的一次 relaxed 读取 (见 ProfileScope::active)。
+// FLOPs 与访存字节数按算子类型估计，用于判断算子是算力受限还是带宽受限。
+struct ProfileEvent {
+    std::string name;
+    const char* category{"op"}; // "op" 或 "backward"
+    std::vector<std::vector<size_t>> input_shapes;
+    uint64_t start_ns{0}; // 相对 Profiler 构造时刻
+    uint64_t dur_ns{0};
+    uint64_t self_ns{0};  // 扣除嵌套在内的其它事件
+    uint32_t thread{0};   // 线程编号 (进程内从 1 开始)
+    uint64_t flops{0};
+    uint64_t bytes{0};
+};
+
+class Profiler {
+public:
+    Profiler();  // 开始在当前线程上记录
+    ~Profiler(); // 等同 stop()
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    void stop(); // 当前线程停止记录，已有事件保留
+
+    std::vector<ProfileEvent> events() const;
+    // Chrome trace_event 格式 (chrome://tracing、Perfetto 可直接打开)，每个事件为一个 "X" 事件
+    std::string chrome_trace() const;
+    void save_chrome_trace(const std::string& path) const;
+    // 按名字汇总的表格，按 self time 降序；top > 0 时只列前 top 行
+    std::string summary(size_t top = 0) const;
+
+    void add(ProfileEvent&& e);
+    uint64_t now_ns() const;
+
+private:
+    std::chrono::steady_clock::time_point start_;
+    mutable std::mutex mu_;
+    std::vector<ProfileEvent> events_;
+    Profiler* saved_{nullptr};
+    bool stopped_{false};
+};
+
+// 让当前线程 (例如数据并行的副本线程) 在作用域内向 p 记录
+class ProfilerThreadScope {
+public:
+    explicit ProfilerThreadScope(Profiler& p);
+    ~ProfilerThreadScope();
+    ProfilerThreadScope(const ProfilerThreadScope&) = delete;
+    ProfilerThreadScope& operator=(const ProfilerThreadScope&) = delete;
+
+private:
+    Profiler* saved_;
+};
+
+// 当前线程正在记录的 Profiler，没有则为 nullptr
+extern thread_local Profiler* t_profiler;
+inline Profiler* current_profiler() { return t_profiler; }
+
+using ShapeList = std::vector<std::vector<size_t>>;
+ShapeList input_shapes(const std::vector<Tensor>& inputs);
+
+// --- 代价估计 ---
+struct OpCost {
+    uint64_t flops{0};
+    uint64_t bytes{0};
+};
+// 逐元素 (含广播)：输出元素数 × flops_per_elem；读全部输入、写一份输出 (元素类型同第一个输入)
+OpCost elementwise_cost(std::initializer_list<const Tensor*> inputs, uint64_t flops_per_elem = 1);
+// [m, k] × [k, n]
+OpCost matmul_cost(const Tensor& a, const Tensor& b);
+// 只搬运数据：读一遍、写一遍
+OpCost copy_cost(const Tensor& t);
+// 从 [num, dim] 的表里按行取 rows 行
+OpCost gather_cost(const Tensor& table, size_t rows);
+// 循环网络：x [.., I] 的每一行各做一次输入投影与循环投影
+OpCost recurrent_cost(const Tensor& x, const Tensor& w_ih, const Tensor& w_hh);
+// q [.., T, D] k [.., S, D] v [.., S, Dv]：q k^T 与 P v 两次 GEMM
+OpCost attention_cost(const Tensor& q, const Tensor& k, const Tensor& v);
+
+// --- 作用域 ---
+// 构造时取一次当前 Profiler；未开启时 begin 不会被调用，析构也只是判空 (事件只在开启时才分配)。
+// 只开了内存剖析时 begin 只把算子名压入本线程的作用域栈，用于内存分配的归因
+class ProfileScope {
+public:
+    ProfileScope() : prof_(current_profiler()) {}
+    ~ProfileScope() {
+        if (open_) end();
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    bool active() const { return prof_ != nullptr || memory_profiling_enabled(); }
+    bool tracing() const { return prof_ != nullptr; } // 需要记录事件 (形状、代价)
+    void begin(const char* name, std::initializer_list<const Tensor*> inputs, OpCost cost);
+    void begin(const char* name, std::vector<std::vector<size_t>> input_shapes, OpCost cost);
+    // 反向节点：输入形状为 [grad_out, parents...]
+    void begin_backward(GradFn& fn, const Tensor& out);
+
+    const char* name() const { return name_; }
+    bool in_backward() const { return in_backward_; } // 本作用域或某个外层作用域是反向节点
+
+private:
+    void start(const char* name, bool backward, std::vector<std::vector<size_t>> shapes, OpCost cost);
+    void push(const char* name, bool backward);
+    void end();
+
+    Profiler* prof_;
+    ProfileEvent* ev_{nullptr};
+    ProfileScope* parent_{nullptr};
+    const char* name_{nullptr};
+    bool in_backward_{false};
+    bool open_{false};
+    uint64_t child_ns_{0};
+};
+
+// 当前线程最内层打开的作用域，没有则为 nullptr
+const ProfileScope* current_profile_scope();
+
+// 放在算子函数体开头：COST 只在记录事件时求值，其余参数为输入张量的指针
+#define MINIDL_PROFILE_OP(NAME, COST, ...)                                                   \
+    ProfileScope minidl_profile_scope_;                                                       \
+    if (minidl_profile_scope_.active())                                                       \
+    minidl_profile_scope_.begin(NAME, {__VA_ARGS__}, minidl_profile_scope_.tracing() ? COST : OpCost{})
+
+// 输入不是单个张量 (量化矩阵、张量列表) 的算子用：SHAPES 为 ShapeList 表达式，与 COST 一样只在记录事件时求值
+#define MINIDL_PROFILE_OP_SHAPES(NAME, COST, SHAPES)                                         \
+    ProfileScope minidl_profile_scope_;                                                       \
+    if (minidl_profile_scope_.active())                                                       \
+    minidl_profile_scope_.begin(NAME, minidl_profile_scope_.tracing() ? SHAPES : ShapeList{}, \
+                                minidl_profile_scope_.tracing() ? COST : OpCost{})
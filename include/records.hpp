@@ -0,0 +1,96 @@
+#pragma once
+#include "tensor.hpp"
+#include "data.hpp"
+#include "mapped_file.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// --- 分片记录文件 ---
+// 数据文件：逐条 [u64 length][payload][0 填充到 8 字节]，payload 起点 8 字节对齐，
+//          因此 float payload 可以直接当作张量内存使用
+// 索引文件 (数据文件名 + ".idx")：magic "MINIDLIX" | u64 count | u64 offset * count，
+//          offset 为每条记录头在数据文件中的位置
+// 一个数据集由若干分片组成，记录的全局编号按分片顺序连续排列。
+
+class RecordWriter {
+public:
+    explicit RecordWriter(const std::string& path);
+    ~RecordWriter(); // 未 close 时自动 close (错误被忽略)
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+
+    void write(const void* data, size_t bytes);
+    void write(const Tensor& t); // 按 float 原样写出
+    void close();                // 写出索引文件
+    size_t count() const { return offsets_.size(); }
+
+private:
+    std::string path_;
+    FILE* f_{nullptr};
+    uint64_t pos_{0};
+    std::vector<uint64_t> offsets_;
+};
+
+struct RecordView {
+    const char* data;
+    size_t size; // 字节数
+};
+
+// --- RecordReader：mmap 全部分片及其索引，按全局编号随机访问 ---
+// 索引也保持映射状态，不拷贝进内存。
+class RecordReader {
+public:
+    explicit RecordReader(const std::vector<std::string>& shard_paths);
+
+    size_t size() const { return starts_.back(); } // 所有分片的记录总数
+    size_t num_shards() const { return shards_.size(); }
+
+    RecordView record(size_t i) const;
+    // 把第 i 条记录的 payload 当作 float 张量，直接引用映射内存 (零拷贝)，元素数必须与 shape 一致
+    Tensor tensor(size_t i, const std::vector<size_t>& shape) const;
+
+    // 访问模式提示：顺序扫描用 Sequential (加大预读)，打乱读取用 Random (关闭预读)
+    void advise(MappedFile::Advice advice) const;
+    void prefetch(size_t i) const; // 对第 i 条记录发 WillNeed
+
+    // 全部记录的读取顺序；shuffle 时是由 (seed, epoch) 决定的跨分片全局排列
+    std::vector<size_t> order(bool shuffle, uint64_t seed = 0, uint64_t epoch = 0) const;
+    // 确定性的 worker 切分：取 order 中的第 rank, rank + world, ... 条，
+    // 每个 worker 条数相同 (不足 world 的尾部丢弃)，同一 (seed, epoch) 下各 worker 互不重叠
+    std::vector<size_t> shard_indices(size_t rank, size_t world, bool shuffle,
+                                      uint64_t seed = 0, uint64_t epoch = 0) const;
+
+private:
+    size_t shard_of(size_t i) const;
+
+    struct Shard {
+        std::shared_ptr<MappedFile> data;
+        std::shared_ptr<MappedFile> index;
+        const uint64_t* offsets; // 指向 index 映射内部
+        size_t count;
+    };
+    std::vector<Shard> shards_;
+    std::vector<size_t> starts_; // 分片记录数的前缀和，长度 num_shards() + 1
+};
+
+// --- RecordDataset：每条记录是若干定长 float 字段依次拼接，接到 DataLoader 上 ---
+// indices 为空时使用全部记录，否则只暴露 indices 指定的记录 (如 shard_indices 的结果)。
+// get 直接从映射内存拷进 DataLoader 的 batch 槽，不经过中间张量。
+class RecordDataset : public Dataset {
+public:
+    RecordDataset(std::shared_ptr<RecordReader> reader, std::vector<std::vector<size_t>> shapes,
+                  std::vector<size_t> indices = {});
+    size_t size() const override;
+    std::vector<std::vector<size_t>> sample_shapes() const override { return shapes_; }
+    void get(size_t index, const std::vector<float*>& out) const override;
+
+private:
+    std::shared_ptr<RecordReader> reader_;
+    std::vector<std::vector<size_t>> shapes_;
+    std::vector<size_t> field_numel_;
+    size_t record_numel_{0};
+    std::vector<size_t> indices_;
+};
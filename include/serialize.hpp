@@ -0,0 +1,33 @@
+#pragma once
+#include "tensor.hpp"
+#include "module.hpp"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// --- 张量检查点 ---
+// 文件布局 (小端)：
+//   magic "MINIDLCK" | version u32 | count u32 | data_offset u64
+//   count 个条目：name_len u32 | name | dtype u8 | ndim u32 | dims u64 * ndim | offset u64 | numel u64
+//   数据区从 data_offset 开始，每个张量的 offset 都按 64 字节对齐
+// offset 是相对文件头的绝对位置，因此数据区可以直接 mmap 后当作 float 数组使用。
+
+// 文件中的 dtype 编码，与内存中的 DType 一一对应
+enum class CkptDType : uint8_t { F32 = 0, F16 = 1, BF16 = 2, F64 = 3, I32 = 4, I64 = 5, U8 = 6 };
+
+using NamedTensors = std::vector<std::pair<std::string, Tensor>>;
+
+// durable=true 时关闭前 fsync，保证返回时数据已落盘
+void save_tensors(const std::string& path, const NamedTensors& tensors, bool durable = false);
+
+// use_mmap=true 时以 MAP_PRIVATE 映射整个文件，返回的张量直接以映射为存储 (零拷贝)：
+// 多个进程加载同一文件时共享 page cache，写入会触发写时复制，不影响文件。
+// 映射在最后一个引用它的张量释放后才解除。use_mmap=false 时读入自有内存。
+NamedTensors load_tensors(const std::string& path, bool use_mmap = true);
+
+// 按 named_parameters() 的名字保存 / 加载模块参数
+void save_module(const Module& m, const std::string& path);
+// 未打包的模块直接把参数换成映射视图；已 flatten_parameters() 的模块拷贝进 arena。
+// strict=true 时名字、形状必须一一对应
+void load_module(Module& m, const std::string& path, bool strict = true);
@@ -0,0 +1,72 @@
+#pragma once
+#include "tensor.hpp"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// --- CSRPattern：CSR 稀疏结构 (不可变，多个矩阵可以共享) ---
+struct CSRPattern {
+    size_t rows{0}, cols{0};
+    std::vector<size_t> row_ptr; // [rows + 1]
+    std::vector<size_t> col_idx; // [nnz]，每行内按列升序、无重复
+
+    size_t nnz() const { return col_idx.size(); }
+
+    // 转置结构，反向第一次用到时构建并缓存。
+    // transpose_perm()[e] 是转置中第 e 个非零元在原结构中的下标，用来重排 values
+    const CSRPattern& transposed() const;
+    const std::vector<size_t>& transpose_perm() const;
+
+private:
+    void build_transpose() const;
+
+    mutable std::once_flag t_once_;
+    mutable std::unique_ptr<CSRPattern> t_;
+    mutable std::vector<size_t> t_perm_;
+};
+
+// --- CSRMatrix：稀疏结构 + 一维 values [nnz] ---
+// values 是普通 Tensor，可以 requires_grad，也可以直接来自 sddmm 的输出；
+// 内存只与 nnz 成正比，不会物化 rows × cols 的稠密矩阵
+class CSRMatrix {
+public:
+    // 总是带着非空的 pattern：访问器直接解引用 pattern_，因此不提供默认构造
+    CSRMatrix() = delete;
+    CSRMatrix(std::shared_ptr<const CSRPattern> pattern, Tensor values);
+
+    // COO -> CSR：按 (row, col) 排序，重复坐标的值相加；values 为空时全部取 1
+    static CSRMatrix from_coo(size_t rows, size_t cols,
+                              const std::vector<size_t>& row, const std::vector<size_t>& col,
+                              const std::vector<float>& values = {}, bool requires_grad = false);
+
+    // 共享结构、换一组 values (例如 sddmm 输出的注意力分数)
+    CSRMatrix with_values(const Tensor& values) const { return CSRMatrix(pattern_, values); }
+
+    size_t rows() const { return pattern_->rows; }
+    size_t cols() const { return pattern_->cols; }
+    size_t nnz() const { return pattern_->nnz(); }
+    const std::shared_ptr<const CSRPattern>& pattern() const { return pattern_; }
+    const Tensor& values() const { return values_; }
+
+    Tensor to_dense() const; // 调试 / 测试用
+
+private:
+    std::shared_ptr<const CSRPattern> pattern_;
+    Tensor values_;
+};
+
+// --- 稀疏算子 (可求导) ---
+// SpMM：[rows, cols] × x [cols, F] -> [rows, F]，对 x 与 a.values() 求导
+Tensor spmm(const CSRMatrix& a, const Tensor& x);
+// SDDMM：只在 pattern 的非零位置上计算 a b^T，a [rows, D]、b [cols, D] -> [nnz]
+// out[e] = dot(a[i], b[j])，(i, j) 是第 e 个非零元的坐标
+Tensor sddmm(const CSRMatrix& pattern, const Tensor& a, const Tensor& b);
+
+// --- 底层内核 (裸指针，不建图，按行并行) ---
+// out[rows, f] = A x；values 按 p 的非零元顺序排列
+void csr_spmm(const CSRPattern& p, const float* values, const float* x, size_t f, float* out);
+// out[rows..] = A^T x，借助缓存的转置结构，不需要原子操作
+void csr_spmm_t(const CSRPattern& p, const float* values, const float* x, size_t f, float* out);
+// out[e] = dot(a[i], b[j])
+void csr_sddmm(const CSRPattern& p, const float* a, const float* b, size_t d, float* out);
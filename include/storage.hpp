@@ -0,0 +1,89 @@
+#pragma once
+#include "dtype.hpp"
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+// --- Storage：Tensor 的底层连续内存 ---
+// 要么自己拥有（64 字节对齐分配），要么是别处内存的视图（参数 arena 等），
+// 由 owner_ 保活。接口与 std::vector<float> 对齐，原来按 vector 使用 data()/grad() 的代码不用改。
+//
+// 元素类型由 dtype_ 决定，默认 Float32。data()/begin()/end() 只对 Float32 有效，
+// 对其他类型调用会抛异常；其他类型用 data_ptr<T>() 按元素类型访问，半精度数据通过 raw() 访问，
+// 并用 dtype.hpp 中的 convert 转换。
+//
+// 赋值是"写入"语义：长度与 dtype 相同时直接覆盖当前内存（视图依然指向原处），否则重新分配；
+// 视图不会重新分配，长度或 dtype 不同时抛异常。需要改变指向时用 rebind()。
+class Storage {
+public:
+    Storage() = default;
+    explicit Storage(size_t n, float value = 0.0f);
+    Storage(size_t n, DType dtype); // 按 dtype 分配 n 个元素并清零
+    explicit Storage(const std::vector<float>& v);
+    explicit Storage(std::vector<float>&& v); // 接管 vector 的内存，不拷贝
+    Storage(std::initializer_list<float> il);
+
+    Storage(const Storage& other); // 深拷贝，结果总是自有内存
+    Storage(Storage&& other) noexcept;
+    Storage& operator=(const Storage& other);
+    Storage& operator=(Storage&& other);
+    Storage& operator=(const std::vector<float>& v);
+    Storage& operator=(std::initializer_list<float> il);
+
+    // 构造一个指向外部内存的视图，owner 负责保活
+    static Storage view(float* ptr, size_t n, std::shared_ptr<void> owner);
+    static Storage view(void* ptr, size_t n, std::shared_ptr<void> owner, DType dtype);
+    // 放弃当前内存，直接改为指向 other 的内存（不拷贝数据）
+    void rebind(Storage&& other) noexcept;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool is_view() const { return is_view_; }
+    const std::shared_ptr<void>& owner() const { return owner_; }
+    DType dtype() const { return dtype_; }
+    size_t nbytes() const { return size_ * dtype_size(dtype_); }
+
+    void* raw() { return ptr_; }
+    const void* raw() const { return ptr_; }
+
+    // T 必须与 dtype() 对应 (见 DTypeOf)，否则抛异常
+    template <typename T> T* data_ptr() { check_dtype(dtype_of<T>()); return static_cast<T*>(ptr_); }
+    template <typename T> const T* data_ptr() const { check_dtype(dtype_of<T>()); return static_cast<const T*>(ptr_); }
+
+    float* data() { check_f32(); return static_cast<float*>(ptr_); }
+    const float* data() const { check_f32(); return static_cast<const float*>(ptr_); }
+    float& operator[](size_t i) { assert(dtype_ == DType::Float32); return static_cast<float*>(ptr_)[i]; }
+    const float& operator[](size_t i) const { assert(dtype_ == DType::Float32); return static_cast<const float*>(ptr_)[i]; }
+    float* begin() { return data(); }
+    float* end() { return data() + size_; }
+    const float* begin() const { return data(); }
+    const float* end() const { return data() + size_; }
+
+    // 以下接口只产生 Float32 存储
+    void assign(size_t n, float value);
+    void resize(size_t n, float value = 0.0f);
+    void clear();
+    std::vector<float> to_vector() const { return std::vector<float>(begin(), end()); }
+
+private:
+    void allocate(size_t n, DType dtype = DType::Float32);
+    void prepare_write(size_t n, DType dtype); // 写入前按需重新分配 (视图则检查长度与 dtype)
+    void copy_from(const void* src, size_t n);
+    void check_f32() const {
+        if (dtype_ != DType::Float32) throw_not_f32();
+    }
+    void check_dtype(DType expected) const {
+        if (dtype_ != expected) throw_dtype_mismatch(expected);
+    }
+    [[noreturn]] void throw_not_f32() const;
+    [[noreturn]] void throw_dtype_mismatch(DType expected) const;
+    [[noreturn]] void throw_view_resize(size_t n, DType dtype) const;
+
+    std::shared_ptr<void> owner_;
+    void* ptr_{nullptr};
+    size_t size_{0};
+    bool is_view_{false};
+    DType dtype_{DType::Float32};
+};
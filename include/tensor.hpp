@@ -1,5 +1,8 @@
 #pragma once
 #include "tensor_utils.hpp"
+#include "storage.hpp"
+#include "memory_profiler.hpp"
+#include <algorithm>
 #include <vector>
 #include <memory>
 #include <functional>
@@ -8,17 +11,35 @@
 #include <iostream>
 
 struct GradFn;
+class Tensor;
+
+// 梯度就绪钩子，参数为梯度已累加完毕的叶子张量
+using GradHook = std::function<void(Tensor&)>;
+
+// --- 行稀疏梯度 ---
+// 用于 Embedding 这类只触及少数行的参数：indices 升序且互不重复，
+// values 形状为 [indices.size(), row_size]，不为整张表分配稠密 grad_
+struct SparseRowGrad {
+    std::vector<size_t> indices;
+    Storage values;
+    size_t row_size{0};
+
+    bool empty() const { return indices.empty(); }
+    void clear() { indices.clear(); values.clear(); }
+};
 
 struct TensorImpl {
     /* === 数据本体 === */
-    std::vector<float> data_;
+    Storage data_;
     std::vector<size_t> shape_;
 
     /* === Autograd 内部状态 === */
-    std::vector<float> grad_;
+    Storage grad_;
     bool requires_grad_{false};
     std::shared_ptr<GradFn> grad_fn_; // 保持使用 shared_ptr 管理 grad_fn
-    int grad_pending_{0};             // 用于拓扑排序的依赖计数
+    bool sparse_grad_{false};         // 为 true 时梯度累加到 sparse_rows_，grad_ 保持为空
+    SparseRowGrad sparse_rows_;
+    std::vector<std::pair<size_t, GradHook>> grad_hooks_; // (id, hook)，按注册顺序调用
 
     // 构造函数
     TensorImpl(const std::vector<size_t>& shape, bool requires_grad)
@@ -30,6 +51,25 @@ struct TensorImpl {
             grad_.assign(n, 0.0f);
         }
     }
+
+    // 直接接管一段已有的 Storage（例如 arena 视图）
+    TensorImpl(const std::vector<size_t>& shape, Storage data, bool requires_grad)
+        : data_(std::move(data)), shape_(shape), requires_grad_(requires_grad) {
+        if (requires_grad_) {
+            if (!is_floating_point(data_.dtype())) {
+                throw std::runtime_error("Only floating point tensors can require gradients");
+            }
+            alloc_grad();
+        }
+    }
+
+    ~TensorImpl();
+
+    // 按 grad_dtype 分配清零的稠密梯度
+    void alloc_grad() {
+        grad_ = Storage(data_.size(), grad_dtype(data_.dtype()));
+        if (memory_profiling_enabled()) memory_tag(grad_, MemoryKind::Grad);
+    }
 };
 
 // --- 外壳：Tensor 句柄 ---
@@ -43,6 +83,19 @@ public:
 
     // (可选) 增加支持大括号 {} 初始化的构造函数，这样写起来更像 PyTorch
     Tensor(const std::vector<size_t>& shape, std::initializer_list<float> data, bool requires_grad = false);
+    // 接管一段 Storage（不拷贝），Storage 长度必须与 shape 一致
+    Tensor(const std::vector<size_t>& shape, Storage data, bool requires_grad = false);
+    // 指定存储类型的全 0 张量；梯度类型见 grad_dtype (Float64 为 Float64，其余为 Float32)
+    Tensor(const std::vector<size_t>& shape, DType dtype, bool requires_grad = false);
+    // 由任意算术类型的数据构造，dtype 由 T 决定 (如 std::vector<int64_t> -> Int64)
+    template <typename T>
+    static Tensor from_data(const std::vector<size_t>& shape, const std::vector<T>& data,
+                            bool requires_grad = false) {
+        Tensor t(shape, dtype_of<T>(), requires_grad);
+        if (data.size() != t.numel()) throw std::runtime_error("Data size does not match tensor shape");
+        std::copy(data.begin(), data.end(), t.data().template data_ptr<T>());
+        return t;
+    }
     
     // 拷贝构造与赋值：现在是浅拷贝（遥控器拷贝）
     Tensor(const Tensor& other) : impl_(other.impl_) {}
@@ -53,16 +106,25 @@ public:
     ~Tensor() = default;
 
     // 基本信息
+    bool defined() const { return impl_ != nullptr; }
     const std::vector<size_t>& shape() const { return impl_->shape_; }
     size_t numel() const;
+    DType dtype() const { return impl_->data_.dtype(); }
 
     // 数据访问
-    std::vector<float>& data() { return impl_->data_; }
-    const std::vector<float>& data() const { return impl_->data_; }
-    std::vector<float>& grad() { return impl_->grad_; }
-    const std::vector<float>& grad() const { return impl_->grad_; }
+    Storage& data() { return impl_->data_; }
+    const Storage& data() const { return impl_->data_; }
+    Storage& grad() { return impl_->grad_; }
+    const Storage& grad() const { return impl_->grad_; }
 
-    // 索引访问
+    // 按元素类型访问数据，T 必须与 dtype() 对应
+    template <typename T> T* data_ptr() { return impl_->data_.template data_ptr<T>(); }
+    template <typename T> const T* data_ptr() const { return impl_->data_.template data_ptr<T>(); }
+
+    // 转换存储类型 (浮点之间可求导，梯度转换回输入的梯度类型)；类型相同时返回自身
+    Tensor to(DType dtype) const;
+
+    // 索引访问 (仅 Float32)
     float& operator[](size_t i) { return impl_->data_[i]; }
     const float& operator[](size_t i) const { return impl_->data_[i]; }
     float& operator()(const std::vector<size_t>& indices);
@@ -83,23 +145,39 @@ public:
 
     /* === Autograd 接口 === */
     friend struct GradFn;
+    friend class MemoryProfiler;
     bool requires_grad() const { return impl_ ? impl_->requires_grad_ : false; }
     void set_requires_grad(bool r);
     void zero_grad();
+    // 行稀疏梯度开关 (仅对 2D 参数有意义)，开启后释放稠密 grad_
+    void set_sparse_grad(bool sparse);
+    bool is_sparse_grad() const { return impl_ && impl_->sparse_grad_; }
+    SparseRowGrad& sparse_grad() { return impl_->sparse_rows_; }
+    const SparseRowGrad& sparse_grad() const { return impl_->sparse_rows_; }
     void backward(); 
+    // 以 grad_out (与本张量同形状) 作为种子梯度反向传播
+    void backward(const Storage& grad_out);
     
+    // 梯度就绪钩子 (仅叶子张量)：一次 backward 中所有流向本张量的梯度都累加完后调用 hook(*this)，
+    // 此后这次 backward 不会再改动它的梯度。返回的 id 用于 remove_grad_hook
+    size_t register_grad_hook(GradHook hook);
+    void remove_grad_hook(size_t id);
+
     GradFn* grad_fn() const { return impl_->grad_fn_.get(); }
     void set_grad_fn(GradFn* fn);
 
-    // 暴露内部 pending 给拓扑排序使用
-    int& grad_pending() { return impl_->grad_pending_; }
-
 protected:
     void accumulate_grad(const std::vector<float>& g);
+    void accumulate_grad(const Storage& g);
+    void accumulate_grad(const float* g, size_t n);
+    // rows 升序不重复，values 为 [rows.size(), 最后一维]；稀疏模式下合并进 sparse_rows_，否则加到对应行
+    void accumulate_grad_rows(const std::vector<size_t>& rows, const Storage& values);
 
 private:
     std::shared_ptr<TensorImpl> impl_;
     size_t calcOffset(const std::vector<size_t>& indices) const;
+    struct BackwardPass; // 一次 run_backward 的叶子钩子状态，见 tensor.cpp
+    void run_backward(); // 种子梯度已写入 grad_ 后，按拓扑序执行各个 grad_fn
 };
 
 // class Tensor {
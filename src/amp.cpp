@@ -0,0 +1,70 @@
+#include "amp.hpp"
+#include "ops.hpp"
+#include "parallel.hpp"
+#include <atomic>
+#include <cmath>
+
+namespace {
+
+thread_local DType g_autocast = DType::Float32;
+
+constexpr size_t kUnscaleGrain = 1 << 15;
+
+// 原地 g *= inv，返回这段里是否出现 inf/nan
+bool unscale(float* g, size_t n, float inv) {
+    std::atomic<bool> bad{false};
+    parallel_for(0, n, kUnscaleGrain, [&](size_t lo, size_t hi) {
+        bool local = false;
+        for (size_t i = lo; i < hi; ++i) {
+            g[i] *= inv;
+            local |= !std::isfinite(g[i]);
+        }
+        if (local) bad.store(true, std::memory_order_relaxed);
+    });
+    return bad.load();
+}
+
+} // namespace
+
+DType autocast_dtype() { return g_autocast; }
+
+AutocastGuard::AutocastGuard(DType dtype) : prev_(g_autocast) { g_autocast = dtype; }
+
+AutocastGuard::~AutocastGuard() { g_autocast = prev_; }
+
+// ---------------- GradScaler ----------------
+
+GradScaler::GradScaler(float init_scale, float growth_factor, float backoff_factor, size_t growth_interval)
+    : scale_(init_scale), growth_factor_(growth_factor), backoff_factor_(backoff_factor),
+      growth_interval_(growth_interval) {}
+
+Tensor GradScaler::scale(const Tensor& loss) const {
+    return mul(loss, Tensor({1}, {scale_}));
+}
+
+bool GradScaler::step(Optimizer& opt) {
+    const float inv = 1.0f / scale_;
+    found_inf_ = false;
+    for (const Tensor& p : opt.params()) {
+        Tensor t = p;
+        if (t.is_sparse_grad()) {
+            auto& v = t.sparse_grad().values;
+            if (!v.empty()) found_inf_ |= unscale(v.data(), v.size(), inv);
+        } else if (!t.grad().empty()) {
+            found_inf_ |= unscale(t.grad().data(), t.grad().size(), inv);
+        }
+    }
+    if (found_inf_) return false;
+    opt.step();
+    return true;
+}
+
+void GradScaler::update() {
+    if (found_inf_) {
+        scale_ *= backoff_factor_;
+        good_steps_ = 0;
+    } else if (++good_steps_ == growth_interval_) {
+        scale_ *= growth_factor_;
+        good_steps_ = 0;
+    }
+}
@@ -7,6 +7,33 @@ void GradFn::accumulate(Tensor* t, const std::vector<float>& g) {
     }
 }
 
+void GradFn::accumulate(Tensor* t, const Storage& g) {
+    if (t && t->requires_grad()) {
+        t->accumulate_grad(g);
+    }
+}
+
+void GradFn::accumulate_rows(Tensor* t, const std::vector<size_t>& rows, const Storage& values) {
+    if (t && t->requires_grad()) {
+        t->accumulate_grad_rows(rows, values);
+    }
+}
+
+// --- 梯度模式 ---
+namespace {
+thread_local bool t_grad_enabled = true;
+thread_local size_t t_dropped_grad_fns = 0;
+} // namespace
+
+bool is_grad_enabled() { return t_grad_enabled; }
+void set_grad_enabled(bool enabled) { t_grad_enabled = enabled; }
+
+GradModeGuard::GradModeGuard(bool enabled) : saved_(t_grad_enabled) { t_grad_enabled = enabled; }
+GradModeGuard::~GradModeGuard() { t_grad_enabled = saved_; }
+
+size_t dropped_grad_fn_count() { return t_dropped_grad_fns; }
+void note_dropped_grad_fn() { ++t_dropped_grad_fns; }
+
 // // Add 实现
 // void AddGradFn::backward(const std::vector<float>& grad_out) {
 //     if (a_.requires_grad())  accumulate(&a_, grad_out);
@@ -0,0 +1,215 @@
+#include "checkpoint.hpp"
+#include "parallel.hpp"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr size_t kStagingAlign = 16; // 以 float 计，与 ParamArena 一致
+constexpr size_t kCopyGrain = 1 << 16;
+
+size_t align_up(size_t n) { return (n + kStagingAlign - 1) / kStagingAlign * kStagingAlign; }
+
+// rename 之后 fsync 目录，保证目录项本身也已持久化
+void sync_parent_dir(const std::string& path) {
+#if !defined(_WIN32)
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+#else
+    (void)path;
+#endif
+}
+
+} // namespace
+
+// ---------------- AsyncCheckpointer ----------------
+
+AsyncCheckpointer::AsyncCheckpointer(size_t max_in_flight)
+    : max_in_flight_(std::max<size_t>(1, max_in_flight)) {
+    thread_ = std::thread([this] { writer_loop(); });
+}
+
+AsyncCheckpointer::~AsyncCheckpointer() {
+    {
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait(lk, [&] { return in_flight_ == 0; });
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+void AsyncCheckpointer::rethrow_error() {
+    if (error_) {
+        std::exception_ptr e = error_;
+        error_ = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+void AsyncCheckpointer::save(const std::string& path, const NamedTensors& tensors, Optimizer* opt) {
+    // 1. 收集要保存的 (名字, 形状, 源指针)
+    struct Item {
+        std::string name;
+        std::vector<size_t> shape;
+        const float* src;
+        size_t n;
+    };
+    std::vector<Item> items;
+    for (auto& kv : tensors) items.push_back({kv.first, kv.second.shape(), kv.second.data().data(), kv.second.numel()});
+    Tensor step; // 步数单独以 int64 保存：放进 float 暂存缓冲会在 2^24 之后丢精度
+    if (opt) {
+        for (auto& kv : opt->state_buffers()) {
+            items.push_back({"optim." + kv.first, {kv.second->size()}, kv.second->data(), kv.second->size()});
+        }
+        step = Tensor::from_data<int64_t>({1}, {static_cast<int64_t>(opt->step_count())});
+    }
+    size_t total = 0;
+    for (auto& it : items) total = align_up(total + it.n);
+
+    // 2. 等待空位，并尽量复用一块足够大的暂存缓冲
+    auto job = std::make_unique<Job>();
+    job->path = path;
+    {
+        std::unique_lock<std::mutex> lk(mu_);
+        rethrow_error();
+        cv_.wait(lk, [&] { return in_flight_ < max_in_flight_ || error_; });
+        rethrow_error();
+        ++in_flight_;
+        for (size_t i = 0; i < pool_.size(); ++i) {
+            if (pool_[i].size() >= total) {
+                job->staging.rebind(std::move(pool_[i]));
+                pool_.erase(pool_.begin() + static_cast<std::ptrdiff_t>(i));
+                break;
+            }
+        }
+    }
+    // 暂存缓冲的分配或拷贝抛异常时归还占位 (以及取出的缓冲)，否则 wait() 与析构会一直等下去
+    struct SlotGuard {
+        AsyncCheckpointer* self;
+        Job* job;
+        ~SlotGuard() {
+            if (!job) return;
+            {
+                std::lock_guard<std::mutex> lk(self->mu_);
+                if (!job->staging.empty()) self->pool_.push_back(std::move(job->staging));
+                --self->in_flight_;
+            }
+            self->cv_.notify_all();
+        }
+    } guard{this, job.get()};
+    if (job->staging.size() < total) job->staging.rebind(Storage(total));
+
+    // 3. 快照：训练线程只付出这一次拷贝
+    size_t off = 0;
+    for (auto& it : items) {
+        float* dst = job->staging.data() + off;
+        const float* src = it.src;
+        parallel_for(0, it.n, kCopyGrain, [&](size_t lo, size_t hi) {
+            std::memcpy(dst + lo, src + lo, (hi - lo) * sizeof(float));
+        });
+        job->views.emplace_back(it.name, Tensor(it.shape, Storage::view(dst, it.n, job->staging.owner())));
+        off = align_up(off + it.n);
+    }
+    if (opt) job->views.emplace_back("optim.step", std::move(step));
+
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        guard.job = nullptr; // 占位从这里起交给写盘线程
+        queue_.push_back(std::move(job));
+    }
+    cv_.notify_all();
+}
+
+void AsyncCheckpointer::save(const std::string& path, const Module& m, Optimizer* opt) {
+    save(path, m.named_parameters(), opt);
+}
+
+void AsyncCheckpointer::writer_loop() {
+    std::unique_lock<std::mutex> lk(mu_);
+    while (true) {
+        cv_.wait(lk, [&] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) return; // stop_ 且队列已空
+        std::unique_ptr<Job> job = std::move(queue_.front());
+        queue_.pop_front();
+        lk.unlock();
+
+        std::exception_ptr err;
+        std::string tmp = job->path + ".tmp";
+        try {
+            save_tensors(tmp, job->views, true);
+            if (std::rename(tmp.c_str(), job->path.c_str()) != 0) {
+                throw std::runtime_error("Failed to rename checkpoint to " + job->path);
+            }
+            sync_parent_dir(job->path);
+        } catch (...) {
+            std::remove(tmp.c_str());
+            err = std::current_exception();
+        }
+        job->views.clear();
+
+        lk.lock();
+        if (err && !error_) error_ = err;
+        if (!err) ++completed_;
+        pool_.push_back(std::move(job->staging));
+        --in_flight_;
+        cv_.notify_all();
+    }
+}
+
+void AsyncCheckpointer::wait() {
+    std::unique_lock<std::mutex> lk(mu_);
+    cv_.wait(lk, [&] { return in_flight_ == 0; });
+    rethrow_error();
+}
+
+size_t AsyncCheckpointer::in_flight() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return in_flight_;
+}
+
+size_t AsyncCheckpointer::completed() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return completed_;
+}
+
+// ---------------- 恢复 ----------------
+
+void load_checkpoint(const std::string& path, Module& m, Optimizer* opt) {
+    NamedTensors loaded = load_tensors(path);
+    std::unordered_map<std::string, const Tensor*> by_name;
+    for (auto& kv : loaded) by_name[kv.first] = &kv.second;
+
+    for (auto& kv : m.named_parameters()) {
+        auto it = by_name.find(kv.first);
+        if (it == by_name.end()) throw std::runtime_error("Missing parameter in checkpoint: " + kv.first);
+        if (it->second->shape() != kv.second.shape()) {
+            throw std::runtime_error("Shape mismatch for parameter " + kv.first);
+        }
+        kv.second.data() = cast(*it->second, kv.second.dtype()).data(); // 拷贝，恢复后的训练不触碰映射
+    }
+
+    if (!opt) return;
+    for (auto& kv : opt->state_buffers()) {
+        auto it = by_name.find("optim." + kv.first);
+        if (it == by_name.end()) throw std::runtime_error("Missing optimizer state in checkpoint: " + kv.first);
+        const Storage& src = it->second->data();
+        if (src.size() != kv.second->size()) throw std::runtime_error("Optimizer state size mismatch: " + kv.first);
+        std::copy(src.begin(), src.end(), kv.second->begin());
+    }
+    auto it = by_name.find("optim.step");
+    if (it == by_name.end()) throw std::runtime_error("Missing optimizer step in checkpoint");
+    opt->set_step_count(static_cast<size_t>(cast(*it->second, DType::Int64).data_ptr<int64_t>()[0]));
+}
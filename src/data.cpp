@@ -0,0 +1,251 @@
+#include "data.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+// ---------------- TensorDataset ----------------
+
+TensorDataset::TensorDataset(std::vector<Tensor> tensors) : tensors_(std::move(tensors)) {
+    if (tensors_.empty()) throw std::runtime_error("TensorDataset needs at least one tensor");
+    for (auto& t : tensors_) {
+        if (t.shape().empty() || t.shape()[0] != tensors_[0].shape()[0]) {
+            throw std::runtime_error("TensorDataset tensors must share the first dimension");
+        }
+    }
+}
+
+size_t TensorDataset::size() const { return tensors_[0].shape()[0]; }
+
+std::vector<std::vector<size_t>> TensorDataset::sample_shapes() const {
+    std::vector<std::vector<size_t>> shapes;
+    for (auto& t : tensors_) shapes.emplace_back(t.shape().begin() + 1, t.shape().end());
+    return shapes;
+}
+
+void TensorDataset::get(size_t index, const std::vector<float*>& out) const {
+    for (size_t f = 0; f < tensors_.size(); ++f) {
+        size_t n = tensors_[f].numel() / tensors_[f].shape()[0];
+        std::memcpy(out[f], tensors_[f].data().data() + index * n, n * sizeof(float));
+    }
+}
+
+// ---------------- DataLoader 共享状态 ----------------
+
+struct DataLoaderState {
+    enum class SlotState { Free, Filling, Ready, InUse }; // InUse：已交给调用方
+    struct Slot {
+        std::vector<Storage> buffers; // 每个字段一段 [batch_size, field...] 的内存
+        std::vector<size_t> indices;
+        SlotState state{SlotState::Free};
+        size_t batch_id{0};
+    };
+
+    std::shared_ptr<Dataset> dataset;
+    DataLoaderOptions opt;
+    std::vector<std::vector<size_t>> shapes;
+    std::vector<size_t> field_numel;
+    size_t n_batches{0};
+    std::vector<Slot> slots;
+
+    std::mutex mu;
+    std::condition_variable cv_free, cv_ready;
+    size_t next_fill{0}; // 下一个待认领的全局 batch 编号 (跨 epoch 连续编号)
+    size_t epoch{0};
+    size_t pos{0};       // 当前 epoch 内主线程已取走的 batch 数
+    bool stop{false};
+    std::exception_ptr error;
+    std::map<size_t, std::shared_ptr<const std::vector<size_t>>> orders; // epoch -> 样本顺序
+    std::vector<std::thread> workers;
+
+    // 需持有 mu
+    std::shared_ptr<const std::vector<size_t>> order(size_t e) {
+        auto it = orders.find(e);
+        if (it != orders.end()) return it->second;
+        auto ord = std::make_shared<std::vector<size_t>>(dataset->size());
+        std::iota(ord->begin(), ord->end(), size_t{0});
+        if (opt.shuffle) {
+            std::seed_seq seq{static_cast<uint32_t>(opt.seed), static_cast<uint32_t>(opt.seed >> 32),
+                              static_cast<uint32_t>(e)};
+            std::mt19937_64 gen(seq);
+            std::shuffle(ord->begin(), ord->end(), gen);
+        }
+        orders[e] = ord;
+        return ord;
+    }
+
+    // 不持有 mu：把全局第 g 个 batch 的样本直接写进槽内存
+    void fill(Slot& s, size_t g, const std::vector<size_t>& ord) {
+        size_t start = (g % n_batches) * opt.batch_size;
+        size_t n = std::min(opt.batch_size, ord.size() - start);
+        s.indices.assign(ord.begin() + start, ord.begin() + start + n);
+        std::vector<float*> ptrs(shapes.size());
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t f = 0; f < shapes.size(); ++f) ptrs[f] = s.buffers[f].data() + i * field_numel[f];
+            dataset->get(s.indices[i], ptrs);
+        }
+    }
+
+    // 需持有 lk：认领下一个 batch 并填充，返回时仍持有 lk
+    void claim_and_fill(std::unique_lock<std::mutex>& lk) {
+        size_t g = next_fill++;
+        Slot& s = slots[g % slots.size()];
+        s.state = SlotState::Filling;
+        s.batch_id = g;
+        auto ord = order(g / n_batches);
+        lk.unlock();
+        try {
+            fill(s, g, *ord);
+        } catch (...) {
+            lk.lock();
+            if (!error) error = std::current_exception();
+            s.state = SlotState::Ready;
+            cv_ready.notify_all();
+            return;
+        }
+        lk.lock();
+        s.state = SlotState::Ready;
+        cv_ready.notify_all();
+    }
+
+    void worker_loop() {
+        std::unique_lock<std::mutex> lk(mu);
+        while (true) {
+            cv_free.wait(lk, [&] { return stop || slots[next_fill % slots.size()].state == SlotState::Free; });
+            if (stop) return;
+            claim_and_fill(lk);
+        }
+    }
+
+    void release(size_t slot) {
+        std::lock_guard<std::mutex> lk(mu);
+        slots[slot].state = SlotState::Free;
+        cv_free.notify_all();
+    }
+};
+
+// ---------------- Batch ----------------
+
+Batch::Batch(Batch&& other) noexcept { *this = std::move(other); }
+
+Batch& Batch::operator=(Batch&& other) noexcept {
+    if (this != &other) {
+        release();
+        fields = std::move(other.fields);
+        indices = std::move(other.indices);
+        state_ = std::move(other.state_);
+        slot_ = other.slot_;
+    }
+    return *this;
+}
+
+Batch::~Batch() { release(); }
+
+void Batch::release() {
+    fields.clear();
+    indices.clear();
+    if (state_) {
+        state_->release(slot_);
+        state_.reset();
+    }
+}
+
+// ---------------- DataLoader ----------------
+
+DataLoader::DataLoader(std::shared_ptr<Dataset> dataset, DataLoaderOptions options)
+    : state_(std::make_shared<DataLoaderState>()) {
+    if (!dataset) throw std::runtime_error("DataLoader needs a dataset");
+    if (options.batch_size == 0) throw std::runtime_error("DataLoader batch_size must be positive");
+    auto& st = *state_;
+    st.dataset = std::move(dataset);
+    st.opt = options;
+    st.opt.prefetch = std::max<size_t>(1, options.prefetch);
+    st.shapes = st.dataset->sample_shapes();
+    for (auto& shape : st.shapes) {
+        size_t n = 1;
+        for (auto d : shape) n *= d;
+        st.field_numel.push_back(n);
+    }
+    size_t N = st.dataset->size();
+    st.n_batches = options.drop_last ? N / options.batch_size
+                                     : (N + options.batch_size - 1) / options.batch_size;
+
+    // 所有 batch 内存一次性分配，之后只复用
+    st.slots.resize(st.opt.prefetch);
+    for (auto& s : st.slots) {
+        for (auto n : st.field_numel) s.buffers.emplace_back(options.batch_size * n);
+        s.indices.reserve(options.batch_size);
+    }
+
+    if (st.n_batches > 0) {
+        for (size_t w = 0; w < options.num_workers; ++w) {
+            st.workers.emplace_back([&st] { st.worker_loop(); });
+        }
+    }
+}
+
+DataLoader::~DataLoader() {
+    {
+        std::lock_guard<std::mutex> lk(state_->mu);
+        state_->stop = true;
+    }
+    state_->cv_free.notify_all();
+    for (auto& t : state_->workers) t.join();
+}
+
+size_t DataLoader::num_batches() const { return state_->n_batches; }
+
+size_t DataLoader::epoch() const {
+    std::lock_guard<std::mutex> lk(state_->mu);
+    return state_->epoch;
+}
+
+bool DataLoader::next(Batch& out) {
+    out.release();
+    auto& st = *state_;
+    std::unique_lock<std::mutex> lk(st.mu);
+
+    if (st.pos == st.n_batches) {
+        st.pos = 0;
+        ++st.epoch;
+        st.orders.erase(st.orders.begin(), st.orders.lower_bound(st.epoch));
+        return false;
+    }
+
+    size_t g = st.epoch * st.n_batches + st.pos;
+    auto& slot = st.slots[g % st.slots.size()];
+    if (slot.state == DataLoaderState::SlotState::InUse) {
+        // 调用方还持有 prefetch 个 batch 之前的那个 batch，等待只会死锁
+        throw std::runtime_error("DataLoader slot still held by an older Batch; release it or raise prefetch");
+    }
+    if (st.workers.empty()) {
+        // 同步模式：当前线程自己填
+        st.claim_and_fill(lk);
+    } else {
+        st.cv_ready.wait(lk, [&] {
+            return st.error || (slot.state == DataLoaderState::SlotState::Ready && slot.batch_id == g);
+        });
+    }
+    if (st.error) std::rethrow_exception(st.error);
+    ++st.pos;
+    slot.state = DataLoaderState::SlotState::InUse;
+
+    // 交给调用方的是槽内存的视图，形状按实际样本数裁剪
+    size_t n = slot.indices.size();
+    for (size_t f = 0; f < st.shapes.size(); ++f) {
+        std::vector<size_t> shape{n};
+        shape.insert(shape.end(), st.shapes[f].begin(), st.shapes[f].end());
+        Storage& buf = slot.buffers[f];
+        out.fields.emplace_back(shape, Storage::view(buf.data(), n * st.field_numel[f], buf.owner()));
+    }
+    out.indices = slot.indices;
+    out.state_ = state_;
+    out.slot_ = g % st.slots.size();
+    return true;
+}
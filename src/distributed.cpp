@@ -0,0 +1,400 @@
+#include "distributed.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// ---------------- 进程内 (线程) 后端 ----------------
+
+namespace {
+
+constexpr size_t kReduceBlock = 4096; // reduce-scatter 每次在缓存里累加的元素数
+
+// 一个 rank 在本次集合操作里公开的缓冲
+struct Slot {
+    void* ptr{nullptr};
+    size_t n{0};
+    DType dtype{DType::Float32};
+    size_t aux{0}; // all_gather 的输出长度
+};
+
+void check_floating(DType dt) {
+    if (dt != DType::Float32 && dt != DType::Float64) {
+        throw std::runtime_error(std::string("collective: unsupported dtype ") + dtype_name(dt));
+    }
+}
+
+// 第 r 段 [lo, hi)
+std::pair<size_t, size_t> chunk_range(size_t n, size_t world, size_t r) {
+    size_t chunk = (n + world - 1) / world;
+    size_t lo = std::min(n, r * chunk);
+    return {lo, std::min(n, lo + chunk)};
+}
+
+// 把其余 rank 的 [lo, hi) 按块累加进 self 的缓冲，Mean 时块内顺带缩放
+template <typename T>
+void reduce_chunk(const std::vector<Slot>& slots, size_t self, size_t lo, size_t hi, bool mean) {
+    T* dst = static_cast<T*>(slots[self].ptr);
+    const T scale = T(1) / T(slots.size());
+    for (size_t b = lo; b < hi; b += kReduceBlock) {
+        const size_t e = std::min(hi, b + kReduceBlock);
+        for (size_t q = 0; q < slots.size(); ++q) {
+            if (q == self) continue;
+            const T* src = static_cast<const T*>(slots[q].ptr);
+            for (size_t i = b; i < e; ++i) dst[i] += src[i];
+        }
+        if (mean) {
+            for (size_t i = b; i < e; ++i) dst[i] *= scale;
+        }
+    }
+}
+
+} // namespace
+
+struct ThreadGroup::Shared {
+    size_t world;
+    std::vector<Slot> slots;
+    std::mutex mu;
+    std::condition_variable cv;
+    size_t arrived{0};
+    size_t generation{0};
+
+    explicit Shared(size_t w) : world(w), slots(w) {}
+
+    void barrier() {
+        std::unique_lock<std::mutex> lk(mu);
+        size_t gen = generation;
+        if (++arrived == world) {
+            arrived = 0;
+            ++generation;
+            cv.notify_all();
+            return;
+        }
+        cv.wait(lk, [&] { return generation != gen; });
+    }
+
+    // 公开本 rank 的缓冲并等齐所有 rank；各 rank 用同一份公开信息校验，出错时一起抛异常
+    void publish(size_t rank, Slot s, const char* op) {
+        slots[rank] = s;
+        barrier();
+        for (const Slot& o : slots) {
+            if (o.n != slots[0].n || o.dtype != slots[0].dtype || o.aux != slots[0].aux) {
+                throw std::runtime_error(std::string(op) + ": buffers differ across ranks");
+            }
+        }
+        check_floating(slots[0].dtype);
+    }
+};
+
+namespace {
+
+class ThreadRank : public ProcessGroup {
+public:
+    ThreadRank(std::shared_ptr<ThreadGroup::Shared> s, size_t rank) : s_(std::move(s)), rank_(rank) {}
+
+    size_t rank() const override { return rank_; }
+    size_t size() const override { return s_->world; }
+
+    void barrier() override { s_->barrier(); }
+
+    void all_reduce(Storage& buf, ReduceOp op) override {
+        s_->publish(rank_, {buf.raw(), buf.size(), buf.dtype(), 0}, "all_reduce");
+        const size_t n = buf.size(), esize = dtype_size(buf.dtype());
+        // 1. reduce-scatter：只写自己负责的一段，只读其余 rank 的同一段
+        auto own = chunk_range(n, s_->world, rank_);
+        if (buf.dtype() == DType::Float64) reduce_chunk<double>(s_->slots, rank_, own.first, own.second, op == ReduceOp::Mean);
+        else reduce_chunk<float>(s_->slots, rank_, own.first, own.second, op == ReduceOp::Mean);
+        s_->barrier();
+        // 2. all-gather：从负责者那里拷回其余段
+        char* dst = static_cast<char*>(buf.raw());
+        for (size_t q = 0; q < s_->world; ++q) {
+            if (q == rank_) continue;
+            auto r = chunk_range(n, s_->world, q);
+            const char* src = static_cast<const char*>(s_->slots[q].ptr);
+            std::memcpy(dst + r.first * esize, src + r.first * esize, (r.second - r.first) * esize);
+        }
+        // 3. 等所有 rank 拷完，之后各自才能改动缓冲
+        s_->barrier();
+    }
+
+    void broadcast(Storage& buf, size_t root) override {
+        if (root >= s_->world) throw std::runtime_error("broadcast: root out of range");
+        s_->publish(rank_, {buf.raw(), buf.size(), buf.dtype(), 0}, "broadcast");
+        if (rank_ != root) std::memcpy(buf.raw(), s_->slots[root].ptr, buf.nbytes());
+        s_->barrier();
+    }
+
+    void all_gather(const Storage& in, Storage& out) override {
+        s_->publish(rank_, {const_cast<void*>(in.raw()), in.size(), in.dtype(), out.size()}, "all_gather");
+        if (out.size() != in.size() * s_->world || out.dtype() != in.dtype()) {
+            // 各 rank 的 out 长度已校验一致，这里所有 rank 会一起抛出
+            throw std::runtime_error("all_gather: output must hold size() * input elements");
+        }
+        char* dst = static_cast<char*>(out.raw());
+        for (size_t q = 0; q < s_->world; ++q) {
+            std::memcpy(dst + q * in.nbytes(), s_->slots[q].ptr, in.nbytes());
+        }
+        s_->barrier();
+    }
+
+private:
+    std::shared_ptr<ThreadGroup::Shared> s_;
+    size_t rank_;
+};
+
+} // namespace
+
+ThreadGroup::ThreadGroup(size_t world_size) {
+    if (world_size == 0) throw std::runtime_error("ThreadGroup: world_size must be positive");
+    shared_ = std::make_shared<Shared>(world_size);
+    for (size_t r = 0; r < world_size; ++r) handles_.push_back(std::make_unique<ThreadRank>(shared_, r));
+}
+
+ThreadGroup::~ThreadGroup() = default;
+
+ProcessGroup& ThreadGroup::handle(size_t rank) {
+    if (rank >= handles_.size()) throw std::runtime_error("ThreadGroup: rank out of range");
+    return *handles_[rank];
+}
+
+// ---------------- DataParallel ----------------
+
+DataParallel::DataParallel(size_t num_replicas, const std::function<std::shared_ptr<Module>()>& make_replica)
+    : group_(num_replicas) {
+    for (size_t r = 0; r < num_replicas; ++r) {
+        auto m = make_replica();
+        if (!m) throw std::runtime_error("DataParallel: make_replica returned null");
+        for (const Tensor& p : m->parameters()) {
+            if (p.is_sparse_grad()) throw std::runtime_error("DataParallel does not support sparse gradients");
+        }
+        if (!m->is_flattened()) m->flatten_parameters();
+        replicas_.push_back(std::move(m));
+    }
+    // 各副本从副本 0 的参数出发
+    const ParamArena& first = *replicas_[0]->arena();
+    for (size_t r = 1; r < num_replicas; ++r) {
+        ParamArena& a = *replicas_[r]->arena();
+        if (a.size() != first.size() || a.data.dtype() != first.data.dtype()) {
+            throw std::runtime_error("DataParallel: replicas have different parameter layouts");
+        }
+        a.data = first.data;
+    }
+    for (size_t r = 0; r < num_replicas; ++r) workers_.emplace_back([this, r] { worker_loop(r); });
+}
+
+DataParallel::~DataParallel() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& w : workers_) w.join();
+}
+
+void DataParallel::worker_loop(size_t rank) {
+    SerialRegion serial;
+    size_t seen = 0;
+    while (true) {
+        const std::function<void(size_t)>* job;
+        {
+            std::unique_lock<std::mutex> lk(mu_);
+            cv_.wait(lk, [&] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+            job = job_;
+        }
+        std::exception_ptr err;
+        try {
+            (*job)(rank);
+        } catch (...) {
+            err = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lk(mu_);
+        if (err && !error_) error_ = err;
+        if (--pending_ == 0) done_cv_.notify_all();
+    }
+}
+
+std::exception_ptr DataParallel::dispatch(const std::function<void(size_t)>& job) {
+    std::unique_lock<std::mutex> lk(mu_);
+    job_ = &job;
+    error_ = nullptr;
+    pending_ = workers_.size();
+    ++generation_;
+    cv_.notify_all();
+    done_cv_.wait(lk, [&] { return pending_ == 0; });
+    return error_;
+}
+
+void DataParallel::run(const ReplicaFn& step, const ReplicaFn& after_reduce) {
+    // step 失败时不进入集合操作，避免其余线程在 all_reduce 里等一个不会到来的 rank
+    if (auto err = dispatch([&](size_t r) { step(r, *replicas_[r]); })) std::rethrow_exception(err);
+    auto err = dispatch([&](size_t r) {
+        group_.handle(r).all_reduce(replicas_[r]->arena()->grad, ReduceOp::Mean);
+        if (after_reduce) after_reduce(r, *replicas_[r]);
+    });
+    if (err) std::rethrow_exception(err);
+}
+
+// ---------------- BucketReducer ----------------
+
+BucketReducer::BucketReducer(const std::vector<Tensor>& params, ProcessGroup& pg, ReduceOp op, size_t bucket_bytes)
+    : pg_(pg), op_(op) {
+    for (const Tensor& p : params) {
+        if (!p.requires_grad()) continue;
+        if (p.is_sparse_grad()) throw std::runtime_error("BucketReducer does not support sparse gradients");
+        if (p.grad().empty()) throw std::runtime_error("BucketReducer: parameter has no gradient buffer");
+        params_.push_back(p);
+    }
+    // 逆序装桶；dtype 变化或超出 bucket_bytes 时另起一桶
+    bucket_of_.resize(params_.size());
+    size_t bytes = 0;
+    for (size_t k = params_.size(); k-- > 0;) {
+        const Storage& g = params_[k].grad();
+        if (buckets_.empty() || bytes + g.nbytes() > bucket_bytes ||
+            g.dtype() != params_[buckets_.back().params[0]].grad().dtype()) {
+            buckets_.emplace_back();
+            bytes = 0;
+        }
+        buckets_.back().params.push_back(k);
+        bucket_of_[k] = buckets_.size() - 1;
+        bytes += g.nbytes();
+    }
+
+    for (Bucket& b : buckets_) {
+        // 桶内各梯度是同一 arena 的视图且首尾相接时，整桶就是 arena 里的一段
+        std::vector<const Storage*> gs;
+        size_t n = 0;
+        for (size_t k : b.params) {
+            gs.push_back(&params_[k].grad());
+            n += params_[k].grad().size();
+        }
+        std::sort(gs.begin(), gs.end(), [](const Storage* x, const Storage* y) { return x->raw() < y->raw(); });
+        bool contiguous = true;
+        for (size_t i = 0; i < gs.size(); ++i) {
+            contiguous = contiguous && gs[i]->is_view() && gs[i]->owner() == gs[0]->owner();
+            if (i > 0) {
+                contiguous = contiguous && static_cast<const char*>(gs[i - 1]->raw()) + gs[i - 1]->nbytes() == gs[i]->raw();
+            }
+        }
+        const DType dt = gs[0]->dtype();
+        b.zero_copy = contiguous;
+        b.buffer = contiguous ? Storage::view(const_cast<void*>(gs[0]->raw()), n, gs[0]->owner(), dt) : Storage(n, dt);
+        b.pending = b.params.size();
+    }
+
+    ready_.assign(params_.size(), false);
+    comm_ = std::thread([this] { comm_loop(); });
+    for (size_t k = 0; k < params_.size(); ++k) {
+        hook_ids_.push_back(params_[k].register_grad_hook([this, k](Tensor&) { mark_ready(k); }));
+    }
+}
+
+BucketReducer::~BucketReducer() {
+    for (size_t k = 0; k < hook_ids_.size(); ++k) params_[k].remove_grad_hook(hook_ids_[k]);
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    comm_.join();
+}
+
+size_t BucketReducer::launched() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return launched_;
+}
+
+void BucketReducer::mark_ready(size_t param) {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (ready_[param]) throw std::runtime_error("BucketReducer: gradient became ready twice in one iteration");
+    ready_[param] = true;
+    Bucket& b = buckets_[bucket_of_[param]];
+    if (--b.pending == 0) launch(b);
+}
+
+void BucketReducer::launch(Bucket& b) {
+    if (!b.zero_copy) {
+        char* dst = static_cast<char*>(b.buffer.raw());
+        for (size_t k : b.params) {
+            const Storage& g = params_[k].grad();
+            std::memcpy(dst, g.raw(), g.nbytes());
+            dst += g.nbytes();
+        }
+    }
+    b.launched = true;
+    ++launched_;
+    cv_.notify_all();
+}
+
+void BucketReducer::comm_loop() {
+    while (true) {
+        Bucket* b;
+        bool failed;
+        {
+            std::unique_lock<std::mutex> lk(mu_);
+            // 按编号依次归约：下一个桶还没满时等它，即使后面的桶已经满了
+            cv_.wait(lk, [&] { return stop_ || (completed_ < buckets_.size() && buckets_[completed_].launched); });
+            if (stop_) return;
+            b = &buckets_[completed_];
+            failed = error_ != nullptr;
+        }
+        std::exception_ptr err;
+        // 出错后不再发起集合操作，只把剩下的桶记为完成，finish 照常返回并抛出
+        if (!failed) {
+            try {
+                pg_.all_reduce(b->buffer, op_);
+                if (!b->zero_copy) {
+                    const char* src = static_cast<const char*>(b->buffer.raw());
+                    for (size_t k : b->params) {
+                        Storage& g = params_[k].grad();
+                        std::memcpy(g.raw(), src, g.nbytes());
+                        src += g.nbytes();
+                    }
+                }
+            } catch (...) {
+                err = std::current_exception();
+            }
+        }
+        std::lock_guard<std::mutex> lk(mu_);
+        if (err && !error_) error_ = err;
+        ++completed_;
+        done_cv_.notify_all();
+    }
+}
+
+void BucketReducer::finish() {
+    std::unique_lock<std::mutex> lk(mu_);
+    for (Bucket& b : buckets_) {
+        if (!b.launched) launch(b);
+    }
+    done_cv_.wait(lk, [&] { return completed_ == buckets_.size(); });
+    for (Bucket& b : buckets_) {
+        b.launched = false;
+        b.pending = b.params.size();
+    }
+    std::fill(ready_.begin(), ready_.end(), false);
+    launched_ = completed_ = 0;
+    if (error_) {
+        auto err = error_;
+        error_ = nullptr;
+        std::rethrow_exception(err);
+    }
+}
+
+Tensor shard_rows(const Tensor& batch, size_t part, size_t parts) {
+    if (batch.shape().empty()) throw std::runtime_error("shard_rows expects at least 1 dim");
+    if (parts == 0 || part >= parts) throw std::runtime_error("shard_rows: part out of range");
+    const size_t rows = batch.shape()[0];
+    const size_t row_bytes = rows ? batch.data().nbytes() / rows : 0;
+    const size_t base = rows / parts, extra = rows % parts;
+    const size_t start = part * base + std::min(part, extra);
+    const size_t count = base + (part < extra ? 1 : 0);
+
+    std::vector<size_t> shape = batch.shape();
+    shape[0] = count;
+    Tensor out(shape, batch.dtype());
+    std::memcpy(out.data().raw(), static_cast<const char*>(batch.data().raw()) + start * row_bytes, count * row_bytes);
+    return out;
+}
@@ -0,0 +1,276 @@
+#include "dtype.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MINIDL_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+size_t dtype_size(DType dtype) {
+    switch (dtype) {
+    case DType::Float32: return 4;
+    case DType::Float16:
+    case DType::BFloat16: return 2;
+    case DType::Float64:
+    case DType::Int64: return 8;
+    case DType::Int32: return 4;
+    case DType::UInt8: return 1;
+    }
+    throw std::runtime_error("Unknown dtype");
+}
+
+const char* dtype_name(DType dtype) {
+    switch (dtype) {
+    case DType::Float32: return "float32";
+    case DType::Float16: return "float16";
+    case DType::BFloat16: return "bfloat16";
+    case DType::Float64: return "float64";
+    case DType::Int32: return "int32";
+    case DType::Int64: return "int64";
+    case DType::UInt8: return "uint8";
+    }
+    return "unknown";
+}
+
+namespace {
+
+int int_rank(DType d) { return d == DType::UInt8 ? 0 : d == DType::Int32 ? 1 : 2; }
+
+} // namespace
+
+DType promote_types(DType a, DType b) {
+    if (a == b) return a;
+    if (a == DType::Float64 || b == DType::Float64) return DType::Float64;
+    bool fa = is_floating_point(a), fb = is_floating_point(b);
+    if (fa && fb) return DType::Float32;
+    if (fa) return a;
+    if (fb) return b;
+    return int_rank(a) >= int_rank(b) ? a : b;
+}
+
+// ---------------- 标量转换 ----------------
+
+uint16_t float_to_half(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, 4);
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t abs = x & 0x7fffffff;
+    if (abs >= 0x7f800000) { // Inf / NaN (NaN 保留 quiet 位)
+        return static_cast<uint16_t>(sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 | ((abs >> 13) & 0x3ff) : 0));
+    }
+    if (abs >= 0x477ff000) return static_cast<uint16_t>(sign | 0x7c00); // >= 65520 舍入为 Inf
+    if (abs < 0x38800000) {
+        // 半精度次正规数：以 2^-24 为单位就近取整 (默认舍入模式即 RNE)
+        float af;
+        std::memcpy(&af, &abs, 4);
+        return static_cast<uint16_t>(sign | static_cast<uint32_t>(std::nearbyint(af * 16777216.0f)));
+    }
+    // 正规数：指数减去 112，尾数按 RNE 舍掉低 13 位 (进位可以自然进到指数)
+    abs += 0xc8000fffu + ((abs >> 13) & 1);
+    return static_cast<uint16_t>(sign | (abs >> 13));
+}
+
+float half_to_float(uint16_t h) {
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t x;
+    if (exp == 0) {
+        float f = static_cast<float>(mant) * (1.0f / 16777216.0f);
+        std::memcpy(&x, &f, 4);
+        x |= sign;
+    } else if (exp == 31) {
+        x = sign | 0x7f800000 | (mant << 13);
+    } else {
+        x = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    float f;
+    std::memcpy(&f, &x, 4);
+    return f;
+}
+
+uint16_t float_to_bf16(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, 4);
+    if ((x & 0x7fffffff) > 0x7f800000) return static_cast<uint16_t>((x >> 16) | 0x40); // quiet NaN
+    x += 0x7fff + ((x >> 16) & 1);
+    return static_cast<uint16_t>(x >> 16);
+}
+
+float bf16_to_float(uint16_t h) {
+    uint32_t x = static_cast<uint32_t>(h) << 16;
+    float f;
+    std::memcpy(&f, &x, 4);
+    return f;
+}
+
+// ---------------- 批量转换内核 ----------------
+
+namespace {
+
+using ConvertFn = void (*)(const void*, void*, size_t);
+
+void f32_to_f16_scalar(const void* src, void* dst, size_t n) {
+    const float* s = static_cast<const float*>(src);
+    uint16_t* d = static_cast<uint16_t*>(dst);
+    for (size_t i = 0; i < n; ++i) d[i] = float_to_half(s[i]);
+}
+
+void f16_to_f32_scalar(const void* src, void* dst, size_t n) {
+    const uint16_t* s = static_cast<const uint16_t*>(src);
+    float* d = static_cast<float*>(dst);
+    for (size_t i = 0; i < n; ++i) d[i] = half_to_float(s[i]);
+}
+
+void f32_to_bf16_scalar(const void* src, void* dst, size_t n) {
+    const float* s = static_cast<const float*>(src);
+    uint16_t* d = static_cast<uint16_t*>(dst);
+    for (size_t i = 0; i < n; ++i) d[i] = float_to_bf16(s[i]);
+}
+
+void bf16_to_f32_scalar(const void* src, void* dst, size_t n) {
+    const uint16_t* s = static_cast<const uint16_t*>(src);
+    float* d = static_cast<float*>(dst);
+    for (size_t i = 0; i < n; ++i) d[i] = bf16_to_float(s[i]);
+}
+
+#if defined(MINIDL_X86_DISPATCH)
+
+__attribute__((target("avx,f16c")))
+void f32_to_f16_f16c(const void* src, void* dst, size_t n) {
+    const float* s = static_cast<const float*>(src);
+    uint16_t* d = static_cast<uint16_t*>(dst);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(s + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), h);
+    }
+    for (; i < n; ++i) d[i] = float_to_half(s[i]);
+}
+
+__attribute__((target("avx,f16c")))
+void f16_to_f32_f16c(const void* src, void* dst, size_t n) {
+    const uint16_t* s = static_cast<const uint16_t*>(src);
+    float* d = static_cast<float*>(dst);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        _mm256_storeu_ps(d + i, _mm256_cvtph_ps(h));
+    }
+    for (; i < n; ++i) d[i] = half_to_float(s[i]);
+}
+
+// VCVTNEPS2BF16 按 RNE 舍入，但把次正规数当 0 处理，与标量路径只在 |x| < 2^-126 时不同
+__attribute__((target("avx512f,avx512bf16")))
+void f32_to_bf16_avx512(const void* src, void* dst, size_t n) {
+    const float* s = static_cast<const float*>(src);
+    uint16_t* d = static_cast<uint16_t*>(dst);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256bh h = _mm512_cvtneps_pbh(_mm512_loadu_ps(s + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i), reinterpret_cast<__m256i&>(h));
+    }
+    for (; i < n; ++i) d[i] = float_to_bf16(s[i]);
+}
+
+__attribute__((target("avx2")))
+void bf16_to_f32_avx2(const void* src, void* dst, size_t n) {
+    const uint16_t* s = static_cast<const uint16_t*>(src);
+    float* d = static_cast<float*>(dst);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i), _mm256_slli_epi32(w, 16));
+    }
+    for (; i < n; ++i) d[i] = bf16_to_float(s[i]);
+}
+
+#endif
+
+struct Kernels {
+    ConvertFn f32_to_f16 = f32_to_f16_scalar;
+    ConvertFn f16_to_f32 = f16_to_f32_scalar;
+    ConvertFn f32_to_bf16 = f32_to_bf16_scalar;
+    ConvertFn bf16_to_f32 = bf16_to_f32_scalar;
+
+    Kernels() {
+#if defined(MINIDL_X86_DISPATCH)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("f16c")) {
+            f32_to_f16 = f32_to_f16_f16c;
+            f16_to_f32 = f16_to_f32_f16c;
+        }
+        if (__builtin_cpu_supports("avx512bf16")) f32_to_bf16 = f32_to_bf16_avx512;
+        if (__builtin_cpu_supports("avx2")) bf16_to_f32 = bf16_to_f32_avx2;
+#endif
+    }
+};
+
+const Kernels& kernels() {
+    static const Kernels k;
+    return k;
+}
+
+constexpr size_t kConvertBlock = 1024;
+constexpr size_t kConvertGrain = 1 << 16;
+
+template <typename S, typename D>
+void cast_loop(const S* s, D* d, size_t n) {
+    for (size_t i = 0; i < n; ++i) d[i] = static_cast<D>(s[i]);
+}
+
+// 有算术类型的两种 dtype 之间直接逐元素 static_cast
+void convert_numeric(const void* src, DType src_dtype, void* dst, DType dst_dtype, size_t n) {
+    MINIDL_DISPATCH_ALL_TYPES(src_dtype, "convert", [&] {
+        using S = scalar_t;
+        MINIDL_DISPATCH_ALL_TYPES(dst_dtype, "convert", [&] {
+            cast_loop(static_cast<const S*>(src), static_cast<scalar_t*>(dst), n);
+        });
+    });
+}
+
+} // namespace
+
+void convert(const void* src, DType src_dtype, void* dst, DType dst_dtype, size_t n) {
+    if (n == 0) return;
+    if (src_dtype == dst_dtype) {
+        std::memmove(dst, src, n * dtype_size(src_dtype));
+        return;
+    }
+    if (!is_half(src_dtype) && !is_half(dst_dtype)) {
+        convert_numeric(src, src_dtype, dst, dst_dtype, n);
+        return;
+    }
+    if (src_dtype != DType::Float32 && dst_dtype != DType::Float32) {
+        // 半精度与其他类型之间经 fp32 中转，分块放在栈上
+        float buf[kConvertBlock];
+        size_t ss = dtype_size(src_dtype), ds = dtype_size(dst_dtype);
+        const char* s = static_cast<const char*>(src);
+        char* d = static_cast<char*>(dst);
+        for (size_t i = 0; i < n; i += kConvertBlock) {
+            size_t m = std::min(kConvertBlock, n - i);
+            convert(s + i * ss, src_dtype, buf, DType::Float32, m);
+            convert(buf, DType::Float32, d + i * ds, dst_dtype, m);
+        }
+        return;
+    }
+    const Kernels& k = kernels();
+    if (src_dtype == DType::Float32) {
+        (dst_dtype == DType::Float16 ? k.f32_to_f16 : k.f32_to_bf16)(src, dst, n);
+    } else {
+        (src_dtype == DType::Float16 ? k.f16_to_f32 : k.bf16_to_f32)(src, dst, n);
+    }
+}
+
+void convert_parallel(const void* src, DType src_dtype, void* dst, DType dst_dtype, size_t n) {
+    size_t ss = dtype_size(src_dtype), ds = dtype_size(dst_dtype);
+    const char* s = static_cast<const char*>(src);
+    char* d = static_cast<char*>(dst);
+    parallel_for(0, n, kConvertGrain, [&](size_t lo, size_t hi) {
+        convert(s + lo * ss, src_dtype, d + lo * ds, dst_dtype, hi - lo);
+    });
+}
@@ -0,0 +1,412 @@
+#include "fusion.hpp"
+#include "grad_fn.hpp"
+#include "parallel.hpp"
+#include "broadcast.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+constexpr size_t kFusedGrain = 1 << 14;
+constexpr size_t kFusedBlock = 256; // 逐元素链按块计算，块内每一步是一条独立的循环
+
+bool is_binary(OpKind k) {
+    return k == OpKind::Add || k == OpKind::Sub || k == OpKind::Mul || k == OpKind::Div;
+}
+
+bool is_elementwise(OpKind k) {
+    switch (k) {
+    case OpKind::Add:
+    case OpKind::Sub:
+    case OpKind::Mul:
+    case OpKind::Div:
+    case OpKind::Neg:
+    case OpKind::AddScalar:
+    case OpKind::SubScalar:
+    case OpKind::RSubScalar:
+    case OpKind::MulScalar:
+    case OpKind::DivScalar:
+    case OpKind::RDivScalar:
+    case OpKind::Relu:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// 链上一步的局部导数：g 为对本步输出的梯度，dv / dy 为对链上输入 / side 输入的梯度
+inline void step_grad(const FusedStep& s, float v, float y, float g, float& dv, float& dy) {
+    const float c = s.scalar;
+    dy = 0.0f;
+    switch (s.kind) {
+    case OpKind::Add: dv = g; dy = g; break;
+    case OpKind::Sub:
+        dv = s.chain_lhs ? g : -g;
+        dy = s.chain_lhs ? -g : g;
+        break;
+    case OpKind::Mul: dv = g * y; dy = g * v; break;
+    case OpKind::Div:
+        if (s.chain_lhs) {
+            dv = g / y;
+            dy = -g * v / (y * y);
+        } else {
+            dv = -g * y / (v * v);
+            dy = g / v;
+        }
+        break;
+    case OpKind::Neg: dv = -g; break;
+    case OpKind::AddScalar:
+    case OpKind::SubScalar: dv = g; break;
+    case OpKind::RSubScalar: dv = -g; break;
+    case OpKind::MulScalar: dv = g * c; break;
+    case OpKind::DivScalar: dv = g / c; break;
+    case OpKind::RDivScalar: dv = -g * c / (v * v); break;
+    case OpKind::Relu: dv = v > 0.0f ? g : 0.0f; break;
+    default: throw std::runtime_error(std::string("fused_elementwise: unsupported op ") + op_name(s.kind));
+    }
+}
+
+void check_nonzero(const float* v, size_t n) {
+    for (size_t j = 0; j < n; ++j) {
+        if (v[j] == 0) throw std::runtime_error("Division by zero");
+    }
+}
+
+// v[j] = f(v[j], y)：y 沿这一行连续时逐个读取，广播时只读 y[0]
+template <typename F>
+void side_loop(float* v, const float* y, bool contiguous, size_t m, F f) {
+    if (contiguous) {
+        for (size_t j = 0; j < m; ++j) v[j] = f(v[j], y[j]);
+    } else {
+        const float c = y[0];
+        for (size_t j = 0; j < m; ++j) v[j] = f(v[j], c);
+    }
+}
+
+// 把链上的一步作用到一个块 v[0, m)；y 为 side 输入在块首的位置 (单目 / 标量运算为空)
+void apply_block(const FusedStep& s, float* v, const float* y, bool y_contiguous, size_t m) {
+    const float c = s.scalar;
+    const bool lhs = s.chain_lhs;
+    switch (s.kind) {
+    case OpKind::Add: side_loop(v, y, y_contiguous, m, [](float a, float b) { return a + b; }); break;
+    case OpKind::Sub:
+        if (lhs) side_loop(v, y, y_contiguous, m, [](float a, float b) { return a - b; });
+        else side_loop(v, y, y_contiguous, m, [](float a, float b) { return b - a; });
+        break;
+    case OpKind::Mul: side_loop(v, y, y_contiguous, m, [](float a, float b) { return a * b; }); break;
+    case OpKind::Div:
+        if (lhs) {
+            check_nonzero(y, y_contiguous ? m : 1);
+            side_loop(v, y, y_contiguous, m, [](float a, float b) { return a / b; });
+        } else {
+            check_nonzero(v, m);
+            side_loop(v, y, y_contiguous, m, [](float a, float b) { return b / a; });
+        }
+        break;
+    case OpKind::Neg: for (size_t j = 0; j < m; ++j) v[j] = -v[j]; break;
+    case OpKind::AddScalar: for (size_t j = 0; j < m; ++j) v[j] = v[j] + c; break;
+    case OpKind::SubScalar: for (size_t j = 0; j < m; ++j) v[j] = v[j] - c; break;
+    case OpKind::RSubScalar: for (size_t j = 0; j < m; ++j) v[j] = c - v[j]; break;
+    case OpKind::MulScalar: for (size_t j = 0; j < m; ++j) v[j] = v[j] * c; break;
+    case OpKind::DivScalar: for (size_t j = 0; j < m; ++j) v[j] = v[j] / c; break;
+    case OpKind::RDivScalar:
+        check_nonzero(v, m);
+        for (size_t j = 0; j < m; ++j) v[j] = c / v[j];
+        break;
+    case OpKind::Relu: for (size_t j = 0; j < m; ++j) v[j] = v[j] > 0.0f ? v[j] : 0.0f; break;
+    default: throw std::runtime_error(std::string("fused_elementwise: unsupported op ") + op_name(s.kind));
+    }
+}
+
+BroadcastLayout fused_layout(const std::vector<Tensor>& inputs, const std::vector<size_t>& out_shape) {
+    std::vector<const std::vector<size_t>*> shapes;
+    for (const Tensor& t : inputs) shapes.push_back(&t.shape());
+    return make_broadcast_layout(out_shape, shapes);
+}
+
+} // namespace
+
+// ---------------- 融合 kernel ----------------
+
+void fused_elementwise_forward(const std::vector<Tensor>& inputs, const std::vector<FusedStep>& steps,
+                               Tensor& out) {
+    if (out.numel() == 0) return;
+    const BroadcastLayout l = fused_layout(inputs, out.shape());
+    std::vector<const float*> src(inputs.size());
+    for (size_t k = 0; k < inputs.size(); ++k) src[k] = inputs[k].data().data();
+    float* o = out.data().data();
+
+    // 按行遍历 (操作数 0 为输出，k + 1 为 inputs[k])，行内分块，每一步在整块上跑完再进行下一步
+    const size_t grain = std::max<size_t>(1, kFusedGrain / l.inner_numel());
+    parallel_for(0, l.shape[0], grain, [&](size_t lo, size_t hi) {
+        float v[kFusedBlock];
+        for_each_row(l, lo, hi, [&](const size_t* off, size_t n) {
+            for (size_t j0 = 0; j0 < n; j0 += kFusedBlock) {
+                const size_t m = std::min(kFusedBlock, n - j0);
+                const bool c0 = l.inner_contiguous(1);
+                for (size_t j = 0; j < m; ++j) v[j] = src[0][off[1] + (c0 ? j0 + j : 0)];
+                for (const auto& s : steps) {
+                    const float* y = nullptr;
+                    bool yc = false;
+                    if (s.side != kNoSide) {
+                        yc = l.inner_contiguous(s.side + 1);
+                        y = src[s.side] + off[s.side + 1] + (yc ? j0 : 0);
+                    }
+                    apply_block(s, v, y, yc, m);
+                }
+                std::copy(v, v + m, o + off[0] + j0);
+            }
+        });
+    });
+}
+
+void fused_elementwise_backward(const std::vector<Tensor>& inputs, const std::vector<FusedStep>& steps,
+                                const std::vector<size_t>& out_shape, const Storage& grad_out,
+                                std::vector<Storage>& grads) {
+    if (grad_out.size() == 0) return;
+    const BroadcastLayout l = fused_layout(inputs, out_shape);
+    std::vector<const float*> src(inputs.size());
+    for (size_t k = 0; k < inputs.size(); ++k) src[k] = inputs[k].data().data();
+    std::vector<float*> dst(inputs.size(), nullptr);
+    for (size_t k = 0; k < inputs.size(); ++k) {
+        if (!grads[k].empty()) dst[k] = grads[k].data();
+    }
+    const float* go = grad_out.data();
+
+    // 写入输入 k 的梯度：沿行连续时逐个累加，沿行广播时先求和再加到一个位置
+    auto scatter = [&](size_t k, const size_t* off, size_t j0, const float* d, size_t m) {
+        if (l.inner_contiguous(k + 1)) {
+            float* p = dst[k] + off[k + 1] + j0;
+            for (size_t j = 0; j < m; ++j) p[j] += d[j];
+        } else {
+            float sum = 0.0f;
+            for (size_t j = 0; j < m; ++j) sum += d[j];
+            dst[k][off[k + 1]] += sum;
+        }
+    };
+
+    // 广播输入的梯度要在多个输出位置上累加，串行执行
+    const size_t S = steps.size();
+    std::vector<float> vals((S + 1) * kFusedBlock);
+    std::vector<const float*> ys(S, nullptr);
+    float g[kFusedBlock], dy[kFusedBlock];
+    for_each_row(l, 0, l.shape[0], [&](const size_t* off, size_t n) {
+        for (size_t j0 = 0; j0 < n; j0 += kFusedBlock) {
+            const size_t m = std::min(kFusedBlock, n - j0);
+            // 1. 重算链上每一步的输入值
+            const bool c0 = l.inner_contiguous(1);
+            for (size_t j = 0; j < m; ++j) vals[j] = src[0][off[1] + (c0 ? j0 + j : 0)];
+            for (size_t s = 0; s < S; ++s) {
+                float* v = &vals[(s + 1) * kFusedBlock];
+                std::copy(&vals[s * kFusedBlock], &vals[s * kFusedBlock] + m, v);
+                size_t side = steps[s].side;
+                bool yc = side != kNoSide && l.inner_contiguous(side + 1);
+                if (side != kNoSide) ys[s] = src[side] + off[side + 1] + (yc ? j0 : 0);
+                apply_block(steps[s], v, ys[s], yc, m);
+            }
+            // 2. 反向走一遍
+            std::copy(go + off[0] + j0, go + off[0] + j0 + m, g);
+            for (size_t s = S; s-- > 0;) {
+                size_t side = steps[s].side;
+                bool yc = side != kNoSide && l.inner_contiguous(side + 1);
+                const float* v = &vals[s * kFusedBlock];
+                for (size_t j = 0; j < m; ++j) {
+                    float y = side == kNoSide ? 0.0f : ys[s][yc ? j : 0];
+                    float dv;
+                    step_grad(steps[s], v[j], y, g[j], dv, dy[j]);
+                    g[j] = dv;
+                }
+                if (side != kNoSide && dst[side]) scatter(side, off, j0, dy, m);
+            }
+            if (dst[0]) scatter(0, off, j0, g, m);
+        }
+    });
+}
+
+void fused_linear_forward(const Tensor& x, const Tensor& w, const Tensor& bias, bool relu,
+                          Tensor& out, uint8_t* mask) {
+    size_t m = x.shape()[0], k = x.shape()[1], n = w.shape()[1];
+    const float* A = x.data().data();
+    const float* B = w.data().data();
+    const float* bs = bias.defined() ? bias.data().data() : nullptr;
+    float* C = out.data().data();
+
+    // 与 matmul 相同的累加顺序，每个元素算完直接加 bias、过激活后写出
+    parallel_for(0, m, std::max<size_t>(1, kFusedGrain / std::max<size_t>(n * k, 1)), [&](size_t r0, size_t r1) {
+        for (size_t i = r0; i < r1; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                float sum = 0.0f;
+                for (size_t p = 0; p < k; ++p) sum += A[i * k + p] * B[p * n + j];
+                if (bs) sum = sum + bs[j];
+                if (relu) {
+                    bool pos = sum > 0.0f;
+                    if (mask) mask[i * n + j] = pos;
+                    if (!pos) sum = 0.0f;
+                }
+                C[i * n + j] = sum;
+            }
+        }
+    });
+}
+
+// ---------------- 融合 pass ----------------
+
+FusionStats fuse_graph(CapturedGraph& g) {
+    if (g.memory_planned_) throw std::runtime_error("fuse_graph must run before plan_memory");
+    auto& nodes = g.nodes_;
+    const size_t n = nodes.size();
+    FusionStats st;
+    st.nodes_before = n;
+
+    // 以 Storage 地址标识张量
+    auto key = [](const Tensor& t) { return &t.data(); };
+    std::unordered_map<const Storage*, size_t> uses, consumer;
+    for (size_t j = 0; j < n; ++j) {
+        for (const Tensor& in : nodes[j].inputs) {
+            uses[key(in)]++;
+            consumer[key(in)] = j;
+        }
+    }
+    // 能被融合掉的中间结果：只被一个算子用一次，且不是图的输出 / 反向起点
+    auto intermediate = [&](const Tensor& t) {
+        auto it = uses.find(key(t));
+        if (it == uses.end() || it->second != 1) return false;
+        if (g.output_.defined() && key(t) == key(g.output_)) return false;
+        if (g.backward_root_.defined() && key(t) == key(g.backward_root_)) return false;
+        return true;
+    };
+    // 输出需要梯度却没有 grad_fn (张量 × 标量) 的算子截断了梯度，需要梯度时不能融合
+    auto cuts_grad = [](const Tensor& t) { return t.requires_grad() && !t.grad_fn(); };
+
+    std::vector<char> removed(n, 0);
+    std::unordered_set<const Storage*> dropped; // 被融合掉的中间张量，它们的反向步骤一并删除
+
+    // 1. matmul epilogue：matmul -> (+ bias) -> (relu)
+    for (size_t i = 0; i < n; ++i) {
+        if (nodes[i].kind != OpKind::MatMul || removed[i]) continue;
+        Tensor x = nodes[i].inputs[0], w = nodes[i].inputs[1];
+        Tensor cur = nodes[i].output;
+        size_t cols = cur.shape()[1];
+        std::vector<size_t> chain = {i};
+        std::vector<OpKind> kinds = {OpKind::MatMul};
+        Tensor bias;
+        bool relu = false;
+
+        if (intermediate(cur)) {
+            size_t j = consumer[key(cur)];
+            const GraphNode& a = nodes[j];
+            if (a.kind == OpKind::Add && a.output.shape() == cur.shape()) {
+                const Tensor& other = key(a.inputs[0]) == key(cur) ? a.inputs[1] : a.inputs[0];
+                if (other.shape().size() <= 2 && !other.shape().empty() && other.shape().back() == cols &&
+                    other.numel() == cols) {
+                    bias = other;
+                    chain.push_back(j);
+                    kinds.push_back(OpKind::Add);
+                    cur = a.output;
+                }
+            }
+        }
+        if (intermediate(cur)) {
+            size_t j = consumer[key(cur)];
+            if (nodes[j].kind == OpKind::Relu) {
+                relu = true;
+                chain.push_back(j);
+                kinds.push_back(OpKind::Relu);
+                cur = nodes[j].output;
+            }
+        }
+        if (chain.size() < 2) continue;
+
+        Tensor out = cur;
+        if (out.requires_grad()) {
+            size_t mask_size = relu ? out.numel() : 0;
+            out.set_grad_fn(new FusedLinearGradFn(x, w, bias, relu, std::vector<uint8_t>(mask_size)));
+        }
+        GraphNode fused{OpKind::FusedMatMul, {x, w}, out, 0.0f, nullptr, kinds};
+        if (bias.defined()) fused.inputs.push_back(bias);
+        fused.kernel = [x, w, bias, relu, out]() mutable {
+            auto* fn = static_cast<FusedLinearGradFn*>(out.grad_fn());
+            fused_linear_forward(x, w, bias, relu, out, fn && relu ? fn->mask_.data() : nullptr);
+        };
+        fused.kernel(); // 填好 relu 掩码
+        for (size_t c = 0; c + 1 < chain.size(); ++c) {
+            removed[chain[c]] = 1;
+            dropped.insert(key(nodes[chain[c]].output));
+        }
+        nodes[chain.back()] = std::move(fused);
+        ++st.matmul_epilogues;
+    }
+
+    // 2. 逐元素链：每个中间结果只流向链上的下一个算子，形状保持为链输出的形状
+    for (size_t i = 0; i < n; ++i) {
+        if (removed[i] || !is_elementwise(nodes[i].kind) || cuts_grad(nodes[i].output)) continue;
+        std::vector<size_t> chain = {i};
+        Tensor cur = nodes[i].output;
+        while (intermediate(cur)) {
+            size_t j = consumer[key(cur)];
+            const GraphNode& nj = nodes[j];
+            if (removed[j] || !is_elementwise(nj.kind) || cuts_grad(nj.output) ||
+                nj.output.shape() != cur.shape()) {
+                break;
+            }
+            chain.push_back(j);
+            cur = nj.output;
+        }
+        if (chain.size() < 2) continue;
+
+        // 外部输入去重，inputs[0] 为链的起点
+        std::vector<Tensor> inputs;
+        auto input_index = [&](const Tensor& t) {
+            for (size_t k = 0; k < inputs.size(); ++k) {
+                if (key(inputs[k]) == key(t)) return k;
+            }
+            inputs.push_back(t);
+            return inputs.size() - 1;
+        };
+        std::vector<FusedStep> steps;
+        std::vector<OpKind> kinds;
+        for (size_t c = 0; c < chain.size(); ++c) {
+            const GraphNode& nd = nodes[chain[c]];
+            kinds.push_back(nd.kind);
+            FusedStep s{nd.kind, kNoSide, true, nd.scalar};
+            if (c == 0) {
+                input_index(nd.inputs[0]);
+                if (is_binary(nd.kind)) s.side = input_index(nd.inputs[1]);
+            } else if (is_binary(nd.kind)) {
+                const Tensor& prev = nodes[chain[c - 1]].output;
+                s.chain_lhs = key(nd.inputs[0]) == key(prev);
+                s.side = input_index(s.chain_lhs ? nd.inputs[1] : nd.inputs[0]);
+            }
+            steps.push_back(s);
+        }
+
+        Tensor out = cur;
+        if (out.requires_grad()) out.set_grad_fn(new FusedElementwiseGradFn(inputs, steps, out.shape()));
+        GraphNode fused{OpKind::FusedElementwise, inputs, out, 0.0f, nullptr, kinds};
+        fused.kernel = [inputs, steps, out]() mutable { fused_elementwise_forward(inputs, steps, out); };
+        for (size_t c = 0; c + 1 < chain.size(); ++c) {
+            removed[chain[c]] = 1;
+            dropped.insert(key(nodes[chain[c]].output));
+        }
+        nodes[chain.back()] = std::move(fused);
+        ++st.elementwise_chains;
+    }
+
+    // 3. 删除被融合的节点与中间张量的反向步骤，重建按需清零的列表
+    std::vector<GraphNode> kept;
+    for (size_t i = 0; i < n; ++i) {
+        if (!removed[i]) kept.push_back(std::move(nodes[i]));
+    }
+    nodes = std::move(kept);
+    std::vector<BackwardStep> steps;
+    for (auto& s : g.backward_) {
+        if (!dropped.count(key(s.tensor))) steps.push_back(std::move(s));
+    }
+    g.backward_ = std::move(steps);
+    g.index_backward();
+
+    st.nodes_after = nodes.size();
+    return st;
+}
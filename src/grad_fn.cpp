@@ -2,67 +2,151 @@
 #include "ops.hpp"
 #include "tensor.hpp" 
 #include "grad_fn.hpp" 
+#include "parallel.hpp"
+#include "kernels.hpp"
+#include "amp.hpp"
+#include "broadcast.hpp"
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// 广播反向：把输出形状的梯度按广播规则求和回输入形状 (梯度类型保持不变)
+Storage reduce_to_shape(const Storage& grad_out,
+                        const std::vector<size_t>& out_shape,
+                        const std::vector<size_t>& in_shape) {
+    size_t n = 1;
+    for (auto d : in_shape) n *= d;
+    Storage g(n, grad_out.dtype());
+    MINIDL_DISPATCH_FLOATING_TYPES(grad_out.dtype(), "reduce_to_shape", [&] {
+        broadcast_reduce_sum(grad_out.data_ptr<scalar_t>(), out_shape, g.data_ptr<scalar_t>(), in_shape);
+    });
+    return g;
+}
+
+Storage negated(const Storage& g) {
+    Storage out(g.size(), g.dtype());
+    MINIDL_DISPATCH_FLOATING_TYPES(g.dtype(), "neg backward", [&] {
+        const scalar_t* src = g.data_ptr<scalar_t>();
+        scalar_t* dst = out.data_ptr<scalar_t>();
+        for (size_t i = 0; i < g.size(); ++i) dst[i] = -src[i];
+    });
+    return out;
+}
+
+// 反向读取输入数值用：转成不建图的 dtype 副本 (半精度 / 整数输入 -> fp32，Float64 梯度 -> Float64)
+Tensor as_dtype(const Tensor& t, DType dtype) {
+    if (t.dtype() == dtype) return t;
+    Tensor out(t.shape(), dtype);
+    convert_parallel(t.data().raw(), t.dtype(), out.data().raw(), dtype, t.numel());
+    return out;
+}
+
+// 乘除法对输入 t (a_ 或 b_) 的梯度：f(g, x, y) 在输出形状上逐元素求值，再按广播规则求和回 t 的形状。
+// 梯度为 Float64 时按 double 计算，否则按 fp32
+template <typename T, typename F>
+Storage binary_input_grad_typed(const Tensor& a_, const Tensor& b_, const Tensor& t, const Storage& grad_out, F& f) {
+    auto out_shape = broadcast_shape(a_.shape(), b_.shape());
+    const Tensor a = as_dtype(a_, grad_out.dtype()), b = as_dtype(b_, grad_out.dtype());
+    Storage full(grad_out.size(), grad_out.dtype());
+    broadcast_map(out_shape, full.data_ptr<T>(), f, broadcast_input(grad_out.data_ptr<T>(), out_shape),
+                  broadcast_input(a.data_ptr<T>(), a_.shape()), broadcast_input(b.data_ptr<T>(), b_.shape()));
+    if (t.shape() == out_shape) return full;
+    Storage g(t.numel(), grad_out.dtype());
+    broadcast_reduce_sum(full.data_ptr<T>(), out_shape, g.data_ptr<T>(), t.shape());
+    return g;
+}
+
+template <typename F>
+Storage binary_input_grad(const Tensor& a, const Tensor& b, const Tensor& t, const Storage& grad_out, F f) {
+    if (grad_out.dtype() == DType::Float64) return binary_input_grad_typed<double>(a, b, t, grad_out, f);
+    return binary_input_grad_typed<float>(a, b, t, grad_out, f);
+}
+
+} // namespace
+
+// Cast 实现
+void CastGradFn::backward(const Storage& grad_out) { accumulate(&src_, grad_out); }
+std::vector<Tensor*> CastGradFn::parents() { return {&src_}; }
+
+// Where 实现：梯度按掩码分给 a 或 b，再按广播规则求和
+void WhereGradFn::backward(const Storage& grad_out) {
+    auto out_shape = broadcast_shape(mask_.shape(), broadcast_shape(a_.shape(), b_.shape()));
+    const uint8_t* M = mask_.data_ptr<uint8_t>();
+    for (Tensor* t : {&a_, &b_}) {
+        if (!t->requires_grad()) continue;
+        bool take = t == &a_;
+        Storage g(grad_out.size(), grad_out.dtype());
+        MINIDL_DISPATCH_FLOATING_TYPES(grad_out.dtype(), "where backward", [&] {
+            broadcast_map(out_shape, g.data_ptr<scalar_t>(),
+                          [take](uint8_t m, scalar_t x) { return (m != 0) == take ? x : scalar_t(0); },
+                          broadcast_input(M, mask_.shape()), broadcast_input(grad_out.data_ptr<scalar_t>(), out_shape));
+        });
+        if (t->shape() == out_shape) accumulate(t, g);
+        else accumulate(t, reduce_to_shape(g, out_shape, t->shape()));
+    }
+}
+std::vector<Tensor*> WhereGradFn::parents() { return {&a_, &b_}; }
 
 // Add 实现
-void AddGradFn::backward(const std::vector<float>& grad_out) {
-    if (a_.requires_grad())  accumulate(&a_, grad_out);
-    if (b_.requires_grad())  accumulate(&b_, grad_out);
+void AddGradFn::backward(const Storage& grad_out) {
+    auto out_shape = broadcast_shape(a_.shape(), b_.shape());
+    for (Tensor* t : {&a_, &b_}) {
+        if (!t->requires_grad()) continue;
+        if (t->shape() == out_shape) accumulate(t, grad_out);
+        else accumulate(t, reduce_to_shape(grad_out, out_shape, t->shape()));
+    }
 }
 std::vector<Tensor*> AddGradFn::parents() { return {&a_, &b_}; }
 
 // Sub 实现
-void SubGradFn::backward(const std::vector<float>& grad_out) {
+void SubGradFn::backward(const Storage& grad_out) {
+    auto out_shape = broadcast_shape(a_.shape(), b_.shape());
     if (a_.requires_grad()) {
-            accumulate(&a_, grad_out);
+            if (a_.shape() == out_shape) accumulate(&a_, grad_out);
+            else accumulate(&a_, reduce_to_shape(grad_out, out_shape, a_.shape()));
         }
         
         if (b_.requires_grad()) {
             // 对 grad_out 取反
-            std::vector<float> neg_grad = grad_out;
-            for (auto& v : neg_grad) v = -v;
+            Storage neg_grad = negated(b_.shape() == out_shape
+                ? grad_out : reduce_to_shape(grad_out, out_shape, b_.shape()));
             accumulate(&b_, neg_grad);
         }
 }
 std::vector<Tensor*> SubGradFn::parents() { return { const_cast<Tensor*>(&a_), const_cast<Tensor*>(&b_) }; }
 
 // Neg 实现
-void NegGradFn::backward(const std::vector<float>& grad_out) {
+void NegGradFn::backward(const Storage& grad_out) {
     if (a_.requires_grad()) {
-            std::vector<float> neg = grad_out;
-            for (auto& v : neg) v = -v;
-            accumulate(&a_, neg);
+            accumulate(&a_, negated(grad_out));
         }
 }
 std::vector<Tensor*> NegGradFn::parents() { return { const_cast<Tensor*>(&a_) }; }
 
-// Mul 实现
-void MulGradFn::backward(const std::vector<float>& grad_out) {
-    // 1. 获取前向传播时的广播形状
-    auto out_shape = broadcast_shape(a_.shape(), b_.shape());
-    
-    // 2. 初始化输入张量的梯度容器（大小与输入一致，初始为0）
-    std::vector<float> grad_a(a_.numel(), 0.0f);
-    std::vector<float> grad_b(b_.numel(), 0.0f);
-
-    // 3. 遍历输出梯度，将其分摊（累加）回输入梯度
-    for (size_t i = 0; i < grad_out.size(); ++i) {
-        // 使用你的工具函数找到当前输出点对应的输入点索引
-        auto idx = unravel_index(i, out_shape);
-        size_t ia = ravel_index_broadcast(idx, a_.shape());
-        size_t ib = ravel_index_broadcast(idx, b_.shape());
-
-        // 根据乘法法则：da = d_out * b, db = d_out * a
-        if (a_.requires_grad()) {
-            grad_a[ia] += grad_out[i] * b_[ib]; 
-        }
-        if (b_.requires_grad()) {
-            grad_b[ib] += grad_out[i] * a_[ia];
-        }
-    }
+// ReLU 实现：输入大于 0 处梯度直通
+void ReluGradFn::backward(const Storage& grad_out) {
+    if (!a_.requires_grad()) return;
+    Storage g(grad_out.size(), grad_out.dtype());
+    MINIDL_DISPATCH_FLOATING_TYPES(a_.dtype(), "relu backward", [&] {
+        const scalar_t* x = a_.data_ptr<scalar_t>();
+        const scalar_t* go = grad_out.data_ptr<scalar_t>();
+        scalar_t* dst = g.data_ptr<scalar_t>();
+        for (size_t i = 0; i < g.size(); ++i) dst[i] = x[i] > scalar_t(0) ? go[i] : scalar_t(0);
+    });
+    accumulate(&a_, g);
+}
+std::vector<Tensor*> ReluGradFn::parents() { return { &a_ }; }
 
-    // 4. 调用你定义的辅助函数更新 TensorImpl 里的 grad 数组
-    if (a_.requires_grad()) accumulate(&a_, grad_a);
-    if (b_.requires_grad()) accumulate(&b_, grad_b);
+// Mul 实现：da = g * b, db = g * a
+void MulGradFn::backward(const Storage& grad_out) {
+    if (a_.requires_grad()) {
+        accumulate(&a_, binary_input_grad(a_, b_, a_, grad_out, [](auto g, auto, auto y) { return g * y; }));
+    }
+    if (b_.requires_grad()) {
+        accumulate(&b_, binary_input_grad(a_, b_, b_, grad_out, [](auto g, auto x, auto) { return g * x; }));
+    }
 }
 
 std::vector<Tensor*> MulGradFn::parents() {
@@ -70,30 +154,15 @@ std::vector<Tensor*> MulGradFn::parents() {
     }
 
 
-// Div 实现
-void DivGradFn::backward(const std::vector<float>& grad_out) {
-    auto out_shape = broadcast_shape(a_.shape(), b_.shape());
-    std::vector<float> grad_a(a_.numel(), 0.0f);
-    std::vector<float> grad_b(b_.numel(), 0.0f);
-
-    for (size_t i = 0; i < grad_out.size(); ++i) {
-        auto idx = unravel_index(i, out_shape);
-        size_t ia = ravel_index_broadcast(idx, a_.shape());
-        size_t ib = ravel_index_broadcast(idx, b_.shape());
-
-        float a_val = a_.data()[ia];
-        float b_val = b_.data()[ib];
-
-        if (a_.requires_grad()) {
-            grad_a[ia] += grad_out[i] * (1.0f / b_val);
-        }
-        if (b_.requires_grad()) {
-            grad_b[ib] += grad_out[i] * (-a_val / (b_val * b_val));
-        }
+// Div 实现：da = g / b, db = -g * a / b^2
+void DivGradFn::backward(const Storage& grad_out) {
+    if (a_.requires_grad()) {
+        accumulate(&a_, binary_input_grad(a_, b_, a_, grad_out, [](auto g, auto, auto y) { return g / y; }));
+    }
+    if (b_.requires_grad()) {
+        accumulate(&b_, binary_input_grad(a_, b_, b_, grad_out,
+                                          [](auto g, auto x, auto y) { return -g * x / (y * y); }));
     }
-
-    if (a_.requires_grad()) accumulate(&a_, grad_a);
-    if (b_.requires_grad()) accumulate(&b_, grad_b);
 }
 
 std::vector<Tensor*> DivGradFn::parents() {
@@ -101,22 +170,24 @@ std::vector<Tensor*> DivGradFn::parents() {
 }
 
 // MatMul 实现
-void MatMulGradFn::backward(const std::vector<float>& grad_out) {
+void MatMulGradFn::backward(const Storage& grad_out) {
     // 构造 grad_out 的 Tensor 视图 [m, n]
     size_t m = a_.shape()[0];
     size_t n = b_.shape()[1];
     Tensor g_out({m, n}, grad_out);
+    AutocastGuard fp32(DType::Float32); // 梯度在梯度类型 (fp32 / Float64) 中计算
+    DType gd = grad_out.dtype();
 
     if (a_.requires_grad()) {
         // dL/dA = G_out * B^T
-        Tensor b_t = transpose(b_); 
+        Tensor b_t = transpose(as_dtype(b_, gd));
         Tensor g_a = matmul(g_out, b_t);
         accumulate(&a_, g_a.data());
     }
 
     if (b_.requires_grad()) {
         // dL/dB = A^T * G_out
-        Tensor a_t = transpose(a_);
+        Tensor a_t = transpose(as_dtype(a_, gd));
         Tensor g_b = matmul(a_t, g_out);
         accumulate(&b_, g_b.data());
     }
@@ -124,4 +195,631 @@ void MatMulGradFn::backward(const std::vector<float>& grad_out) {
 
 std::vector<Tensor*> MatMulGradFn::parents() {
     return { const_cast<Tensor*>(&a_), const_cast<Tensor*>(&b_) };
-}
\ No newline at end of file
+}
+
+// ---------------- 归一化反向 ----------------
+
+namespace {
+
+inline size_t num_row_blocks(size_t rows, size_t d) {
+    size_t nb = std::max<size_t>(1, std::min(get_num_threads(), rows * d / 16384 + 1));
+    return std::min(nb, std::max<size_t>(rows, 1));
+}
+
+// 把 rows 行切成 num_row_blocks 段并行处理；每段拿到自己的编号，
+// 用于写各自的 dgamma/dbeta 局部和，最后串行归约
+template <typename F>
+void for_row_blocks(size_t rows, size_t d, F&& fn) {
+    size_t nb = num_row_blocks(rows, d);
+    parallel_for(0, nb, 1, [&](size_t b0, size_t b1) {
+        for (size_t b = b0; b < b1; ++b) {
+            fn(b, rows * b / nb, rows * (b + 1) / nb);
+        }
+    });
+}
+
+} // namespace
+
+// LayerNorm 实现
+// 第一遍求 sum(g) 与 sum(g * x_hat)，第二遍写 dx，并顺带累加 dgamma/dbeta
+void LayerNormGradFn::backward(const Storage& grad_out) {
+    size_t d = x_.shape().back();
+    size_t rows = d ? x_.numel() / d : 0;
+    const float* X = x_.data().data();
+    const float* G = gamma_.data().data();
+    const float* DY = grad_out.data();
+
+    bool need_x = x_.requires_grad();
+    bool need_w = gamma_.requires_grad() || beta_.requires_grad();
+    std::vector<float> grad_x(need_x ? x_.numel() : 0, 0.0f);
+    size_t nb = num_row_blocks(rows, d);
+    std::vector<float> partial(need_w ? nb * 2 * d : 0, 0.0f);
+
+    for_row_blocks(rows, d, [&](size_t b, size_t r0, size_t r1) {
+        float* dg = need_w ? partial.data() + b * 2 * d : nullptr;
+        float* db = need_w ? dg + d : nullptr;
+        for (size_t r = r0; r < r1; ++r) {
+            const float* xr = X + r * d;
+            const float* dyr = DY + r * d;
+            float mu = mean_[r], rs = rstd_[r];
+            if (need_x) {
+                float s1 = 0.0f, s2 = 0.0f;
+                for (size_t j = 0; j < d; ++j) {
+                    float g = dyr[j] * G[j];
+                    s1 += g;
+                    s2 += g * (xr[j] - mu) * rs;
+                }
+                s1 /= d;
+                s2 /= d;
+                float* dxr = grad_x.data() + r * d;
+                for (size_t j = 0; j < d; ++j) {
+                    float xhat = (xr[j] - mu) * rs;
+                    dxr[j] = rs * (dyr[j] * G[j] - s1 - xhat * s2);
+                }
+            }
+            if (need_w) {
+                for (size_t j = 0; j < d; ++j) {
+                    dg[j] += dyr[j] * (xr[j] - mu) * rs;
+                    db[j] += dyr[j];
+                }
+            }
+        }
+    });
+
+    if (need_x) accumulate(&x_, grad_x);
+    if (need_w) {
+        std::vector<float> grad_g(d, 0.0f), grad_b(d, 0.0f);
+        for (size_t b = 0; b < nb; ++b) {
+            const float* dg = partial.data() + b * 2 * d;
+            for (size_t j = 0; j < d; ++j) {
+                grad_g[j] += dg[j];
+                grad_b[j] += dg[d + j];
+            }
+        }
+        if (gamma_.requires_grad()) accumulate(&gamma_, grad_g);
+        if (beta_.requires_grad()) accumulate(&beta_, grad_b);
+    }
+}
+
+std::vector<Tensor*> LayerNormGradFn::parents() { return {&x_, &gamma_, &beta_}; }
+
+// RMSNorm 实现: dx = rstd * (g - x_hat * mean(g * x_hat))，g = dy * gamma
+void RMSNormGradFn::backward(const Storage& grad_out) {
+    size_t d = x_.shape().back();
+    size_t rows = d ? x_.numel() / d : 0;
+    const float* X = x_.data().data();
+    const float* G = gamma_.data().data();
+    const float* DY = grad_out.data();
+
+    bool need_x = x_.requires_grad();
+    bool need_w = gamma_.requires_grad();
+    std::vector<float> grad_x(need_x ? x_.numel() : 0, 0.0f);
+    size_t nb = num_row_blocks(rows, d);
+    std::vector<float> partial(need_w ? nb * d : 0, 0.0f);
+
+    for_row_blocks(rows, d, [&](size_t b, size_t r0, size_t r1) {
+        float* dg = need_w ? partial.data() + b * d : nullptr;
+        for (size_t r = r0; r < r1; ++r) {
+            const float* xr = X + r * d;
+            const float* dyr = DY + r * d;
+            float rs = rstd_[r];
+            if (need_x) {
+                float s2 = 0.0f;
+                for (size_t j = 0; j < d; ++j) s2 += dyr[j] * G[j] * xr[j] * rs;
+                s2 /= d;
+                float* dxr = grad_x.data() + r * d;
+                for (size_t j = 0; j < d; ++j) {
+                    dxr[j] = rs * (dyr[j] * G[j] - xr[j] * rs * s2);
+                }
+            }
+            if (need_w) {
+                for (size_t j = 0; j < d; ++j) dg[j] += dyr[j] * xr[j] * rs;
+            }
+        }
+    });
+
+    if (need_x) accumulate(&x_, grad_x);
+    if (need_w) {
+        std::vector<float> grad_g(d, 0.0f);
+        for (size_t b = 0; b < nb; ++b) {
+            const float* dg = partial.data() + b * d;
+            for (size_t j = 0; j < d; ++j) grad_g[j] += dg[j];
+        }
+        accumulate(&gamma_, grad_g);
+    }
+}
+
+std::vector<Tensor*> RMSNormGradFn::parents() { return {&x_, &gamma_}; }
+
+// BatchNorm 实现：按通道并行，每个通道两遍
+// 第一遍求 sum(dy) 与 sum(dy * x_hat)，第二遍写 dx
+void BatchNormGradFn::backward(const Storage& grad_out) {
+    const auto& shape = x_.shape();
+    size_t n = shape[0], c = shape[1];
+    size_t l = 1;
+    for (size_t i = 2; i < shape.size(); ++i) l *= shape[i];
+    size_t m = n * l;
+
+    const float* X = x_.data().data();
+    const float* G = gamma_.data().data();
+    const float* DY = grad_out.data();
+
+    bool need_x = x_.requires_grad();
+    std::vector<float> grad_x(need_x ? x_.numel() : 0, 0.0f);
+    std::vector<float> grad_g(c, 0.0f), grad_b(c, 0.0f);
+
+    parallel_for(0, c, std::max<size_t>(1, 16384 / std::max<size_t>(m, 1)), [&](size_t c0, size_t c1) {
+        for (size_t ch = c0; ch < c1; ++ch) {
+            float mu = mean_[ch], rs = rstd_[ch];
+            float sdy = 0.0f, sdyx = 0.0f;
+            for (size_t b = 0; b < n; ++b) {
+                const float* xp = X + (b * c + ch) * l;
+                const float* dyp = DY + (b * c + ch) * l;
+                for (size_t j = 0; j < l; ++j) {
+                    sdy += dyp[j];
+                    sdyx += dyp[j] * (xp[j] - mu) * rs;
+                }
+            }
+            grad_g[ch] = sdyx;
+            grad_b[ch] = sdy;
+            if (!need_x) continue;
+
+            float k = G[ch] * rs;
+            float mean_dy = m ? sdy / m : 0.0f;
+            float mean_dyx = m ? sdyx / m : 0.0f;
+            for (size_t b = 0; b < n; ++b) {
+                const float* xp = X + (b * c + ch) * l;
+                const float* dyp = DY + (b * c + ch) * l;
+                float* dxp = grad_x.data() + (b * c + ch) * l;
+                if (training_) {
+                    for (size_t j = 0; j < l; ++j) {
+                        float xhat = (xp[j] - mu) * rs;
+                        dxp[j] = k * (dyp[j] - mean_dy - xhat * mean_dyx);
+                    }
+                } else {
+                    for (size_t j = 0; j < l; ++j) dxp[j] = k * dyp[j];
+                }
+            }
+        }
+    });
+
+    if (need_x) accumulate(&x_, grad_x);
+    if (gamma_.requires_grad()) accumulate(&gamma_, grad_g);
+    if (beta_.requires_grad()) accumulate(&beta_, grad_b);
+}
+
+std::vector<Tensor*> BatchNormGradFn::parents() { return {&x_, &gamma_, &beta_}; }
+
+// ---------------- Embedding 反向 ----------------
+
+// 先按 index 排序分组（重复 index 合并），再按组并行求和，
+// 得到 [唯一行数, dim] 的紧凑梯度，成本只和本次用到的行数相关
+void EmbeddingGradFn::backward(const Storage& grad_out) {
+    size_t d = weight_.shape()[1];
+    size_t n = indices_.size();
+    if (n == 0) return;
+
+    // 每个位置对应的 grad_out 行以及缩放系数
+    std::vector<size_t> src_row(n);
+    std::vector<float> scale(n, 1.0f);
+    if (offsets_.empty()) {
+        for (size_t p = 0; p < n; ++p) src_row[p] = p;
+    } else {
+        for (size_t b = 0; b < offsets_.size(); ++b) {
+            size_t s0 = offsets_[b];
+            size_t s1 = b + 1 < offsets_.size() ? offsets_[b + 1] : n;
+            float w = (mean_ && s1 > s0) ? 1.0f / static_cast<float>(s1 - s0) : 1.0f;
+            for (size_t p = s0; p < s1; ++p) {
+                src_row[p] = b;
+                scale[p] = w;
+            }
+        }
+    }
+
+    std::vector<size_t> order(n);
+    for (size_t p = 0; p < n; ++p) order[p] = p;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t x, size_t y) { return indices_[x] < indices_[y]; });
+
+    std::vector<size_t> rows, starts;
+    for (size_t k = 0; k < n; ++k) {
+        if (k == 0 || indices_[order[k]] != indices_[order[k - 1]]) {
+            rows.push_back(indices_[order[k]]);
+            starts.push_back(k);
+        }
+    }
+    starts.push_back(n);
+
+    Storage values(rows.size() * d, 0.0f);
+    const float* G = grad_out.data();
+    parallel_for(0, rows.size(), std::max<size_t>(1, 4096 / std::max<size_t>(d, 1)),
+                 [&](size_t r0, size_t r1) {
+        for (size_t r = r0; r < r1; ++r) {
+            float* out = values.data() + r * d;
+            for (size_t k = starts[r]; k < starts[r + 1]; ++k) {
+                size_t p = order[k];
+                const float* g = G + src_row[p] * d;
+                float w = scale[p];
+                for (size_t j = 0; j < d; ++j) out[j] += w * g[j];
+            }
+        }
+    });
+
+    accumulate_rows(&weight_, rows, values);
+}
+
+std::vector<Tensor*> EmbeddingGradFn::parents() { return {&weight_}; }
+
+// ---------------- Slice 反向 ----------------
+
+void SliceGradFn::backward(const Storage& grad_out) {
+    Storage g(src_.numel(), 0.0f);
+    std::copy(grad_out.begin(), grad_out.end(), g.data() + offset_);
+    accumulate(&src_, g);
+}
+
+std::vector<Tensor*> SliceGradFn::parents() { return {&src_}; }
+
+// ---------------- 循环网络反向 ----------------
+
+namespace {
+
+// 反向时的权重梯度都可以把全部时间步拼起来做一次 GEMM：
+// dX = dG W_ih^T，dW_ih = X^T dG，dW_hh = H_prev^T dG_h，db = sum_rows(dG)
+void rnn_weight_grads(Tensor& x, Tensor& w_ih, Tensor& w_hh,
+                      const Storage& dgx, const Storage& dgh, const Storage& h_prev,
+                      size_t rows, size_t I, size_t H, size_t G,
+                      std::vector<float>& dx, std::vector<float>& dw_ih, std::vector<float>& dw_hh) {
+    if (x.requires_grad()) {
+        dx.assign(rows * I, 0.0f);
+        sgemm(false, true, rows, I, G, 1.0f, dgx.data(), G, w_ih.data().data(), G, 0.0f, dx.data(), I);
+    }
+    if (w_ih.requires_grad()) {
+        dw_ih.assign(I * G, 0.0f);
+        sgemm(true, false, I, G, rows, 1.0f, x.data().data(), I, dgx.data(), G, 0.0f, dw_ih.data(), G);
+    }
+    if (w_hh.requires_grad()) {
+        dw_hh.assign(H * G, 0.0f);
+        sgemm(true, false, H, G, rows, 1.0f, h_prev.data(), H, dgh.data(), G, 0.0f, dw_hh.data(), G);
+    }
+}
+
+// [h0; h_0 ... h_{T-2}]，即每一步用到的 h_{t-1}
+Storage shifted_hidden(const Tensor& h0, const Storage& hs, size_t T, size_t B, size_t H) {
+    Storage hp(T * B * H);
+    std::copy(h0.data().begin(), h0.data().end(), hp.data());
+    if (T > 1) std::copy(hs.data(), hs.data() + (T - 1) * B * H, hp.data() + B * H);
+    return hp;
+}
+
+} // namespace
+
+// LSTM 实现：逐步回传只做逐元素门运算和一次 [B, 4H] x [4H, H] GEMM，
+// 与时间无关的 GEMM 全部推迟到最后一次性完成
+void LSTMGradFn::backward(const Storage& grad_out) {
+    size_t T = T_, B = B_, I = I_, H = H_, G = 4 * H;
+    const float* d_out = grad_out.data();
+
+    Storage dg(T * B * G);
+    Storage dh_next(B * H, 0.0f);
+    Storage dc_next(B * H);
+    std::copy(d_out + T * B * H, d_out + (T + 1) * B * H, dc_next.data());
+    const float* Whh = w_hh_.data().data();
+
+    for (size_t t = T; t-- > 0;) {
+        const float* at = acts_.data() + t * B * G;
+        const float* c_prev = cs_.data() + t * B * H;
+        const float* c_t = cs_.data() + (t + 1) * B * H;
+        const float* dy = d_out + t * B * H;
+        float* dgt = dg.data() + t * B * G;
+        parallel_for(0, B, std::max<size_t>(1, 4096 / G), [&](size_t b0, size_t b1) {
+            for (size_t b = b0; b < b1; ++b) {
+                const float* a = at + b * G;
+                float* d = dgt + b * G;
+                for (size_t j = 0; j < H; ++j) {
+                    size_t k = b * H + j;
+                    float ig = a[j], fg = a[H + j], gg = a[2 * H + j], og = a[3 * H + j];
+                    float tc = std::tanh(c_t[k]);
+                    float dh = dy[k] + dh_next[k];
+                    float dc = dc_next[k] + dh * og * (1.0f - tc * tc);
+                    d[j] = dc * gg * ig * (1.0f - ig);
+                    d[H + j] = dc * c_prev[k] * fg * (1.0f - fg);
+                    d[2 * H + j] = dc * ig * (1.0f - gg * gg);
+                    d[3 * H + j] = dh * tc * og * (1.0f - og);
+                    dc_next[k] = dc * fg;
+                }
+            }
+        });
+        sgemm(false, true, B, H, G, 1.0f, dgt, G, Whh, G, 0.0f, dh_next.data(), H);
+    }
+
+    std::vector<float> dx, dw_ih, dw_hh;
+    Storage hp = w_hh_.requires_grad() ? shifted_hidden(h0_, hs_, T, B, H) : Storage();
+    rnn_weight_grads(x_, w_ih_, w_hh_, dg, dg, hp, T * B, I, H, G, dx, dw_ih, dw_hh);
+
+    if (x_.requires_grad()) accumulate(&x_, dx);
+    if (w_ih_.requires_grad()) accumulate(&w_ih_, dw_ih);
+    if (w_hh_.requires_grad()) accumulate(&w_hh_, dw_hh);
+    if (bias_.requires_grad()) {
+        std::vector<float> db(G, 0.0f);
+        sum_rows(dg.data(), T * B, G, db.data());
+        accumulate(&bias_, db);
+    }
+    if (h0_.requires_grad()) accumulate(&h0_, dh_next);
+    if (c0_.requires_grad()) accumulate(&c0_, dc_next);
+}
+
+std::vector<Tensor*> LSTMGradFn::parents() { return {&x_, &h0_, &c0_, &w_ih_, &w_hh_, &bias_}; }
+
+// GRU 实现：输入侧与循环侧的门梯度分开存 (n 门的循环侧要乘 r)
+void GRUGradFn::backward(const Storage& grad_out) {
+    size_t T = T_, B = B_, I = I_, H = H_, G = 3 * H;
+    const float* d_out = grad_out.data();
+
+    Storage dgx(T * B * G), dgh(T * B * G);
+    Storage dh_next(B * H, 0.0f);
+    const float* Whh = w_hh_.data().data();
+
+    for (size_t t = T; t-- > 0;) {
+        const float* at = acts_.data() + t * B * 4 * H;
+        const float* h_prev = t == 0 ? h0_.data().data() : hs_.data() + (t - 1) * B * H;
+        const float* dy = d_out + t * B * H;
+        float* dxt = dgx.data() + t * B * G;
+        float* dht = dgh.data() + t * B * G;
+        parallel_for(0, B, std::max<size_t>(1, 4096 / G), [&](size_t b0, size_t b1) {
+            for (size_t b = b0; b < b1; ++b) {
+                const float* a = at + b * 4 * H;
+                float* gx = dxt + b * G;
+                float* gh = dht + b * G;
+                for (size_t j = 0; j < H; ++j) {
+                    size_t k = b * H + j;
+                    float r = a[j], z = a[H + j], nv = a[2 * H + j], hn = a[3 * H + j];
+                    float dh = dy[k] + dh_next[k];
+                    float dan = dh * (1.0f - z) * (1.0f - nv * nv);
+                    float daz = dh * (h_prev[k] - nv) * z * (1.0f - z);
+                    float dar = dan * hn * r * (1.0f - r);
+                    gx[j] = dar; gx[H + j] = daz; gx[2 * H + j] = dan;
+                    gh[j] = dar; gh[H + j] = daz; gh[2 * H + j] = dan * r;
+                    dh_next[k] = dh * z;
+                }
+            }
+        });
+        sgemm(false, true, B, H, G, 1.0f, dht, G, Whh, G, 1.0f, dh_next.data(), H);
+    }
+
+    std::vector<float> dx, dw_ih, dw_hh;
+    Storage hp = w_hh_.requires_grad() ? shifted_hidden(h0_, hs_, T, B, H) : Storage();
+    rnn_weight_grads(x_, w_ih_, w_hh_, dgx, dgh, hp, T * B, I, H, G, dx, dw_ih, dw_hh);
+
+    if (x_.requires_grad()) accumulate(&x_, dx);
+    if (w_ih_.requires_grad()) accumulate(&w_ih_, dw_ih);
+    if (w_hh_.requires_grad()) accumulate(&w_hh_, dw_hh);
+    if (b_ih_.requires_grad()) {
+        std::vector<float> db(G, 0.0f);
+        sum_rows(dgx.data(), T * B, G, db.data());
+        accumulate(&b_ih_, db);
+    }
+    if (b_hh_.requires_grad()) {
+        std::vector<float> db(G, 0.0f);
+        sum_rows(dgh.data(), T * B, G, db.data());
+        accumulate(&b_hh_, db);
+    }
+    if (h0_.requires_grad()) accumulate(&h0_, dh_next);
+}
+
+std::vector<Tensor*> GRUGradFn::parents() { return {&x_, &h0_, &w_ih_, &w_hh_, &b_ih_, &b_hh_}; }
+
+// ---------------- 稀疏反向 ----------------
+
+// SpMM 实现
+void SpMMGradFn::backward(const Storage& grad_out) {
+    const CSRPattern& p = *pattern_;
+    size_t f = x_.shape()[1];
+    if (x_.requires_grad()) {
+        Storage dx(p.cols * f);
+        csr_spmm_t(p, values_.data().data(), grad_out.data(), f, dx.data());
+        accumulate(&x_, dx);
+    }
+    if (values_.requires_grad()) {
+        Storage dv(p.nnz());
+        csr_sddmm(p, grad_out.data(), x_.data().data(), f, dv.data());
+        accumulate(&values_, dv);
+    }
+}
+std::vector<Tensor*> SpMMGradFn::parents() { return {&values_, &x_}; }
+
+// SDDMM 实现
+void SDDMMGradFn::backward(const Storage& grad_out) {
+    const CSRPattern& p = *pattern_;
+    size_t d = a_.shape()[1];
+    if (a_.requires_grad()) {
+        Storage da(p.rows * d);
+        csr_spmm(p, grad_out.data(), b_.data().data(), d, da.data());
+        accumulate(&a_, da);
+    }
+    if (b_.requires_grad()) {
+        Storage db(p.cols * d);
+        csr_spmm_t(p, grad_out.data(), a_.data().data(), d, db.data());
+        accumulate(&b_, db);
+    }
+}
+std::vector<Tensor*> SDDMMGradFn::parents() { return {&a_, &b_}; }
+
+// ---------------- 注意力反向 ----------------
+
+namespace {
+
+constexpr size_t kAttnBwdBlock = 64;
+
+inline float dot(const float* a, const float* b, size_t n) {
+    float acc = 0.0f;
+    for (size_t i = 0; i < n; ++i) acc += a[i] * b[i];
+    return acc;
+}
+
+} // namespace
+
+// Attention 实现：P_ij = exp(s_ij - lse_i)，dS_ij = P_ij (dO_i . V_j - delta_i)，delta_i = dO_i . O_i
+// dK/dV 按 key 块并行 (每块只写自己的行)，dQ 按 query 块并行，两遍都按块重算 P，不存 [T, S] 矩阵
+void AttentionGradFn::backward(const Storage& grad_out) {
+    const float scale = 1.0f / std::sqrt(static_cast<float>(D_));
+    const float* Q = q_.data().data();
+    const float* K = k_.data().data();
+    const float* V = v_.data().data();
+    const float* dO = grad_out.data();
+    const size_t T = T_, S = S_, D = D_, Dv = Dv_;
+    const bool causal = causal_;
+
+    Storage delta(BH_ * T);
+    parallel_for(0, BH_ * T, 4096, [&](size_t lo, size_t hi) {
+        for (size_t r = lo; r < hi; ++r) delta[r] = dot(dO + r * Dv, out_.data() + r * Dv, Dv);
+    });
+
+    // P 与 dS 的一个元素：i 为 query，j 为 key
+    auto grad_entry = [&](size_t bh, size_t i, size_t j, float& p, float& ds) {
+        float sij = dot(Q + (bh * T + i) * D, K + (bh * S + j) * D, D) * scale;
+        p = std::exp(sij - lse_[bh * T + i]);
+        float dp = dot(dO + (bh * T + i) * Dv, V + (bh * S + j) * Dv, Dv);
+        ds = p * (dp - delta[bh * T + i]);
+    };
+
+    if (k_.requires_grad() || v_.requires_grad()) {
+        Storage dk(BH_ * S * D), dv(BH_ * S * Dv);
+        size_t nk = (S + kAttnBwdBlock - 1) / kAttnBwdBlock;
+        parallel_for(0, BH_ * nk, 1, [&](size_t lo, size_t hi) {
+            for (size_t task = lo; task < hi; ++task) {
+                size_t bh = task / nk;
+                size_t j0 = (task % nk) * kAttnBwdBlock;
+                size_t j1 = std::min(S, j0 + kAttnBwdBlock);
+                for (size_t i = causal ? j0 : 0; i < T; ++i) {
+                    const float* qi = Q + (bh * T + i) * D;
+                    const float* gi = dO + (bh * T + i) * Dv;
+                    size_t j_end = causal ? std::min(j1, i + 1) : j1;
+                    for (size_t j = j0; j < j_end; ++j) {
+                        float p, ds;
+                        grad_entry(bh, i, j, p, ds);
+                        float* dvj = dv.data() + (bh * S + j) * Dv;
+                        for (size_t d = 0; d < Dv; ++d) dvj[d] += p * gi[d];
+                        float* dkj = dk.data() + (bh * S + j) * D;
+                        for (size_t d = 0; d < D; ++d) dkj[d] += scale * ds * qi[d];
+                    }
+                }
+            }
+        });
+        accumulate(&k_, dk);
+        accumulate(&v_, dv);
+    }
+
+    if (q_.requires_grad()) {
+        Storage dq(BH_ * T * D);
+        size_t nq = (T + kAttnBwdBlock - 1) / kAttnBwdBlock;
+        parallel_for(0, BH_ * nq, 1, [&](size_t lo, size_t hi) {
+            for (size_t task = lo; task < hi; ++task) {
+                size_t bh = task / nq;
+                size_t i0 = (task % nq) * kAttnBwdBlock;
+                size_t i1 = std::min(T, i0 + kAttnBwdBlock);
+                size_t s_end = causal ? std::min(S, i1) : S;
+                // key 分块放在外层，使一块 K/V 在处理整个 query 块时留在缓存里
+                for (size_t j0 = 0; j0 < s_end; j0 += kAttnBwdBlock) {
+                    size_t j1 = std::min(s_end, j0 + kAttnBwdBlock);
+                    for (size_t i = i0; i < i1; ++i) {
+                        float* dqi = dq.data() + (bh * T + i) * D;
+                        size_t j_end = causal ? std::min(j1, i + 1) : j1;
+                        for (size_t j = j0; j < j_end; ++j) {
+                            float p, ds;
+                            grad_entry(bh, i, j, p, ds);
+                            const float* kj = K + (bh * S + j) * D;
+                            for (size_t d = 0; d < D; ++d) dqi[d] += scale * ds * kj[d];
+                        }
+                    }
+                }
+            }
+        });
+        accumulate(&q_, dq);
+    }
+}
+
+std::vector<Tensor*> AttentionGradFn::parents() { return {&q_, &k_, &v_}; }
+
+// Checkpoint 实现：输入换成共享数据、梯度独立的叶子副本，开启梯度重算片段并从重算的输出反向，
+// 再把副本上的梯度累加回真正的输入
+void CheckpointGradFn::backward(const Storage& grad_out) {
+    std::vector<Tensor> detached;
+    detached.reserve(inputs_.size());
+    for (Tensor& t : inputs_) {
+        Storage& d = t.data();
+        detached.emplace_back(t.shape(), Storage::view(d.raw(), d.size(), d.owner(), d.dtype()), t.requires_grad());
+    }
+    {
+        GradModeGuard enable_grad(true);
+        Tensor out = fn_(detached);
+        // 嵌套在外层反向里：计数独立，闭包参数的钩子交给外层在检查点节点都执行完后触发
+        out.backward(grad_out);
+    }
+    for (size_t i = 0; i < inputs_.size(); ++i) {
+        if (inputs_[i].requires_grad() && !detached[i].grad().empty()) accumulate(&inputs_[i], detached[i].grad());
+    }
+}
+std::vector<Tensor*> CheckpointGradFn::parents() {
+    std::vector<Tensor*> ps;
+    for (Tensor& t : inputs_) ps.push_back(&t);
+    return ps;
+}
+
+// ---------------- 融合算子反向 ----------------
+
+void FusedElementwiseGradFn::backward(const Storage& grad_out) {
+    std::vector<Storage> grads(inputs_.size());
+    bool any = false;
+    for (size_t k = 0; k < inputs_.size(); ++k) {
+        if (inputs_[k].requires_grad()) {
+            grads[k] = Storage(inputs_[k].numel());
+            any = true;
+        }
+    }
+    if (!any) return;
+    fused_elementwise_backward(inputs_, steps_, out_shape_, grad_out, grads);
+    for (size_t k = 0; k < inputs_.size(); ++k) {
+        if (!grads[k].empty()) accumulate(&inputs_[k], grads[k]);
+    }
+}
+
+std::vector<Tensor*> FusedElementwiseGradFn::parents() {
+    std::vector<Tensor*> ps;
+    for (auto& t : inputs_) ps.push_back(&t);
+    return ps;
+}
+
+void FusedLinearGradFn::backward(const Storage& grad_out) {
+    size_t m = x_.shape()[0], k = x_.shape()[1], n = w_.shape()[1];
+    const float* g = grad_out.data();
+    Storage masked;
+    if (relu_) {
+        masked = Storage(m * n);
+        for (size_t i = 0; i < m * n; ++i) masked[i] = mask_[i] ? g[i] : 0.0f;
+        g = masked.data();
+    }
+    if (bias_.defined() && bias_.requires_grad()) {
+        Storage gb(n);
+        for (size_t i = 0; i < m; ++i)
+            for (size_t j = 0; j < n; ++j) gb[j] += g[i * n + j];
+        accumulate(&bias_, gb);
+    }
+    if (x_.requires_grad()) {
+        // dL/dX = G W^T
+        Storage gx(m * k);
+        sgemm(false, true, m, k, n, 1.0f, g, n, w_.data().data(), n, 0.0f, gx.data(), k);
+        accumulate(&x_, gx);
+    }
+    if (w_.requires_grad()) {
+        // dL/dW = X^T G
+        Storage gw(k * n);
+        sgemm(true, false, k, n, m, 1.0f, x_.data().data(), k, g, n, 0.0f, gw.data(), n);
+        accumulate(&w_, gw);
+    }
+}
+
+std::vector<Tensor*> FusedLinearGradFn::parents() {
+    if (bias_.defined()) return {&x_, &w_, &bias_};
+    return {&x_, &w_};
+}
@@ -0,0 +1,130 @@
+#include "graph.hpp"
+#include "autograd.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
+const char* op_name(OpKind kind) {
+    switch (kind) {
+    case OpKind::Add: return "add";
+    case OpKind::Sub: return "sub";
+    case OpKind::Mul: return "mul";
+    case OpKind::Div: return "div";
+    case OpKind::Neg: return "neg";
+    case OpKind::AddScalar: return "add_scalar";
+    case OpKind::SubScalar: return "sub_scalar";
+    case OpKind::RSubScalar: return "rsub_scalar";
+    case OpKind::MulScalar: return "mul_scalar";
+    case OpKind::DivScalar: return "div_scalar";
+    case OpKind::RDivScalar: return "rdiv_scalar";
+    case OpKind::Relu: return "relu";
+    case OpKind::MatMul: return "matmul";
+    case OpKind::Transpose: return "transpose";
+    case OpKind::Cast: return "cast";
+    case OpKind::LayerNorm: return "layer_norm";
+    case OpKind::RMSNorm: return "rms_norm";
+    case OpKind::FusedElementwise: return "fused_elementwise";
+    case OpKind::FusedMatMul: return "fused_matmul";
+    }
+    return "unknown";
+}
+
+// ---------------- 录制 ----------------
+
+class GraphRecorder {
+public:
+    explicit GraphRecorder(CapturedGraph& g) : g_(g) {}
+
+    void add_node(GraphNode node) { g_.nodes_.push_back(std::move(node)); }
+    void set_output(const Tensor& out) { g_.output_ = out; }
+
+    void set_backward(const Tensor& root, const std::vector<Tensor>& order) {
+        if (g_.backward_root_.defined()) throw std::runtime_error("capture_graph records at most one backward()");
+        g_.backward_root_ = root;
+        for (const Tensor& t : order) g_.backward_.push_back({t});
+        g_.index_backward();
+    }
+
+private:
+    CapturedGraph& g_;
+};
+
+namespace {
+
+thread_local GraphRecorder* t_recorder = nullptr;
+
+} // namespace
+
+bool is_capturing() { return t_recorder != nullptr; }
+
+RecordingPause::RecordingPause() : saved_(t_recorder) { t_recorder = nullptr; }
+RecordingPause::~RecordingPause() { t_recorder = saved_; }
+
+void record_op(OpKind kind, std::vector<Tensor> inputs, const Tensor& output,
+               std::function<void()> kernel, float scalar) {
+    if (!t_recorder) return;
+    t_recorder->add_node({kind, std::move(inputs), output, scalar, std::move(kernel), {}});
+}
+
+void check_capturable(const char* op) {
+    if (t_recorder) throw std::runtime_error(std::string(op) + " cannot be recorded by capture_graph");
+}
+
+void record_backward(const Tensor& root, const std::vector<Tensor>& order) {
+    if (t_recorder) t_recorder->set_backward(root, order);
+}
+
+CapturedGraph capture_graph(const std::function<Tensor()>& fn) {
+    if (t_recorder) throw std::runtime_error("capture_graph cannot be nested");
+    CapturedGraph g;
+    GraphRecorder rec(g);
+    t_recorder = &rec;
+    try {
+        rec.set_output(fn());
+    } catch (...) {
+        t_recorder = nullptr;
+        throw;
+    }
+    t_recorder = nullptr;
+    return g;
+}
+
+// ---------------- 重放 ----------------
+
+void CapturedGraph::index_backward() {
+    // 算子输出 (非叶子) 的梯度在第一次被写入的那一步之前清零；叶子 (参数) 的梯度照常累加
+    std::unordered_set<const Storage*> produced, seen;
+    for (const auto& n : nodes_) produced.insert(&n.output.data());
+    zero_before_.assign(backward_.size(), {});
+    for (size_t i = 0; i < backward_.size(); ++i) {
+        for (Tensor* p : backward_[i].tensor.grad_fn()->parents()) {
+            const Storage* key = &p->data();
+            if (p->requires_grad() && produced.count(key) && seen.insert(key).second) {
+                zero_before_[i].push_back(*p);
+            }
+        }
+    }
+}
+
+void CapturedGraph::replay_forward() {
+    for (auto& n : nodes_) n.kernel();
+}
+
+void CapturedGraph::replay_backward() {
+    if (!backward_root_.defined()) return;
+    Storage& seed = backward_root_.grad();
+    if (seed.dtype() == DType::Float64) std::fill(seed.data_ptr<double>(), seed.data_ptr<double>() + seed.size(), 1.0);
+    else std::fill(seed.begin(), seed.end(), 1.0f);
+    for (size_t i = 0; i < backward_.size(); ++i) {
+        for (auto& t : zero_before_[i]) t.zero_grad();
+        Tensor& t = backward_[i].tensor;
+        t.grad_fn()->backward(t.grad());
+    }
+}
+
+void CapturedGraph::replay() {
+    replay_forward();
+    replay_backward();
+}
@@ -0,0 +1,227 @@
+#include "kernels.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MINIDL_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// k 方向分块，使 B 的一段行在 L2 中复用
+constexpr size_t kBlockK = 256;
+
+// C 行 [i0, i1) 的 A*B (A 不转置或已转置, B 不转置)：i-p-j 顺序，内层沿 j 连续可向量化
+void gemm_nn_rows(size_t i0, size_t i1, size_t n, size_t k, float alpha,
+                  const float* a, size_t lda, bool trans_a,
+                  const float* b, size_t ldb, float* c, size_t ldc) {
+    for (size_t p0 = 0; p0 < k; p0 += kBlockK) {
+        size_t p1 = std::min(k, p0 + kBlockK);
+        for (size_t i = i0; i < i1; ++i) {
+            float* __restrict ci = c + i * ldc;
+            for (size_t p = p0; p < p1; ++p) {
+                float av = alpha * (trans_a ? a[p * lda + i] : a[i * lda + p]);
+                if (av == 0.0f) continue;
+                const float* __restrict bp = b + p * ldb;
+                for (size_t j = 0; j < n; ++j) ci[j] += av * bp[j];
+            }
+        }
+    }
+}
+
+// B 转置时每个输出是两段连续内存的点积
+void gemm_nt_rows(size_t i0, size_t i1, size_t n, size_t k, float alpha,
+                  const float* a, size_t lda, const float* b, size_t ldb, float* c, size_t ldc) {
+    for (size_t i = i0; i < i1; ++i) {
+        const float* __restrict ai = a + i * lda;
+        float* ci = c + i * ldc;
+        for (size_t j = 0; j < n; ++j) {
+            const float* __restrict bj = b + j * ldb;
+            float acc = 0.0f;
+            for (size_t p = 0; p < k; ++p) acc += ai[p] * bj[p];
+            ci[j] += alpha * acc;
+        }
+    }
+}
+
+} // namespace
+
+void sgemm(bool trans_a, bool trans_b, size_t m, size_t n, size_t k,
+           float alpha, const float* a, size_t lda, const float* b, size_t ldb,
+           float beta, float* c, size_t ldc) {
+    if (m == 0 || n == 0) return;
+
+    // 先处理 beta
+    parallel_for(0, m, std::max<size_t>(1, 16384 / n), [&](size_t i0, size_t i1) {
+        for (size_t i = i0; i < i1; ++i) {
+            float* ci = c + i * ldc;
+            if (beta == 0.0f) std::fill(ci, ci + n, 0.0f);
+            else if (beta != 1.0f) for (size_t j = 0; j < n; ++j) ci[j] *= beta;
+        }
+    });
+    if (k == 0 || alpha == 0.0f) return;
+
+    // A、B 都转置的情况很少见：先把 A 转成 [m, k]
+    std::vector<float> a_copy;
+    if (trans_a && trans_b) {
+        a_copy.resize(m * k);
+        for (size_t p = 0; p < k; ++p)
+            for (size_t i = 0; i < m; ++i) a_copy[i * k + p] = a[p * lda + i];
+        a = a_copy.data();
+        lda = k;
+        trans_a = false;
+    }
+
+    size_t grain = std::max<size_t>(1, 65536 / std::max<size_t>(n * k, 1));
+    parallel_for(0, m, grain, [&](size_t i0, size_t i1) {
+        if (trans_b) gemm_nt_rows(i0, i1, n, k, alpha, a, lda, b, ldb, c, ldc);
+        else gemm_nn_rows(i0, i1, n, k, alpha, a, lda, trans_a, b, ldb, c, ldc);
+    });
+}
+
+void sum_rows(const float* x, size_t rows, size_t n, float* out) {
+    for (size_t i = 0; i < rows; ++i) {
+        const float* xi = x + i * n;
+        for (size_t j = 0; j < n; ++j) out[j] += xi[j];
+    }
+}
+
+// ---------------- INT8 GEMM ----------------
+
+namespace {
+
+// 一次算 A 的一行与 B 的 nb (<= 4) 行的点积，A 行的每次加载被 nb 个输出复用
+using DotFn = void (*)(const int8_t* a, const int8_t* b, size_t ldb, size_t k, size_t nb, int32_t* out);
+
+void dot_s8_scalar(const int8_t* a, const int8_t* b, size_t ldb, size_t k, size_t nb, int32_t* out) {
+    for (size_t j = 0; j < nb; ++j) {
+        const int8_t* bj = b + j * ldb;
+        int32_t acc = 0;
+        for (size_t p = 0; p < k; ++p) acc += int32_t(a[p]) * int32_t(bj[p]);
+        out[j] = acc;
+    }
+}
+
+#if defined(MINIDL_X86_DISPATCH)
+
+__attribute__((target("avx2")))
+inline int32_t hsum_epi32(__m256i v) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return _mm_cvtsi128_si32(s);
+}
+
+// vpmaddubsw 要求一侧无符号：取 |a|，把 a 的符号转移到 b 上。
+// 两侧都在 [-127, 127] 内时相邻两项之和 <= 2 * 127 * 127 < 32767，int16 不会饱和
+__attribute__((target("avx2")))
+void dot_s8_avx2(const int8_t* a, const int8_t* b, size_t ldb, size_t k, size_t nb, int32_t* out) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(),
+                      _mm256_setzero_si256(), _mm256_setzero_si256()};
+    for (size_t p = 0; p < k; p += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + p));
+        __m256i ua = _mm256_abs_epi8(va);
+        for (size_t j = 0; j < nb; ++j) {
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j * ldb + p));
+            __m256i prod = _mm256_maddubs_epi16(ua, _mm256_sign_epi8(vb, va));
+            acc[j] = _mm256_add_epi32(acc[j], _mm256_madd_epi16(prod, ones));
+        }
+    }
+    for (size_t j = 0; j < nb; ++j) out[j] = hsum_epi32(acc[j]);
+}
+
+// vpdpbusd 直接把 4 个 u8*s8 乘积累加进 int32，中间没有 int16 饱和
+__attribute__((target("avx2,avx512f,avx512vl,avx512vnni")))
+void dot_s8_vnni(const int8_t* a, const int8_t* b, size_t ldb, size_t k, size_t nb, int32_t* out) {
+    __m256i acc[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(),
+                      _mm256_setzero_si256(), _mm256_setzero_si256()};
+    for (size_t p = 0; p < k; p += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + p));
+        __m256i ua = _mm256_abs_epi8(va);
+        for (size_t j = 0; j < nb; ++j) {
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j * ldb + p));
+            acc[j] = _mm256_dpbusd_epi32(acc[j], ua, _mm256_sign_epi8(vb, va));
+        }
+    }
+    for (size_t j = 0; j < nb; ++j) out[j] = hsum_epi32(acc[j]);
+}
+
+#endif
+
+struct Int8Kernel {
+    DotFn dot = dot_s8_scalar;
+    const char* name = "scalar";
+
+    Int8Kernel() {
+#if defined(MINIDL_X86_DISPATCH)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512vl")) {
+            dot = dot_s8_vnni;
+            name = "vnni";
+        } else if (__builtin_cpu_supports("avx2")) {
+            dot = dot_s8_avx2;
+            name = "avx2";
+        }
+#endif
+    }
+};
+
+const Int8Kernel& int8_kernel() {
+    static const Int8Kernel k;
+    return k;
+}
+
+// B 按列块遍历，使一块 B (kInt8BlockN 行 × k) 在 L2 中被 A 的多行复用
+constexpr size_t kInt8BlockN = 128;
+
+template <typename Epilogue>
+void qgemm_s8(size_t m, size_t n, size_t k, const int8_t* a, size_t lda,
+              const int8_t* b, size_t ldb, Epilogue&& epi) {
+    if (m == 0 || n == 0) return;
+    DotFn dot = int8_kernel().dot;
+    size_t grain = std::max<size_t>(1, 65536 / std::max<size_t>(n * k, 1));
+    parallel_for(0, m, grain, [&](size_t i0, size_t i1) {
+        int32_t acc[4];
+        for (size_t j0 = 0; j0 < n; j0 += kInt8BlockN) {
+            size_t j1 = std::min(n, j0 + kInt8BlockN);
+            for (size_t i = i0; i < i1; ++i) {
+                for (size_t j = j0; j < j1; j += 4) {
+                    size_t nb = std::min<size_t>(4, j1 - j);
+                    dot(a + i * lda, b + j * ldb, ldb, k, nb, acc);
+                    for (size_t t = 0; t < nb; ++t) epi(i, j + t, acc[t]);
+                }
+            }
+        }
+    });
+}
+
+} // namespace
+
+void qgemm_s8_dequant(size_t m, size_t n, size_t k,
+                      const int8_t* a, size_t lda, const float* a_scale,
+                      const int8_t* b, size_t ldb, const float* b_scale,
+                      const float* bias, float* c, size_t ldc) {
+    qgemm_s8(m, n, k, a, lda, b, ldb, [&](size_t i, size_t j, int32_t acc) {
+        float v = float(acc) * a_scale[i] * b_scale[j];
+        c[i * ldc + j] = bias ? v + bias[j] : v;
+    });
+}
+
+void qgemm_s8_requant(size_t m, size_t n, size_t k,
+                      const int8_t* a, size_t lda, const float* a_scale,
+                      const int8_t* b, size_t ldb, const float* b_scale,
+                      const float* bias, float out_scale, int8_t* c, size_t ldc) {
+    float inv = 1.0f / out_scale;
+    qgemm_s8(m, n, k, a, lda, b, ldb, [&](size_t i, size_t j, int32_t acc) {
+        float v = float(acc) * a_scale[i] * b_scale[j];
+        if (bias) v += bias[j];
+        float q = std::nearbyint(v * inv);
+        c[i * ldc + j] = static_cast<int8_t>(std::min(127.0f, std::max(-127.0f, q)));
+    });
+}
+
+const char* qgemm_s8_kernel_name() { return int8_kernel().name; }
@@ -0,0 +1,77 @@
+#include "mapped_file.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path) {
+    std::shared_ptr<MappedFile> m(new MappedFile());
+#if !defined(_WIN32)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat " + path);
+    }
+    m->size_ = static_cast<size_t>(st.st_size);
+    if (m->size_ > 0) {
+        void* addr = mmap(nullptr, m->size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Cannot mmap " + path);
+        }
+        m->data_ = static_cast<char*>(addr);
+        m->mapped_ = true;
+    }
+    ::close(fd); // 映射建立后 fd 即可关闭
+#else
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) throw std::runtime_error("Cannot open " + path);
+    std::fseek(f, 0, SEEK_END);
+    m->size_ = static_cast<size_t>(std::ftell(f));
+    std::fseek(f, 0, SEEK_SET);
+    if (m->size_ > 0) {
+        m->data_ = static_cast<char*>(std::malloc(m->size_));
+        if (!m->data_ || std::fread(m->data_, 1, m->size_, f) != m->size_) {
+            std::fclose(f);
+            throw std::runtime_error("Cannot read " + path);
+        }
+    }
+    std::fclose(f);
+#endif
+    return m;
+}
+
+MappedFile::~MappedFile() {
+#if !defined(_WIN32)
+    if (mapped_) munmap(data_, size_);
+#else
+    std::free(data_);
+#endif
+}
+
+void MappedFile::advise(Advice advice, size_t offset, size_t len) const {
+#if !defined(_WIN32)
+    if (!mapped_ || offset >= size_) return;
+    if (len == 0 || len > size_ - offset) len = size_ - offset;
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = offset / page * page;
+    int flag = MADV_NORMAL;
+    switch (advice) {
+    case Advice::Normal: flag = MADV_NORMAL; break;
+    case Advice::Sequential: flag = MADV_SEQUENTIAL; break;
+    case Advice::Random: flag = MADV_RANDOM; break;
+    case Advice::WillNeed: flag = MADV_WILLNEED; break;
+    }
+    madvise(data_ + begin, offset + len - begin, flag); // 只是提示，失败无需处理
+#else
+    (void)advice; (void)offset; (void)len;
+#endif
+}
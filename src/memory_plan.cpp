@@ -0,0 +1,201 @@
+#include "memory_plan.hpp"
+#include "autograd.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+constexpr size_t kPlanAlign = 64;
+constexpr size_t kNone = static_cast<size_t>(-1);
+
+size_t align_up(size_t n) { return (n + kPlanAlign - 1) / kPlanAlign * kPlanAlign; }
+
+// 反向会读取输入数据的算子；其余算子的反向只用到输入的形状
+bool backward_reads_inputs(OpKind kind) {
+    switch (kind) {
+    case OpKind::Mul:
+    case OpKind::Div:
+    case OpKind::Relu: // 按输入的符号选择梯度
+    case OpKind::MatMul:
+    case OpKind::LayerNorm:
+    case OpKind::RMSNorm:
+    case OpKind::FusedElementwise:
+    case OpKind::FusedMatMul:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// 输出可以直接写进哪个输入：逐元素算子每个位置先读后写，逐行归一化读完一行才写这一行。
+// 返回可选的输入下标个数 (前若干个输入)
+size_t inplace_candidates(OpKind kind) {
+    switch (kind) {
+    case OpKind::FusedElementwise:
+        return kNone; // 任一与输出同形状的输入
+    case OpKind::Add:
+    case OpKind::Sub:
+    case OpKind::Mul:
+    case OpKind::Div:
+        return 2;
+    case OpKind::Neg:
+    case OpKind::AddScalar:
+    case OpKind::SubScalar:
+    case OpKind::RSubScalar:
+    case OpKind::MulScalar:
+    case OpKind::DivScalar:
+    case OpKind::RDivScalar:
+    case OpKind::LayerNorm:
+    case OpKind::RMSNorm:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+struct Member {
+    Tensor tensor;
+    bool grad; // true 时规划的是梯度缓冲
+};
+
+struct Buffer {
+    size_t bytes{0};
+    size_t start{0}, end{0}; // 闭区间 [start, end]
+    size_t offset{0};
+    std::vector<Member> members;
+};
+
+} // namespace
+
+MemoryPlan plan_memory(CapturedGraph& g, bool allow_inplace) {
+    if (g.memory_planned_) throw std::runtime_error("plan_memory: graph is already planned");
+    const auto& nodes = g.nodes_;
+    const size_t n = nodes.size();
+    const size_t steps = g.backward_.size();
+
+    // 以 Storage 地址标识张量 (同一个 TensorImpl 只有一个 data_)
+    std::unordered_map<const Storage*, size_t> node_of;
+    for (size_t i = 0; i < n; ++i) node_of[&nodes[i].output.data()] = i;
+    auto find = [&](const Tensor& t) {
+        auto it = node_of.find(&t.data());
+        return it == node_of.end() ? kNone : it->second;
+    };
+    auto excluded = [&](const Tensor& t) {
+        return (g.output_.defined() && &t.data() == &g.output_.data()) ||
+               (g.backward_root_.defined() && &t.data() == &g.backward_root_.data());
+    };
+
+    // 1. 数据缓冲的最后一次使用
+    std::vector<size_t> last(n);
+    for (size_t i = 0; i < n; ++i) {
+        last[i] = i;
+        for (const Tensor& in : nodes[i].inputs) {
+            size_t j = find(in);
+            if (j != kNone) last[j] = std::max(last[j], i);
+        }
+    }
+    std::vector<size_t> step_node(steps);
+    for (size_t k = 0; k < steps; ++k) {
+        size_t i = find(g.backward_[k].tensor);
+        step_node[k] = i;
+        if (i == kNone || !backward_reads_inputs(nodes[i].kind)) continue;
+        for (const Tensor& in : nodes[i].inputs) {
+            size_t j = find(in);
+            if (j != kNone) last[j] = std::max(last[j], n + k);
+        }
+    }
+
+    // 2. 数据缓冲：能原地写回死亡输入的合并进输入的缓冲，否则新开一个
+    MemoryPlan plan;
+    std::vector<Buffer> buffers;
+    std::vector<size_t> buf_of(n, kNone);
+    for (size_t i = 0; i < n; ++i) {
+        const Tensor& out = nodes[i].output;
+        if (excluded(out) || out.data().nbytes() == 0) continue;
+        size_t cands = allow_inplace ? inplace_candidates(nodes[i].kind) : 0;
+        for (size_t c = 0; c < cands && c < nodes[i].inputs.size(); ++c) {
+            const Tensor& in = nodes[i].inputs[c];
+            size_t j = find(in);
+            if (j == kNone || buf_of[j] == kNone) continue;
+            Buffer& b = buffers[buf_of[j]];
+            if (b.end != i || in.shape() != out.shape() || in.dtype() != out.dtype()) continue;
+            b.end = last[i];
+            b.members.push_back({out, false});
+            buf_of[i] = buf_of[j];
+            ++plan.num_inplace;
+            break;
+        }
+        if (buf_of[i] != kNone) continue;
+        buf_of[i] = buffers.size();
+        buffers.push_back({out.data().nbytes(), i, last[i], 0, {{out, false}}});
+    }
+
+    // 3. 梯度缓冲：从第一次写入活到自己那一步反向结束
+    std::vector<size_t> grad_start(n, kNone), grad_end(n, 0);
+    for (size_t k = 0; k < steps; ++k) {
+        Tensor& t = g.backward_[k].tensor;
+        for (Tensor* p : t.grad_fn()->parents()) {
+            size_t j = find(*p);
+            if (j == kNone || !p->requires_grad()) continue;
+            grad_start[j] = std::min(grad_start[j], n + k);
+            grad_end[j] = std::max(grad_end[j], n + k);
+        }
+        if (step_node[k] != kNone) grad_end[step_node[k]] = std::max(grad_end[step_node[k]], n + k);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const Tensor& out = nodes[i].output;
+        if (grad_start[i] == kNone || excluded(out) || out.grad().nbytes() == 0) continue;
+        buffers.push_back({out.grad().nbytes(), grad_start[i], std::max(grad_start[i], grad_end[i]), 0,
+                           {{out, true}}});
+    }
+
+    // 4. 按大小从大到小放置，每个缓冲取与其活跃区间重叠的已放置缓冲之间最低的空隙
+    std::vector<size_t> order(buffers.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return buffers[a].bytes > buffers[b].bytes; });
+    std::vector<size_t> placed;
+    size_t arena_bytes = 0;
+    for (size_t id : order) {
+        Buffer& b = buffers[id];
+        std::vector<std::pair<size_t, size_t>> busy;
+        for (size_t o : placed) {
+            const Buffer& p = buffers[o];
+            if (p.start <= b.end && b.start <= p.end) busy.push_back({p.offset, p.offset + align_up(p.bytes)});
+        }
+        std::sort(busy.begin(), busy.end());
+        size_t offset = 0, size = align_up(b.bytes);
+        for (const auto& r : busy) {
+            if (offset + size <= r.first) break;
+            offset = std::max(offset, r.second);
+        }
+        b.offset = offset;
+        arena_bytes = std::max(arena_bytes, offset + size);
+        placed.push_back(id);
+    }
+
+    // 5. 统计
+    std::vector<size_t> live(n + steps, 0);
+    for (const Buffer& b : buffers) {
+        for (size_t t = b.start; t <= b.end && t < live.size(); ++t) live[t] += b.bytes;
+        for (const Member& m : b.members) {
+            plan.naive_bytes += m.grad ? m.tensor.grad().nbytes() : m.tensor.data().nbytes();
+        }
+    }
+    plan.live_bytes = live.empty() ? 0 : *std::max_element(live.begin(), live.end());
+    plan.planned_bytes = arena_bytes;
+    plan.num_buffers = buffers.size();
+
+    // 6. 改为指向 arena 的视图
+    Storage arena(arena_bytes, DType::UInt8);
+    char* base = static_cast<char*>(arena.raw());
+    for (Buffer& b : buffers) {
+        for (Member& m : b.members) {
+            Storage& s = m.grad ? m.tensor.grad() : m.tensor.data();
+            s.rebind(Storage::view(base + b.offset, s.size(), arena.owner(), s.dtype()));
+        }
+    }
+    g.memory_planned_ = true;
+    return plan;
+}
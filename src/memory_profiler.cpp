@@ -0,0 +1,383 @@
+#include "memory_profiler.hpp"
+#include "tensor.hpp"
+#include "autograd.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+std::atomic<bool> g_memory_profiling{false};
+
+namespace {
+
+// 保护 g_active 的切换；钩子在持有它期间访问 g_active，stop() 之后不会再有钩子进入
+std::mutex g_mu;
+MemoryProfiler* g_active = nullptr;
+
+const void* block_key(const Storage& s) { return s.is_view() ? nullptr : s.owner().get(); }
+
+std::string format_bytes(size_t bytes) {
+    char buf[32];
+    if (bytes >= (size_t(1) << 30)) {
+        std::snprintf(buf, sizeof(buf), "%.2f GB", bytes / double(size_t(1) << 30));
+    } else if (bytes >= (size_t(1) << 20)) {
+        std::snprintf(buf, sizeof(buf), "%.2f MB", bytes / double(size_t(1) << 20));
+    } else if (bytes >= 1024) {
+        std::snprintf(buf, sizeof(buf), "%.2f KB", bytes / 1024.0);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%zu B", bytes);
+    }
+    return buf;
+}
+
+std::string format_shape(const std::vector<size_t>& shape) {
+    std::string s = "[";
+    for (size_t i = 0; i < shape.size(); ++i) s += (i ? ", " : "") + std::to_string(shape[i]);
+    return s + "]";
+}
+
+// 算子名都是代码里的字面量，不含需要转义的字符
+void write_usage_json(std::ostringstream& os, const MemoryUsage& u) {
+    os << "{\"total\":" << u.total;
+    for (size_t k = 0; k < kNumMemoryKinds; ++k) {
+        os << ",\"" << memory_kind_name(static_cast<MemoryKind>(k)) << "\":" << u.by_kind[k];
+    }
+    os << "}";
+}
+
+} // namespace
+
+const char* memory_kind_name(MemoryKind kind) {
+    switch (kind) {
+    case MemoryKind::Data: return "data";
+    case MemoryKind::Grad: return "grad";
+    case MemoryKind::Scratch: return "scratch";
+    case MemoryKind::Other: return "other";
+    }
+    return "unknown";
+}
+
+// ---------------- MemoryProfiler ----------------
+
+MemoryProfiler::MemoryProfiler() : start_(std::chrono::steady_clock::now()) {
+    std::lock_guard<std::mutex> g(g_mu);
+    if (g_active) throw std::runtime_error("Another MemoryProfiler is already recording");
+    g_active = this;
+    g_memory_profiling.store(true, std::memory_order_relaxed);
+}
+
+MemoryProfiler::~MemoryProfiler() { stop(); }
+
+void MemoryProfiler::stop() {
+    std::lock_guard<std::mutex> g(g_mu);
+    if (g_active != this) return;
+    g_active = nullptr;
+    g_memory_profiling.store(false, std::memory_order_relaxed);
+}
+
+uint64_t MemoryProfiler::now_ns() const {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+}
+
+void MemoryProfiler::record(int64_t delta, MemoryKind kind, const char* op) {
+    size_t& k = current_.by_kind[static_cast<size_t>(kind)];
+    if (delta >= 0) {
+        current_.total += size_t(delta);
+        k += size_t(delta);
+    } else {
+        current_.total -= size_t(-delta);
+        k -= size_t(-delta);
+    }
+    if (current_.total > peak_.total) peak_ = current_;
+    events_.push_back({now_ns(), delta, kind, op ? op : "", current_});
+}
+
+void MemoryProfiler::retag(Block& b, MemoryKind kind) {
+    if (b.kind == kind) return;
+    current_.by_kind[static_cast<size_t>(b.kind)] -= b.bytes;
+    current_.by_kind[static_cast<size_t>(kind)] += b.bytes;
+    b.kind = kind;
+    // 刚分配的块在峰值时刻还没改判：峰值的组成跟着修正
+    if (current_.total == peak_.total) peak_ = current_;
+}
+
+size_t MemoryProfiler::current_bytes() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return current_.total;
+}
+
+size_t MemoryProfiler::peak_bytes() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return peak_.total;
+}
+
+MemoryUsage MemoryProfiler::current_usage() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return current_;
+}
+
+MemoryUsage MemoryProfiler::peak_usage() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return peak_;
+}
+
+void MemoryProfiler::reset_peak() {
+    std::lock_guard<std::mutex> lk(mu_);
+    peak_ = current_;
+}
+
+std::vector<MemoryEvent> MemoryProfiler::timeline() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return events_;
+}
+
+std::string MemoryProfiler::timeline_trace() const {
+    std::ostringstream os;
+    os << "{\"traceEvents\":[";
+    char buf[64];
+    bool first = true;
+    for (const MemoryEvent& e : timeline()) {
+        if (!first) os << ",";
+        first = false;
+        std::snprintf(buf, sizeof(buf), "%.3f", e.time_ns / 1e3);
+        os << "\n{\"name\":\"memory\",\"ph\":\"C\",\"ts\":" << buf << ",\"pid\":0,\"args\":{";
+        for (size_t k = 0; k < kNumMemoryKinds; ++k) {
+            os << (k ? "," : "") << "\"" << memory_kind_name(static_cast<MemoryKind>(k)) << "\":" << e.usage.by_kind[k];
+        }
+        os << "}}";
+    }
+    os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return os.str();
+}
+
+void MemoryProfiler::save_timeline_trace(const std::string& path) const {
+    std::ofstream f(path, std::ios::binary);
+    if (!f) throw std::runtime_error("Cannot open " + path);
+    f << timeline_trace();
+    if (!f) throw std::runtime_error("Cannot write " + path);
+}
+
+MemorySnapshot MemoryProfiler::snapshot() const {
+    // 先在锁外把活跃张量提升为强引用：最后一个引用在这里释放时析构会再进钩子
+    std::vector<std::pair<std::weak_ptr<TensorImpl>, uint64_t>> records;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        records.reserve(tensors_.size());
+        for (const auto& kv : tensors_) records.emplace_back(kv.second.impl, kv.second.id);
+    }
+    std::vector<std::pair<std::shared_ptr<TensorImpl>, uint64_t>> live;
+    for (auto& r : records) {
+        if (auto sp = r.first.lock()) live.emplace_back(std::move(sp), r.second);
+    }
+    std::sort(live.begin(), live.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+
+    // 反向图对各张量的引用数：活跃张量的 grad_fn 持有的 parents
+    std::unordered_map<const TensorImpl*, long> graph_refs;
+    for (const auto& l : live) {
+        if (!l.first->grad_fn_) continue;
+        for (Tensor* p : l.first->grad_fn_->parents()) {
+            if (p->defined()) ++graph_refs[p->impl_.get()];
+        }
+    }
+
+    MemorySnapshot snap;
+    std::lock_guard<std::mutex> lk(mu_);
+    snap.time_ns = now_ns();
+    snap.current = current_;
+    snap.peak = peak_;
+    std::unordered_set<const void*> claimed;
+    // 返回 (字节数, 算子)；块未被记录或已计给别的张量时为 0
+    auto claim = [&](const Storage& s, std::string& op) -> size_t {
+        const void* key = block_key(s);
+        if (!key || !claimed.insert(key).second) return 0;
+        auto it = blocks_.find(key);
+        if (it == blocks_.end()) return 0;
+        if (it->second.op) op = it->second.op;
+        return it->second.bytes;
+    };
+    for (const auto& l : live) {
+        const TensorImpl& impl = *l.first;
+        LiveTensor t;
+        t.id = l.second;
+        t.shape = impl.shape_;
+        t.dtype = impl.data_.dtype();
+        t.requires_grad = impl.requires_grad_;
+        t.data_is_view = impl.data_.is_view();
+        if (impl.grad_fn_) t.grad_fn = impl.grad_fn_->name();
+        t.data_bytes = claim(impl.data_, t.data_op);
+        t.grad_bytes = claim(impl.grad_, t.grad_op);
+        // 这里自己持有一个引用
+        auto it = graph_refs.find(&impl);
+        const long user_refs = l.first.use_count() - 1 - (it == graph_refs.end() ? 0 : it->second);
+        t.graph_retained = it != graph_refs.end() && user_refs <= 0;
+        (t.graph_retained ? snap.graph_retained_bytes : snap.user_held_bytes) += t.bytes();
+        snap.tensors.push_back(std::move(t));
+    }
+    for (const auto& kv : blocks_) {
+        if (claimed.count(kv.first)) continue;
+        snap.blocks.push_back({kv.second.bytes, kv.second.kind, kv.second.op ? kv.second.op : ""});
+    }
+    std::stable_sort(snap.tensors.begin(), snap.tensors.end(),
+                     [](const LiveTensor& a, const LiveTensor& b) { return a.bytes() > b.bytes(); });
+    std::sort(snap.blocks.begin(), snap.blocks.end(), [](const LiveBlock& a, const LiveBlock& b) {
+        return a.bytes != b.bytes ? a.bytes > b.bytes : a.op < b.op;
+    });
+    return snap;
+}
+
+// ---------------- 快照输出 ----------------
+
+std::string MemorySnapshot::to_string(size_t top) const {
+    std::ostringstream os;
+    char buf[256];
+    auto usage_line = [&](const char* label, const MemoryUsage& u) {
+        std::snprintf(buf, sizeof(buf), "%-8s %10s  (data %s, grad %s, scratch %s, other %s)\n", label,
+                      format_bytes(u.total).c_str(), format_bytes(u.bytes(MemoryKind::Data)).c_str(),
+                      format_bytes(u.bytes(MemoryKind::Grad)).c_str(), format_bytes(u.bytes(MemoryKind::Scratch)).c_str(),
+                      format_bytes(u.bytes(MemoryKind::Other)).c_str());
+        os << buf;
+    };
+    usage_line("Current", current);
+    usage_line("Peak", peak);
+    std::snprintf(buf, sizeof(buf), "Live tensors: %zu (graph-retained %s, user-held %s), other blocks: %zu\n",
+                  tensors.size(), format_bytes(graph_retained_bytes).c_str(), format_bytes(user_held_bytes).c_str(),
+                  blocks.size());
+    os << buf;
+
+    // 按分配算子汇总：张量的数据 / 梯度缓冲与其余内存块分别计给各自的算子
+    struct OpRow {
+        size_t buffers{0}, bytes{0};
+    };
+    std::map<std::string, OpRow> by_op;
+    auto add = [&](const std::string& op, size_t bytes) {
+        if (bytes == 0) return;
+        OpRow& r = by_op[op.empty() ? "(outside ops)" : op];
+        ++r.buffers;
+        r.bytes += bytes;
+    };
+    for (const LiveTensor& t : tensors) {
+        add(t.data_op, t.data_bytes);
+        add(t.grad_op, t.grad_bytes);
+    }
+    for (const LiveBlock& b : blocks) add(b.op, b.bytes);
+    std::vector<std::pair<std::string, OpRow>> rows(by_op.begin(), by_op.end());
+    std::stable_sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.second.bytes > b.second.bytes; });
+    std::snprintf(buf, sizeof(buf), "\n%-28s %8s %12s\n", "Allocated by", "Buffers", "Bytes");
+    os << buf;
+    for (const auto& r : rows) {
+        std::snprintf(buf, sizeof(buf), "%-28s %8zu %12s\n", r.first.substr(0, 28).c_str(), r.second.buffers,
+                      format_bytes(r.second.bytes).c_str());
+        os << buf;
+    }
+
+    std::snprintf(buf, sizeof(buf), "\n%6s %-20s %-8s %10s %10s %-20s %-20s %s\n", "Id", "Shape", "DType", "Data",
+                  "Grad", "Op", "GradFn", "Held by");
+    os << buf;
+    const size_t n = top > 0 ? std::min(top, tensors.size()) : tensors.size();
+    for (size_t i = 0; i < n; ++i) {
+        const LiveTensor& t = tensors[i];
+        std::snprintf(buf, sizeof(buf), "%6llu %-20s %-8s %10s %10s %-20s %-20s %s\n",
+                      static_cast<unsigned long long>(t.id), format_shape(t.shape).substr(0, 20).c_str(),
+                      dtype_name(t.dtype), t.data_is_view ? "(view)" : format_bytes(t.data_bytes).c_str(),
+                      format_bytes(t.grad_bytes).c_str(), t.data_op.substr(0, 20).c_str(),
+                      t.grad_fn.substr(0, 20).c_str(), t.graph_retained ? "graph" : "user");
+        os << buf;
+    }
+    return os.str();
+}
+
+std::string MemorySnapshot::to_json() const {
+    std::ostringstream os;
+    os << "{\"time_ns\":" << time_ns << ",\"current\":";
+    write_usage_json(os, current);
+    os << ",\"peak\":";
+    write_usage_json(os, peak);
+    os << ",\"graph_retained_bytes\":" << graph_retained_bytes << ",\"user_held_bytes\":" << user_held_bytes;
+    os << ",\"tensors\":[";
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        const LiveTensor& t = tensors[i];
+        os << (i ? ",\n" : "\n") << "{\"id\":" << t.id << ",\"shape\":[";
+        for (size_t j = 0; j < t.shape.size(); ++j) os << (j ? "," : "") << t.shape[j];
+        os << "],\"dtype\":\"" << dtype_name(t.dtype) << "\",\"data_bytes\":" << t.data_bytes
+           << ",\"grad_bytes\":" << t.grad_bytes << ",\"data_op\":\"" << t.data_op << "\",\"grad_op\":\"" << t.grad_op
+           << "\",\"grad_fn\":\"" << t.grad_fn << "\",\"requires_grad\":" << (t.requires_grad ? "true" : "false")
+           << ",\"view\":" << (t.data_is_view ? "true" : "false")
+           << ",\"graph_retained\":" << (t.graph_retained ? "true" : "false") << "}";
+    }
+    os << "],\"blocks\":[";
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        os << (i ? ",\n" : "\n") << "{\"bytes\":" << blocks[i].bytes << ",\"kind\":\"" << memory_kind_name(blocks[i].kind)
+           << "\",\"op\":\"" << blocks[i].op << "\"}";
+    }
+    os << "]}\n";
+    return os.str();
+}
+
+// ---------------- 钩子 ----------------
+
+void memory_on_alloc(const void* key, size_t bytes) {
+    if (!key || bytes == 0) return;
+    // 反向节点 (及其内部调用的算子) 里的分配先记为临时缓冲，成为张量的数据 / 梯度时再改判
+    const ProfileScope* scope = current_profile_scope();
+    const char* op = scope ? scope->name() : nullptr;
+    const MemoryKind kind = scope && scope->in_backward() ? MemoryKind::Scratch : MemoryKind::Other;
+    std::lock_guard<std::mutex> g(g_mu);
+    if (!g_active) return;
+    MemoryProfiler& m = *g_active;
+    std::lock_guard<std::mutex> lk(m.mu_);
+    auto res = m.blocks_.insert({key, MemoryProfiler::Block{bytes, kind, op}});
+    if (!res.second) {
+        // 同一地址的旧块没记到释放：先按释放处理，保持计数一致
+        m.record(-int64_t(res.first->second.bytes), res.first->second.kind, res.first->second.op);
+        res.first->second = MemoryProfiler::Block{bytes, kind, op};
+    }
+    m.record(int64_t(bytes), kind, op);
+}
+
+void memory_on_free(const void* key) {
+    std::lock_guard<std::mutex> g(g_mu);
+    if (!g_active) return;
+    MemoryProfiler& m = *g_active;
+    std::lock_guard<std::mutex> lk(m.mu_);
+    auto it = m.blocks_.find(key);
+    if (it == m.blocks_.end()) return; // 开启之前分配的块
+    m.record(-int64_t(it->second.bytes), it->second.kind, it->second.op);
+    m.blocks_.erase(it);
+}
+
+void memory_tag(const Storage& s, MemoryKind kind) {
+    const void* key = block_key(s);
+    if (!key) return;
+    std::lock_guard<std::mutex> g(g_mu);
+    if (!g_active) return;
+    MemoryProfiler& m = *g_active;
+    std::lock_guard<std::mutex> lk(m.mu_);
+    auto it = m.blocks_.find(key);
+    if (it != m.blocks_.end()) m.retag(it->second, kind);
+}
+
+void memory_on_tensor_created(const std::shared_ptr<TensorImpl>& impl) {
+    const void* data = block_key(impl->data_);
+    const void* grad = block_key(impl->grad_);
+    std::lock_guard<std::mutex> g(g_mu);
+    if (!g_active) return;
+    MemoryProfiler& m = *g_active;
+    std::lock_guard<std::mutex> lk(m.mu_);
+    m.tensors_[impl.get()] = {impl, m.next_tensor_id_++};
+    auto it = data ? m.blocks_.find(data) : m.blocks_.end();
+    if (it != m.blocks_.end()) m.retag(it->second, MemoryKind::Data);
+    it = grad ? m.blocks_.find(grad) : m.blocks_.end();
+    if (it != m.blocks_.end()) m.retag(it->second, MemoryKind::Grad);
+}
+
+void memory_on_tensor_destroyed(const TensorImpl* impl) {
+    std::lock_guard<std::mutex> g(g_mu);
+    if (!g_active) return;
+    std::lock_guard<std::mutex> lk(g_active->mu_);
+    g_active->tensors_.erase(impl);
+}
@@ -0,0 +1,243 @@
+#include "module.hpp"
+#include "ops.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <unordered_set>
+
+namespace {
+
+constexpr size_t kArenaAlign = 16; // 以 float 计，即 64 字节
+
+size_t align_up(size_t n) { return (n + kArenaAlign - 1) / kArenaAlign * kArenaAlign; }
+
+} // namespace
+
+// ---------------- ParamArena ----------------
+
+ParamArena::ParamArena(const std::vector<Tensor>& ps) : params(ps) {
+    size_t total = 0;
+    for (auto& p : params) {
+        offsets.push_back(total);
+        total = align_up(total + p.numel());
+    }
+
+    data = Storage(total, 0.0f);
+    grad = Storage(total, 0.0f);
+
+    // 参数视图共享 data/grad 的 owner，arena 析构后参数依然有效
+    for (size_t i = 0; i < params.size(); ++i) {
+        Tensor& p = params[i];
+        size_t n = p.numel();
+        float* dp = data.data() + offsets[i];
+        float* gp = grad.data() + offsets[i];
+
+        std::memcpy(dp, p.data().data(), n * sizeof(float));
+        if (p.grad().size() == n) std::memcpy(gp, p.grad().data(), n * sizeof(float));
+
+        p.data().rebind(Storage::view(dp, n, data.owner()));
+        p.grad().rebind(Storage::view(gp, n, grad.owner()));
+    }
+}
+
+void ParamArena::zero_grad() {
+    if (!grad.empty()) std::memset(grad.data(), 0, grad.size() * sizeof(float));
+}
+
+// ---------------- Module ----------------
+
+Tensor& Module::register_parameter(const std::string& name, Tensor t) {
+    if (!t.requires_grad()) t.set_requires_grad(true);
+    params_.emplace_back(name, t);
+    arena_.reset();
+    return params_.back().second;
+}
+
+void Module::register_module(const std::string& name, std::shared_ptr<Module> m) {
+    children_.emplace_back(name, std::move(m));
+    arena_.reset();
+}
+
+void Module::collect(const std::string& prefix,
+                     std::vector<std::pair<std::string, Tensor>>& out) const {
+    for (auto& kv : params_) out.emplace_back(prefix + kv.first, kv.second);
+    for (auto& kv : children_) kv.second->collect(prefix + kv.first + ".", out);
+}
+
+std::vector<std::pair<std::string, Tensor>> Module::named_parameters() const {
+    std::vector<std::pair<std::string, Tensor>> out;
+    collect("", out);
+    return out;
+}
+
+std::vector<Tensor> Module::parameters() const {
+    // 同一个参数被多个子模块共享时只出现一次
+    std::vector<Tensor> out;
+    std::unordered_set<const float*> seen;
+    for (auto& kv : named_parameters()) {
+        if (seen.insert(kv.second.data().data()).second) out.push_back(kv.second);
+    }
+    return out;
+}
+
+void Module::flatten_parameters() {
+    // 子模块之前各自打包过的 arena 不再有效
+    std::vector<Module*> stack{this};
+    while (!stack.empty()) {
+        Module* m = stack.back();
+        stack.pop_back();
+        m->arena_.reset();
+        for (auto& kv : m->children_) stack.push_back(kv.second.get());
+    }
+    std::vector<Tensor> dense;
+    sparse_params_.clear();
+    for (auto& p : parameters()) {
+        if (p.is_sparse_grad()) sparse_params_.push_back(p);
+        else dense.push_back(p);
+    }
+    arena_ = std::make_shared<ParamArena>(dense);
+}
+
+void Module::zero_grad() {
+    if (arena_) {
+        arena_->zero_grad();
+        for (auto& p : sparse_params_) p.zero_grad();
+        return;
+    }
+    for (auto& p : parameters()) p.zero_grad();
+}
+
+// ---------------- Linear ----------------
+
+Linear::Linear(size_t in_features, size_t out_features, bool use_bias, uint32_t seed)
+    : in_features(in_features), out_features(out_features) {
+    // 与 PyTorch 一致：U(-1/sqrt(in), 1/sqrt(in))
+    std::mt19937 gen(seed);
+    float k = 1.0f / std::sqrt(static_cast<float>(in_features));
+    std::uniform_real_distribution<float> dist(-k, k);
+
+    Tensor w({in_features, out_features}, true);
+    for (auto& v : w.data()) v = dist(gen);
+    weight = register_parameter("weight", w);
+
+    if (use_bias) {
+        Tensor b({out_features}, true);
+        for (auto& v : b.data()) v = dist(gen);
+        bias = register_parameter("bias", b);
+    }
+}
+
+Tensor Linear::forward(const Tensor& x) const {
+    Tensor y = matmul(x, weight);
+    if (!bias.defined()) return y;
+    // autocast 下 y 为半精度，bias 跟着转换，使输出保持半精度
+    return add(y, y.dtype() == bias.dtype() ? bias : cast(bias, y.dtype()));
+}
+
+// ---------------- 量化 ----------------
+
+void MinMaxObserver::observe(const Tensor& x) {
+    float m = 0.0f;
+    for (float v : x.data()) m = std::max(m, std::abs(v));
+    if (momentum_ > 0.0f && count_ > 0) max_abs_ = (1.0f - momentum_) * max_abs_ + momentum_ * m;
+    else max_abs_ = std::max(max_abs_, m);
+    ++count_;
+}
+
+QuantizedLinear::QuantizedLinear(const Linear& linear, float input_scale)
+    : weight(quantize_weight(linear.weight)), input_scale(input_scale),
+      in_features(linear.in_features), out_features(linear.out_features) {
+    if (linear.bias.defined()) {
+        bias = Tensor(linear.bias.shape());
+        bias.data() = linear.bias.data();
+    }
+}
+
+Tensor QuantizedLinear::forward(const Tensor& x) const {
+    return quantized_matmul(x, weight, bias, input_scale);
+}
+
+// ---------------- Embedding / EmbeddingBag ----------------
+
+namespace {
+
+// 与 PyTorch 一致：N(0, 1)
+Tensor init_embedding_weight(size_t num, size_t dim, bool sparse, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    Tensor w({num, dim});
+    for (auto& v : w.data()) v = dist(gen);
+    if (sparse) w.set_sparse_grad(true); // 先切到稀疏模式，避免分配稠密梯度
+    w.set_requires_grad(true);
+    return w;
+}
+
+} // namespace
+
+Embedding::Embedding(size_t num_embeddings, size_t embedding_dim, bool sparse, uint32_t seed) {
+    weight = register_parameter("weight", init_embedding_weight(num_embeddings, embedding_dim, sparse, seed));
+}
+
+Tensor Embedding::forward(const std::vector<size_t>& indices) const {
+    return embedding(weight, indices);
+}
+
+EmbeddingBag::EmbeddingBag(size_t num_embeddings, size_t embedding_dim, BagMode mode,
+                           bool sparse, uint32_t seed)
+    : mode(mode) {
+    weight = register_parameter("weight", init_embedding_weight(num_embeddings, embedding_dim, sparse, seed));
+}
+
+Tensor EmbeddingBag::forward(const std::vector<size_t>& indices, const std::vector<size_t>& offsets) const {
+    return embedding_bag(weight, indices, offsets, mode);
+}
+
+// ---------------- LSTM / GRU ----------------
+
+namespace {
+
+// 与 PyTorch 一致：全部权重 U(-1/sqrt(H), 1/sqrt(H))
+Tensor init_uniform(const std::vector<size_t>& shape, float k, std::mt19937& gen) {
+    std::uniform_real_distribution<float> dist(-k, k);
+    Tensor t(shape, true);
+    for (auto& v : t.data()) v = dist(gen);
+    return t;
+}
+
+} // namespace
+
+LSTM::LSTM(size_t input_size, size_t hidden_size, uint32_t seed)
+    : input_size(input_size), hidden_size(hidden_size) {
+    std::mt19937 gen(seed);
+    float k = 1.0f / std::sqrt(static_cast<float>(hidden_size));
+    w_ih = register_parameter("w_ih", init_uniform({input_size, 4 * hidden_size}, k, gen));
+    w_hh = register_parameter("w_hh", init_uniform({hidden_size, 4 * hidden_size}, k, gen));
+    bias = register_parameter("bias", init_uniform({4 * hidden_size}, k, gen));
+}
+
+std::pair<Tensor, Tensor> LSTM::forward(const Tensor& x, const Tensor& h0, const Tensor& c0) const {
+    return lstm(x, h0, c0, w_ih, w_hh, bias);
+}
+
+std::pair<Tensor, Tensor> LSTM::step(const Tensor& x, const Tensor& h, const Tensor& c) const {
+    return lstm_cell(x, h, c, w_ih, w_hh, bias);
+}
+
+GRU::GRU(size_t input_size, size_t hidden_size, uint32_t seed)
+    : input_size(input_size), hidden_size(hidden_size) {
+    std::mt19937 gen(seed);
+    float k = 1.0f / std::sqrt(static_cast<float>(hidden_size));
+    w_ih = register_parameter("w_ih", init_uniform({input_size, 3 * hidden_size}, k, gen));
+    w_hh = register_parameter("w_hh", init_uniform({hidden_size, 3 * hidden_size}, k, gen));
+    b_ih = register_parameter("b_ih", init_uniform({3 * hidden_size}, k, gen));
+    b_hh = register_parameter("b_hh", init_uniform({3 * hidden_size}, k, gen));
+}
+
+Tensor GRU::forward(const Tensor& x, const Tensor& h0) const {
+    return gru(x, h0, w_ih, w_hh, b_ih, b_hh);
+}
+
+Tensor GRU::step(const Tensor& x, const Tensor& h) const {
+    return gru_cell(x, h, w_ih, w_hh, b_ih, b_hh);
+}
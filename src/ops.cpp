@@ -2,110 +2,388 @@
 #include "tensor_utils.hpp"
 #include "autograd.hpp"
 #include "grad_fn.hpp"
+#include "parallel.hpp"
+#include "kernels.hpp"
+#include "amp.hpp"
+#include "graph.hpp"
+#include "broadcast.hpp"
+#include "profiler.hpp"
 #include <vector>
 #include <stdexcept>
 #include <cassert>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
+
+// ---------------- 存储类型转换 ----------------
+
+Tensor cast(const Tensor& t, DType dtype) {
+    if (t.dtype() == dtype) return t;
+    MINIDL_PROFILE_OP("cast", copy_cost(t), &t);
+    Tensor out(t.shape(), dtype);
+    auto kernel = [t, out]() mutable {
+        convert_parallel(t.data().raw(), t.dtype(), out.data().raw(), out.dtype(), t.numel());
+    };
+    kernel();
+    record_op(OpKind::Cast, {t}, out, kernel);
+    if (is_floating_point(dtype) && any_requires_grad(t)) {
+        out.set_requires_grad(true);
+        out.set_grad_fn(new CastGradFn(t));
+    }
+    return out;
+}
 
-// ---------------- Tensor × Tensor (广播机制) ----------------
+// ---------------- 混合精度 ----------------
 
-Tensor add(const Tensor& a, const Tensor& b) {
-    auto out_shape = broadcast_shape(a.shape(), b.shape());
-    Tensor out(out_shape);
+namespace {
+
+enum class BinaryOp { Add, Sub, Mul, Div };
+
+// 分块大小：每块转成 fp32 后放在栈上
+constexpr size_t kMixedBlock = 256;
+constexpr size_t kMixedGrain = 1 << 14;
 
-    for (size_t i = 0; i < out.numel(); ++i) {
-        auto idx = unravel_index(i, out_shape);
-        size_t ia = ravel_index_broadcast(idx, a.shape());
-        size_t ib = ravel_index_broadcast(idx, b.shape());
-        out[i] = a[ia] + b[ib];
+inline const char* raw_at(const Tensor& t, size_t i) {
+    return static_cast<const char*>(t.data().raw()) + i * dtype_size(t.dtype());
+}
+
+// 不建图的类型转换副本
+Tensor to_dtype_nograd(const Tensor& t, DType dtype) {
+    if (t.dtype() == dtype) return t;
+    Tensor out(t.shape(), dtype);
+    convert_parallel(t.data().raw(), t.dtype(), out.data().raw(), dtype, t.numel());
+    return out;
+}
+
+Tensor to_f32_nograd(const Tensor& t) { return to_dtype_nograd(t, DType::Float32); }
+
+// 任一输入为半精度的逐元素运算：同形状时按块加载 -> fp32 计算 -> 写回输出类型，
+// 广播时退回到先转 fp32 再复用 fp32 实现。反向节点与 fp32 版本相同，读取输入时再转 fp32
+Tensor binary_mixed(const Tensor& a, const Tensor& b, BinaryOp op) {
+    DType out_dt = promote_types(a.dtype(), b.dtype());
+    Tensor out;
+    if (a.shape() == b.shape()) {
+        out = Tensor(a.shape(), out_dt);
+        char* dst = static_cast<char*>(out.data().raw());
+        size_t out_size = dtype_size(out_dt);
+        parallel_for(0, a.numel(), kMixedGrain, [&](size_t lo, size_t hi) {
+            float xa[kMixedBlock], xb[kMixedBlock];
+            for (size_t i = lo; i < hi; i += kMixedBlock) {
+                size_t m = std::min(kMixedBlock, hi - i);
+                convert(raw_at(a, i), a.dtype(), xa, DType::Float32, m);
+                convert(raw_at(b, i), b.dtype(), xb, DType::Float32, m);
+                switch (op) {
+                case BinaryOp::Add: for (size_t j = 0; j < m; ++j) xa[j] += xb[j]; break;
+                case BinaryOp::Sub: for (size_t j = 0; j < m; ++j) xa[j] -= xb[j]; break;
+                case BinaryOp::Mul: for (size_t j = 0; j < m; ++j) xa[j] *= xb[j]; break;
+                case BinaryOp::Div:
+                    for (size_t j = 0; j < m; ++j) {
+                        if (xb[j] == 0) throw std::runtime_error("Division by zero");
+                        xa[j] /= xb[j];
+                    }
+                    break;
+                }
+                convert(xa, DType::Float32, dst + i * out_size, out_dt, m);
+            }
+        });
+    } else {
+        Tensor fa = to_f32_nograd(a), fb = to_f32_nograd(b);
+        Tensor r;
+        switch (op) {
+        case BinaryOp::Add: r = add(fa, fb); break;
+        case BinaryOp::Sub: r = sub(fa, fb); break;
+        case BinaryOp::Mul: r = mul(fa, fb); break;
+        case BinaryOp::Div: r = div(fa, fb); break;
+        }
+        out = Tensor(r.shape(), out_dt);
+        convert_parallel(r.data().data(), DType::Float32, out.data().raw(), out_dt, r.numel());
     }
 
-    // ===== Autograd 绑定 =====
-    // 此时传入的 a, b 是 Tensor 句柄，内部 shared_ptr 会自动增加引用计数
-    if (a.requires_grad() || b.requires_grad()) {
+    if (any_requires_grad(a, b)) {
         out.set_requires_grad(true);
-        out.set_grad_fn(new AddGradFn(a, b));
+        switch (op) {
+        case BinaryOp::Add: out.set_grad_fn(new AddGradFn(a, b)); break;
+        case BinaryOp::Sub: out.set_grad_fn(new SubGradFn(a, b)); break;
+        case BinaryOp::Mul: out.set_grad_fn(new MulGradFn(a, b)); break;
+        case BinaryOp::Div: out.set_grad_fn(new DivGradFn(a, b)); break;
+        }
     }
-
     return out;
 }
 
-Tensor sub(const Tensor& a, const Tensor& b) {
-    auto out_shape = broadcast_shape(a.shape(), b.shape());
-    Tensor out(out_shape);
+inline bool is_mixed(const Tensor& a, const Tensor& b) {
+    return a.dtype() != DType::Float32 || b.dtype() != DType::Float32;
+}
 
-    for (size_t i = 0; i < out.numel(); ++i) {
-        auto idx = unravel_index(i, out_shape);
-        size_t ia = ravel_index_broadcast(idx, a.shape());
-        size_t ib = ravel_index_broadcast(idx, b.shape());
-        out[i] = a[ia] - b[ib];
-    }
+// 结果为 Float64 或整数时按结果类型实例化内核，输入先转成结果类型
+inline bool needs_typed_kernel(DType out_dt) { return out_dt == DType::Float64 || !is_floating_point(out_dt); }
 
-    // ===== Autograd 绑定 =====
-    if (a.requires_grad() || b.requires_grad()) {
+// out[i] = f(a[ia], b[ib])：按秩与广播模式特化的循环，按输出第 0 维并行
+template <typename T, typename R, typename F>
+void broadcast_apply(const Tensor& a, const Tensor& b, const std::vector<size_t>& out_shape,
+                     const T* A, const T* B, R* out, F&& f) {
+    broadcast_map(out_shape, out, f, broadcast_input(A, a.shape()), broadcast_input(B, b.shape()));
+}
+
+// Float64 / 整数的逐元素运算；整数除法向 0 截断
+Tensor binary_typed(const Tensor& a, const Tensor& b, BinaryOp op, DType out_dt) {
+    auto out_shape = broadcast_shape(a.shape(), b.shape());
+    Tensor ca = to_dtype_nograd(a, out_dt), cb = to_dtype_nograd(b, out_dt);
+    Tensor out(out_shape, out_dt);
+    MINIDL_DISPATCH_ALL_TYPES(out_dt, "binary op", [&] {
+        const scalar_t* A = ca.data_ptr<scalar_t>();
+        const scalar_t* B = cb.data_ptr<scalar_t>();
+        scalar_t* O = out.data_ptr<scalar_t>();
+        switch (op) {
+        case BinaryOp::Add: broadcast_apply(a, b, out_shape, A, B, O, [](scalar_t x, scalar_t y) { return scalar_t(x + y); }); break;
+        case BinaryOp::Sub: broadcast_apply(a, b, out_shape, A, B, O, [](scalar_t x, scalar_t y) { return scalar_t(x - y); }); break;
+        case BinaryOp::Mul: broadcast_apply(a, b, out_shape, A, B, O, [](scalar_t x, scalar_t y) { return scalar_t(x * y); }); break;
+        case BinaryOp::Div:
+            for (size_t i = 0; i < cb.numel(); ++i) {
+                if (B[i] == scalar_t(0)) throw std::runtime_error("Division by zero");
+            }
+            broadcast_apply(a, b, out_shape, A, B, O, [](scalar_t x, scalar_t y) { return scalar_t(x / y); });
+            break;
+        }
+    });
+
+    if (any_requires_grad(a, b)) {
         out.set_requires_grad(true);
-        out.set_grad_fn(new SubGradFn(a, b));
+        switch (op) {
+        case BinaryOp::Add: out.set_grad_fn(new AddGradFn(a, b)); break;
+        case BinaryOp::Sub: out.set_grad_fn(new SubGradFn(a, b)); break;
+        case BinaryOp::Mul: out.set_grad_fn(new MulGradFn(a, b)); break;
+        case BinaryOp::Div: out.set_grad_fn(new DivGradFn(a, b)); break;
+        }
     }
-
     return out;
 }
 
-Tensor mul(const Tensor& a, const Tensor& b) {
-    // 1. 确定输出形状（处理广播）
+// 非 fp32 输入的统一入口：半精度 / fp32 结果走分块 fp32 计算，其余按结果类型实例化
+Tensor binary_dispatch(const Tensor& a, const Tensor& b, BinaryOp op) {
+    check_capturable("elementwise op on non-float32 tensors");
+    DType out_dt = promote_types(a.dtype(), b.dtype());
+    if (needs_typed_kernel(out_dt)) return binary_typed(a, b, op, out_dt);
+    return binary_mixed(a, b, op);
+}
+
+// 比较运算在这种类型中进行 (半精度先转 fp32)
+DType compare_dtype(const Tensor& a, const Tensor& b) {
+    DType dt = promote_types(a.dtype(), b.dtype());
+    return is_half(dt) ? DType::Float32 : dt;
+}
+
+enum class CompareOp { Eq, Ne, Lt, Le, Gt, Ge };
+
+Tensor compare(const Tensor& a, const Tensor& b, CompareOp op) {
+    check_capturable("compare");
     auto out_shape = broadcast_shape(a.shape(), b.shape());
-    Tensor out(out_shape);
+    DType dt = compare_dtype(a, b);
+    Tensor ca = to_dtype_nograd(a, dt), cb = to_dtype_nograd(b, dt);
+    Tensor out(out_shape, DType::UInt8);
+    MINIDL_DISPATCH_ALL_TYPES(dt, "compare", [&] {
+        const scalar_t* A = ca.data_ptr<scalar_t>();
+        const scalar_t* B = cb.data_ptr<scalar_t>();
+        uint8_t* O = out.data_ptr<uint8_t>();
+        switch (op) {
+        case CompareOp::Eq: broadcast_apply(a, b, out_shape, A, B, O, [](scalar_t x, scalar_t y) { return uint8_t(x == y); }); break;
+        case CompareOp::Ne: broadcast_apply(a, b, out_shape, A, B, O, [](scalar_t x, scalar_t y) { return uint8_t(x != y); }); break;
+        case CompareOp::Lt: broadcast_apply(a, b, out_shape, A, B, O, [](scalar_t x, scalar_t y) { return uint8_t(x < y); }); break;
+        case CompareOp::Le: broadcast_apply(a, b, out_shape, A, B, O, [](scalar_t x, scalar_t y) { return uint8_t(x <= y); }); break;
+        case CompareOp::Gt: broadcast_apply(a, b, out_shape, A, B, O, [](scalar_t x, scalar_t y) { return uint8_t(x > y); }); break;
+        case CompareOp::Ge: broadcast_apply(a, b, out_shape, A, B, O, [](scalar_t x, scalar_t y) { return uint8_t(x >= y); }); break;
+        }
+    });
+    return out;
+}
 
-    // 2. 前向计算：逐元素相乘，并处理广播索引映射
-    for (size_t i = 0; i < out.numel(); ++i) {
-        auto idx = unravel_index(i, out_shape);
-        size_t ia = ravel_index_broadcast(idx, a.shape());
-        size_t ib = ravel_index_broadcast(idx, b.shape());
-        
-        // 实际计算
-        out[i] = a[ia] * b[ib];
+// Float64 / 整数 matmul：i-p-j 顺序，按输出行并行
+Tensor matmul_typed(const Tensor& a, const Tensor& b, size_t m, size_t k, size_t n, DType out_dt) {
+    Tensor ca = to_dtype_nograd(a, out_dt), cb = to_dtype_nograd(b, out_dt);
+    Tensor out({m, n}, out_dt);
+    MINIDL_DISPATCH_ALL_TYPES(out_dt, "matmul", [&] {
+        const scalar_t* A = ca.data_ptr<scalar_t>();
+        const scalar_t* B = cb.data_ptr<scalar_t>();
+        scalar_t* C = out.data_ptr<scalar_t>();
+        parallel_for(0, m, std::max<size_t>(1, 65536 / std::max<size_t>(n * k, 1)), [&](size_t i0, size_t i1) {
+            for (size_t i = i0; i < i1; ++i) {
+                scalar_t* ci = C + i * n;
+                for (size_t p = 0; p < k; ++p) {
+                    scalar_t av = A[i * k + p];
+                    const scalar_t* bp = B + p * n;
+                    for (size_t j = 0; j < n; ++j) ci[j] += av * bp[j];
+                }
+            }
+        });
+    });
+    if (any_requires_grad(a, b)) {
+        out.set_requires_grad(true);
+        out.set_grad_fn(new MatMulGradFn(a, b));
     }
+    return out;
+}
 
-    // 3. Autograd 绑定：
-    // 只要其中一个输入需要梯度，结果就需要梯度，并挂载 MulGradFn
-    if (a.requires_grad() || b.requires_grad()) {
+// 半精度 matmul：B 整体转成 fp32 一次 (每个元素要被用 m 次)，A 按行块加载转换，
+// 在 fp32 中用 sgemm 累加后再按输出类型写回
+constexpr size_t kMixedMatmulRows = 32;
+
+Tensor matmul_mixed(const Tensor& a, const Tensor& b, size_t m, size_t k, size_t n) {
+    DType out_dt = promote_types(a.dtype(), b.dtype());
+    Tensor out({m, n}, out_dt);
+    Tensor b32 = to_f32_nograd(b);
+    const float* B = b32.data().data();
+    char* dst = static_cast<char*>(out.data().raw());
+    size_t out_size = dtype_size(out_dt);
+
+    parallel_for(0, m, std::max<size_t>(1, kMixedMatmulRows), [&](size_t lo, size_t hi) {
+        std::vector<float> abuf, cbuf;
+        for (size_t i0 = lo; i0 < hi; i0 += kMixedMatmulRows) {
+            size_t rows = std::min(kMixedMatmulRows, hi - i0);
+            const float* A;
+            if (a.dtype() == DType::Float32) {
+                A = a.data().data() + i0 * k;
+            } else {
+                abuf.resize(rows * k);
+                convert(raw_at(a, i0 * k), a.dtype(), abuf.data(), DType::Float32, rows * k);
+                A = abuf.data();
+            }
+            cbuf.resize(rows * n);
+            sgemm(false, false, rows, n, k, 1.0f, A, k, B, n, 0.0f, cbuf.data(), n);
+            convert(cbuf.data(), DType::Float32, dst + i0 * n * out_size, out_dt, rows * n);
+        }
+    });
+
+    if (any_requires_grad(a, b)) {
         out.set_requires_grad(true);
-        // 这里传入 a 和 b 的句柄，MulGradFn 会自动通过 shared_ptr 延长它们的生命周期
-        out.set_grad_fn(new MulGradFn(a, b)); 
+        out.set_grad_fn(new MatMulGradFn(a, b));
     }
-
     return out;
 }
 
-Tensor div(const Tensor& a, const Tensor& b) {
+} // namespace
+
+// ---------------- Tensor × Tensor (广播机制) ----------------
+
+namespace {
+
+OpKind op_kind(BinaryOp op) {
+    switch (op) {
+    case BinaryOp::Add: return OpKind::Add;
+    case BinaryOp::Sub: return OpKind::Sub;
+    case BinaryOp::Mul: return OpKind::Mul;
+    case BinaryOp::Div: return OpKind::Div;
+    }
+    return OpKind::Add;
+}
+
+// fp32 逐元素运算：kernel 把结果写进已分配的 out，录制图时原样保存下来供重放
+Tensor binary_f32(const Tensor& a, const Tensor& b, BinaryOp op) {
     auto out_shape = broadcast_shape(a.shape(), b.shape());
     Tensor out(out_shape);
 
-    for (size_t i = 0; i < out.numel(); ++i) {
-        auto idx = unravel_index(i, out_shape);
-        size_t ia = ravel_index_broadcast(idx, a.shape());
-        size_t ib = ravel_index_broadcast(idx, b.shape());
-        if (b[ib] == 0) throw std::runtime_error("Division by zero");
-        out[i] = a[ia] / b[ib];
-    }
+    auto kernel = [a, b, out, op]() mutable {
+        const float* A = a.data_ptr<float>();
+        const float* B = b.data_ptr<float>();
+        float* O = out.data_ptr<float>();
+        auto ia = broadcast_input(A, a.shape()), ib = broadcast_input(B, b.shape());
+        switch (op) {
+        case BinaryOp::Add: broadcast_map(out.shape(), O, [](float x, float y) { return x + y; }, ia, ib); break;
+        case BinaryOp::Sub: broadcast_map(out.shape(), O, [](float x, float y) { return x - y; }, ia, ib); break;
+        case BinaryOp::Mul: broadcast_map(out.shape(), O, [](float x, float y) { return x * y; }, ia, ib); break;
+        case BinaryOp::Div:
+            // 广播会用到 b 的每个元素，先整体检查除数
+            if (std::find(B, B + b.numel(), 0.0f) != B + b.numel()) throw std::runtime_error("Division by zero");
+            broadcast_map(out.shape(), O, [](float x, float y) { return x / y; }, ia, ib);
+            break;
+        }
+    };
+    kernel();
+    record_op(op_kind(op), {a, b}, out, kernel);
 
-    // 3. 绑定 Autograd 逻辑
-    if (a.requires_grad() || b.requires_grad()) {
+    // ===== Autograd 绑定 =====
+    // 此时传入的 a, b 是 Tensor 句柄，内部 shared_ptr 会自动增加引用计数
+    if (any_requires_grad(a, b)) {
         out.set_requires_grad(true);
-        out.set_grad_fn(new DivGradFn(a, b)); 
+        switch (op) {
+        case BinaryOp::Add: out.set_grad_fn(new AddGradFn(a, b)); break;
+        case BinaryOp::Sub: out.set_grad_fn(new SubGradFn(a, b)); break;
+        case BinaryOp::Mul: out.set_grad_fn(new MulGradFn(a, b)); break;
+        case BinaryOp::Div: out.set_grad_fn(new DivGradFn(a, b)); break;
+        }
     }
+    return out;
+}
 
+// fp32 张量与标量的逐元素运算 (不建图，只传递 requires_grad)
+template <typename F>
+Tensor scalar_f32(const Tensor& t, OpKind kind, float scalar, F f) {
+    Tensor out(t.shape());
+    auto kernel = [t, out, f]() mutable {
+        for (size_t i = 0; i < t.numel(); ++i) out[i] = f(t[i]);
+    };
+    kernel();
+    record_op(kind, {t}, out, kernel, scalar);
+    if (t.requires_grad() && is_grad_enabled()) out.set_requires_grad(true);
     return out;
 }
 
+} // namespace
+
+Tensor add(const Tensor& a, const Tensor& b) {
+    MINIDL_PROFILE_OP("add", elementwise_cost({&a, &b}), &a, &b);
+    if (is_mixed(a, b)) return binary_dispatch(a, b, BinaryOp::Add);
+    return binary_f32(a, b, BinaryOp::Add);
+}
+
+Tensor sub(const Tensor& a, const Tensor& b) {
+    MINIDL_PROFILE_OP("sub", elementwise_cost({&a, &b}), &a, &b);
+    if (is_mixed(a, b)) return binary_dispatch(a, b, BinaryOp::Sub);
+    return binary_f32(a, b, BinaryOp::Sub);
+}
+
+Tensor mul(const Tensor& a, const Tensor& b) {
+    MINIDL_PROFILE_OP("mul", elementwise_cost({&a, &b}), &a, &b);
+    if (is_mixed(a, b)) return binary_dispatch(a, b, BinaryOp::Mul);
+    return binary_f32(a, b, BinaryOp::Mul);
+}
+
+Tensor div(const Tensor& a, const Tensor& b) {
+    MINIDL_PROFILE_OP("div", elementwise_cost({&a, &b}), &a, &b);
+    if (is_mixed(a, b)) return binary_dispatch(a, b, BinaryOp::Div);
+    return binary_f32(a, b, BinaryOp::Div);
+}
+
 Tensor neg(const Tensor& a) {
+    MINIDL_PROFILE_OP("neg", elementwise_cost({&a}), &a);
+    if (a.dtype() != DType::Float32) {
+        check_capturable("neg (non-float32)");
+        // 半精度在 fp32 中取负再转回；其余类型按元素类型实例化
+        Tensor src = is_half(a.dtype()) ? to_f32_nograd(a) : a;
+        Tensor out(a.shape(), src.dtype());
+        MINIDL_DISPATCH_ALL_TYPES(src.dtype(), "neg", [&] {
+            const scalar_t* x = src.data_ptr<scalar_t>();
+            scalar_t* o = out.data_ptr<scalar_t>();
+            for (size_t i = 0; i < a.numel(); ++i) o[i] = scalar_t(-x[i]);
+        });
+        if (is_half(a.dtype())) out = to_dtype_nograd(out, a.dtype());
+        if (any_requires_grad(a)) {
+            out.set_requires_grad(true);
+            out.set_grad_fn(new NegGradFn(a));
+        }
+        return out;
+    }
     Tensor out(a.shape());
 
-    for (size_t i = 0; i < a.numel(); ++i) {
-        out[i] = -a[i];
-    }
+    auto kernel = [a, out]() mutable {
+        for (size_t i = 0; i < a.numel(); ++i) {
+            out[i] = -a[i];
+        }
+    };
+    kernel();
+    record_op(OpKind::Neg, {a}, out, kernel);
 
     // ===== Autograd 绑定 =====
-    if (a.requires_grad()) {
+    if (any_requires_grad(a)) {
         out.set_requires_grad(true);
         out.set_grad_fn(new NegGradFn(a));
     }
@@ -113,61 +391,141 @@ Tensor neg(const Tensor& a) {
     return out;
 }
 
+Tensor relu(const Tensor& a) {
+    MINIDL_PROFILE_OP("relu", elementwise_cost({&a}), &a);
+    if (a.dtype() != DType::Float32) {
+        check_capturable("relu (non-float32)");
+        Tensor out(a.shape(), a.dtype());
+        MINIDL_DISPATCH_FLOATING_TYPES(a.dtype(), "relu", [&] {
+            const scalar_t* x = a.data_ptr<scalar_t>();
+            scalar_t* o = out.data_ptr<scalar_t>();
+            for (size_t i = 0; i < a.numel(); ++i) o[i] = x[i] > scalar_t(0) ? x[i] : scalar_t(0);
+        });
+        if (any_requires_grad(a)) {
+            out.set_requires_grad(true);
+            out.set_grad_fn(new ReluGradFn(a));
+        }
+        return out;
+    }
+    Tensor out(a.shape());
+    auto kernel = [a, out]() mutable {
+        const float* x = a.data().data();
+        float* o = out.data().data();
+        for (size_t i = 0; i < a.numel(); ++i) o[i] = x[i] > 0.0f ? x[i] : 0.0f;
+    };
+    kernel();
+    record_op(OpKind::Relu, {a}, out, kernel);
+
+    if (any_requires_grad(a)) {
+        out.set_requires_grad(true);
+        out.set_grad_fn(new ReluGradFn(a));
+    }
+    return out;
+}
+
 // ---------------- Tensor × Scalar 混合运算 ----------------
 
 Tensor add(const Tensor& t, float scalar) {
-    Tensor out(t.shape());
-    for (size_t i = 0; i < t.numel(); ++i) out[i] = t[i] + scalar;
-    if (t.requires_grad()) out.set_requires_grad(true);
-    return out;
+    MINIDL_PROFILE_OP("add_scalar", elementwise_cost({&t}), &t);
+    return scalar_f32(t, OpKind::AddScalar, scalar, [scalar](float x) { return x + scalar; });
 }
 
 Tensor add(float scalar, const Tensor& t) { return add(t, scalar); }
 
 Tensor sub(const Tensor& t, float scalar) {
-    Tensor out(t.shape());
-    for (size_t i = 0; i < t.numel(); ++i) out[i] = t[i] - scalar;
-    if (t.requires_grad()) out.set_requires_grad(true);
-    return out;
+    MINIDL_PROFILE_OP("sub_scalar", elementwise_cost({&t}), &t);
+    return scalar_f32(t, OpKind::SubScalar, scalar, [scalar](float x) { return x - scalar; });
 }
 
 Tensor sub(float scalar, const Tensor& t) {
-    Tensor out(t.shape());
-    for (size_t i = 0; i < t.numel(); ++i) out[i] = scalar - t[i];
-    if (t.requires_grad()) out.set_requires_grad(true);
-    return out;
+    MINIDL_PROFILE_OP("rsub_scalar", elementwise_cost({&t}), &t);
+    return scalar_f32(t, OpKind::RSubScalar, scalar, [scalar](float x) { return scalar - x; });
 }
 
 Tensor mul(const Tensor& t, float scalar) {
-    Tensor out(t.shape());
-    for (size_t i = 0; i < t.numel(); ++i) out[i] = t[i] * scalar;
-    if (t.requires_grad()) out.set_requires_grad(true);
-    return out;
+    MINIDL_PROFILE_OP("mul_scalar", elementwise_cost({&t}), &t);
+    return scalar_f32(t, OpKind::MulScalar, scalar, [scalar](float x) { return x * scalar; });
 }
 
 Tensor mul(float scalar, const Tensor& t) { return mul(t, scalar); }
 
 Tensor div(const Tensor& t, float scalar) {
+    MINIDL_PROFILE_OP("div_scalar", elementwise_cost({&t}), &t);
     if (scalar == 0) throw std::runtime_error("Division by zero");
-    Tensor out(t.shape());
-    for (size_t i = 0; i < t.numel(); ++i) out[i] = t[i] / scalar;
-    if (t.requires_grad()) out.set_requires_grad(true);
-    return out;
+    return scalar_f32(t, OpKind::DivScalar, scalar, [scalar](float x) { return x / scalar; });
 }
 
 Tensor div(float scalar, const Tensor& t) {
-    Tensor out(t.shape());
-    for (size_t i = 0; i < t.numel(); ++i) {
-        if (t[i] == 0) throw std::runtime_error("Division by zero");
-        out[i] = scalar / t[i];
+    MINIDL_PROFILE_OP("rdiv_scalar", elementwise_cost({&t}), &t);
+    return scalar_f32(t, OpKind::RDivScalar, scalar, [scalar](float x) {
+        if (x == 0) throw std::runtime_error("Division by zero");
+        return scalar / x;
+    });
+}
+
+// ---------------- 比较与选择 ----------------
+
+Tensor eq(const Tensor& a, const Tensor& b) {
+    MINIDL_PROFILE_OP("eq", elementwise_cost({&a, &b}), &a, &b);
+    return compare(a, b, CompareOp::Eq);
+}
+
+Tensor ne(const Tensor& a, const Tensor& b) {
+    MINIDL_PROFILE_OP("ne", elementwise_cost({&a, &b}), &a, &b);
+    return compare(a, b, CompareOp::Ne);
+}
+
+Tensor lt(const Tensor& a, const Tensor& b) {
+    MINIDL_PROFILE_OP("lt", elementwise_cost({&a, &b}), &a, &b);
+    return compare(a, b, CompareOp::Lt);
+}
+
+Tensor le(const Tensor& a, const Tensor& b) {
+    MINIDL_PROFILE_OP("le", elementwise_cost({&a, &b}), &a, &b);
+    return compare(a, b, CompareOp::Le);
+}
+
+Tensor gt(const Tensor& a, const Tensor& b) {
+    MINIDL_PROFILE_OP("gt", elementwise_cost({&a, &b}), &a, &b);
+    return compare(a, b, CompareOp::Gt);
+}
+
+Tensor ge(const Tensor& a, const Tensor& b) {
+    MINIDL_PROFILE_OP("ge", elementwise_cost({&a, &b}), &a, &b);
+    return compare(a, b, CompareOp::Ge);
+}
+
+Tensor where(const Tensor& mask, const Tensor& a, const Tensor& b) {
+    MINIDL_PROFILE_OP("where", elementwise_cost({&mask, &a, &b}), &mask, &a, &b);
+    check_capturable("where");
+    if (mask.dtype() != DType::UInt8) throw std::runtime_error("where expects a uint8 mask");
+    auto out_shape = broadcast_shape(mask.shape(), broadcast_shape(a.shape(), b.shape()));
+    DType out_dt = promote_types(a.dtype(), b.dtype());
+    DType dt = is_half(out_dt) ? DType::Float32 : out_dt;
+    Tensor ca = to_dtype_nograd(a, dt), cb = to_dtype_nograd(b, dt);
+    Tensor out(out_shape, dt);
+    const uint8_t* M = mask.data_ptr<uint8_t>();
+    MINIDL_DISPATCH_ALL_TYPES(dt, "where", [&] {
+        const scalar_t* A = ca.data_ptr<scalar_t>();
+        const scalar_t* B = cb.data_ptr<scalar_t>();
+        scalar_t* O = out.data_ptr<scalar_t>();
+        broadcast_map(out_shape, O, [](uint8_t m, scalar_t x, scalar_t y) { return m ? x : y; },
+                      broadcast_input(M, mask.shape()), broadcast_input(A, a.shape()),
+                      broadcast_input(B, b.shape()));
+    });
+    if (dt != out_dt) out = to_dtype_nograd(out, out_dt);
+
+    if (any_requires_grad(a, b)) {
+        out.set_requires_grad(true);
+        out.set_grad_fn(new WhereGradFn(mask, a, b));
     }
-    if (t.requires_grad()) out.set_requires_grad(true);
     return out;
 }
 
 // ---------------- 矩阵与转置 ----------------
 
 Tensor matmul(const Tensor& a, const Tensor& b) {
+    MINIDL_PROFILE_OP("matmul", matmul_cost(a, b), &a, &b);
     if (a.shape().size() != 2 || b.shape().size() != 2) {
         throw std::runtime_error("matmul only supports 2D tensors");
     }
@@ -179,23 +537,38 @@ Tensor matmul(const Tensor& a, const Tensor& b) {
 
     if (k != k2) throw std::runtime_error("matmul shape mismatch");
 
+    DType ac = autocast_dtype();
+    bool typed = needs_typed_kernel(promote_types(a.dtype(), b.dtype()));
+    if (typed || ac != DType::Float32 || is_mixed(a, b)) check_capturable("matmul (non-float32)");
+    if (typed) return matmul_typed(a, b, m, k, n, promote_types(a.dtype(), b.dtype()));
+    if (ac != DType::Float32) {
+        AutocastGuard off(DType::Float32); // 避免递归
+        return matmul_mixed(cast(a, ac), cast(b, ac), m, k, n);
+    }
+    if (is_mixed(a, b)) return matmul_mixed(a, b, m, k, n);
+
     Tensor out({m, n});
-    const auto& A = a.data();
-    const auto& B = b.data();
-    auto& C = out.data();
-
-    for (size_t i = 0; i < m; ++i) {
-        for (size_t j = 0; j < n; ++j) {
-            float sum = 0.0f;
-            for (size_t p = 0; p < k; ++p) {
-                sum += A[i * k + p] * B[p * n + j];
+    auto kernel = [a, b, out, m, k, n]() mutable {
+        const auto& A = a.data();
+        const auto& B = b.data();
+        auto& C = out.data();
+
+        for (size_t i = 0; i < m; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                float sum = 0.0f;
+                for (size_t p = 0; p < k; ++p) {
+                    sum += A[i * k + p] * B[p * n + j];
+                }
+                C[i * n + j] = sum;
             }
-            C[i * n + j] = sum;
         }
-    }
-    
+    };
+    kernel();
+    record_op(OpKind::MatMul, {a, b}, out, kernel);
+
+
     // 如果需要矩阵求导，在此绑定 MatMulGradFn
-    if (a.requires_grad() || b.requires_grad()) {
+    if (any_requires_grad(a, b)) {
         out.set_requires_grad(true);
         out.set_grad_fn(new MatMulGradFn(a, b));
     }
@@ -204,25 +577,822 @@ Tensor matmul(const Tensor& a, const Tensor& b) {
 }
 
 Tensor transpose(const Tensor& t) {
+    MINIDL_PROFILE_OP("transpose", copy_cost(t), &t);
     if (t.shape().size() != 2) {
         throw std::runtime_error("transpose only supports 2D tensors");
     }
 
     size_t m = t.shape()[0];
     size_t n = t.shape()[1];
+    if (t.dtype() != DType::Float32) {
+        check_capturable("transpose (non-float32)");
+        // 其他类型按字节搬运，与元素类型无关
+        Tensor out({n, m}, t.dtype());
+        size_t es = dtype_size(t.dtype());
+        const char* src = static_cast<const char*>(t.data().raw());
+        char* dst = static_cast<char*>(out.data().raw());
+        for (size_t i = 0; i < m; ++i)
+            for (size_t j = 0; j < n; ++j) std::memcpy(dst + (j * m + i) * es, src + (i * n + j) * es, es);
+        if (t.requires_grad() && is_grad_enabled()) out.set_requires_grad(true);
+        return out;
+    }
     Tensor out({n, m});
+    auto kernel = [t, out, m, n]() mutable {
+        const auto& src = t.data();
+        auto& dst = out.data();
+
+        for (size_t i = 0; i < m; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                dst[j * m + i] = src[i * n + j];
+            }
+        }
+    };
+    kernel();
+    record_op(OpKind::Transpose, {t}, out, kernel);
+
+
+    if (t.requires_grad() && is_grad_enabled()) out.set_requires_grad(true);
+
+    return out;
+}
+
+// ---------------- INT8 量化推理 ----------------
+
+namespace {
+
+size_t pad_k(size_t k) { return (k + kInt8PadK - 1) / kInt8PadK * kInt8PadK; }
+
+int8_t quantize_value(float x, float inv_scale) {
+    float q = std::nearbyint(x * inv_scale);
+    return static_cast<int8_t>(std::min(127.0f, std::max(-127.0f, q)));
+}
+
+// 全 0 的行 scale 取 1，避免除零
+float scale_from_max(float max_abs) { return max_abs > 0.0f ? max_abs / 127.0f : 1.0f; }
+
+const float* bias_ptr(const Tensor& bias, size_t n) {
+    if (!bias.defined()) return nullptr;
+    if (bias.numel() != n) throw std::runtime_error("quantized_matmul bias shape mismatch");
+    return bias.data().data();
+}
+
+void check_quantized_operands(const QuantizedMatrix& x, const QuantizedMatrix& w) {
+    if (x.cols != w.cols) throw std::runtime_error("quantized_matmul shape mismatch");
+}
+
+// int8 操作数按补齐后的行长读，输出每个元素 out_bytes 字节
+OpCost quantized_gemm_cost(const QuantizedMatrix& x, const QuantizedMatrix& w, uint64_t out_bytes) {
+    return {2 * uint64_t(x.rows) * w.rows * x.cols,
+            uint64_t(x.rows) * x.k_padded + uint64_t(w.rows) * w.k_padded + uint64_t(x.rows) * w.rows * out_bytes};
+}
+
+// 每个元素一次乘法：读 int8，写 float
+OpCost dequantize_cost(const QuantizedMatrix& q) {
+    const uint64_t n = uint64_t(q.rows) * q.cols;
+    return {n, n * 5};
+}
+
+} // namespace
+
+QuantizedMatrix quantize_weight(const Tensor& w) {
+    MINIDL_PROFILE_OP("quantize_weight", elementwise_cost({&w}, 2), &w);
+    check_capturable("quantize_weight");
+    if (w.shape().size() != 2) throw std::runtime_error("quantize_weight expects a 2D [in, out] tensor");
+    size_t k = w.shape()[0], n = w.shape()[1];
+    const float* W = w.data().data();
+
+    QuantizedMatrix q;
+    q.rows = n;
+    q.cols = k;
+    q.k_padded = pad_k(k);
+    q.data.assign(n * q.k_padded, 0);
+    q.scales.resize(n);
+    parallel_for(0, n, 64, [&](size_t j0, size_t j1) {
+        for (size_t j = j0; j < j1; ++j) {
+            float max_abs = 0.0f;
+            for (size_t p = 0; p < k; ++p) max_abs = std::max(max_abs, std::abs(W[p * n + j]));
+            q.scales[j] = scale_from_max(max_abs);
+            float inv = 1.0f / q.scales[j];
+            int8_t* row = q.data.data() + j * q.k_padded;
+            for (size_t p = 0; p < k; ++p) row[p] = quantize_value(W[p * n + j], inv);
+        }
+    });
+    return q;
+}
+
+QuantizedMatrix quantize_activations(const Tensor& x, float scale) {
+    MINIDL_PROFILE_OP("quantize_activations", elementwise_cost({&x}, 2), &x);
+    check_capturable("quantize_activations");
+    if (x.shape().size() != 2) throw std::runtime_error("quantize_activations expects a 2D tensor");
+    size_t m = x.shape()[0], k = x.shape()[1];
+    const float* X = x.data().data();
+
+    QuantizedMatrix q;
+    q.rows = m;
+    q.cols = k;
+    q.k_padded = pad_k(k);
+    q.data.assign(m * q.k_padded, 0);
+    q.scales.resize(m);
+    parallel_for(0, m, std::max<size_t>(1, 16384 / std::max<size_t>(k, 1)), [&](size_t i0, size_t i1) {
+        for (size_t i = i0; i < i1; ++i) {
+            const float* xi = X + i * k;
+            float s = scale;
+            if (s <= 0.0f) {
+                float max_abs = 0.0f;
+                for (size_t p = 0; p < k; ++p) max_abs = std::max(max_abs, std::abs(xi[p]));
+                s = scale_from_max(max_abs);
+            }
+            q.scales[i] = s;
+            float inv = 1.0f / s;
+            int8_t* row = q.data.data() + i * q.k_padded;
+            for (size_t p = 0; p < k; ++p) row[p] = quantize_value(xi[p], inv);
+        }
+    });
+    return q;
+}
+
+Tensor dequantize(const QuantizedMatrix& q) {
+    MINIDL_PROFILE_OP_SHAPES("dequantize", dequantize_cost(q), ShapeList({{q.rows, q.cols}}));
+    check_capturable("dequantize");
+    Tensor out({q.rows, q.cols});
+    float* o = out.data().data();
+    for (size_t i = 0; i < q.rows; ++i) {
+        const int8_t* row = q.data.data() + i * q.k_padded;
+        for (size_t p = 0; p < q.cols; ++p) o[i * q.cols + p] = float(row[p]) * q.scales[i];
+    }
+    return out;
+}
+
+Tensor quantized_matmul(const Tensor& x, const QuantizedMatrix& w, const Tensor& bias, float input_scale) {
+    return quantized_matmul(quantize_activations(x, input_scale), w, bias);
+}
+
+Tensor quantized_matmul(const QuantizedMatrix& x, const QuantizedMatrix& w, const Tensor& bias) {
+    MINIDL_PROFILE_OP_SHAPES("quantized_matmul", quantized_gemm_cost(x, w, 4),
+                             ShapeList({{x.rows, x.cols}, {w.rows, w.cols}}));
+    check_capturable("quantized_matmul");
+    check_quantized_operands(x, w);
+    Tensor out({x.rows, w.rows});
+    qgemm_s8_dequant(x.rows, w.rows, x.k_padded,
+                     x.data.data(), x.k_padded, x.scales.data(),
+                     w.data.data(), w.k_padded, w.scales.data(),
+                     bias_ptr(bias, w.rows), out.data().data(), w.rows);
+    return out;
+}
+
+QuantizedMatrix quantized_matmul_requant(const QuantizedMatrix& x, const QuantizedMatrix& w,
+                                         const Tensor& bias, float output_scale) {
+    MINIDL_PROFILE_OP_SHAPES("quantized_matmul_requant", quantized_gemm_cost(x, w, 1),
+                             ShapeList({{x.rows, x.cols}, {w.rows, w.cols}}));
+    check_capturable("quantized_matmul_requant");
+    check_quantized_operands(x, w);
+    if (output_scale <= 0.0f) throw std::runtime_error("quantized_matmul_requant needs a positive output scale");
+    QuantizedMatrix out;
+    out.rows = x.rows;
+    out.cols = w.rows;
+    out.k_padded = pad_k(w.rows);
+    out.data.assign(out.rows * out.k_padded, 0);
+    out.scales.assign(out.rows, output_scale);
+    qgemm_s8_requant(x.rows, w.rows, x.k_padded,
+                     x.data.data(), x.k_padded, x.scales.data(),
+                     w.data.data(), w.k_padded, w.scales.data(),
+                     bias_ptr(bias, w.rows), output_scale, out.data.data(), out.k_padded);
+    return out;
+}
+
+// ---------------- 归一化 ----------------
+
+namespace {
+
+// 每块大约处理这么多个元素再切给下一个线程
+constexpr size_t kNormGrainElems = 16384;
+
+// 校验 [.., D] 与 gamma/beta [D]，返回行数
+size_t norm_rows(const Tensor& x, const Tensor& gamma, const Tensor* beta) {
+    if (x.shape().empty()) throw std::runtime_error("norm expects at least 1D input");
+    size_t d = x.shape().back();
+    if (gamma.numel() != d || (beta && beta->numel() != d)) {
+        throw std::runtime_error("norm weight shape mismatch");
+    }
+    return d == 0 ? 0 : x.numel() / d;
+}
+
+// 单遍 Welford：一次读完一行得到 mean 与 (biased) var
+inline void welford(const float* p, size_t n, size_t stride, double& mean, double& var) {
+    double m = 0.0, m2 = 0.0;
+    for (size_t j = 0; j < n; ++j) {
+        double v = p[j * stride];
+        double d = v - m;
+        m += d / static_cast<double>(j + 1);
+        m2 += d * (v - m);
+    }
+    mean = m;
+    var = n ? m2 / static_cast<double>(n) : 0.0;
+}
+
+} // namespace
+
+namespace {
+
+// 逐行归一化写入 out；mean / rstd 非空时同时保存每行统计量供反向使用
+void layer_norm_rows(const Tensor& x, const Tensor& gamma, const Tensor& beta, float eps,
+                     Tensor& out, float* mean, float* rstd) {
+    size_t d = x.shape().back();
+    size_t rows = d == 0 ? 0 : x.numel() / d;
+    const float* X = x.data().data();
+    const float* G = gamma.data().data();
+    const float* B = beta.data().data();
+    float* Y = out.data().data();
+
+    parallel_for(0, rows, std::max<size_t>(1, kNormGrainElems / std::max<size_t>(d, 1)),
+                 [&](size_t r0, size_t r1) {
+        for (size_t r = r0; r < r1; ++r) {
+            const float* xr = X + r * d;
+            double m, v;
+            welford(xr, d, 1, m, v);
+            float mu = static_cast<float>(m);
+            float rs = static_cast<float>(1.0 / std::sqrt(v + eps));
+            if (mean) mean[r] = mu;
+            if (rstd) rstd[r] = rs;
+            float* yr = Y + r * d;
+            for (size_t j = 0; j < d; ++j) yr[j] = (xr[j] - mu) * rs * G[j] + B[j];
+        }
+    });
+}
+
+void rms_norm_rows(const Tensor& x, const Tensor& gamma, float eps, Tensor& out, float* rstd) {
+    size_t d = x.shape().back();
+    size_t rows = d == 0 ? 0 : x.numel() / d;
+    const float* X = x.data().data();
+    const float* G = gamma.data().data();
+    float* Y = out.data().data();
+
+    parallel_for(0, rows, std::max<size_t>(1, kNormGrainElems / std::max<size_t>(d, 1)),
+                 [&](size_t r0, size_t r1) {
+        for (size_t r = r0; r < r1; ++r) {
+            const float* xr = X + r * d;
+            double ss = 0.0;
+            for (size_t j = 0; j < d; ++j) ss += static_cast<double>(xr[j]) * xr[j];
+            float rs = static_cast<float>(1.0 / std::sqrt(ss / d + eps));
+            if (rstd) rstd[r] = rs;
+            float* yr = Y + r * d;
+            for (size_t j = 0; j < d; ++j) yr[j] = xr[j] * rs * G[j];
+        }
+    });
+}
+
+} // namespace
+
+Tensor layer_norm(const Tensor& x, const Tensor& gamma, const Tensor& beta, float eps) {
+    MINIDL_PROFILE_OP("layer_norm", elementwise_cost({&x, &gamma, &beta}, 8), &x, &gamma, &beta);
+    size_t rows = norm_rows(x, gamma, &beta);
+    Tensor out(x.shape());
+
+    std::vector<float> mean(rows), rstd(rows);
+    layer_norm_rows(x, gamma, beta, eps, out, mean.data(), rstd.data());
+
+    if (any_requires_grad(x, gamma, beta)) {
+        out.set_requires_grad(true);
+        out.set_grad_fn(new LayerNormGradFn(x, gamma, beta, std::move(mean), std::move(rstd)));
+    }
+    // 重放时把统计量直接写回 GradFn，反向用的是本次前向的 mean / rstd
+    record_op(OpKind::LayerNorm, {x, gamma, beta}, out, [x, gamma, beta, eps, out]() mutable {
+        auto* fn = static_cast<LayerNormGradFn*>(out.grad_fn());
+        layer_norm_rows(x, gamma, beta, eps, out, fn ? fn->mean_.data() : nullptr,
+                        fn ? fn->rstd_.data() : nullptr);
+    }, eps);
+    return out;
+}
+
+Tensor rms_norm(const Tensor& x, const Tensor& gamma, float eps) {
+    MINIDL_PROFILE_OP("rms_norm", elementwise_cost({&x, &gamma}, 6), &x, &gamma);
+    size_t rows = norm_rows(x, gamma, nullptr);
+    Tensor out(x.shape());
+
+    std::vector<float> rstd(rows);
+    rms_norm_rows(x, gamma, eps, out, rstd.data());
+
+    if (any_requires_grad(x, gamma)) {
+        out.set_requires_grad(true);
+        out.set_grad_fn(new RMSNormGradFn(x, gamma, std::move(rstd)));
+    }
+    record_op(OpKind::RMSNorm, {x, gamma}, out, [x, gamma, eps, out]() mutable {
+        auto* fn = static_cast<RMSNormGradFn*>(out.grad_fn());
+        rms_norm_rows(x, gamma, eps, out, fn ? fn->rstd_.data() : nullptr);
+    }, eps);
+    return out;
+}
+
+Tensor batch_norm(const Tensor& x, const Tensor& gamma, const Tensor& beta,
+                  Tensor& running_mean, Tensor& running_var,
+                  bool training, float momentum, float eps) {
+    MINIDL_PROFILE_OP("batch_norm", elementwise_cost({&x}, 8), &x, &gamma, &beta);
+    check_capturable("batch_norm");
+    const auto& shape = x.shape();
+    if (shape.size() < 2) throw std::runtime_error("batch_norm expects [N, C, ...] input");
+    size_t n = shape[0], c = shape[1];
+    size_t l = 1;
+    for (size_t i = 2; i < shape.size(); ++i) l *= shape[i];
+    if (gamma.numel() != c || beta.numel() != c ||
+        running_mean.numel() != c || running_var.numel() != c) {
+        throw std::runtime_error("batch_norm weight shape mismatch");
+    }
+
+    Tensor out(shape);
+    std::vector<float> mean(c), rstd(c);
+    const float* X = x.data().data();
+    const float* G = gamma.data().data();
+    const float* B = beta.data().data();
+    float* RM = running_mean.data().data();
+    float* RV = running_var.data().data();
+    float* Y = out.data().data();
+    size_t m = n * l;
+
+    parallel_for(0, c, std::max<size_t>(1, kNormGrainElems / std::max<size_t>(m, 1)),
+                 [&](size_t c0, size_t c1) {
+        for (size_t ch = c0; ch < c1; ++ch) {
+            float mu, rs;
+            if (training) {
+                // 跨 N 个 [C, L] 块做 Welford，逐块合并
+                double cm = 0.0, cm2 = 0.0;
+                size_t cnt = 0;
+                for (size_t b = 0; b < n; ++b) {
+                    double bm, bv;
+                    welford(X + (b * c + ch) * l, l, 1, bm, bv);
+                    size_t tot = cnt + l;
+                    double delta = bm - cm;
+                    cm += delta * l / tot;
+                    cm2 += bv * l + delta * delta * static_cast<double>(cnt) * l / tot;
+                    cnt = tot;
+                }
+                double var = m ? cm2 / m : 0.0;
+                mu = static_cast<float>(cm);
+                rs = static_cast<float>(1.0 / std::sqrt(var + eps));
+                double unbiased = m > 1 ? cm2 / (m - 1) : var;
+                RM[ch] = (1.0f - momentum) * RM[ch] + momentum * mu;
+                RV[ch] = (1.0f - momentum) * RV[ch] + momentum * static_cast<float>(unbiased);
+            } else {
+                mu = RM[ch];
+                rs = 1.0f / std::sqrt(RV[ch] + eps);
+            }
+            mean[ch] = mu;
+            rstd[ch] = rs;
+
+            float scale = rs * G[ch];
+            float shift = B[ch] - mu * scale;
+            for (size_t b = 0; b < n; ++b) {
+                const float* xp = X + (b * c + ch) * l;
+                float* yp = Y + (b * c + ch) * l;
+                for (size_t j = 0; j < l; ++j) yp[j] = xp[j] * scale + shift;
+            }
+        }
+    });
+
+    if (any_requires_grad(x, gamma, beta)) {
+        out.set_requires_grad(true);
+        out.set_grad_fn(new BatchNormGradFn(x, gamma, beta, std::move(mean), std::move(rstd), training));
+    }
+    return out;
+}
+
+// ---------------- Embedding ----------------
+
+namespace {
+
+void check_embedding(const Tensor& weight, const std::vector<size_t>& indices) {
+    if (weight.shape().size() != 2) throw std::runtime_error("embedding weight must be 2D");
+    size_t rows = weight.shape()[0];
+    for (size_t idx : indices) {
+        if (idx >= rows) throw std::runtime_error("embedding index out of range");
+    }
+}
+
+// bag 必须恰好覆盖全部 indices：从 0 开始、单调不减、不越过末尾。
+// 反向按同样的划分把 grad_out 的行分给每个位置，有位置落在 bag 之外会读错行或越界
+void check_bag_offsets(const std::vector<size_t>& indices, const std::vector<size_t>& offsets) {
+    if (offsets.empty()) {
+        if (!indices.empty()) throw std::runtime_error("embedding_bag offsets must not be empty when indices are given");
+        return;
+    }
+    if (offsets[0] != 0) throw std::runtime_error("embedding_bag offsets[0] must be 0");
+    for (size_t b = 0; b < offsets.size(); ++b) {
+        size_t end = b + 1 < offsets.size() ? offsets[b + 1] : indices.size();
+        if (offsets[b] > end) {
+            throw std::runtime_error("embedding_bag offsets must be non-decreasing and not exceed indices.size()");
+        }
+    }
+}
+
+} // namespace
+
+Tensor embedding(const Tensor& weight, const std::vector<size_t>& indices) {
+    MINIDL_PROFILE_OP("embedding", gather_cost(weight, indices.size()), &weight);
+    check_capturable("embedding");
+    check_embedding(weight, indices);
+    size_t d = weight.shape()[1];
+    Tensor out({indices.size(), d});
+    const float* W = weight.data().data();
+    float* Y = out.data().data();
+
+    parallel_for(0, indices.size(), std::max<size_t>(1, 16384 / std::max<size_t>(d, 1)),
+                 [&](size_t i0, size_t i1) {
+        for (size_t i = i0; i < i1; ++i) {
+            std::copy(W + indices[i] * d, W + (indices[i] + 1) * d, Y + i * d);
+        }
+    });
+
+    if (any_requires_grad(weight)) {
+        out.set_requires_grad(true);
+        out.set_grad_fn(new EmbeddingGradFn(weight, indices, {}, false));
+    }
+    return out;
+}
+
+namespace {
+
+// Int32 / Int64 / UInt8 下标张量 -> size_t 下标，负数报错
+std::vector<size_t> to_indices(const Tensor& t) {
+    if (is_floating_point(t.dtype())) throw std::runtime_error("Index tensor must have an integer dtype");
+    std::vector<size_t> out(t.numel());
+    MINIDL_DISPATCH_ALL_TYPES(t.dtype(), "to_indices", [&] {
+        const scalar_t* p = t.data_ptr<scalar_t>();
+        for (size_t i = 0; i < out.size(); ++i) {
+            if (p[i] < scalar_t(0)) throw std::runtime_error("Negative index");
+            out[i] = static_cast<size_t>(p[i]);
+        }
+    });
+    return out;
+}
+
+} // namespace
+
+Tensor embedding(const Tensor& weight, const Tensor& indices) {
+    return embedding(weight, to_indices(indices));
+}
+
+Tensor embedding_bag(const Tensor& weight, const Tensor& indices, const Tensor& offsets, BagMode mode) {
+    return embedding_bag(weight, to_indices(indices), to_indices(offsets), mode);
+}
+
+Tensor embedding_bag(const Tensor& weight, const std::vector<size_t>& indices,
+                     const std::vector<size_t>& offsets, BagMode mode) {
+    MINIDL_PROFILE_OP("embedding_bag", gather_cost(weight, indices.size()), &weight);
+    check_capturable("embedding_bag");
+    check_embedding(weight, indices);
+    check_bag_offsets(indices, offsets);
+    size_t d = weight.shape()[1];
+    size_t nbags = offsets.size();
+    Tensor out({nbags, d});
+    const float* W = weight.data().data();
+    float* Y = out.data().data();
+
+    parallel_for(0, nbags, std::max<size_t>(1, 4096 / std::max<size_t>(d, 1)), [&](size_t b0, size_t b1) {
+        for (size_t b = b0; b < b1; ++b) {
+            size_t s0 = offsets[b];
+            size_t s1 = b + 1 < nbags ? offsets[b + 1] : indices.size();
+            float* yr = Y + b * d;
+            for (size_t p = s0; p < s1; ++p) {
+                const float* wr = W + indices[p] * d;
+                for (size_t j = 0; j < d; ++j) yr[j] += wr[j];
+            }
+            if (mode == BagMode::Mean && s1 > s0) {
+                float inv = 1.0f / static_cast<float>(s1 - s0);
+                for (size_t j = 0; j < d; ++j) yr[j] *= inv;
+            }
+        }
+    });
+
+    if (any_requires_grad(weight)) {
+        out.set_requires_grad(true);
+        out.set_grad_fn(new EmbeddingGradFn(weight, indices, offsets, mode == BagMode::Mean));
+    }
+    return out;
+}
+
+// ---------------- 循环网络 ----------------
+
+namespace {
+
+inline float sigmoidf(float v) { return 1.0f / (1.0f + std::exp(-v)); }
+
+// 取 src 扁平内存 [offset, offset + numel(shape)) 的零拷贝视图，反向经 SliceGradFn 回到 src
+Tensor slice_view(const Tensor& src, size_t offset, const std::vector<size_t>& shape) {
+    MINIDL_PROFILE_OP("slice_view", OpCost{}, &src); // 零拷贝
+    size_t n = 1;
+    for (auto d : shape) n *= d;
+    Storage view = Storage::view(const_cast<float*>(src.data().data()) + offset, n, src.data().owner());
+    Tensor out(shape, std::move(view));
+    if (any_requires_grad(src)) {
+        out.set_requires_grad(true);
+        out.set_grad_fn(new SliceGradFn(src, offset));
+    }
+    return out;
+}
+
+void check_rnn(const Tensor& x, size_t t, size_t b, size_t in, const Tensor& h0, const Tensor& w_ih,
+               const Tensor& w_hh, size_t gates, size_t& hidden) {
+    if (w_hh.shape().size() != 2 || w_ih.shape().size() != 2) {
+        throw std::runtime_error("rnn weights must be 2D");
+    }
+    hidden = w_hh.shape()[0];
+    if (w_hh.shape()[1] != gates * hidden || w_ih.shape()[0] != in || w_ih.shape()[1] != gates * hidden) {
+        throw std::runtime_error("rnn weight shape mismatch");
+    }
+    if (h0.numel() != b * hidden || x.numel() != t * b * in) {
+        throw std::runtime_error("rnn state shape mismatch");
+    }
+}
 
-    const auto& src = t.data();
-    auto& dst = out.data();
+// LSTM 前向核心：x 视为 [T, B, I]，返回挂着 LSTMGradFn 的 [T+1, B, H] 张量
+Tensor lstm_forward(const Tensor& x, size_t T, size_t B, size_t I, const Tensor& h0, const Tensor& c0,
+                    const Tensor& w_ih, const Tensor& w_hh, const Tensor& bias) {
+    size_t H;
+    check_rnn(x, T, B, I, h0, w_ih, w_hh, 4, H);
+    if (c0.numel() != B * H || bias.numel() != 4 * H) throw std::runtime_error("lstm shape mismatch");
+    size_t G = 4 * H;
+
+    // 1. 全部时间步的输入投影：一次 [T*B, I] x [I, 4H] GEMM
+    Storage acts(T * B * G);
+    sgemm(false, false, T * B, G, I, 1.0f, x.data().data(), I, w_ih.data().data(), G,
+          0.0f, acts.data(), G);
+
+    Storage cs((T + 1) * B * H);
+    std::copy(c0.data().begin(), c0.data().end(), cs.data());
+    Tensor hc({T + 1, B, H});
+    float* out = hc.data().data();
+    const float* bs = bias.data().data();
+    const float* Whh = w_hh.data().data();
+
+    for (size_t t = 0; t < T; ++t) {
+        const float* h_prev = t == 0 ? h0.data().data() : out + (t - 1) * B * H;
+        float* at = acts.data() + t * B * G;
+        // 2. 循环部分：gates += h_{t-1} W_hh
+        sgemm(false, false, B, G, H, 1.0f, h_prev, H, Whh, G, 1.0f, at, G);
+
+        // 3. 一遍完成四个门的非线性、c_t 与 h_t
+        const float* c_prev = cs.data() + t * B * H;
+        float* c_t = cs.data() + (t + 1) * B * H;
+        float* h_t = out + t * B * H;
+        parallel_for(0, B, std::max<size_t>(1, 4096 / G), [&](size_t b0, size_t b1) {
+            for (size_t b = b0; b < b1; ++b) {
+                float* a = at + b * G;
+                for (size_t j = 0; j < H; ++j) {
+                    float ig = sigmoidf(a[j] + bs[j]);
+                    float fg = sigmoidf(a[H + j] + bs[H + j]);
+                    float gg = std::tanh(a[2 * H + j] + bs[2 * H + j]);
+                    float og = sigmoidf(a[3 * H + j] + bs[3 * H + j]);
+                    a[j] = ig; a[H + j] = fg; a[2 * H + j] = gg; a[3 * H + j] = og;
+                    float cv = fg * c_prev[b * H + j] + ig * gg;
+                    c_t[b * H + j] = cv;
+                    h_t[b * H + j] = og * std::tanh(cv);
+                }
+            }
+        });
+    }
+    std::copy(cs.data() + T * B * H, cs.data() + (T + 1) * B * H, out + T * B * H);
+
+    if (any_requires_grad(x, h0, c0, w_ih, w_hh, bias)) {
+        Storage hs(T * B * H);
+        std::copy(out, out + T * B * H, hs.data());
+        hc.set_requires_grad(true);
+        hc.set_grad_fn(new LSTMGradFn(x, h0, c0, w_ih, w_hh, bias, std::move(acts), std::move(cs),
+                                      std::move(hs), T, B, I, H));
+    }
+    return hc;
+}
+
+// GRU 前向核心：x 视为 [T, B, I]，返回 [T, B, H]
+Tensor gru_forward(const Tensor& x, size_t T, size_t B, size_t I, const Tensor& h0,
+                   const Tensor& w_ih, const Tensor& w_hh, const Tensor& b_ih, const Tensor& b_hh) {
+    size_t H;
+    check_rnn(x, T, B, I, h0, w_ih, w_hh, 3, H);
+    if (b_ih.numel() != 3 * H || b_hh.numel() != 3 * H) throw std::runtime_error("gru shape mismatch");
+    size_t G = 3 * H;
+
+    Storage gx(T * B * G);
+    sgemm(false, false, T * B, G, I, 1.0f, x.data().data(), I, w_ih.data().data(), G,
+          0.0f, gx.data(), G);
+
+    Storage acts(T * B * 4 * H); // r, z, n, hn
+    Storage gh(B * G);
+    Tensor out({T, B, H});
+    float* Y = out.data().data();
+    const float* bi = b_ih.data().data();
+    const float* bh = b_hh.data().data();
+
+    for (size_t t = 0; t < T; ++t) {
+        const float* h_prev = t == 0 ? h0.data().data() : Y + (t - 1) * B * H;
+        sgemm(false, false, B, G, H, 1.0f, h_prev, H, w_hh.data().data(), G, 0.0f, gh.data(), G);
+
+        const float* gxt = gx.data() + t * B * G;
+        float* at = acts.data() + t * B * 4 * H;
+        float* h_t = Y + t * B * H;
+        parallel_for(0, B, std::max<size_t>(1, 4096 / G), [&](size_t b0, size_t b1) {
+            for (size_t b = b0; b < b1; ++b) {
+                const float* xi = gxt + b * G;
+                const float* hi = gh.data() + b * G;
+                float* a = at + b * 4 * H;
+                for (size_t j = 0; j < H; ++j) {
+                    float r = sigmoidf(xi[j] + bi[j] + hi[j] + bh[j]);
+                    float z = sigmoidf(xi[H + j] + bi[H + j] + hi[H + j] + bh[H + j]);
+                    float hn = hi[2 * H + j] + bh[2 * H + j];
+                    float nv = std::tanh(xi[2 * H + j] + bi[2 * H + j] + r * hn);
+                    a[j] = r; a[H + j] = z; a[2 * H + j] = nv; a[3 * H + j] = hn;
+                    h_t[b * H + j] = (1.0f - z) * nv + z * h_prev[b * H + j];
+                }
+            }
+        });
+    }
 
-    for (size_t i = 0; i < m; ++i) {
-        for (size_t j = 0; j < n; ++j) {
-            dst[j * m + i] = src[i * n + j];
+    if (any_requires_grad(x, h0, w_ih, w_hh, b_ih, b_hh)) {
+        Storage hs(T * B * H);
+        std::copy(Y, Y + T * B * H, hs.data());
+        out.set_requires_grad(true);
+        out.set_grad_fn(new GRUGradFn(x, h0, w_ih, w_hh, b_ih, b_hh, std::move(acts), std::move(hs),
+                                      T, B, I, H));
+    }
+    return out;
+}
+
+} // namespace
+
+std::pair<Tensor, Tensor> lstm(const Tensor& x, const Tensor& h0, const Tensor& c0,
+                               const Tensor& w_ih, const Tensor& w_hh, const Tensor& bias) {
+    MINIDL_PROFILE_OP("lstm", recurrent_cost(x, w_ih, w_hh), &x, &h0, &c0, &w_ih, &w_hh, &bias);
+    check_capturable("lstm");
+    if (x.shape().size() != 3) throw std::runtime_error("lstm expects [T, B, I] input");
+    size_t T = x.shape()[0], B = x.shape()[1];
+    Tensor hc = lstm_forward(x, T, B, x.shape()[2], h0, c0, w_ih, w_hh, bias);
+    size_t H = hc.shape()[2];
+    return {slice_view(hc, 0, {T, B, H}), slice_view(hc, T * B * H, {B, H})};
+}
+
+std::pair<Tensor, Tensor> lstm_cell(const Tensor& x, const Tensor& h, const Tensor& c,
+                                    const Tensor& w_ih, const Tensor& w_hh, const Tensor& bias) {
+    MINIDL_PROFILE_OP("lstm_cell", recurrent_cost(x, w_ih, w_hh), &x, &h, &c, &w_ih, &w_hh, &bias);
+    check_capturable("lstm_cell");
+    if (x.shape().size() != 2) throw std::runtime_error("lstm_cell expects [B, I] input");
+    size_t B = x.shape()[0];
+    Tensor hc = lstm_forward(x, 1, B, x.shape()[1], h, c, w_ih, w_hh, bias);
+    size_t H = hc.shape()[2];
+    return {slice_view(hc, 0, {B, H}), slice_view(hc, B * H, {B, H})};
+}
+
+Tensor gru(const Tensor& x, const Tensor& h0, const Tensor& w_ih, const Tensor& w_hh,
+           const Tensor& b_ih, const Tensor& b_hh) {
+    check_capturable("gru");
+    MINIDL_PROFILE_OP("gru", recurrent_cost(x, w_ih, w_hh), &x, &h0, &w_ih, &w_hh, &b_ih, &b_hh);
+    if (x.shape().size() != 3) throw std::runtime_error("gru expects [T, B, I] input");
+    return gru_forward(x, x.shape()[0], x.shape()[1], x.shape()[2], h0, w_ih, w_hh, b_ih, b_hh);
+}
+
+Tensor gru_cell(const Tensor& x, const Tensor& h, const Tensor& w_ih, const Tensor& w_hh,
+                const Tensor& b_ih, const Tensor& b_hh) {
+    check_capturable("gru_cell");
+    MINIDL_PROFILE_OP("gru_cell", recurrent_cost(x, w_ih, w_hh), &x, &h, &w_ih, &w_hh, &b_ih, &b_hh);
+    if (x.shape().size() != 2) throw std::runtime_error("gru_cell expects [B, I] input");
+    size_t B = x.shape()[0];
+    Tensor out = gru_forward(x, 1, B, x.shape()[1], h, w_ih, w_hh, b_ih, b_hh);
+    out.reshape({B, out.shape()[2]});
+    return out;
+}
+
+// ---------------- 注意力 ----------------
+
+namespace {
+
+// 分块大小：一个 [kAttnBlockQ, kAttnBlockK] 分数块加上对应的 Q/K/V 行能放进 L1/L2
+constexpr size_t kAttnBlockQ = 64;
+constexpr size_t kAttnBlockK = 64;
+
+} // namespace
+
+Tensor scaled_dot_product_attention(const Tensor& q, const Tensor& k, const Tensor& v, bool causal) {
+    MINIDL_PROFILE_OP("scaled_dot_product_attention", attention_cost(q, k, v), &q, &k, &v);
+    check_capturable("scaled_dot_product_attention");
+    const auto& qs = q.shape();
+    const auto& ks = k.shape();
+    const auto& vs = v.shape();
+    size_t nd = qs.size();
+    if (nd < 2 || ks.size() != nd || vs.size() != nd) {
+        throw std::runtime_error("attention expects q/k/v with the same rank >= 2");
+    }
+    for (size_t i = 0; i + 2 < nd; ++i) {
+        if (ks[i] != qs[i] || vs[i] != qs[i]) throw std::runtime_error("attention batch dims mismatch");
+    }
+    size_t T = qs[nd - 2], D = qs[nd - 1];
+    size_t S = ks[nd - 2], Dv = vs[nd - 1];
+    if (ks[nd - 1] != D || vs[nd - 2] != S) throw std::runtime_error("attention shape mismatch");
+    size_t BH = 1;
+    for (size_t i = 0; i + 2 < nd; ++i) BH *= qs[i];
+
+    std::vector<size_t> out_shape(qs.begin(), qs.end() - 1);
+    out_shape.push_back(Dv);
+    Tensor out(out_shape);
+    Storage lse(BH * T);
+
+    const float scale = 1.0f / std::sqrt(static_cast<float>(D));
+    const float* Q = q.data().data();
+    const float* K = k.data().data();
+    const float* V = v.data().data();
+    float* O = out.data().data();
+    size_t nq = (T + kAttnBlockQ - 1) / kAttnBlockQ;
+
+    // 每个任务处理一个 (bh, query 块)：遍历 K/V 块，维护每行的 running max m 与分母 l
+    parallel_for(0, BH * nq, 1, [&](size_t lo, size_t hi) {
+        std::vector<float> s(kAttnBlockQ * kAttnBlockK), m(kAttnBlockQ), l(kAttnBlockQ);
+        for (size_t task = lo; task < hi; ++task) {
+            size_t bh = task / nq;
+            size_t i0 = (task % nq) * kAttnBlockQ;
+            size_t i1 = std::min(T, i0 + kAttnBlockQ);
+            const float* Qb = Q + bh * T * D;
+            const float* Kb = K + bh * S * D;
+            const float* Vb = V + bh * S * Dv;
+            float* Ob = O + bh * T * Dv;
+            std::fill(m.begin(), m.end(), -INFINITY);
+            std::fill(l.begin(), l.end(), 0.0f);
+
+            size_t s_end = causal ? std::min(S, i1) : S;
+            for (size_t j0 = 0; j0 < s_end; j0 += kAttnBlockK) {
+                size_t j1 = std::min(s_end, j0 + kAttnBlockK);
+                size_t bc = j1 - j0;
+                for (size_t i = i0; i < i1; ++i) {
+                    const float* qi = Qb + i * D;
+                    float* si = s.data() + (i - i0) * kAttnBlockK;
+                    float row_max = -INFINITY;
+                    for (size_t j = j0; j < j1; ++j) {
+                        float val;
+                        if (causal && j > i) {
+                            val = -INFINITY;
+                        } else {
+                            const float* kj = Kb + j * D;
+                            float acc = 0.0f;
+                            for (size_t d = 0; d < D; ++d) acc += qi[d] * kj[d];
+                            val = acc * scale;
+                        }
+                        si[j - j0] = val;
+                        row_max = std::max(row_max, val);
+                    }
+                    // 在线 softmax：新块出现更大的 max 时把已累加的 O 与 l 一起缩放
+                    float m_old = m[i - i0];
+                    float m_new = std::max(m_old, row_max);
+                    if (m_new == -INFINITY) continue; // 整块都被 mask
+                    float corr = std::exp(m_old - m_new);
+                    float* oi = Ob + i * Dv;
+                    if (corr != 1.0f) for (size_t d = 0; d < Dv; ++d) oi[d] *= corr; // 首块 corr = 0
+                    float row_sum = 0.0f;
+                    for (size_t jj = 0; jj < bc; ++jj) {
+                        float p = std::exp(si[jj] - m_new);
+                        if (p == 0.0f) continue;
+                        row_sum += p;
+                        const float* vj = Vb + (j0 + jj) * Dv;
+                        for (size_t d = 0; d < Dv; ++d) oi[d] += p * vj[d];
+                    }
+                    l[i - i0] = l[i - i0] * corr + row_sum;
+                    m[i - i0] = m_new;
+                }
+            }
+            for (size_t i = i0; i < i1; ++i) {
+                float* oi = Ob + i * Dv;
+                float li = l[i - i0];
+                if (li == 0.0f) { // S == 0
+                    std::fill(oi, oi + Dv, 0.0f);
+                    lse[bh * T + i] = -INFINITY;
+                    continue;
+                }
+                float inv = 1.0f / li;
+                for (size_t d = 0; d < Dv; ++d) oi[d] *= inv;
+                lse[bh * T + i] = m[i - i0] + std::log(li);
+            }
         }
+    });
+
+    if (any_requires_grad(q, k, v)) {
+        out.set_requires_grad(true);
+        out.set_grad_fn(new AttentionGradFn(q, k, v, Storage(out.data()), std::move(lse),
+                                            BH, T, S, D, Dv, causal));
     }
-    
-    if (t.requires_grad()) out.set_requires_grad(true);
+    return out;
+}
+
+// ---------------- 激活重算 ----------------
 
+Tensor checkpoint(const CheckpointFn& fn, const std::vector<Tensor>& inputs) {
+    MINIDL_PROFILE_OP_SHAPES("checkpoint", OpCost{}, input_shapes(inputs));
+    check_capturable("checkpoint");
+    const size_t dropped = dropped_grad_fn_count();
+    Tensor out;
+    {
+        NoGradGuard no_grad;
+        out = fn(inputs);
+    }
+    // 片段里丢弃过反向边，说明有输入或参数需要梯度
+    if (!is_grad_enabled() || dropped_grad_fn_count() == dropped) return out;
+    for (const Tensor& t : inputs) {
+        if (&t.data() == &out.data()) throw std::runtime_error("checkpoint: fn must return a new tensor");
+    }
+    out.set_requires_grad(true);
+    out.set_grad_fn(new CheckpointGradFn(fn, inputs));
     return out;
 }
 
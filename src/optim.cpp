@@ -0,0 +1,256 @@
+#include "optim.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// 每个线程块至少处理这么多元素
+constexpr size_t kOptimGrain = 1 << 15;
+
+} // namespace
+
+// ---------------- Optimizer ----------------
+
+Optimizer::Optimizer(const std::vector<Tensor>& params) : params_(params) {
+    offsets_.reserve(params_.size() + 1);
+    offsets_.push_back(0);
+    for (auto& p : params_) {
+        if (!p.requires_grad()) {
+            throw std::runtime_error("Optimizer: parameter does not require grad");
+        }
+        total_numel_ += p.numel();
+        offsets_.push_back(total_numel_);
+    }
+}
+
+void Optimizer::zero_grad() {
+    for (auto& p : params_) p.zero_grad();
+}
+
+template <typename F>
+void Optimizer::for_each_chunk(F&& fn) {
+    parallel_for(0, total_numel_, kOptimGrain, [&](size_t lo, size_t hi) {
+        // 找到 lo 所在的参数，然后依次处理与 [lo, hi) 相交的各段
+        size_t k = std::upper_bound(offsets_.begin(), offsets_.end(), lo) - offsets_.begin() - 1;
+        for (; k < params_.size() && offsets_[k] < hi; ++k) {
+            size_t s = std::max(lo, offsets_[k]);
+            size_t e = std::min(hi, offsets_[k + 1]);
+            if (s >= e) continue;
+            auto& g = params_[k].grad();
+            if (g.empty()) continue; // 没有收到梯度的参数跳过
+            size_t local = s - offsets_[k];
+            fn(params_[k].data().data() + local, g.data() + local, s, e - s);
+        }
+    });
+}
+
+template <typename F>
+void Optimizer::for_each_touched_row(F&& fn) {
+    for (size_t k = 0; k < params_.size(); ++k) {
+        Tensor& p = params_[k];
+        if (!p.is_sparse_grad()) {
+            auto& g = p.grad();
+            if (g.empty()) continue;
+            size_t n = g.size();
+            float* pd = p.data().data();
+            const float* gd = g.data();
+            size_t base = offsets_[k];
+            parallel_for(0, n, kOptimGrain, [&](size_t lo, size_t hi) {
+                fn(pd + lo, gd + lo, base + lo, hi - lo);
+            });
+            continue;
+        }
+
+        const auto& sg = p.sparse_grad();
+        if (sg.empty()) continue;
+        size_t d = sg.row_size;
+        float* pd = p.data().data();
+        const float* gd = sg.values.data();
+        size_t base = offsets_[k];
+        parallel_for(0, sg.indices.size(), std::max<size_t>(1, kOptimGrain / std::max<size_t>(d, 1)),
+                     [&](size_t r0, size_t r1) {
+            for (size_t r = r0; r < r1; ++r) {
+                size_t row = sg.indices[r];
+                fn(pd + row * d, gd + r * d, base + row * d, d);
+            }
+        });
+    }
+}
+
+float Optimizer::grad_clip_coef() {
+    if (max_grad_norm_ <= 0.0f) return 1.0f;
+
+    // 每个参数各自求平方和再相加，参数内部按块并行
+    double total = 0.0;
+    for (auto& p : params_) {
+        const auto& g = p.is_sparse_grad() ? p.sparse_grad().values : p.grad();
+        if (g.empty()) continue;
+        const float* gp = g.data();
+        size_t n = g.size();
+        size_t nb = std::max<size_t>(1, std::min(get_num_threads(), n / kOptimGrain + 1));
+        std::vector<double> partial(nb, 0.0);
+        parallel_for(0, nb, 1, [&](size_t b0, size_t b1) {
+            for (size_t b = b0; b < b1; ++b) {
+                size_t lo = n * b / nb, hi = n * (b + 1) / nb;
+                double acc = 0.0; // float 累加在大参数集上会丢精度
+                for (size_t i = lo; i < hi; ++i) acc += static_cast<double>(gp[i]) * gp[i];
+                partial[b] = acc;
+            }
+        });
+        for (double v : partial) total += v;
+    }
+
+    last_grad_norm_ = static_cast<float>(std::sqrt(total));
+    float coef = max_grad_norm_ / (last_grad_norm_ + 1e-6f);
+    return coef < 1.0f ? coef : 1.0f;
+}
+
+// ---------------- SGD ----------------
+
+SGD::SGD(const std::vector<Tensor>& params, float lr, float momentum,
+         float weight_decay, bool nesterov, float dampening)
+    : Optimizer(params), lr(lr), momentum_(momentum), weight_decay_(weight_decay),
+      dampening_(dampening), nesterov_(nesterov) {
+    if (nesterov_ && (momentum_ <= 0.0f || dampening_ != 0.0f)) {
+        throw std::runtime_error("SGD: nesterov requires momentum > 0 and zero dampening");
+    }
+    if (momentum_ != 0.0f) momentum_buf_.assign(total_numel_, 0.0f);
+}
+
+void SGD::step() {
+    const float coef = grad_clip_coef();
+    const float rate = lr, wd = weight_decay_, mom = momentum_;
+    const float damp = step_ == 0 ? 0.0f : dampening_; // 第一步 buf 直接等于 g
+    const float keep = step_ == 0 ? 0.0f : mom;
+    const bool nesterov = nesterov_;
+    float* buf_base = momentum_buf_.data();
+
+    for_each_chunk([&](float* __restrict p, const float* __restrict g, size_t off, size_t n) {
+        if (mom == 0.0f) {
+            for (size_t i = 0; i < n; ++i) {
+                float d = g[i] * coef + wd * p[i];
+                p[i] -= rate * d;
+            }
+            return;
+        }
+        float* __restrict buf = buf_base + off;
+        if (nesterov) {
+            for (size_t i = 0; i < n; ++i) {
+                float d = g[i] * coef + wd * p[i];
+                float b = keep * buf[i] + (1.0f - damp) * d;
+                buf[i] = b;
+                p[i] -= rate * (d + mom * b);
+            }
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                float d = g[i] * coef + wd * p[i];
+                float b = keep * buf[i] + (1.0f - damp) * d;
+                buf[i] = b;
+                p[i] -= rate * b;
+            }
+        }
+    });
+    ++step_;
+}
+
+// ---------------- Adam / AdamW ----------------
+
+Adam::Adam(const std::vector<Tensor>& params, float lr, float beta1, float beta2,
+           float eps, float weight_decay, bool decoupled_weight_decay)
+    : Optimizer(params), lr(lr), beta1_(beta1), beta2_(beta2), eps_(eps),
+      weight_decay_(weight_decay), decoupled_(decoupled_weight_decay),
+      exp_avg_(total_numel_, 0.0f), exp_avg_sq_(total_numel_, 0.0f) {}
+
+void Adam::step() {
+    const float coef = grad_clip_coef();
+    ++step_;
+
+    const float b1 = beta1_, b2 = beta2_, eps = eps_;
+    const float bc1 = 1.0f - std::pow(b1, static_cast<float>(step_));
+    const float bc2 = 1.0f - std::pow(b2, static_cast<float>(step_));
+    const float step_size = lr / bc1;
+    const float inv_sqrt_bc2 = 1.0f / std::sqrt(bc2);
+    // Adam: L2 加到梯度上；AdamW: 参数直接乘 (1 - lr * wd)
+    const float l2 = decoupled_ ? 0.0f : weight_decay_;
+    const float decay = decoupled_ ? 1.0f - lr * weight_decay_ : 1.0f;
+    float* m_base = exp_avg_.data();
+    float* v_base = exp_avg_sq_.data();
+
+    for_each_chunk([&](float* __restrict p, const float* __restrict g, size_t off, size_t n) {
+        float* __restrict m = m_base + off;
+        float* __restrict v = v_base + off;
+        for (size_t i = 0; i < n; ++i) {
+            float d = g[i] * coef + l2 * p[i];
+            float mi = b1 * m[i] + (1.0f - b1) * d;
+            float vi = b2 * v[i] + (1.0f - b2) * d * d;
+            m[i] = mi;
+            v[i] = vi;
+            p[i] = p[i] * decay - step_size * mi / (std::sqrt(vi) * inv_sqrt_bc2 + eps);
+        }
+    });
+}
+
+// ---------------- 稀疏优化器 ----------------
+
+SparseSGD::SparseSGD(const std::vector<Tensor>& params, float lr) : Optimizer(params), lr(lr) {}
+
+void SparseSGD::step() {
+    const float coef = grad_clip_coef();
+    const float rate = lr * coef;
+    for_each_touched_row([&](float* __restrict p, const float* __restrict g, size_t, size_t n) {
+        for (size_t i = 0; i < n; ++i) p[i] -= rate * g[i];
+    });
+    ++step_;
+}
+
+SparseAdagrad::SparseAdagrad(const std::vector<Tensor>& params, float lr, float eps,
+                             float initial_accumulator_value)
+    : Optimizer(params), lr(lr), eps_(eps), sum_(total_numel_, initial_accumulator_value) {}
+
+void SparseAdagrad::step() {
+    const float coef = grad_clip_coef();
+    const float rate = lr, eps = eps_;
+    float* sum_base = sum_.data();
+    for_each_touched_row([&](float* __restrict p, const float* __restrict g, size_t off, size_t n) {
+        float* __restrict s = sum_base + off;
+        for (size_t i = 0; i < n; ++i) {
+            float d = g[i] * coef;
+            float si = s[i] + d * d;
+            s[i] = si;
+            p[i] -= rate * d / (std::sqrt(si) + eps);
+        }
+    });
+    ++step_;
+}
+
+SparseAdam::SparseAdam(const std::vector<Tensor>& params, float lr, float beta1, float beta2, float eps)
+    : Optimizer(params), lr(lr), beta1_(beta1), beta2_(beta2), eps_(eps),
+      exp_avg_(total_numel_, 0.0f), exp_avg_sq_(total_numel_, 0.0f) {}
+
+void SparseAdam::step() {
+    const float coef = grad_clip_coef();
+    ++step_;
+
+    const float b1 = beta1_, b2 = beta2_, eps = eps_;
+    const float bc1 = 1.0f - std::pow(b1, static_cast<float>(step_));
+    const float bc2 = 1.0f - std::pow(b2, static_cast<float>(step_));
+    const float step_size = lr / bc1;
+    const float inv_sqrt_bc2 = 1.0f / std::sqrt(bc2);
+    float* m_base = exp_avg_.data();
+    float* v_base = exp_avg_sq_.data();
+
+    for_each_touched_row([&](float* __restrict p, const float* __restrict g, size_t off, size_t n) {
+        float* __restrict m = m_base + off;
+        float* __restrict v = v_base + off;
+        for (size_t i = 0; i < n; ++i) {
+            float d = g[i] * coef;
+            float mi = b1 * m[i] + (1.0f - b1) * d;
+            float vi = b2 * v[i] + (1.0f - b2) * d * d;
+            m[i] = mi;
+            v[i] = vi;
+            p[i] -= step_size * mi / (std::sqrt(vi) * inv_sqrt_bc2 + eps);
+        }
+    });
+}
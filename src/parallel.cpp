@@ -0,0 +1,172 @@
+#include "parallel.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// 当前线程是否已经处于并行区域内（嵌套调用时串行执行）
+thread_local bool in_parallel_region = false;
+
+// 一次 parallel_for 调用对应一个 Job，多个块共享它
+struct Job {
+    const std::function<void(size_t, size_t)>* fn;
+    size_t begin, end, chunk;
+    size_t remaining{0}; // 受 mu 保护
+    std::mutex mu;
+    std::condition_variable done_cv;
+    std::exception_ptr error;
+
+    void run_chunk(size_t c) {
+        size_t lo = begin + c * chunk;
+        size_t hi = std::min(end, lo + chunk);
+        bool prev = in_parallel_region;
+        in_parallel_region = true;
+        try {
+            (*fn)(lo, hi);
+        } catch (...) {
+            std::lock_guard<std::mutex> lk(mu);
+            if (!error) error = std::current_exception();
+        }
+        in_parallel_region = prev;
+        // 递减与通知都在 mu 内完成：调用线程只有拿到 mu 并看到 remaining == 0 后才会返回并销毁 Job，
+        // 此时最后一个工作线程已经释放了 mu，不会再触碰 Job
+        std::lock_guard<std::mutex> lk(mu);
+        if (--remaining == 0) done_cv.notify_all();
+    }
+};
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t n) : num_threads_(std::max<size_t>(1, n)) {
+        for (size_t i = 1; i < num_threads_; ++i) {
+            workers_.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& w : workers_) w.join();
+    }
+
+    size_t size() const { return num_threads_; }
+
+    void run(Job& job, size_t num_chunks) {
+        job.remaining = num_chunks; // 块尚未分发，无需加锁
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            for (size_t c = 1; c < num_chunks; ++c) tasks_.push_back({&job, c});
+        }
+        cv_.notify_all();
+
+        // 调用线程执行第 0 块，然后尽量帮忙消化队列里属于自己的块
+        job.run_chunk(0);
+        while (true) {
+            Task t{nullptr, 0};
+            {
+                std::lock_guard<std::mutex> lk(mu_);
+                auto it = std::find_if(tasks_.begin(), tasks_.end(),
+                                       [&](const Task& x) { return x.job == &job; });
+                if (it != tasks_.end()) {
+                    t = *it;
+                    tasks_.erase(it);
+                }
+            }
+            if (!t.job) break;
+            t.job->run_chunk(t.chunk);
+        }
+
+        std::unique_lock<std::mutex> lk(job.mu);
+        job.done_cv.wait(lk, [&] { return job.remaining == 0; });
+    }
+
+private:
+    struct Task {
+        Job* job;
+        size_t chunk;
+    };
+
+    void worker_loop() {
+        while (true) {
+            Task t{nullptr, 0};
+            {
+                std::unique_lock<std::mutex> lk(mu_);
+                cv_.wait(lk, [&] { return stop_ || !tasks_.empty(); });
+                if (stop_ && tasks_.empty()) return;
+                t = tasks_.front();
+                tasks_.pop_front();
+            }
+            t.job->run_chunk(t.chunk);
+        }
+    }
+
+    size_t num_threads_;
+    std::vector<std::thread> workers_;
+    std::deque<Task> tasks_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool stop_{false};
+};
+
+size_t default_num_threads() {
+    if (const char* env = std::getenv("MINIDL_NUM_THREADS")) {
+        long v = std::atol(env);
+        if (v > 0) return static_cast<size_t>(v);
+    }
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw ? hw : 1;
+}
+
+std::mutex pool_mu;
+std::shared_ptr<ThreadPool> pool;
+
+std::shared_ptr<ThreadPool> get_pool() {
+    std::lock_guard<std::mutex> lk(pool_mu);
+    if (!pool) pool = std::make_shared<ThreadPool>(default_num_threads());
+    return pool;
+}
+
+} // namespace
+
+size_t get_num_threads() { return get_pool()->size(); }
+
+void set_num_threads(size_t n) {
+    std::lock_guard<std::mutex> lk(pool_mu);
+    pool = std::make_shared<ThreadPool>(n);
+}
+
+void parallel_for(size_t begin, size_t end, size_t grain,
+                  const std::function<void(size_t, size_t)>& fn) {
+    if (begin >= end) return;
+    size_t n = end - begin;
+    if (grain == 0) grain = 1;
+
+    auto p = in_parallel_region ? nullptr : get_pool();
+    if (!p || p->size() == 1 || n <= grain) {
+        fn(begin, end);
+        return;
+    }
+
+    size_t num_chunks = std::min(p->size(), (n + grain - 1) / grain);
+    Job job;
+    job.fn = &fn;
+    job.begin = begin;
+    job.end = end;
+    job.chunk = (n + num_chunks - 1) / num_chunks;
+    num_chunks = (n + job.chunk - 1) / job.chunk;
+    p->run(job, num_chunks);
+    if (job.error) std::rethrow_exception(job.error);
+}
+
+SerialRegion::SerialRegion() : saved_(in_parallel_region) { in_parallel_region = true; }
+SerialRegion::~SerialRegion() { in_parallel_region = saved_; }
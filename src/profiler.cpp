@@ -0,0 +1,275 @@
+#include "profiler.hpp"
+#include "autograd.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+thread_local Profiler* t_profiler = nullptr;
+
+namespace {
+
+thread_local ProfileScope* t_scope = nullptr; // 当前线程最内层的打开的作用域
+std::atomic<uint32_t> g_next_thread{1};
+
+uint32_t thread_index() {
+    thread_local uint32_t id = g_next_thread.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+uint64_t tensor_bytes(const Tensor* t) { return t && t->defined() ? t->data().nbytes() : 0; }
+
+// JSON 字符串转义 (名字一般是字面量，这里只处理引号、反斜杠与控制字符)
+std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+ShapeList input_shapes(const std::vector<Tensor>& inputs) {
+    ShapeList shapes;
+    shapes.reserve(inputs.size());
+    for (const Tensor& t : inputs) shapes.push_back(t.shape());
+    return shapes;
+}
+
+// ---------------- 代价估计 ----------------
+
+OpCost elementwise_cost(std::initializer_list<const Tensor*> inputs, uint64_t flops_per_elem) {
+    // 按广播规则逐维取最大值 (形状不兼容时算子自己会报错，这里不检查)
+    std::vector<size_t> out;
+    uint64_t bytes = 0;
+    size_t esize = 0;
+    for (const Tensor* t : inputs) {
+        if (!t || !t->defined()) continue;
+        const auto& s = t->shape();
+        if (s.size() > out.size()) out.insert(out.begin(), s.size() - out.size(), 1);
+        for (size_t i = 0; i < s.size(); ++i) {
+            size_t& d = out[out.size() - s.size() + i];
+            d = std::max(d, s[i]);
+        }
+        bytes += tensor_bytes(t);
+        if (esize == 0) esize = dtype_size(t->dtype());
+    }
+    uint64_t n = 1;
+    for (size_t d : out) n *= d;
+    return {n * flops_per_elem, bytes + n * esize};
+}
+
+OpCost matmul_cost(const Tensor& a, const Tensor& b) {
+    if (a.shape().empty() || b.shape().empty()) return {};
+    const uint64_t k = a.shape().back(), n = b.shape().back();
+    const uint64_t m = k ? a.numel() / k : 0;
+    return {2 * m * k * n, tensor_bytes(&a) + tensor_bytes(&b) + m * n * dtype_size(a.dtype())};
+}
+
+OpCost copy_cost(const Tensor& t) { return {0, 2 * tensor_bytes(&t)}; }
+
+OpCost gather_cost(const Tensor& table, size_t rows) {
+    if (table.shape().empty() || table.shape()[0] == 0) return {};
+    return {0, 2 * rows * (tensor_bytes(&table) / table.shape()[0])};
+}
+
+OpCost recurrent_cost(const Tensor& x, const Tensor& w_ih, const Tensor& w_hh) {
+    if (x.shape().empty() || x.shape().back() == 0 || w_hh.shape().empty()) return {};
+    const uint64_t rows = x.numel() / x.shape().back();
+    const uint64_t h = w_hh.shape()[0];
+    return {2 * rows * (w_ih.numel() + w_hh.numel()),
+            tensor_bytes(&x) + tensor_bytes(&w_ih) + tensor_bytes(&w_hh) + 2 * rows * h * dtype_size(x.dtype())};
+}
+
+OpCost attention_cost(const Tensor& q, const Tensor& k, const Tensor& v) {
+    const auto& qs = q.shape();
+    const auto& ks = k.shape();
+    const auto& vs = v.shape();
+    if (qs.size() < 2 || ks.size() < 2 || vs.empty() || qs.back() == 0) return {};
+    const uint64_t rows = q.numel() / qs.back(); // batch * heads * T
+    const uint64_t s = ks[ks.size() - 2], d = qs.back(), dv = vs.back();
+    return {2 * rows * s * (d + dv),
+            tensor_bytes(&q) + tensor_bytes(&k) + tensor_bytes(&v) + rows * dv * dtype_size(q.dtype())};
+}
+
+// ---------------- Profiler ----------------
+
+Profiler::Profiler() : start_(std::chrono::steady_clock::now()), saved_(t_profiler) { t_profiler = this; }
+
+Profiler::~Profiler() { stop(); }
+
+void Profiler::stop() {
+    if (stopped_) return;
+    stopped_ = true;
+    if (t_profiler == this) t_profiler = saved_;
+}
+
+uint64_t Profiler::now_ns() const {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+}
+
+void Profiler::add(ProfileEvent&& e) {
+    std::lock_guard<std::mutex> lk(mu_);
+    events_.push_back(std::move(e));
+}
+
+std::vector<ProfileEvent> Profiler::events() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto evs = events_;
+    // 事件在结束时入列 (子事件先于父事件)，按开始时间排序
+    std::stable_sort(evs.begin(), evs.end(),
+                     [](const ProfileEvent& a, const ProfileEvent& b) { return a.start_ns < b.start_ns; });
+    return evs;
+}
+
+std::string Profiler::chrome_trace() const {
+    std::ostringstream os;
+    os << "{\"traceEvents\":[";
+    bool first = true;
+    char buf[64];
+    for (const ProfileEvent& e : events()) {
+        if (!first) os << ",";
+        first = false;
+        os << "\n{\"name\":\"" << json_escape(e.name) << "\",\"cat\":\"" << e.category << "\",\"ph\":\"X\"";
+        std::snprintf(buf, sizeof(buf), ",\"ts\":%.3f,\"dur\":%.3f", e.start_ns / 1e3, e.dur_ns / 1e3);
+        os << buf << ",\"pid\":0,\"tid\":" << e.thread << ",\"args\":{\"shapes\":[";
+        for (size_t i = 0; i < e.input_shapes.size(); ++i) {
+            os << (i ? ",[" : "[");
+            for (size_t j = 0; j < e.input_shapes[i].size(); ++j) os << (j ? "," : "") << e.input_shapes[i][j];
+            os << "]";
+        }
+        os << "],\"flops\":" << e.flops << ",\"bytes\":" << e.bytes << "}}";
+    }
+    os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return os.str();
+}
+
+void Profiler::save_chrome_trace(const std::string& path) const {
+    std::ofstream f(path, std::ios::binary);
+    if (!f) throw std::runtime_error("Cannot open " + path);
+    f << chrome_trace();
+    if (!f) throw std::runtime_error("Cannot write " + path);
+}
+
+std::string Profiler::summary(size_t top) const {
+    struct Row {
+        std::string name;
+        uint64_t calls{0}, self_ns{0}, total_ns{0}, flops{0}, bytes{0};
+    };
+    std::map<std::string, Row> by_name;
+    uint64_t all_self = 0;
+    for (const ProfileEvent& e : events()) {
+        Row& r = by_name[e.name];
+        r.name = e.name;
+        ++r.calls;
+        r.self_ns += e.self_ns;
+        r.total_ns += e.dur_ns;
+        r.flops += e.flops;
+        r.bytes += e.bytes;
+        all_self += e.self_ns;
+    }
+    std::vector<Row> rows;
+    for (auto& kv : by_name) rows.push_back(kv.second);
+    std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.self_ns > b.self_ns; });
+    if (top > 0 && rows.size() > top) rows.resize(top);
+
+    std::ostringstream os;
+    char buf[256];
+    std::snprintf(buf, sizeof(buf), "%-28s %8s %12s %12s %7s %10s %10s %10s\n", "Name", "Calls", "Self(ms)",
+                  "Total(ms)", "Self%", "GFLOP", "MB", "GFLOP/s");
+    os << buf;
+    for (const Row& r : rows) {
+        const double self_ms = r.self_ns / 1e6, total_ms = r.total_ns / 1e6;
+        const double pct = all_self ? 100.0 * r.self_ns / all_self : 0.0;
+        // 吞吐按总时间算：FLOPs 估计包含嵌套在内的子算子
+        const double gflops = r.total_ns ? r.flops / double(r.total_ns) : 0.0;
+        std::snprintf(buf, sizeof(buf), "%-28s %8llu %12.3f %12.3f %6.1f%% %10.4f %10.3f %10.3f\n",
+                      r.name.substr(0, 28).c_str(), static_cast<unsigned long long>(r.calls), self_ms, total_ms, pct,
+                      r.flops / 1e9, r.bytes / 1e6, gflops);
+        os << buf;
+    }
+    return os.str();
+}
+
+const ProfileScope* current_profile_scope() { return t_scope; }
+
+ProfilerThreadScope::ProfilerThreadScope(Profiler& p) : saved_(t_profiler) { t_profiler = &p; }
+
+ProfilerThreadScope::~ProfilerThreadScope() { t_profiler = saved_; }
+
+// ---------------- ProfileScope ----------------
+
+void ProfileScope::begin(const char* name, std::initializer_list<const Tensor*> inputs, OpCost cost) {
+    if (!prof_) return push(name, false);
+    std::vector<std::vector<size_t>> shapes;
+    shapes.reserve(inputs.size());
+    for (const Tensor* t : inputs) shapes.push_back(t && t->defined() ? t->shape() : std::vector<size_t>{});
+    start(name, false, std::move(shapes), cost);
+}
+
+void ProfileScope::begin(const char* name, std::vector<std::vector<size_t>> input_shapes, OpCost cost) {
+    if (!prof_) return push(name, false);
+    start(name, false, std::move(input_shapes), cost);
+}
+
+void ProfileScope::begin_backward(GradFn& fn, const Tensor& out) {
+    if (!prof_) return push(fn.name(), true);
+    std::vector<std::vector<size_t>> shapes{out.shape()};
+    auto parents = fn.parents();
+    // 读 grad_out 与各输入，写各输入的梯度
+    OpCost cost{fn.flops(), out.grad().nbytes()};
+    for (Tensor* p : parents) {
+        shapes.push_back(p->defined() ? p->shape() : std::vector<size_t>{});
+        if (!p->defined()) continue;
+        cost.bytes += p->data().nbytes() + p->numel() * dtype_size(grad_dtype(p->dtype()));
+    }
+    if (cost.flops == 0) cost.flops = uint64_t(out.numel()) * parents.size();
+    start(fn.name(), true, std::move(shapes), cost);
+}
+
+void ProfileScope::push(const char* name, bool backward) {
+    name_ = name;
+    in_backward_ = backward || (t_scope && t_scope->in_backward_);
+    open_ = true;
+    parent_ = t_scope;
+    t_scope = this;
+}
+
+void ProfileScope::start(const char* name, bool backward, std::vector<std::vector<size_t>> shapes, OpCost cost) {
+    ev_ = new ProfileEvent();
+    ev_->name = name;
+    ev_->category = backward ? "backward" : "op";
+    ev_->input_shapes = std::move(shapes);
+    ev_->thread = thread_index();
+    ev_->flops = cost.flops;
+    ev_->bytes = cost.bytes;
+    push(name, backward);
+    ev_->start_ns = prof_->now_ns(); // 最后取时间，不把上面的开销算进算子
+}
+
+void ProfileScope::end() {
+    open_ = false;
+    t_scope = parent_;
+    if (!ev_) return; // 只为内存剖析压入了名字
+    const uint64_t stop = prof_->now_ns();
+    ev_->dur_ns = stop - ev_->start_ns;
+    ev_->self_ns = ev_->dur_ns > child_ns_ ? ev_->dur_ns - child_ns_ : 0;
+    if (parent_) parent_->child_ns_ += ev_->dur_ns;
+    prof_->add(std::move(*ev_));
+    delete ev_;
+    ev_ = nullptr;
+}
@@ -0,0 +1,175 @@
+#include "records.hpp"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+constexpr char kIndexMagic[8] = {'M', 'I', 'N', 'I', 'D', 'L', 'I', 'X'};
+constexpr uint64_t kRecordAlign = 8;
+
+uint64_t align_up(uint64_t n) { return (n + kRecordAlign - 1) / kRecordAlign * kRecordAlign; }
+
+} // namespace
+
+// ---------------- RecordWriter ----------------
+
+RecordWriter::RecordWriter(const std::string& path) : path_(path) {
+    f_ = std::fopen(path.c_str(), "wb");
+    if (!f_) throw std::runtime_error("Cannot create record file " + path);
+}
+
+RecordWriter::~RecordWriter() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void RecordWriter::write(const void* data, size_t bytes) {
+    if (!f_) throw std::runtime_error("RecordWriter is closed");
+    static const char zeros[kRecordAlign] = {};
+    uint64_t len = bytes;
+    size_t pad = static_cast<size_t>(align_up(bytes) - bytes);
+    if (std::fwrite(&len, sizeof(len), 1, f_) != 1 || std::fwrite(data, 1, bytes, f_) != bytes ||
+        std::fwrite(zeros, 1, pad, f_) != pad) {
+        throw std::runtime_error("Failed to write record to " + path_);
+    }
+    offsets_.push_back(pos_);
+    pos_ += sizeof(len) + bytes + pad;
+}
+
+void RecordWriter::write(const Tensor& t) {
+    write(t.data().data(), t.numel() * sizeof(float));
+}
+
+void RecordWriter::close() {
+    if (!f_) return;
+    bool ok = std::fclose(f_) == 0;
+    f_ = nullptr;
+    FILE* idx = std::fopen((path_ + ".idx").c_str(), "wb");
+    if (!ok || !idx) throw std::runtime_error("Failed to finish record file " + path_);
+    uint64_t count = offsets_.size();
+    ok = std::fwrite(kIndexMagic, 1, sizeof(kIndexMagic), idx) == sizeof(kIndexMagic) &&
+         std::fwrite(&count, sizeof(count), 1, idx) == 1 &&
+         std::fwrite(offsets_.data(), sizeof(uint64_t), offsets_.size(), idx) == offsets_.size();
+    if (std::fclose(idx) != 0 || !ok) throw std::runtime_error("Failed to write index for " + path_);
+}
+
+// ---------------- RecordReader ----------------
+
+RecordReader::RecordReader(const std::vector<std::string>& shard_paths) {
+    starts_.push_back(0);
+    for (auto& path : shard_paths) {
+        Shard s;
+        s.data = MappedFile::open(path);
+        s.index = MappedFile::open(path + ".idx");
+        const char* p = s.index->data();
+        size_t n = s.index->size();
+        if (n < sizeof(kIndexMagic) + 8 || std::memcmp(p, kIndexMagic, sizeof(kIndexMagic)) != 0) {
+            throw std::runtime_error("Bad record index " + path + ".idx");
+        }
+        uint64_t count;
+        std::memcpy(&count, p + sizeof(kIndexMagic), sizeof(count));
+        if (count != (n - sizeof(kIndexMagic) - 8) / sizeof(uint64_t)) {
+            throw std::runtime_error("Record index size mismatch " + path + ".idx");
+        }
+        // 头部 16 字节，offset 数组 8 字节对齐
+        s.offsets = reinterpret_cast<const uint64_t*>(p + sizeof(kIndexMagic) + 8);
+        s.count = static_cast<size_t>(count);
+        starts_.push_back(starts_.back() + s.count);
+        shards_.push_back(std::move(s));
+    }
+}
+
+size_t RecordReader::shard_of(size_t i) const {
+    return static_cast<size_t>(std::upper_bound(starts_.begin(), starts_.end(), i) - starts_.begin()) - 1;
+}
+
+RecordView RecordReader::record(size_t i) const {
+    if (i >= size()) throw std::runtime_error("Record index out of range");
+    size_t sh = shard_of(i);
+    const Shard& s = shards_[sh];
+    uint64_t off = s.offsets[i - starts_[sh]];
+    size_t file_size = s.data->size();
+    uint64_t len;
+    if (off > file_size || file_size - off < sizeof(len)) throw std::runtime_error("Corrupt record offset");
+    std::memcpy(&len, s.data->data() + off, sizeof(len));
+    if (len > file_size - off - sizeof(len)) throw std::runtime_error("Corrupt record length");
+    return {s.data->data() + off + sizeof(len), static_cast<size_t>(len)};
+}
+
+Tensor RecordReader::tensor(size_t i, const std::vector<size_t>& shape) const {
+    RecordView r = record(i);
+    size_t n = 1;
+    for (auto d : shape) n *= d;
+    if (r.size != n * sizeof(float)) throw std::runtime_error("Record size does not match tensor shape");
+    size_t sh = shard_of(i);
+    float* ptr = reinterpret_cast<float*>(const_cast<char*>(r.data));
+    return Tensor(shape, Storage::view(ptr, n, shards_[sh].data));
+}
+
+void RecordReader::advise(MappedFile::Advice advice) const {
+    for (auto& s : shards_) s.data->advise(advice);
+}
+
+void RecordReader::prefetch(size_t i) const {
+    RecordView r = record(i);
+    size_t sh = shard_of(i);
+    const MappedFile& f = *shards_[sh].data;
+    f.advise(MappedFile::Advice::WillNeed, static_cast<size_t>(r.data - f.data()), r.size);
+}
+
+std::vector<size_t> RecordReader::order(bool shuffle, uint64_t seed, uint64_t epoch) const {
+    std::vector<size_t> ord(size());
+    std::iota(ord.begin(), ord.end(), size_t{0});
+    if (shuffle) {
+        std::seed_seq seq{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32),
+                          static_cast<uint32_t>(epoch), static_cast<uint32_t>(epoch >> 32)};
+        std::mt19937_64 gen(seq);
+        std::shuffle(ord.begin(), ord.end(), gen);
+    }
+    return ord;
+}
+
+std::vector<size_t> RecordReader::shard_indices(size_t rank, size_t world, bool shuffle,
+                                                uint64_t seed, uint64_t epoch) const {
+    if (world == 0 || rank >= world) throw std::runtime_error("Invalid worker rank/world size");
+    std::vector<size_t> ord = order(shuffle, seed, epoch);
+    size_t per_worker = ord.size() / world;
+    std::vector<size_t> out(per_worker);
+    for (size_t k = 0; k < per_worker; ++k) out[k] = ord[k * world + rank];
+    return out;
+}
+
+// ---------------- RecordDataset ----------------
+
+RecordDataset::RecordDataset(std::shared_ptr<RecordReader> reader, std::vector<std::vector<size_t>> shapes,
+                             std::vector<size_t> indices)
+    : reader_(std::move(reader)), shapes_(std::move(shapes)), indices_(std::move(indices)) {
+    for (auto& shape : shapes_) {
+        size_t n = 1;
+        for (auto d : shape) n *= d;
+        field_numel_.push_back(n);
+        record_numel_ += n;
+    }
+    for (auto i : indices_) {
+        if (i >= reader_->size()) throw std::runtime_error("RecordDataset index out of range");
+    }
+}
+
+size_t RecordDataset::size() const {
+    return indices_.empty() ? reader_->size() : indices_.size();
+}
+
+void RecordDataset::get(size_t index, const std::vector<float*>& out) const {
+    RecordView r = reader_->record(indices_.empty() ? index : indices_[index]);
+    if (r.size != record_numel_ * sizeof(float)) throw std::runtime_error("Record size does not match sample shapes");
+    const char* p = r.data;
+    for (size_t f = 0; f < field_numel_.size(); ++f) {
+        std::memcpy(out[f], p, field_numel_[f] * sizeof(float));
+        p += field_numel_[f] * sizeof(float);
+    }
+}
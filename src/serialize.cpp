@@ -0,0 +1,217 @@
+#include "serialize.hpp"
+#include "mapped_file.hpp"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char kMagic[8] = {'M', 'I', 'N', 'I', 'D', 'L', 'C', 'K'};
+constexpr uint32_t kVersion = 1;
+constexpr uint64_t kDataAlign = 64;
+
+uint64_t align_up(uint64_t n) { return (n + kDataAlign - 1) / kDataAlign * kDataAlign; }
+
+template <typename T>
+void put(std::vector<char>& buf, T v) {
+    const char* p = reinterpret_cast<const char*>(&v);
+    buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+// 带边界检查地顺序读取 header
+struct Reader {
+    const char* p;
+    const char* end;
+
+    template <typename T>
+    T get() {
+        if (static_cast<size_t>(end - p) < sizeof(T)) throw std::runtime_error("Truncated checkpoint header");
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+    std::string str(size_t n) {
+        if (static_cast<size_t>(end - p) < n) throw std::runtime_error("Truncated checkpoint header");
+        std::string s(p, n);
+        p += n;
+        return s;
+    }
+};
+
+CkptDType to_ckpt(DType d) {
+    switch (d) {
+    case DType::Float16: return CkptDType::F16;
+    case DType::BFloat16: return CkptDType::BF16;
+    case DType::Float64: return CkptDType::F64;
+    case DType::Int32: return CkptDType::I32;
+    case DType::Int64: return CkptDType::I64;
+    case DType::UInt8: return CkptDType::U8;
+    default: return CkptDType::F32;
+    }
+}
+
+struct Entry {
+    std::string name;
+    DType dtype;
+    std::vector<size_t> shape;
+    uint64_t offset, numel;
+};
+
+// 解析 header，并检查每个张量的数据都落在文件内
+std::vector<Entry> parse_header(const char* base, size_t file_size) {
+    Reader r{base, base + file_size};
+    if (r.str(sizeof(kMagic)) != std::string(kMagic, sizeof(kMagic))) {
+        throw std::runtime_error("Not a mini_dl checkpoint");
+    }
+    if (r.get<uint32_t>() != kVersion) throw std::runtime_error("Unsupported checkpoint version");
+    uint32_t count = r.get<uint32_t>();
+    r.get<uint64_t>(); // data_offset
+
+    std::vector<Entry> entries(count);
+    for (auto& e : entries) {
+        e.name = r.str(r.get<uint32_t>());
+        switch (static_cast<CkptDType>(r.get<uint8_t>())) {
+        case CkptDType::F32: e.dtype = DType::Float32; break;
+        case CkptDType::F16: e.dtype = DType::Float16; break;
+        case CkptDType::BF16: e.dtype = DType::BFloat16; break;
+        case CkptDType::F64: e.dtype = DType::Float64; break;
+        case CkptDType::I32: e.dtype = DType::Int32; break;
+        case CkptDType::I64: e.dtype = DType::Int64; break;
+        case CkptDType::U8: e.dtype = DType::UInt8; break;
+        default: throw std::runtime_error("Unsupported checkpoint dtype for " + e.name);
+        }
+        uint32_t ndim = r.get<uint32_t>();
+        uint64_t n = 1;
+        for (uint32_t d = 0; d < ndim; ++d) {
+            e.shape.push_back(static_cast<size_t>(r.get<uint64_t>()));
+            n *= e.shape.back();
+        }
+        e.offset = r.get<uint64_t>();
+        e.numel = r.get<uint64_t>();
+        if (e.numel != n || e.offset % kDataAlign != 0 || e.offset > file_size ||
+            e.numel > (file_size - e.offset) / dtype_size(e.dtype)) {
+            throw std::runtime_error("Corrupt checkpoint entry " + e.name);
+        }
+    }
+    return entries;
+}
+
+std::vector<char> read_file(const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) throw std::runtime_error("Cannot open checkpoint " + path);
+    std::vector<char> buf;
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0) buf.insert(buf.end(), chunk, chunk + n);
+    std::fclose(f);
+    return buf;
+}
+
+} // namespace
+
+void save_tensors(const std::string& path, const NamedTensors& tensors, bool durable) {
+    // 1. 先算出 header 长度，再确定每个张量的对齐 offset
+    uint64_t header_size = sizeof(kMagic) + 4 + 4 + 8;
+    for (auto& kv : tensors) {
+        header_size += 4 + kv.first.size() + 1 + 4 + 8 * kv.second.shape().size() + 8 + 8;
+    }
+    std::vector<uint64_t> offsets;
+    uint64_t pos = align_up(header_size);
+    for (auto& kv : tensors) {
+        offsets.push_back(pos);
+        pos = align_up(pos + kv.second.data().nbytes());
+    }
+
+    std::vector<char> header(kMagic, kMagic + sizeof(kMagic));
+    put<uint32_t>(header, kVersion);
+    put<uint32_t>(header, static_cast<uint32_t>(tensors.size()));
+    put<uint64_t>(header, align_up(header_size));
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        const auto& name = tensors[i].first;
+        const Tensor& t = tensors[i].second;
+        put<uint32_t>(header, static_cast<uint32_t>(name.size()));
+        header.insert(header.end(), name.begin(), name.end());
+        put<uint8_t>(header, static_cast<uint8_t>(to_ckpt(t.dtype())));
+        put<uint32_t>(header, static_cast<uint32_t>(t.shape().size()));
+        for (auto d : t.shape()) put<uint64_t>(header, d);
+        put<uint64_t>(header, offsets[i]);
+        put<uint64_t>(header, t.numel());
+    }
+
+    // 2. header 与每段数据之间用 0 填充到 64 字节边界，数据整段写出
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) throw std::runtime_error("Cannot create checkpoint " + path);
+    static const char zeros[kDataAlign] = {};
+    bool ok = std::fwrite(header.data(), 1, header.size(), f) == header.size();
+    uint64_t written = header.size();
+    for (size_t i = 0; ok && i < tensors.size(); ++i) {
+        ok = std::fwrite(zeros, 1, offsets[i] - written, f) == offsets[i] - written;
+        size_t bytes = tensors[i].second.data().nbytes();
+        ok = ok && std::fwrite(tensors[i].second.data().raw(), 1, bytes, f) == bytes;
+        written = offsets[i] + bytes;
+    }
+#if !defined(_WIN32)
+    if (ok && durable) ok = std::fflush(f) == 0 && fsync(fileno(f)) == 0;
+#else
+    (void)durable;
+#endif
+    if (std::fclose(f) != 0 || !ok) throw std::runtime_error("Failed to write checkpoint " + path);
+}
+
+NamedTensors load_tensors(const std::string& path, bool use_mmap) {
+    NamedTensors out;
+    if (use_mmap) {
+        auto mapping = MappedFile::open(path);
+        char* base = mapping->data();
+        if (!base) throw std::runtime_error("Empty checkpoint " + path);
+        for (auto& e : parse_header(base, mapping->size())) {
+            out.emplace_back(e.name, Tensor(e.shape, Storage::view(base + e.offset, e.numel, mapping, e.dtype)));
+        }
+        return out;
+    }
+    std::vector<char> buf = read_file(path);
+    for (auto& e : parse_header(buf.data(), buf.size())) {
+        Storage s(e.numel, e.dtype);
+        std::memcpy(s.raw(), buf.data() + e.offset, s.nbytes());
+        out.emplace_back(e.name, Tensor(e.shape, std::move(s)));
+    }
+    return out;
+}
+
+void save_module(const Module& m, const std::string& path) {
+    save_tensors(path, m.named_parameters());
+}
+
+void load_module(Module& m, const std::string& path, bool strict) {
+    NamedTensors loaded = load_tensors(path, !m.is_flattened());
+    std::unordered_map<std::string, Tensor*> by_name;
+    for (auto& kv : loaded) by_name[kv.first] = &kv.second;
+
+    auto params = m.named_parameters();
+    if (strict && params.size() != loaded.size()) {
+        throw std::runtime_error("Checkpoint parameter count mismatch");
+    }
+    for (auto& kv : params) {
+        auto it = by_name.find(kv.first);
+        if (it == by_name.end()) {
+            if (strict) throw std::runtime_error("Missing parameter in checkpoint: " + kv.first);
+            continue;
+        }
+        Tensor& p = kv.second;
+        Tensor& src = *it->second;
+        if (src.shape() != p.shape()) throw std::runtime_error("Shape mismatch for parameter " + kv.first);
+        if (src.dtype() != p.dtype()) src = cast(src, p.dtype()); // 精度不同时转换，此时无法零拷贝
+        if (m.is_flattened()) {
+            p.data() = src.data(); // 写入 arena 中对应区间
+        } else {
+            p.data().rebind(std::move(src.data())); // 零拷贝：参数直接引用映射
+        }
+    }
+}
@@ -0,0 +1,301 @@
+#include "distributed.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+// ---------------- 多进程共享内存后端 ----------------
+
+namespace {
+
+constexpr uint64_t kShmMagic = 0x6d696e69646c7367ull; // "minidlsg"
+constexpr size_t kShmAlign = 64;                     // 各区域按缓存行对齐，避免 rank 之间伪共享
+constexpr size_t kRingSlots = 2;
+constexpr int kSpinLoads = 2000; // 进入 futex 睡眠前的自旋次数
+constexpr size_t kShmReduceBlock = 4096;
+
+size_t align_up(size_t n) { return (n + kShmAlign - 1) / kShmAlign * kShmAlign; }
+
+using Clock = std::chrono::steady_clock;
+
+#if defined(__linux__)
+void futex_wait(std::atomic<uint32_t>& word, uint32_t seen, Clock::duration left) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(ns / 1000000000);
+    ts.tv_nsec = static_cast<long>(ns % 1000000000);
+    // 段是跨进程共享的映射，不能用 FUTEX_PRIVATE_FLAG
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, seen, &ts, nullptr, 0);
+}
+
+void futex_wake_all(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+#else
+// 没有 futex 的平台退化为让出 CPU 轮询
+void futex_wait(std::atomic<uint32_t>&, uint32_t, Clock::duration) { std::this_thread::yield(); }
+void futex_wake_all(std::atomic<uint32_t>&) {}
+#endif
+
+// 等 word 不再等于 seen；超时抛异常
+void wait_change(std::atomic<uint32_t>& word, uint32_t seen, int timeout_ms) {
+    for (int i = 0; i < kSpinLoads; ++i) {
+        if (word.load(std::memory_order_acquire) != seen) return;
+    }
+    const auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (word.load(std::memory_order_acquire) == seen) {
+        auto left = deadline - Clock::now();
+        if (left <= Clock::duration::zero()) {
+            throw std::runtime_error("ShmGroup: timed out waiting for peers (a process may have exited)");
+        }
+        futex_wait(word, seen, left);
+    }
+}
+
+// 集合操作只支持浮点缓冲；不支持时返回错误信息
+const char* unsupported_dtype(DType dt) {
+    return dt == DType::Float32 || dt == DType::Float64 ? nullptr : "unsupported dtype";
+}
+
+// 第 r 段 [lo, hi)
+std::pair<size_t, size_t> piece_range(size_t n, size_t world, size_t r) {
+    size_t chunk = (n + world - 1) / world;
+    size_t lo = std::min(n, r * chunk);
+    return {lo, std::min(n, lo + chunk)};
+}
+
+// 把各 rank 暂存区的 [lo, hi) 按块累加进 dst (self 的暂存区)，Mean 时块内顺带缩放
+template <typename T>
+void reduce_slots(const std::vector<const char*>& srcs, size_t self, size_t lo, size_t hi, bool mean) {
+    T* dst = reinterpret_cast<T*>(const_cast<char*>(srcs[self]));
+    const T scale = T(1) / T(srcs.size());
+    for (size_t b = lo; b < hi; b += kShmReduceBlock) {
+        const size_t e = std::min(hi, b + kShmReduceBlock);
+        for (size_t q = 0; q < srcs.size(); ++q) {
+            if (q == self) continue;
+            const T* src = reinterpret_cast<const T*>(srcs[q]);
+            for (size_t i = b; i < e; ++i) dst[i] += src[i];
+        }
+        if (mean) {
+            for (size_t i = b; i < e; ++i) dst[i] *= scale;
+        }
+    }
+}
+
+} // namespace
+
+struct alignas(kShmAlign) ShmGroup::Header {
+    std::atomic<uint64_t> magic;  // rank 0 初始化完成后最后写入
+    uint64_t world;
+    uint64_t capacity;
+    std::atomic<uint32_t> attached;   // 已映射的 rank 数
+    std::atomic<uint32_t> arrived;    // 本轮 barrier 已到达的 rank 数
+    std::atomic<uint32_t> generation; // barrier 轮次，futex 等待的字
+};
+
+struct alignas(kShmAlign) ShmGroup::Meta {
+    uint64_t n{0};
+    uint64_t aux{0}; // all_gather 的输出长度 / broadcast 的 root
+    uint32_t dtype{0};
+    uint32_t invalid{0}; // 本 rank 的参数不合法，所有 rank 一起抛异常
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "ShmGroup needs address-free 32-bit atomics");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ShmGroup needs address-free 64-bit atomics");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bits");
+
+ShmGroup::ShmGroup(const std::string& name, size_t rank, size_t world_size, size_t capacity_bytes, int timeout_ms)
+    : name_(name.empty() || name[0] != '/' ? "/" + name : name), rank_(rank), world_(world_size),
+      timeout_ms_(timeout_ms) {
+    if (world_size == 0 || rank >= world_size) throw std::runtime_error("ShmGroup: rank out of range");
+    slot_bytes_ = capacity_bytes / kRingSlots / kShmAlign * kShmAlign;
+    if (slot_bytes_ < sizeof(double)) throw std::runtime_error("ShmGroup: capacity_bytes too small");
+    const size_t header_bytes = align_up(sizeof(Header));
+    const size_t meta_bytes = align_up(sizeof(Meta) * world_);
+    map_bytes_ = header_bytes + meta_bytes + world_ * kRingSlots * slot_bytes_;
+#if defined(_WIN32)
+    throw std::runtime_error("ShmGroup requires POSIX shared memory");
+#else
+    const auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms_);
+    auto map_fd = [&](int fd) {
+        void* addr = mmap(nullptr, map_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd); // 映射建立后 fd 即可关闭
+        if (addr == MAP_FAILED) throw std::runtime_error("ShmGroup: cannot mmap " + name_);
+        base_ = static_cast<char*>(addr);
+        header_ = reinterpret_cast<Header*>(base_);
+    };
+
+    if (rank_ == 0) {
+        shm_unlink(name_.c_str()); // 上次异常退出留下的同名段
+        int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) throw std::runtime_error("ShmGroup: cannot create " + name_ + ": " + std::strerror(errno));
+        if (ftruncate(fd, static_cast<off_t>(map_bytes_)) != 0) {
+            ::close(fd);
+            shm_unlink(name_.c_str());
+            throw std::runtime_error("ShmGroup: cannot size " + name_);
+        }
+        try {
+            map_fd(fd);
+        } catch (...) {
+            shm_unlink(name_.c_str());
+            throw;
+        }
+        // ftruncate 出来的页全为 0，计数器已是初值
+        header_->world = world_;
+        header_->capacity = capacity_bytes;
+        header_->magic.store(kShmMagic, std::memory_order_release);
+    } else {
+        // 等 rank 0 建好段；尺寸不符、尚未初始化或已满员 (旧段) 时都继续等
+        while (true) {
+            int fd = shm_open(name_.c_str(), O_RDWR, 0600);
+            if (fd >= 0) {
+                struct stat st;
+                if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == map_bytes_) {
+                    map_fd(fd);
+                    if (header_->magic.load(std::memory_order_acquire) == kShmMagic && header_->world == world_ &&
+                        header_->capacity == capacity_bytes &&
+                        header_->attached.load(std::memory_order_acquire) < world_) {
+                        break;
+                    }
+                    munmap(base_, map_bytes_);
+                    base_ = nullptr;
+                    header_ = nullptr;
+                } else {
+                    ::close(fd);
+                }
+            }
+            if (Clock::now() >= deadline) throw std::runtime_error("ShmGroup: timed out waiting for " + name_);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    metas_ = reinterpret_cast<Meta*>(base_ + header_bytes);
+    slots_ = base_ + header_bytes + meta_bytes;
+    header_->attached.fetch_add(1, std::memory_order_acq_rel);
+
+    try {
+        barrier();
+    } catch (...) {
+        if (rank_ == 0) shm_unlink(name_.c_str());
+        munmap(base_, map_bytes_);
+        throw;
+    }
+    // 所有 rank 都已映射，名字不再需要
+    if (rank_ == 0) shm_unlink(name_.c_str());
+#endif
+}
+
+ShmGroup::~ShmGroup() {
+#if !defined(_WIN32)
+    if (base_) munmap(base_, map_bytes_);
+#endif
+}
+
+char* ShmGroup::slot(size_t q) const { return slots_ + (q * kRingSlots + ring_) * slot_bytes_; }
+
+void ShmGroup::barrier() {
+    Header& h = *header_;
+    const uint32_t gen = h.generation.load(std::memory_order_acquire);
+    if (h.arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == world_) {
+        // 先清零再推进轮次：被唤醒的 rank 进入下一轮时一定看到 0
+        h.arrived.store(0, std::memory_order_relaxed);
+        h.generation.fetch_add(1, std::memory_order_release);
+        futex_wake_all(h.generation);
+        return;
+    }
+    wait_change(h.generation, gen, timeout_ms_);
+}
+
+void ShmGroup::publish(const Meta& m, const char* op, const char* invalid) {
+    metas_[rank_] = m;
+    metas_[rank_].invalid = invalid ? 1 : 0;
+    barrier();
+    bool same = true, any_invalid = false;
+    for (size_t q = 0; q < world_; ++q) {
+        same = same && metas_[q].n == m.n && metas_[q].dtype == m.dtype && metas_[q].aux == m.aux;
+        any_invalid = any_invalid || metas_[q].invalid;
+    }
+    if (!same || any_invalid) {
+        // 再同步一次：保证所有 rank 都读完描述后，才有 rank 能开始下一次操作并覆盖它
+        barrier();
+        if (!same) throw std::runtime_error(std::string(op) + ": buffers differ across ranks");
+        throw std::runtime_error(std::string(op) + ": " + (invalid ? invalid : "invalid buffer on another rank"));
+    }
+    // 正常路径上 publish 之后至少还有一次 barrier，下次写描述前其余 rank 已校验完
+}
+
+void ShmGroup::all_reduce(Storage& buf, ReduceOp op) {
+    publish({buf.size(), 0, static_cast<uint32_t>(buf.dtype())}, "all_reduce", unsupported_dtype(buf.dtype()));
+    const size_t esize = dtype_size(buf.dtype()), per = slot_bytes_ / esize, n = buf.size();
+    const size_t pieces = std::max<size_t>(1, (n + per - 1) / per);
+    char* data = static_cast<char*>(buf.raw());
+    std::vector<const char*> srcs(world_);
+    for (size_t p = 0; p < pieces; ++p) {
+        const size_t off = p * per, m = std::min(per, n - std::min(n, off));
+        for (size_t q = 0; q < world_; ++q) srcs[q] = slot(q);
+        // 1. 本片拷进自己的暂存格
+        std::memcpy(slot(rank_), data + off * esize, m * esize);
+        barrier();
+        // 2. reduce-scatter：归约自己负责的一段，写回自己的暂存格
+        auto own = piece_range(m, world_, rank_);
+        if (buf.dtype() == DType::Float64) reduce_slots<double>(srcs, rank_, own.first, own.second, op == ReduceOp::Mean);
+        else reduce_slots<float>(srcs, rank_, own.first, own.second, op == ReduceOp::Mean);
+        barrier();
+        // 3. all-gather：从负责者的暂存格拷回各段；下一片写另一格，无需再等
+        for (size_t q = 0; q < world_; ++q) {
+            auto r = piece_range(m, world_, q);
+            std::memcpy(data + (off + r.first) * esize, srcs[q] + r.first * esize, (r.second - r.first) * esize);
+        }
+        advance();
+    }
+}
+
+void ShmGroup::broadcast(Storage& buf, size_t root) {
+    if (root >= world_) throw std::runtime_error("broadcast: root out of range");
+    publish({buf.size(), root, static_cast<uint32_t>(buf.dtype())}, "broadcast", unsupported_dtype(buf.dtype()));
+    const size_t esize = dtype_size(buf.dtype()), per = slot_bytes_ / esize, n = buf.size();
+    const size_t pieces = std::max<size_t>(1, (n + per - 1) / per);
+    char* data = static_cast<char*>(buf.raw());
+    for (size_t p = 0; p < pieces; ++p) {
+        const size_t off = p * per, m = std::min(per, n - std::min(n, off));
+        if (rank_ == root) std::memcpy(slot(root), data + off * esize, m * esize);
+        barrier();
+        if (rank_ != root) std::memcpy(data + off * esize, slot(root), m * esize);
+        advance();
+    }
+}
+
+void ShmGroup::all_gather(const Storage& in, Storage& out) {
+    const char* invalid = unsupported_dtype(in.dtype());
+    if (out.size() != in.size() * world_ || out.dtype() != in.dtype()) {
+        invalid = "output must hold size() * input elements";
+    }
+    publish({in.size(), out.size(), static_cast<uint32_t>(in.dtype())}, "all_gather", invalid);
+    const size_t esize = dtype_size(in.dtype()), per = slot_bytes_ / esize, n = in.size();
+    const size_t pieces = std::max<size_t>(1, (n + per - 1) / per);
+    const char* src = static_cast<const char*>(in.raw());
+    char* dst = static_cast<char*>(out.raw());
+    for (size_t p = 0; p < pieces; ++p) {
+        const size_t off = p * per, m = std::min(per, n - std::min(n, off));
+        std::memcpy(slot(rank_), src + off * esize, m * esize);
+        barrier();
+        for (size_t q = 0; q < world_; ++q) std::memcpy(dst + (q * n + off) * esize, slot(q), m * esize);
+        advance();
+    }
+}
@@ -0,0 +1,186 @@
+#include "sparse.hpp"
+#include "grad_fn.hpp"
+#include "graph.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+// ---------------- CSRPattern ----------------
+
+void CSRPattern::build_transpose() const {
+    auto t = std::make_unique<CSRPattern>();
+    t->rows = cols;
+    t->cols = rows;
+    t->row_ptr.assign(cols + 1, 0);
+    for (size_t c : col_idx) ++t->row_ptr[c + 1];
+    for (size_t j = 0; j < cols; ++j) t->row_ptr[j + 1] += t->row_ptr[j];
+
+    // 按原结构的行顺序填入，转置后每行内的列 (原来的行号) 自然升序
+    std::vector<size_t> next(t->row_ptr.begin(), t->row_ptr.end() - 1);
+    t->col_idx.resize(nnz());
+    t_perm_.resize(nnz());
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t e = row_ptr[i]; e < row_ptr[i + 1]; ++e) {
+            size_t dst = next[col_idx[e]]++;
+            t->col_idx[dst] = i;
+            t_perm_[dst] = e;
+        }
+    }
+    t_ = std::move(t);
+}
+
+const CSRPattern& CSRPattern::transposed() const {
+    std::call_once(t_once_, [this] { build_transpose(); });
+    return *t_;
+}
+
+const std::vector<size_t>& CSRPattern::transpose_perm() const {
+    std::call_once(t_once_, [this] { build_transpose(); });
+    return t_perm_;
+}
+
+// ---------------- CSRMatrix ----------------
+
+CSRMatrix::CSRMatrix(std::shared_ptr<const CSRPattern> pattern, Tensor values)
+    : pattern_(std::move(pattern)), values_(std::move(values)) {
+    if (!pattern_) throw std::runtime_error("CSRMatrix needs a pattern");
+    if (values_.numel() != pattern_->nnz()) throw std::runtime_error("CSRMatrix values size mismatch");
+}
+
+CSRMatrix CSRMatrix::from_coo(size_t rows, size_t cols,
+                              const std::vector<size_t>& row, const std::vector<size_t>& col,
+                              const std::vector<float>& values, bool requires_grad) {
+    size_t n = row.size();
+    if (col.size() != n || (!values.empty() && values.size() != n)) {
+        throw std::runtime_error("from_coo: row / col / values size mismatch");
+    }
+    for (size_t e = 0; e < n; ++e) {
+        if (row[e] >= rows || col[e] >= cols) throw std::runtime_error("from_coo: index out of range");
+    }
+
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t x, size_t y) {
+        return row[x] != row[y] ? row[x] < row[y] : col[x] < col[y];
+    });
+
+    auto p = std::make_shared<CSRPattern>();
+    p->rows = rows;
+    p->cols = cols;
+    p->row_ptr.assign(rows + 1, 0);
+    std::vector<float> vals;
+    for (size_t k = 0; k < n; ++k) {
+        size_t e = order[k];
+        float v = values.empty() ? 1.0f : values[e];
+        bool dup = k > 0 && row[order[k - 1]] == row[e] && col[order[k - 1]] == col[e];
+        if (dup) {
+            vals.back() += v;
+            continue;
+        }
+        p->col_idx.push_back(col[e]);
+        vals.push_back(v);
+        ++p->row_ptr[row[e] + 1];
+    }
+    for (size_t i = 0; i < rows; ++i) p->row_ptr[i + 1] += p->row_ptr[i];
+
+    Tensor t({vals.size()}, vals, requires_grad);
+    return CSRMatrix(std::move(p), t);
+}
+
+Tensor CSRMatrix::to_dense() const {
+    const CSRPattern& p = *pattern_;
+    Tensor out({p.rows, p.cols});
+    const float* v = values_.data().data();
+    float* o = out.data().data();
+    for (size_t i = 0; i < p.rows; ++i) {
+        for (size_t e = p.row_ptr[i]; e < p.row_ptr[i + 1]; ++e) o[i * p.cols + p.col_idx[e]] += v[e];
+    }
+    return out;
+}
+
+// ---------------- 内核 ----------------
+
+namespace {
+
+// 每块大约处理这么多次乘加再切给下一个线程；按行均分时幂律图的长行会拖慢单个线程，
+// 所以块要足够小
+constexpr size_t kSparseGrainWork = 8192;
+
+size_t row_grain(const CSRPattern& p, size_t width) {
+    size_t avg = p.rows ? (p.nnz() + p.rows - 1) / p.rows : 1;
+    return std::max<size_t>(1, kSparseGrainWork / std::max<size_t>(1, avg * width));
+}
+
+} // namespace
+
+void csr_spmm(const CSRPattern& p, const float* values, const float* x, size_t f, float* out) {
+    parallel_for(0, p.rows, row_grain(p, f), [&](size_t r0, size_t r1) {
+        for (size_t i = r0; i < r1; ++i) {
+            float* __restrict oi = out + i * f;
+            std::fill(oi, oi + f, 0.0f);
+            for (size_t e = p.row_ptr[i]; e < p.row_ptr[i + 1]; ++e) {
+                float v = values[e];
+                const float* __restrict xj = x + p.col_idx[e] * f;
+                for (size_t c = 0; c < f; ++c) oi[c] += v * xj[c];
+            }
+        }
+    });
+}
+
+void csr_spmm_t(const CSRPattern& p, const float* values, const float* x, size_t f, float* out) {
+    const CSRPattern& t = p.transposed();
+    const std::vector<size_t>& perm = p.transpose_perm();
+    std::vector<float> tv(p.nnz());
+    for (size_t e = 0; e < tv.size(); ++e) tv[e] = values[perm[e]];
+    csr_spmm(t, tv.data(), x, f, out);
+}
+
+void csr_sddmm(const CSRPattern& p, const float* a, const float* b, size_t d, float* out) {
+    parallel_for(0, p.rows, row_grain(p, d), [&](size_t r0, size_t r1) {
+        for (size_t i = r0; i < r1; ++i) {
+            const float* __restrict ai = a + i * d;
+            for (size_t e = p.row_ptr[i]; e < p.row_ptr[i + 1]; ++e) {
+                const float* __restrict bj = b + p.col_idx[e] * d;
+                float acc = 0.0f;
+                for (size_t c = 0; c < d; ++c) acc += ai[c] * bj[c];
+                out[e] = acc;
+            }
+        }
+    });
+}
+
+// ---------------- 算子 ----------------
+
+Tensor spmm(const CSRMatrix& a, const Tensor& x) {
+    check_capturable("spmm");
+    if (x.shape().size() != 2 || x.shape()[0] != a.cols()) {
+        throw std::runtime_error("spmm shape mismatch");
+    }
+    size_t f = x.shape()[1];
+    Tensor out({a.rows(), f});
+    csr_spmm(*a.pattern(), a.values().data().data(), x.data().data(), f, out.data().data());
+
+    if (any_requires_grad(a.values(), x)) {
+        out.set_requires_grad(true);
+        out.set_grad_fn(new SpMMGradFn(a.pattern(), a.values(), x));
+    }
+    return out;
+}
+
+Tensor sddmm(const CSRMatrix& pattern, const Tensor& a, const Tensor& b) {
+    check_capturable("sddmm");
+    const CSRPattern& p = *pattern.pattern();
+    if (a.shape().size() != 2 || b.shape().size() != 2 || a.shape()[0] != p.rows ||
+        b.shape()[0] != p.cols || a.shape()[1] != b.shape()[1]) {
+        throw std::runtime_error("sddmm shape mismatch");
+    }
+    Tensor out({p.nnz()});
+    csr_sddmm(p, a.data().data(), b.data().data(), a.shape()[1], out.data().data());
+
+    if (any_requires_grad(a, b)) {
+        out.set_requires_grad(true);
+        out.set_grad_fn(new SDDMMGradFn(pattern.pattern(), a, b));
+    }
+    return out;
+}
@@ -0,0 +1,199 @@
+#include "storage.hpp"
+#include "memory_profiler.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr size_t kStorageAlign = 64;
+
+void* aligned_malloc(size_t bytes) {
+    bytes = (bytes + kStorageAlign - 1) / kStorageAlign * kStorageAlign;
+#if defined(_MSC_VER)
+    void* p = _aligned_malloc(bytes, kStorageAlign);
+#else
+    void* p = std::aligned_alloc(kStorageAlign, bytes);
+#endif
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void aligned_free(void* p) {
+#if defined(_MSC_VER)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+// 自有内存的删除器：内存剖析开启时先登记释放
+void free_block(void* p) {
+    if (memory_profiling_enabled()) memory_on_free(p);
+    aligned_free(p);
+}
+
+void free_vector(void* p) {
+    if (memory_profiling_enabled()) memory_on_free(p);
+    delete static_cast<std::vector<float>*>(p);
+}
+
+} // namespace
+
+// --- 构造 ---
+Storage::Storage(size_t n, float value) {
+    allocate(n);
+    std::fill(data(), data() + n, value);
+}
+
+Storage::Storage(size_t n, DType dtype) {
+    allocate(n, dtype);
+    if (n) std::memset(ptr_, 0, nbytes());
+}
+
+Storage::Storage(const std::vector<float>& v) {
+    allocate(v.size());
+    copy_from(v.data(), v.size());
+}
+
+Storage::Storage(std::vector<float>&& v) {
+    auto* holder = new std::vector<float>(std::move(v));
+    ptr_ = holder->data();
+    size_ = holder->size();
+    owner_ = std::shared_ptr<void>(holder, free_vector);
+    if (memory_profiling_enabled()) memory_on_alloc(holder, nbytes());
+}
+
+Storage::Storage(std::initializer_list<float> il) {
+    allocate(il.size());
+    copy_from(il.begin(), il.size());
+}
+
+Storage::Storage(const Storage& other) {
+    allocate(other.size_, other.dtype_);
+    copy_from(other.ptr_, other.size_);
+}
+
+Storage::Storage(Storage&& other) noexcept { rebind(std::move(other)); }
+
+Storage Storage::view(float* ptr, size_t n, std::shared_ptr<void> owner) {
+    return view(ptr, n, std::move(owner), DType::Float32);
+}
+
+Storage Storage::view(void* ptr, size_t n, std::shared_ptr<void> owner, DType dtype) {
+    Storage s;
+    s.owner_ = std::move(owner);
+    s.ptr_ = ptr;
+    s.size_ = n;
+    s.is_view_ = true;
+    s.dtype_ = dtype;
+    return s;
+}
+
+void Storage::rebind(Storage&& other) noexcept {
+    owner_ = std::move(other.owner_);
+    ptr_ = other.ptr_;
+    size_ = other.size_;
+    is_view_ = other.is_view_;
+    dtype_ = other.dtype_;
+    other.ptr_ = nullptr;
+    other.size_ = 0;
+    other.is_view_ = false;
+    other.dtype_ = DType::Float32;
+}
+
+// --- 赋值：长度与 dtype 相同则原地写入 ---
+Storage& Storage::operator=(const Storage& other) {
+    if (this == &other) return *this;
+    prepare_write(other.size_, other.dtype_);
+    copy_from(other.ptr_, other.size_);
+    return *this;
+}
+
+Storage& Storage::operator=(Storage&& other) {
+    if (this == &other) return *this;
+    if (is_view_) {
+        // 视图必须保持指向原处，只能拷贝数据
+        prepare_write(other.size_, other.dtype_);
+        copy_from(other.ptr_, other.size_);
+    } else {
+        rebind(std::move(other));
+    }
+    return *this;
+}
+
+Storage& Storage::operator=(const std::vector<float>& v) {
+    prepare_write(v.size(), DType::Float32);
+    copy_from(v.data(), v.size());
+    return *this;
+}
+
+Storage& Storage::operator=(std::initializer_list<float> il) {
+    prepare_write(il.size(), DType::Float32);
+    copy_from(il.begin(), il.size());
+    return *this;
+}
+
+void Storage::assign(size_t n, float value) {
+    prepare_write(n, DType::Float32);
+    std::fill(data(), data() + n, value);
+}
+
+void Storage::resize(size_t n, float value) {
+    if (n == size_ && dtype_ == DType::Float32) return;
+    if (is_view_) throw_view_resize(n, DType::Float32);
+    Storage bigger(n, value);
+    if (dtype_ == DType::Float32) std::memcpy(bigger.ptr_, ptr_, std::min(n, size_) * sizeof(float));
+    rebind(std::move(bigger));
+}
+
+void Storage::clear() {
+    owner_.reset();
+    ptr_ = nullptr;
+    size_ = 0;
+    is_view_ = false;
+    dtype_ = DType::Float32;
+}
+
+// --- 内部工具 ---
+void Storage::allocate(size_t n, DType dtype) {
+    size_ = n;
+    dtype_ = dtype;
+    is_view_ = false;
+    if (n == 0) {
+        owner_.reset();
+        ptr_ = nullptr;
+        return;
+    }
+    void* p = aligned_malloc(n * dtype_size(dtype));
+    owner_ = std::shared_ptr<void>(p, free_block);
+    ptr_ = p;
+    if (memory_profiling_enabled()) memory_on_alloc(p, nbytes());
+}
+
+void Storage::prepare_write(size_t n, DType dtype) {
+    if (n == size_ && dtype == dtype_) return;
+    if (is_view_) throw_view_resize(n, dtype);
+    allocate(n, dtype);
+}
+
+void Storage::copy_from(const void* src, size_t n) {
+    if (n && src != ptr_) std::memcpy(ptr_, src, n * dtype_size(dtype_));
+}
+
+void Storage::throw_not_f32() const {
+    throw std::runtime_error(std::string("Storage holds ") + dtype_name(dtype_) + ", not float32");
+}
+
+void Storage::throw_view_resize(size_t n, DType dtype) const {
+    // 重新分配会让视图悄悄脱离它指向的内存 (如参数 arena)，之后的写入不再反映到原处
+    throw std::runtime_error("Storage: cannot resize a view of " + std::to_string(size_) + " " +
+                             dtype_name(dtype_) + " elements to " + std::to_string(n) + " " + dtype_name(dtype));
+}
+
+void Storage::throw_dtype_mismatch(DType expected) const {
+    throw std::runtime_error(std::string("Storage holds ") + dtype_name(dtype_) + ", not " + dtype_name(expected));
+}
@@ -2,17 +2,38 @@
 #include "ops.hpp"
 #include "autograd.hpp"
 #include "grad_fn.hpp"
+#include "graph.hpp"
+#include "profiler.hpp"
+#include <cstring>
 #include <numeric>
 #include <algorithm>
+#include <atomic>
 #include <queue>
+#include <unordered_map>
 #include <unordered_set>
 
+namespace {
+
+// 内存剖析开启时登记新建的 TensorImpl
+inline void track_tensor(const std::shared_ptr<TensorImpl>& impl) {
+    if (memory_profiling_enabled()) memory_on_tensor_created(impl);
+}
+
+} // namespace
+
+TensorImpl::~TensorImpl() {
+    if (memory_profiling_enabled()) memory_on_tensor_destroyed(this);
+}
+
 // --- 构造函数 ---
 Tensor::Tensor(const std::vector<size_t>& shape, bool requires_grad)
-    : impl_(std::make_shared<TensorImpl>(shape, requires_grad)) {}
+    : impl_(std::make_shared<TensorImpl>(shape, requires_grad)) {
+    track_tensor(impl_);
+}
 
 Tensor::Tensor(const std::vector<size_t>& shape, float value, bool requires_grad)
     : impl_(std::make_shared<TensorImpl>(shape, requires_grad)) {
+    track_tensor(impl_);
     std::fill(impl_->data_.begin(), impl_->data_.end(), value);
 }
 
@@ -23,6 +44,7 @@ Tensor::Tensor(const std::vector<size_t>& shape, const std::vector<float>& data,
         throw std::runtime_error("Data size does not match tensor shape");
     }
     impl_->data_ = data;
+    track_tensor(impl_);
 }
 
 // 实现 2: 接收 initializer_list (支持大括号直接传值)
@@ -32,8 +54,29 @@ Tensor::Tensor(const std::vector<size_t>& shape, std::initializer_list<float> da
         throw std::runtime_error("Data size does not match tensor shape");
     }
     impl_->data_ = std::vector<float>(data);
+    track_tensor(impl_);
+}
+
+// 实现 3: 直接接管 Storage
+Tensor::Tensor(const std::vector<size_t>& shape, Storage data, bool requires_grad) {
+    size_t n = 1;
+    for (auto s : shape) n *= s;
+    if (data.size() != n) {
+        throw std::runtime_error("Data size does not match tensor shape");
+    }
+    impl_ = std::make_shared<TensorImpl>(shape, std::move(data), requires_grad);
+    track_tensor(impl_);
 }
 
+Tensor::Tensor(const std::vector<size_t>& shape, DType dtype, bool requires_grad) {
+    size_t n = 1;
+    for (auto s : shape) n *= s;
+    impl_ = std::make_shared<TensorImpl>(shape, Storage(n, dtype), requires_grad);
+    track_tensor(impl_);
+}
+
+Tensor Tensor::to(DType dtype) const { return cast(*this, dtype); }
+
 // --- 基础信息 ---
 size_t Tensor::numel() const {
     if (!impl_) return 0;
@@ -43,29 +86,160 @@ size_t Tensor::numel() const {
 }
 
 void Tensor::set_requires_grad(bool r) {
-    impl_->requires_grad_ = r;
-    if (r && impl_->grad_.empty()) {
-        impl_->grad_.assign(numel(), 0.0f);
+    if (r && !is_floating_point(dtype())) {
+        throw std::runtime_error("Only floating point tensors can require gradients");
     }
+    impl_->requires_grad_ = r;
+    if (r && !impl_->sparse_grad_ && impl_->grad_.empty()) impl_->alloc_grad();
 }
 
 void Tensor::zero_grad() {
     if (impl_ && !impl_->grad_.empty()) {
-        std::fill(impl_->grad_.begin(), impl_->grad_.end(), 0.0f);
+        std::memset(impl_->grad_.raw(), 0, impl_->grad_.nbytes());
+    }
+    if (impl_) impl_->sparse_rows_.clear();
+}
+
+void Tensor::set_sparse_grad(bool sparse) {
+    if (sparse && impl_->shape_.size() != 2) {
+        throw std::runtime_error("Sparse gradient requires a 2D tensor");
+    }
+    impl_->sparse_grad_ = sparse;
+    impl_->sparse_rows_.clear();
+    if (sparse) {
+        impl_->grad_.clear();
+    } else if (impl_->requires_grad_) {
+        impl_->grad_.assign(numel(), 0.0f);
+        if (memory_profiling_enabled()) memory_tag(impl_->grad_, MemoryKind::Grad);
     }
 }
 
 void Tensor::set_grad_fn(GradFn* fn) {
+    // 梯度模式关闭时不建图：丢弃 fn (连同它持有的输入)，输出当作不需要梯度的普通张量。
+    // 库内算子已用 any_requires_grad 提前跳过，这里兜底处理其余调用者
+    if (fn && !is_grad_enabled()) {
+        delete fn;
+        note_dropped_grad_fn();
+        impl_->requires_grad_ = false;
+        impl_->grad_.clear();
+        return;
+    }
     // 将原始指针封装进共享指针，管理其生命周期
     impl_->grad_fn_ = std::shared_ptr<GradFn>(fn);
 }
 
+namespace {
+std::atomic<size_t> g_next_grad_hook{1};
+} // namespace
+
+size_t Tensor::register_grad_hook(GradHook hook) {
+    if (impl_->grad_fn_) throw std::runtime_error("Gradient hooks can only be registered on leaf tensors");
+    size_t id = g_next_grad_hook.fetch_add(1, std::memory_order_relaxed);
+    impl_->grad_hooks_.emplace_back(id, std::move(hook));
+    return id;
+}
+
+void Tensor::remove_grad_hook(size_t id) {
+    auto& hooks = impl_->grad_hooks_;
+    hooks.erase(std::remove_if(hooks.begin(), hooks.end(), [&](const auto& h) { return h.first == id; }), hooks.end());
+}
+
 void Tensor::accumulate_grad(const std::vector<float>& g) {
+    accumulate_grad(g.data(), g.size());
+}
+
+void Tensor::accumulate_grad(const Storage& g) {
+    if (!impl_ || !impl_->requires_grad_) return;
+    if (g.dtype() == DType::Float32) {
+        accumulate_grad(g.data(), g.size());
+        return;
+    }
+    if (impl_->grad_.empty()) impl_->alloc_grad();
+    Storage& grad = impl_->grad_;
+    if (g.size() != grad.size()) throw std::runtime_error("Gradient size mismatch");
+    // 梯度类型不同时 (如 Float64 的梯度流回 Float32 输入) 先转换
+    Storage converted;
+    const Storage* src = &g;
+    if (g.dtype() != grad.dtype()) {
+        converted = Storage(g.size(), grad.dtype());
+        convert(g.raw(), g.dtype(), converted.raw(), grad.dtype(), g.size());
+        src = &converted;
+    }
+    MINIDL_DISPATCH_FLOATING_TYPES(grad.dtype(), "accumulate_grad", [&] {
+        scalar_t* dst = grad.data_ptr<scalar_t>();
+        const scalar_t* s = src->data_ptr<scalar_t>();
+        for (size_t i = 0; i < grad.size(); ++i) dst[i] += s[i];
+    });
+}
+
+void Tensor::accumulate_grad(const float* g, size_t n) {
     if (!impl_ || !impl_->requires_grad_) return;
-    if (impl_->grad_.empty()) impl_->grad_.assign(numel(), 0.0f);
-    for (size_t i = 0; i < g.size(); ++i) {
-        impl_->grad_[i] += g[i];
+    if (impl_->grad_.empty()) impl_->alloc_grad();
+    if (n != impl_->grad_.size()) throw std::runtime_error("Gradient size mismatch");
+    if (impl_->grad_.dtype() == DType::Float64) {
+        double* dst = impl_->grad_.data_ptr<double>();
+        for (size_t i = 0; i < n; ++i) dst[i] += g[i];
+        return;
+    }
+    float* dst = impl_->grad_.data();
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] += g[i];
+    }
+}
+
+void Tensor::accumulate_grad_rows(const std::vector<size_t>& rows, const Storage& values) {
+    if (!impl_ || !impl_->requires_grad_ || rows.empty()) return;
+    size_t d = impl_->shape_.back();
+    if (values.size() != rows.size() * d) throw std::runtime_error("Gradient size mismatch");
+
+    if (!impl_->sparse_grad_) {
+        if (impl_->grad_.empty()) {
+            impl_->grad_.assign(numel(), 0.0f);
+            if (memory_profiling_enabled()) memory_tag(impl_->grad_, MemoryKind::Grad);
+        }
+        float* dst = impl_->grad_.data();
+        for (size_t k = 0; k < rows.size(); ++k) {
+            float* row = dst + rows[k] * d;
+            const float* src = values.data() + k * d;
+            for (size_t j = 0; j < d; ++j) row[j] += src[j];
+        }
+        return;
+    }
+
+    auto& sg = impl_->sparse_rows_;
+    sg.row_size = d;
+    if (sg.empty()) {
+        sg.indices = rows;
+        sg.values = values;
+        return;
     }
+
+    // 两个升序行集合做一次归并，重复的行相加
+    std::vector<size_t> idx;
+    idx.reserve(sg.indices.size() + rows.size());
+    Storage merged((sg.indices.size() + rows.size()) * d);
+    const float* old_v = sg.values.data();
+    const float* new_v = values.data();
+    size_t i = 0, k = 0;
+    while (i < sg.indices.size() || k < rows.size()) {
+        float* out = merged.data() + idx.size() * d;
+        bool take_old = k == rows.size() || (i < sg.indices.size() && sg.indices[i] <= rows[k]);
+        bool take_new = i == sg.indices.size() || (k < rows.size() && rows[k] <= sg.indices[i]);
+        if (take_old && take_new) {
+            for (size_t j = 0; j < d; ++j) out[j] = old_v[i * d + j] + new_v[k * d + j];
+            idx.push_back(rows[k]);
+            ++i; ++k;
+        } else if (take_old) {
+            std::copy(old_v + i * d, old_v + (i + 1) * d, out);
+            idx.push_back(sg.indices[i++]);
+        } else {
+            std::copy(new_v + k * d, new_v + (k + 1) * d, out);
+            idx.push_back(rows[k++]);
+        }
+    }
+    merged.resize(idx.size() * d);
+    sg.indices = std::move(idx);
+    sg.values.rebind(std::move(merged));
 }
 
 // --- 索引访问 ---
@@ -116,9 +290,72 @@ void Tensor::backward() {
     if (!requires_grad()) return;
 
     // 1. 初始化种子梯度 (如果是标量或未初始化)
-    if (impl_->grad_.empty()) impl_->grad_.assign(numel(), 1.0f);
-    std::fill(impl_->grad_.begin(), impl_->grad_.end(), 1.0f);
+    if (impl_->grad_.empty()) impl_->alloc_grad();
+    MINIDL_DISPATCH_FLOATING_TYPES(impl_->grad_.dtype(), "backward", [&] {
+        scalar_t* g = impl_->grad_.data_ptr<scalar_t>();
+        std::fill(g, g + impl_->grad_.size(), scalar_t(1));
+    });
+    run_backward();
+}
+
+void Tensor::backward(const Storage& grad_out) {
+    if (!requires_grad()) return;
+    if (grad_out.size() != numel()) throw std::runtime_error("backward: gradient size mismatch");
 
+    // 种子梯度由调用方给出 (类型不同时转换成本张量的梯度类型)
+    if (impl_->grad_.empty()) impl_->alloc_grad();
+    convert(grad_out.raw(), grad_out.dtype(), impl_->grad_.raw(), impl_->grad_.dtype(), grad_out.size());
+    run_backward();
+}
+
+// 一次 run_backward 的叶子钩子状态。检查点的 GradFn 会在自己的 backward 里对重算的子图再调用
+// backward，这次嵌套的反向按当前线程的调用栈串在外层之后：依赖计数各算各的，叶子钩子统一由最外层触发。
+struct Tensor::BackwardPass {
+    explicit BackwardPass(const std::unordered_set<TensorImpl*>& g) : parent(current()), graph(g) { current() = this; }
+    ~BackwardPass() { current() = parent; }
+    BackwardPass(const BackwardPass&) = delete;
+    BackwardPass& operator=(const BackwardPass&) = delete;
+
+    static BackwardPass*& current() {
+        thread_local BackwardPass* pass = nullptr;
+        return pass;
+    }
+
+    // t 在本次反向里的梯度已累加完；还有检查点节点没执行时先扣下 (闭包捕获的参数之后还可能收到梯度)
+    void leaf_ready(Tensor& t) {
+        if (!seen.insert(t.impl_.get()).second) return;
+        if (pending_reentrant > 0) {
+            held.push_back(t);
+            return;
+        }
+        release(t);
+    }
+
+    // 本次反向不会再改动 t 的梯度：最外层直接触发钩子，嵌套的反向交给外层判断
+    void release(Tensor& t) {
+        if (parent) {
+            // 外层图里也有这个叶子时，由外层自己的计数决定何时就绪
+            if (!parent->graph.count(t.impl_.get())) parent->leaf_ready(t);
+            return;
+        }
+        auto hooks = t.impl_->grad_hooks_; // 钩子里可能移除自己
+        for (auto& h : hooks) h.second(t);
+    }
+
+    void release_held() {
+        std::vector<Tensor> ready;
+        ready.swap(held);
+        for (auto& t : ready) release(t);
+    }
+
+    BackwardPass* parent;
+    const std::unordered_set<TensorImpl*>& graph; // 本次遍历到的张量
+    size_t pending_reentrant{0};
+    std::vector<Tensor> held;
+    std::unordered_set<TensorImpl*> seen;
+};
+
+void Tensor::run_backward() {
     // 2. 拓扑排序 (DFS)
     std::vector<Tensor> topo;
     std::unordered_set<TensorImpl*> visited;
@@ -133,37 +370,56 @@ void Tensor::backward() {
         topo.push_back(t);
     };
     dfs(*this);
+    BackwardPass pass(visited);
+    for (auto& t : topo) {
+        if (t.grad_fn() && t.grad_fn()->reenters_backward()) pass.pending_reentrant++;
+    }
 
-    // 3. 计算入度 (pending count)
-    for (auto& t : topo) t.impl_->grad_pending_ = 0;
+    // 3. 计算入度 (pending count)：计数只属于这一次调用，检查点重算里嵌套的 backward 不会改动它
+    std::unordered_map<TensorImpl*, int> pending;
+    pending.reserve(topo.size());
     for (auto& t : topo) {
         if (t.grad_fn()) {
             for (auto* p_raw : t.grad_fn()->parents()) {
-                p_raw->impl_->grad_pending_++;
+                pending[p_raw->impl_.get()]++;
             }
         }
     }
 
-    // 4. 广度优先触发 (队列)
+    // 4. 广度优先触发 (队列)；录制图时记下执行顺序
     std::queue<Tensor> q;
     q.push(*this);
+    const bool capturing = is_capturing();
+    std::vector<Tensor> order;
 
     while (!q.empty()) {
         Tensor t = q.front();
         q.pop();
 
         if (t.grad_fn()) {
-            // 执行当前节点的反向传播，将梯度传给 parents
-            t.grad_fn()->backward(t.grad());
-            
+            // 执行当前节点的反向传播，将梯度传给 parents (GradFn 内部调用的算子不录制)
+            {
+                RecordingPause pause;
+                ProfileScope prof;
+                if (prof.active()) prof.begin_backward(*t.grad_fn(), t);
+                t.grad_fn()->backward(t.grad());
+            }
+            if (capturing) order.push_back(t);
+            if (t.grad_fn()->reenters_backward() && --pass.pending_reentrant == 0) pass.release_held();
+
             for (auto* p_raw : t.grad_fn()->parents()) {
-                p_raw->impl_->grad_pending_--;
-                if (p_raw->impl_->grad_pending_ == 0) {
+                if (--pending[p_raw->impl_.get()] == 0) {
                     q.push(*p_raw);
                 }
             }
+        } else if (t.impl_->requires_grad_ && !t.impl_->grad_hooks_.empty()) {
+            // 入度归零才会入队：叶子在本次遍历中的梯度此时已全部累加完毕
+            if (capturing) throw std::runtime_error("Gradient hooks are not supported during graph capture");
+            pass.leaf_ready(t);
         }
     }
+    pass.release_held();
+    if (capturing) record_backward(*this, order);
 }
 
 // --- 补充 transpose 成员函数 ---
@@ -183,6 +439,7 @@ Tensor Tensor::flatten(size_t start_dim, size_t end_dim) const {
     if (start_dim >= old_shape.size() || end_dim >= old_shape.size() || start_dim > end_dim) {
         throw std::runtime_error("Invalid flatten dimensions");
     }
+    check_capturable("flatten");
 
     std::vector<size_t> new_shape;
     // 保持 start_dim 之前的维度
@@ -198,7 +455,7 @@ Tensor Tensor::flatten(size_t start_dim, size_t end_dim) const {
 
     // 创建一个共享同一个数据的 Tensor (或者深拷贝数据)
     // 简单起见，这里创建新 Tensor 并拷贝数据
-    Tensor out(new_shape, this->requires_grad());
+    Tensor out(new_shape, this->requires_grad() && is_grad_enabled());
     out.data() = this->data(); // 拷贝数据
     return out;
 }
@@ -0,0 +1,204 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "module.hpp"
+#include "autograd.hpp"
+#include "graph.hpp"
+#include "memory_profiler.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+std::vector<float> random_values(size_t n, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> v(n);
+    for (auto& x : v) x = dist(gen);
+    return v;
+}
+
+bool all_near(const Storage& a, const Storage& b, float tol = 1e-4f) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (!near(a[i], b[i], tol)) return false;
+    }
+    return true;
+}
+
+void test_no_grad_guard() {
+    std::cout << "[Test] NoGradGuard skips graph construction..." << std::endl;
+    Tensor x({2, 3}, random_values(6, 1), true);
+    Tensor w({3, 2}, random_values(6, 2), true);
+    {
+        NoGradGuard no_grad;
+        assert(!is_grad_enabled());
+        MemoryProfiler mp;
+        const size_t dropped = dropped_grad_fn_count();
+        Tensor y = relu(matmul(x, w));
+        assert(!y.requires_grad() && y.grad_fn() == nullptr);
+        assert(!mul(x, 2.0f).requires_grad());
+        // 不分配梯度缓冲 (也不构造随即丢弃的 GradFn)，但本该建立的反向边仍被计数
+        assert(y.grad().empty());
+        for (const MemoryEvent& e : mp.timeline()) assert(e.kind != MemoryKind::Grad);
+        assert(dropped_grad_fn_count() == dropped + 1); // 只有 matmul；relu 的输入已不需要梯度
+        mp.stop();
+        {
+            GradModeGuard enable(true);
+            Tensor z = add(x, x);
+            assert(z.requires_grad() && z.grad_fn() != nullptr);
+        }
+        assert(!is_grad_enabled());
+    }
+    assert(is_grad_enabled());
+    Tensor y = matmul(x, w);
+    assert(y.requires_grad() && y.grad_fn() != nullptr);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+// 8 个 Linear + relu 的块，按 sqrt(8) 左右分段做检查点
+struct Deep {
+    std::vector<Linear> layers;
+    Deep() {
+        for (uint32_t i = 0; i < 8; ++i) layers.emplace_back(16, 16, true, i + 1);
+    }
+    Tensor block(const Tensor& h, size_t lo, size_t hi) const {
+        Tensor y = h;
+        for (size_t i = lo; i < hi; ++i) y = relu(layers[i].forward(y));
+        return y;
+    }
+};
+
+void test_checkpoint_matches_plain() {
+    std::cout << "[Test] Checkpointed segments give the same gradients..." << std::endl;
+    Deep plain, ckpt;
+    Tensor x({4, 16}, random_values(64, 7), true);
+    Tensor xc({4, 16}, random_values(64, 7), true);
+
+    Tensor ref = mul(plain.block(x, 0, 8), Tensor({4, 16}, random_values(64, 8)));
+    ref.backward();
+
+    size_t calls = 0;
+    Tensor inner;
+    Tensor h = xc;
+    const size_t bounds[] = {0, 3, 6, 8};
+    for (size_t s = 0; s < 3; ++s) {
+        size_t lo = bounds[s], hi = bounds[s + 1];
+        h = checkpoint([&, lo, hi](const std::vector<Tensor>& in) {
+            ++calls;
+            Tensor first = ckpt.block(in[0], lo, lo + 1);
+            if (lo == 0 && !inner.defined()) inner = first;
+            return ckpt.block(first, lo + 1, hi);
+        }, {h});
+        assert(h.requires_grad() && h.grad_fn() != nullptr);
+        assert(h.grad_fn()->parents().size() == 1);
+    }
+    // 片段内部不建图：中间结果没有 grad_fn，也就不会被保留
+    assert(inner.grad_fn() == nullptr && !inner.requires_grad());
+    assert(calls == 3);
+    assert(all_near(h.data(), plain.block(x, 0, 8).data()));
+
+    Tensor out = mul(h, Tensor({4, 16}, random_values(64, 8)));
+    out.backward();
+    assert(calls == 6); // 反向时每段各重算一次
+    for (size_t i = 0; i < 8; ++i) {
+        assert(all_near(plain.layers[i].weight.grad(), ckpt.layers[i].weight.grad()));
+        assert(all_near(plain.layers[i].bias.grad(), ckpt.layers[i].bias.grad()));
+    }
+    assert(all_near(x.grad(), xc.grad()));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_checkpoint_grad_detection() {
+    std::cout << "[Test] checkpoint only builds a node when gradients are needed..." << std::endl;
+    Tensor x({2, 4}, random_values(8, 3));
+    Tensor c({4, 4}, random_values(16, 4));
+    Tensor y = checkpoint([&](const std::vector<Tensor>& in) { return matmul(in[0], c); }, {x});
+    assert(!y.requires_grad() && y.grad_fn() == nullptr);
+
+    // 输入不需要梯度，但闭包里的参数需要：参数照样拿到梯度
+    Linear lin(4, 3, true, 5);
+    Tensor z = checkpoint([&](const std::vector<Tensor>& in) { return lin.forward(in[0]); }, {x});
+    assert(z.requires_grad());
+    z.backward();
+    Tensor ref_x({2, 4}, x.data().to_vector());
+    Linear ref(4, 3, true, 5);
+    ref.forward(ref_x).backward();
+    assert(all_near(lin.weight.grad(), ref.weight.grad()));
+    assert(all_near(lin.bias.grad(), ref.bias.grad()));
+
+    // 梯度模式关闭时直接返回普通张量
+    {
+        NoGradGuard no_grad;
+        Tensor xg({2, 4}, random_values(8, 3), true);
+        Tensor u = checkpoint([](const std::vector<Tensor>& in) { return relu(in[0]); }, {xg});
+        assert(!u.requires_grad());
+    }
+
+    // 录制中不支持
+    bool threw = false;
+    try {
+        capture_graph([&] { return checkpoint([](const std::vector<Tensor>& in) { return neg(in[0]); }, {x}); });
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_checkpoint_shared_parameter() {
+    std::cout << "[Test] Parameters used inside and outside a checkpoint get one hook call..." << std::endl;
+    Tensor x({3}, {1.0f, 2.0f, 3.0f}, true);
+    Tensor w({3}, {0.5f, -1.0f, 2.0f}, true);
+    CheckpointFn seg = [&](const std::vector<Tensor>& in) { return mul(in[0], w); };
+    size_t w_calls = 0, x_calls = 0;
+    std::vector<float> w_seen, x_seen;
+    w.register_grad_hook([&](Tensor& t) {
+        ++w_calls;
+        w_seen = t.grad().to_vector();
+    });
+    x.register_grad_hook([&](Tensor& t) {
+        ++x_calls;
+        x_seen = t.grad().to_vector();
+    });
+
+    // w 由两段重算的反向和片段外的 mul 各贡献一份：钩子只在三份都累加后触发一次
+    Tensor y = add(add(checkpoint(seg, {x}), checkpoint(seg, {x})), mul(x, w));
+    y.backward();
+    assert(w_calls == 1 && x_calls == 1);
+    for (size_t i = 0; i < 3; ++i) {
+        assert(near(w.grad()[i], 3.0f * x[i]) && near(w_seen[i], w.grad()[i]));
+        assert(near(x.grad()[i], 3.0f * w[i]) && near(x_seen[i], x.grad()[i]));
+    }
+
+    // 检查点嵌套在检查点里
+    w.zero_grad();
+    x.zero_grad();
+    CheckpointFn outer = [&](const std::vector<Tensor>& in) { return add(checkpoint(seg, {in[0]}), mul(in[0], w)); };
+    add(checkpoint(outer, {x}), mul(x, w)).backward();
+    assert(w_calls == 2 && x_calls == 2);
+    for (size_t i = 0; i < 3; ++i) {
+        assert(near(w.grad()[i], 3.0f * x[i]) && near(w_seen[i], w.grad()[i]));
+        assert(near(x.grad()[i], 3.0f * w[i]) && near(x_seen[i], x.grad()[i]));
+    }
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_no_grad_guard();
+        test_checkpoint_matches_plain();
+        test_checkpoint_grad_detection();
+        test_checkpoint_shared_parameter();
+        std::cout << "\nAll activation checkpoint tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
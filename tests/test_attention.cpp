@@ -0,0 +1,114 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+Tensor random_tensor(const std::vector<size_t>& shape, uint32_t seed, bool requires_grad) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    Tensor t(shape, requires_grad);
+    for (auto& v : t.data()) v = dist(gen);
+    return t;
+}
+
+// 朴素参考实现：显式构造 [T, S] 分数矩阵，double 精度
+std::vector<double> reference_attention(const Tensor& q, const Tensor& k, const Tensor& v,
+                                        size_t BH, size_t T, size_t S, size_t D, size_t Dv, bool causal) {
+    std::vector<double> out(BH * T * Dv, 0.0);
+    double scale = 1.0 / std::sqrt(static_cast<double>(D));
+    for (size_t b = 0; b < BH; ++b) {
+        for (size_t i = 0; i < T; ++i) {
+            std::vector<double> s(S, -INFINITY);
+            double mx = -INFINITY;
+            for (size_t j = 0; j < S; ++j) {
+                if (causal && j > i) continue;
+                double acc = 0.0;
+                for (size_t d = 0; d < D; ++d) acc += q[(b * T + i) * D + d] * k[(b * S + j) * D + d];
+                s[j] = acc * scale;
+                mx = std::max(mx, s[j]);
+            }
+            double sum = 0.0;
+            for (size_t j = 0; j < S; ++j) { s[j] = std::exp(s[j] - mx); sum += s[j]; }
+            for (size_t j = 0; j < S; ++j)
+                for (size_t d = 0; d < Dv; ++d) out[(b * T + i) * Dv + d] += s[j] / sum * v[(b * S + j) * Dv + d];
+        }
+    }
+    return out;
+}
+
+// 中心差分抽查 p 的梯度 (每 stride 个元素查一个)
+void check_grad(Tensor& p, const std::function<float()>& loss, size_t stride = 1) {
+    const float h = 1e-2f;
+    for (size_t i = 0; i < p.numel(); i += stride) {
+        float old = p[i];
+        p[i] = old + h; float lp = loss();
+        p[i] = old - h; float lm = loss();
+        p[i] = old;
+        assert(near(p.grad()[i], (lp - lm) / (2 * h), 2e-2f));
+    }
+}
+
+void run_case(size_t B, size_t H, size_t T, size_t S, size_t D, size_t Dv, bool causal, size_t stride) {
+    Tensor q = random_tensor({B, H, T, D}, 1, true);
+    Tensor k = random_tensor({B, H, S, D}, 2, true);
+    Tensor v = random_tensor({B, H, S, Dv}, 3, true);
+    Tensor w = random_tensor({B, H, T, Dv}, 4, false);
+
+    Tensor out = scaled_dot_product_attention(q, k, v, causal);
+    assert(out.shape() == std::vector<size_t>({B, H, T, Dv}));
+    auto ref = reference_attention(q, k, v, B * H, T, S, D, Dv, causal);
+    for (size_t i = 0; i < ref.size(); ++i) assert(near(out[i], static_cast<float>(ref[i])));
+
+    auto loss = [&]() {
+        Tensor o = scaled_dot_product_attention(q, k, v, causal);
+        float s = 0.0f;
+        for (size_t i = 0; i < o.numel(); ++i) s += o[i] * w[i];
+        return s;
+    };
+    Tensor l = out * w;
+    l.backward();
+    check_grad(q, loss, stride);
+    check_grad(k, loss, stride);
+    check_grad(v, loss, stride);
+}
+
+void test_attention_small() {
+    std::cout << "[Test] Attention forward/backward (small, non-causal)..." << std::endl;
+    run_case(2, 2, 5, 7, 4, 3, false, 1);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_attention_causal() {
+    std::cout << "[Test] Attention forward/backward (causal)..." << std::endl;
+    run_case(1, 2, 6, 6, 4, 4, true, 1);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_attention_multi_block() {
+    std::cout << "[Test] Attention across K/V blocks (T = 150)..." << std::endl;
+    run_case(1, 1, 150, 150, 8, 8, false, 37);
+    run_case(1, 2, 150, 150, 8, 8, true, 41);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_attention_small();
+        test_attention_causal();
+        test_attention_multi_block();
+        std::cout << "\nAll attention tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "broadcast.hpp"
+#include "tensor_utils.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+std::vector<float> random_values(size_t n, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> v(n);
+    for (auto& x : v) x = dist(gen);
+    return v;
+}
+
+size_t numel_of(const std::vector<size_t>& shape) {
+    size_t n = 1;
+    for (size_t d : shape) n *= d;
+    return n;
+}
+
+// 输入形状：从 out 的后 rank 维出发，mask 的第 d 位为 1 时该维广播成 1
+std::vector<size_t> broadcast_variant(const std::vector<size_t>& out, size_t rank, unsigned mask) {
+    std::vector<size_t> s(out.end() - rank, out.end());
+    for (size_t d = 0; d < rank; ++d) {
+        if (mask >> d & 1u) s[d] = 1;
+    }
+    return s;
+}
+
+void test_map_matches_reference() {
+    std::cout << "[Test] broadcast_map matches unravel reference for ranks 1-7..." << std::endl;
+    const std::vector<size_t> dims = {3, 2, 4, 2, 5, 2, 3};
+    size_t cases = 0;
+    for (size_t rank = 1; rank <= dims.size(); ++rank) {
+        std::vector<size_t> out_shape(dims.begin(), dims.begin() + rank);
+        for (unsigned ma = 0; ma < (1u << rank); ma += 3) {
+            for (unsigned mb = 0; mb < (1u << rank); mb += 5) {
+                auto sa = broadcast_variant(out_shape, rank - ma % rank, ma);
+                auto sb = broadcast_variant(out_shape, rank, mb);
+                auto a = random_values(numel_of(sa), ma + 1);
+                auto b = random_values(numel_of(sb), mb + 100);
+                std::vector<float> out(numel_of(out_shape));
+                broadcast_map(out_shape, out.data(), [](float x, float y) { return x * 2.0f - y; },
+                              broadcast_input(a.data(), sa), broadcast_input(b.data(), sb));
+                for (size_t i = 0; i < out.size(); ++i) {
+                    auto idx = unravel_index(i, out_shape);
+                    float ref = a[ravel_index_broadcast(idx, sa)] * 2.0f - b[ravel_index_broadcast(idx, sb)];
+                    assert(near(out[i], ref));
+                }
+                ++cases;
+            }
+        }
+    }
+    assert(cases > 50);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_reduce_matches_reference() {
+    std::cout << "[Test] broadcast_reduce_sum matches unravel reference..." << std::endl;
+    const std::vector<size_t> out_shape = {2, 3, 1, 4, 5, 2, 3};
+    for (unsigned mask = 0; mask < (1u << out_shape.size()); mask += 7) {
+        auto dst_shape = broadcast_variant(out_shape, out_shape.size() - mask % 3, mask);
+        auto src = random_values(numel_of(out_shape), mask);
+        std::vector<float> dst(numel_of(dst_shape), 1.0f), ref(dst.size(), 1.0f);
+        broadcast_reduce_sum(src.data(), out_shape, dst.data(), dst_shape);
+        for (size_t i = 0; i < src.size(); ++i) {
+            ref[ravel_index_broadcast(unravel_index(i, out_shape), dst_shape)] += src[i];
+        }
+        for (size_t i = 0; i < dst.size(); ++i) assert(near(dst[i], ref[i], 1e-3f));
+    }
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_layout_collapses_dims() {
+    std::cout << "[Test] Layout merges contiguous dims..." << std::endl;
+    std::vector<size_t> out = {4, 3, 5, 6}, same = {4, 3, 5, 6}, row = {6}, col = {4, 3, 1, 1};
+    BroadcastLayout l = make_broadcast_layout(out, {&same});
+    assert(l.rank == 1 && l.shape[0] == 360);
+    l = make_broadcast_layout(out, {&same, &row});
+    assert(l.rank == 2 && l.shape[0] == 60 && l.shape[1] == 6);
+    assert(l.inner_contiguous(1) && l.inner_contiguous(2) && l.stride(2, 0) == 0);
+    l = make_broadcast_layout(out, {&col});
+    assert(l.rank == 2 && l.shape[0] == 12 && l.shape[1] == 30);
+    assert(!l.inner_contiguous(1) && l.stride(1, 0) == 1);
+    std::vector<size_t> bad = {3, 6};
+    bool threw = false;
+    try {
+        make_broadcast_layout(out, {&bad});
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_ops_broadcast_backward() {
+    std::cout << "[Test] mul / div / where backward with broadcasting..." << std::endl;
+    Tensor a({2, 1, 3}, random_values(6, 1), true);
+    Tensor b({4, 1}, {1.0f, 2.0f, -1.0f, 0.5f}, true);
+    Tensor y = div(mul(a, b), b); // y == a，广播到 [2, 4, 3]
+    y.backward();
+    for (size_t i = 0; i < 6; ++i) assert(near(a.grad()[i], 4.0f));
+    for (size_t i = 0; i < 4; ++i) assert(near(b.grad()[i], 0.0f));
+
+    Tensor mask = gt(Tensor({3}, {1.0f, -1.0f, 1.0f}), Tensor({1}, {0.0f}));
+    Tensor p({2, 3}, random_values(6, 2), true), q({1}, {5.0f}, true);
+    Tensor w = where(mask, p, q);
+    assert(near(w[1], 5.0f) && near(w[3], p[3]));
+    w.backward();
+    assert(near(p.grad()[0], 1.0f) && near(p.grad()[1], 0.0f) && near(p.grad()[5], 1.0f));
+    assert(near(q.grad()[0], 2.0f));
+
+    bool threw = false;
+    try {
+        div(a, Tensor({3}, {1.0f, 0.0f, 1.0f}));
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_map_matches_reference();
+        test_reduce_matches_reference();
+        test_layout_collapses_dims();
+        test_ops_broadcast_backward();
+        std::cout << "\nAll broadcast tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,193 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "module.hpp"
+#include "distributed.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+std::vector<float> random_values(size_t n, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> v(n);
+    for (auto& x : v) x = dist(gen);
+    return v;
+}
+
+void test_grad_hooks() {
+    std::cout << "[Test] Gradient-ready hooks fire once per leaf after all contributions..." << std::endl;
+    Tensor x({3}, {1.0f, 2.0f, 3.0f}, true);
+    Tensor w({3}, {0.5f, -1.0f, 2.0f}, true);
+    std::vector<float> seen;
+    size_t calls = 0;
+    size_t id = x.register_grad_hook([&](Tensor& t) {
+        ++calls;
+        seen = t.grad().to_vector();
+    });
+    // x 被用了三次：钩子只在三份梯度都累加后触发一次
+    Tensor y = add(mul(x, w), mul(x, x));
+    y = add(y, x);
+    y.backward();
+    assert(calls == 1);
+    for (size_t i = 0; i < 3; ++i) assert(near(seen[i], w[i] + 2.0f * x[i] + 1.0f));
+
+    x.zero_grad();
+    x.remove_grad_hook(id);
+    mul(x, w).backward();
+    assert(calls == 1);
+
+    bool threw = false;
+    try {
+        y.register_grad_hook([](Tensor&) {});
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+struct MLP : public Module {
+    std::shared_ptr<Linear> l1, l2, l3;
+    MLP() {
+        l1 = std::make_shared<Linear>(8, 32, true, 1);
+        l2 = std::make_shared<Linear>(32, 32, true, 2);
+        l3 = std::make_shared<Linear>(32, 4, true, 3);
+        register_module("l1", l1);
+        register_module("l2", l2);
+        register_module("l3", l3);
+    }
+    Tensor loss(const Tensor& x) const { return l3->forward(relu(l2->forward(relu(l1->forward(x))))); }
+};
+
+// 每个 rank 一个线程、各自一份模型和 reducer，对自己那份 batch 做 backward
+void check_reducer(bool flatten, size_t bucket_bytes) {
+    const size_t W = 3, rows = 12;
+    ThreadGroup g(W);
+    std::vector<std::unique_ptr<MLP>> models;
+    for (size_t r = 0; r < W; ++r) {
+        models.push_back(std::make_unique<MLP>());
+        if (flatten) models.back()->flatten_parameters();
+    }
+    MLP ref;
+
+    for (uint32_t it = 0; it < 2; ++it) {
+        Tensor x({rows, 8}, random_values(rows * 8, 50 + it));
+        std::vector<size_t> launched_at_first_layer(W);
+        std::vector<size_t> buckets(W);
+        std::vector<std::thread> ts;
+        for (size_t r = 0; r < W; ++r) {
+            ts.emplace_back([&, r] {
+                MLP& m = *models[r];
+                BucketReducer reducer(m.parameters(), g.handle(r), ReduceOp::Mean, bucket_bytes);
+                buckets[r] = reducer.num_buckets();
+                // 第一层的梯度最后才就绪：此时后面几层的桶应已发出
+                size_t id = m.l1->weight.register_grad_hook([&, r](Tensor&) { launched_at_first_layer[r] = reducer.launched(); });
+                m.zero_grad();
+                m.loss(shard_rows(x, r, W)).backward();
+                reducer.finish();
+                m.l1->weight.remove_grad_hook(id);
+            });
+        }
+        for (auto& t : ts) t.join();
+
+        ref.zero_grad();
+        ref.loss(x).backward();
+        auto ref_params = ref.parameters();
+        for (size_t r = 0; r < W; ++r) {
+            assert(buckets[r] > 1);
+            assert(launched_at_first_layer[r] >= 1);
+            auto ps = models[r]->parameters();
+            for (size_t k = 0; k < ps.size(); ++k) {
+                for (size_t i = 0; i < ps[k].numel(); ++i) {
+                    assert(near(ps[k].grad()[i], ref_params[k].grad()[i] / float(W)));
+                }
+            }
+        }
+    }
+}
+
+void test_bucket_reducer() {
+    std::cout << "[Test] BucketReducer averages gradients while backward runs..." << std::endl;
+    check_reducer(false, 2048); // 各参数独立的梯度：拷进桶缓冲
+    check_reducer(true, 4096);  // arena 梯度：直接归约 arena 切片
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_unused_parameter() {
+    std::cout << "[Test] BucketReducer::finish flushes buckets of unused parameters..." << std::endl;
+    const size_t W = 2;
+    ThreadGroup g(W);
+    std::vector<std::thread> ts;
+    std::vector<float> result(W);
+    for (size_t r = 0; r < W; ++r) {
+        ts.emplace_back([&, r] {
+            Tensor used({2}, {1.0f, 2.0f}, true);
+            Tensor unused({2}, 0.0f, true);
+            unused.grad()[0] = float(r + 1); // 没参与本轮计算，梯度是上轮留下的
+            BucketReducer reducer({used, unused}, g.handle(r), ReduceOp::Sum, 8);
+            mul(used, Tensor({2}, float(r + 1))).backward();
+            assert(reducer.launched() == 1);
+            reducer.finish();
+            assert(near(used.grad()[0], 3.0f));
+            result[r] = unused.grad()[0];
+        });
+    }
+    for (auto& t : ts) t.join();
+    assert(near(result[0], 3.0f) && near(result[1], 3.0f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_checkpoint_shared_parameter() {
+    std::cout << "[Test] BucketReducer waits for checkpoint recomputation of shared parameters..." << std::endl;
+    const size_t W = 2;
+    ThreadGroup g(W);
+    std::vector<std::thread> ts;
+    std::vector<std::vector<float>> result(W);
+    for (size_t r = 0; r < W; ++r) {
+        ts.emplace_back([&, r] {
+            Tensor w({2}, {1.0f, -2.0f}, true);
+            Tensor b({2}, 0.0f, true);
+            BucketReducer reducer({w, b}, g.handle(r), ReduceOp::Sum, 8);
+            CheckpointFn seg = [&](const std::vector<Tensor>& in) { return mul(in[0], w); };
+            for (int it = 0; it < 3; ++it) {
+                w.zero_grad();
+                b.zero_grad();
+                // w 在片段内外各用一次：它的桶要等重算的反向也累加完才能发出
+                Tensor x({2}, float(r + 1), true);
+                add(add(checkpoint(seg, {x}), mul(x, w)), b).backward();
+                assert(reducer.launched() == 2);
+                reducer.finish();
+            }
+            result[r] = {w.grad()[0], w.grad()[1], b.grad()[0]};
+        });
+    }
+    for (auto& t : ts) t.join();
+    // 每个 rank 的 w 梯度为 2 * (r + 1)，求和得 6
+    for (size_t r = 0; r < W; ++r) {
+        assert(near(result[r][0], 6.0f) && near(result[r][1], 6.0f));
+        assert(near(result[r][2], 2.0f));
+    }
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_grad_hooks();
+        test_bucket_reducer();
+        test_unused_parameter();
+        test_checkpoint_shared_parameter();
+        std::cout << "\nAll bucket reducer tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "tensor.hpp"
+#include "module.hpp"
+#include "optim.hpp"
+#include "checkpoint.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-6f) {
+    return std::abs(a - b) < tol;
+}
+
+const std::string kPath = "test_checkpoint_async.bin";
+
+bool file_exists(const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (f) std::fclose(f);
+    return f != nullptr;
+}
+
+void train_step(Linear& net, Optimizer& opt) {
+    Tensor x({2, 4}, {1, 2, 3, 4, -1, 0.5f, 2, 0});
+    Tensor y = net.forward(x);
+    opt.zero_grad();
+    y.backward();
+    opt.step();
+}
+
+void test_snapshot_and_restore() {
+    std::cout << "[Test] Async save snapshots params + Adam state..." << std::endl;
+    Linear net(4, 3, true, 1);
+    Adam opt(net.parameters(), 1e-2f);
+    for (int i = 0; i < 3; ++i) train_step(net, opt);
+
+    std::vector<float> w_snap = net.weight.data().to_vector();
+    std::vector<float> m_snap = *opt.state_buffers()[0].second;
+
+    AsyncCheckpointer ckpt;
+    ckpt.save(kPath, net, &opt);
+    // save 返回后立刻继续训练，快照不受影响
+    for (int i = 0; i < 2; ++i) train_step(net, opt);
+    ckpt.wait();
+    assert(ckpt.completed() == 1);
+    assert(file_exists(kPath) && !file_exists(kPath + ".tmp"));
+
+    Linear restored(4, 3, true, 99);
+    Adam opt2(restored.parameters(), 1e-2f);
+    load_checkpoint(kPath, restored, &opt2);
+    for (size_t i = 0; i < w_snap.size(); ++i) assert(near(restored.weight[i], w_snap[i]));
+    const auto& m2 = *opt2.state_buffers()[0].second;
+    for (size_t i = 0; i < m_snap.size(); ++i) assert(near(m2[i], m_snap[i]));
+    assert(opt2.step_count() == 3);
+
+    // 步数按 int64 保存，超过 2^24 也能精确恢复
+    const size_t big_step = (size_t(1) << 24) + 1;
+    opt.set_step_count(big_step);
+    ckpt.save(kPath, net, &opt);
+    ckpt.wait();
+    load_checkpoint(kPath, restored, &opt2);
+    assert(opt2.step_count() == big_step);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_bounded_in_flight() {
+    std::cout << "[Test] Bounded in-flight snapshots..." << std::endl;
+    Linear net(64, 64, true, 2);
+    AsyncCheckpointer ckpt(1);
+    for (int i = 0; i < 5; ++i) {
+        net.weight[0] = static_cast<float>(i);
+        ckpt.save(kPath, net);
+        assert(ckpt.in_flight() <= 1);
+    }
+    ckpt.wait();
+    assert(ckpt.completed() == 5);
+
+    // 最后一次保存的内容覆盖了文件
+    Linear restored(64, 64, true, 3);
+    load_checkpoint(kPath, restored);
+    assert(near(restored.weight[0], 4.0f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_write_error() {
+    std::cout << "[Test] Background write errors surface in wait()..." << std::endl;
+    Linear net(2, 2, true, 4);
+    AsyncCheckpointer ckpt;
+    ckpt.save("no_such_dir/ckpt.bin", net);
+    bool threw = false;
+    try { ckpt.wait(); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    ckpt.save(kPath, net); // 错误被取走后可以继续使用
+    ckpt.wait();
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_snapshot_and_restore();
+        test_bounded_in_flight();
+        test_write_error();
+        std::remove(kPath.c_str());
+        std::cout << "\nAll checkpoint tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
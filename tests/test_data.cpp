@@ -0,0 +1,158 @@
+#include "tensor.hpp"
+#include "data.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-6f) {
+    return std::abs(a - b) < tol;
+}
+
+// x[i] = [i, 10 i]，y[i] = -i
+std::shared_ptr<TensorDataset> make_dataset(size_t n) {
+    Tensor x({n, 2}), y({n});
+    for (size_t i = 0; i < n; ++i) {
+        x[i * 2] = static_cast<float>(i);
+        x[i * 2 + 1] = static_cast<float>(10 * i);
+        y[i] = -static_cast<float>(i);
+    }
+    return std::make_shared<TensorDataset>(std::vector<Tensor>{x, y});
+}
+
+// 检查 batch 内容与 indices 一致，返回样本下标
+std::vector<size_t> check_batch(const Batch& b) {
+    assert(b.fields.size() == 2);
+    assert(b.fields[0].shape() == std::vector<size_t>({b.size(), 2}));
+    assert(b.fields[1].shape() == std::vector<size_t>({b.size()}));
+    for (size_t r = 0; r < b.size(); ++r) {
+        float i = static_cast<float>(b.indices[r]);
+        assert(near(b.fields[0][r * 2], i));
+        assert(near(b.fields[0][r * 2 + 1], 10 * i));
+        assert(near(b.fields[1][r], -i));
+    }
+    return b.indices;
+}
+
+void test_sequential() {
+    std::cout << "[Test] DataLoader sequential order / last partial batch..." << std::endl;
+    DataLoaderOptions opt;
+    opt.batch_size = 3;
+    opt.num_workers = 3;
+    DataLoader loader(make_dataset(10), opt);
+    assert(loader.num_batches() == 4);
+
+    std::vector<size_t> seen, sizes;
+    for (Batch b; loader.next(b);) {
+        auto idx = check_batch(b);
+        seen.insert(seen.end(), idx.begin(), idx.end());
+        sizes.push_back(b.size());
+    }
+    assert(sizes == std::vector<size_t>({3, 3, 3, 1}));
+    for (size_t i = 0; i < 10; ++i) assert(seen[i] == i);
+    assert(loader.epoch() == 1);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+std::vector<std::vector<size_t>> run_epochs(size_t workers, size_t epochs) {
+    DataLoaderOptions opt;
+    opt.batch_size = 4;
+    opt.shuffle = true;
+    opt.drop_last = true;
+    opt.num_workers = workers;
+    opt.prefetch = 3;
+    opt.seed = 42;
+    DataLoader loader(make_dataset(22), opt);
+    assert(loader.num_batches() == 5);
+
+    std::vector<std::vector<size_t>> orders;
+    for (size_t e = 0; e < epochs; ++e) {
+        std::vector<size_t> order;
+        Batch b;
+        while (loader.next(b)) {
+            assert(b.size() == 4);
+            auto idx = check_batch(b);
+            order.insert(order.end(), idx.begin(), idx.end());
+        }
+        orders.push_back(order);
+    }
+    return orders;
+}
+
+void test_shuffle_deterministic() {
+    std::cout << "[Test] Seeded shuffle + drop_last, independent of worker count..." << std::endl;
+    auto a = run_epochs(0, 3);
+    auto b = run_epochs(4, 3);
+    assert(a == b);
+    for (auto& order : a) {
+        assert(order.size() == 20);
+        assert(std::set<size_t>(order.begin(), order.end()).size() == 20);
+    }
+    assert(a[0] != a[1]); // 每个 epoch 重新打乱
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_slot_reuse() {
+    std::cout << "[Test] Batch buffers come from a fixed ring..." << std::endl;
+    DataLoaderOptions opt;
+    opt.batch_size = 2;
+    opt.num_workers = 2;
+    opt.prefetch = 2;
+    DataLoader loader(make_dataset(16), opt);
+    std::set<const float*> buffers;
+    for (size_t e = 0; e < 2; ++e) {
+        for (Batch b; loader.next(b);) buffers.insert(b.fields[0].data().data());
+    }
+    assert(buffers.size() == 2);
+
+    // 同时持有 prefetch 个以上的 batch 会报错而不是死锁
+    Batch b1, b2, b3;
+    assert(loader.next(b1) && loader.next(b2));
+    bool threw = false;
+    try { loader.next(b3); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+struct FailingDataset : public Dataset {
+    size_t size() const override { return 8; }
+    std::vector<std::vector<size_t>> sample_shapes() const override { return {{1}}; }
+    void get(size_t index, const std::vector<float*>& out) const override {
+        if (index == 5) throw std::runtime_error("bad sample");
+        out[0][0] = static_cast<float>(index);
+    }
+};
+
+void test_worker_error() {
+    std::cout << "[Test] Worker exceptions reach the caller..." << std::endl;
+    DataLoaderOptions opt;
+    opt.batch_size = 2;
+    opt.num_workers = 2;
+    DataLoader loader(std::make_shared<FailingDataset>(), opt);
+    bool threw = false;
+    try {
+        for (Batch b; loader.next(b);) {}
+    } catch (const std::runtime_error& e) {
+        threw = std::string(e.what()) == "bad sample";
+    }
+    assert(threw);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_sequential();
+        test_shuffle_deterministic();
+        test_slot_reuse();
+        test_worker_error();
+        std::cout << "\nAll data tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "module.hpp"
+#include "optim.hpp"
+#include "distributed.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+std::vector<float> random_values(size_t n, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> v(n);
+    for (auto& x : v) x = dist(gen);
+    return v;
+}
+
+// 每个 rank 一个线程执行 fn(rank, pg)
+template <typename F>
+void run_ranks(ThreadGroup& g, F fn) {
+    std::vector<std::thread> ts;
+    for (size_t r = 0; r < g.size(); ++r) ts.emplace_back([&, r] { fn(r, g.handle(r)); });
+    for (auto& t : ts) t.join();
+}
+
+void test_collectives() {
+    std::cout << "[Test] ThreadGroup all_reduce / broadcast / all_gather..." << std::endl;
+    const size_t W = 4;
+    ThreadGroup g(W);
+    for (size_t n : {size_t(1), size_t(3), size_t(1003), size_t(10000)}) {
+        std::vector<Storage> bufs(W), means(W);
+        for (size_t r = 0; r < W; ++r) {
+            bufs[r] = Storage(std::vector<float>(n));
+            for (size_t i = 0; i < n; ++i) bufs[r][i] = float(r + 1) * float(i % 7);
+            means[r] = bufs[r];
+        }
+        run_ranks(g, [&](size_t r, ProcessGroup& pg) {
+            assert(pg.rank() == r && pg.size() == W);
+            pg.all_reduce(bufs[r]);
+            pg.all_reduce(means[r], ReduceOp::Mean);
+        });
+        for (size_t r = 0; r < W; ++r) {
+            for (size_t i = 0; i < n; ++i) {
+                assert(near(bufs[r][i], 10.0f * float(i % 7)));
+                assert(near(means[r][i], 2.5f * float(i % 7)));
+            }
+        }
+    }
+
+    // Float64 / broadcast / all_gather
+    std::vector<Storage> d(W), b(W), in(W), out(W);
+    for (size_t r = 0; r < W; ++r) {
+        d[r] = Storage(5, DType::Float64);
+        for (size_t i = 0; i < 5; ++i) d[r].data_ptr<double>()[i] = double(r) + 0.25;
+        b[r] = Storage(std::vector<float>(6, float(r)));
+        in[r] = Storage(std::vector<float>{float(r), float(r) + 0.5f});
+        out[r] = Storage(std::vector<float>(2 * W));
+    }
+    run_ranks(g, [&](size_t r, ProcessGroup& pg) {
+        pg.all_reduce(d[r]);
+        pg.broadcast(b[r], 2);
+        pg.barrier();
+        pg.all_gather(in[r], out[r]);
+    });
+    for (size_t r = 0; r < W; ++r) {
+        assert(std::abs(d[r].data_ptr<double>()[4] - 7.0) < 1e-12);
+        for (size_t i = 0; i < 6; ++i) assert(near(b[r][i], 2.0f));
+        for (size_t q = 0; q < W; ++q) assert(near(out[r][2 * q], float(q)) && near(out[r][2 * q + 1], q + 0.5f));
+    }
+
+    // 长度不一致时所有 rank 一起抛异常，而不是卡住
+    size_t threw = 0;
+    std::vector<Storage> bad(W);
+    for (size_t r = 0; r < W; ++r) bad[r] = Storage(std::vector<float>(r == 1 ? 3 : 4));
+    std::mutex mu;
+    run_ranks(g, [&](size_t r, ProcessGroup& pg) {
+        try {
+            pg.all_reduce(bad[r]);
+        } catch (const std::runtime_error&) {
+            std::lock_guard<std::mutex> lk(mu);
+            ++threw;
+        }
+    });
+    assert(threw == W);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+struct MLP : public Module {
+    std::shared_ptr<Linear> l1, l2;
+    explicit MLP(uint32_t seed) {
+        l1 = std::make_shared<Linear>(8, 16, true, seed);
+        l2 = std::make_shared<Linear>(16, 4, true, seed + 1);
+        register_module("l1", l1);
+        register_module("l2", l2);
+    }
+    Tensor loss(const Tensor& x, const Tensor& target) const {
+        Tensor d = sub(l2->forward(relu(l1->forward(x))), target);
+        return mul(d, d);
+    }
+};
+
+void test_data_parallel_training() {
+    std::cout << "[Test] DataParallel matches single-replica training..." << std::endl;
+    const size_t N = 4, rows = 16;
+    uint32_t seed = 10;
+    // 每个副本用不同的种子初始化，验证构造时以副本 0 为准同步
+    DataParallel dp(N, [&] { return std::make_shared<MLP>(seed++); });
+    MLP ref(10);
+
+    std::vector<std::unique_ptr<SGD>> opts;
+    for (size_t r = 0; r < N; ++r) opts.push_back(std::make_unique<SGD>(dp.replica(r).parameters(), 0.05f));
+    // backward 的种子为全 1，单模型的梯度是所有行之和；各副本平均后再乘 N 才与之对应
+    SGD ref_opt(ref.parameters(), 0.05f / N);
+
+    for (uint32_t it = 0; it < 3; ++it) {
+        Tensor x({rows, 8}, random_values(rows * 8, 100 + it));
+        Tensor y({rows, 4}, random_values(rows * 4, 200 + it));
+        dp.run([&](size_t r, Module& m) {
+                   m.zero_grad();
+                   static_cast<MLP&>(m).loss(shard_rows(x, r, N), shard_rows(y, r, N)).backward();
+               },
+               [&](size_t r, Module&) { opts[r]->step(); });
+        ref.zero_grad();
+        ref.loss(x, y).backward();
+        ref_opt.step();
+    }
+
+    auto ref_params = ref.parameters();
+    for (size_t r = 0; r < N; ++r) {
+        auto ps = dp.replica(r).parameters();
+        assert(ps.size() == ref_params.size());
+        for (size_t k = 0; k < ps.size(); ++k) {
+            for (size_t i = 0; i < ps[k].numel(); ++i) assert(near(ps[k][i], ref_params[k][i], 1e-4f));
+        }
+    }
+
+    // 某个副本的 step 抛异常时 run 重新抛出，不会卡在 all_reduce 里
+    bool threw = false;
+    try {
+        dp.run([](size_t r, Module&) {
+            if (r == 2) throw std::runtime_error("boom");
+        });
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    Tensor batch({5, 2}, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+    Tensor s0 = shard_rows(batch, 0, 2), s1 = shard_rows(batch, 1, 2);
+    assert(s0.shape()[0] == 3 && s1.shape()[0] == 2 && near(s1[0], 6.0f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_collectives();
+        test_data_parallel_training();
+        std::cout << "\nAll distributed tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,212 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "serialize.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(double a, double b, double tol = 1e-4) {
+    return std::abs(a - b) < tol;
+}
+
+void test_promotion() {
+    std::cout << "[Test] Type promotion rules..." << std::endl;
+    assert(promote_types(DType::Float32, DType::Float64) == DType::Float64);
+    assert(promote_types(DType::Float16, DType::Float64) == DType::Float64);
+    assert(promote_types(DType::Float16, DType::BFloat16) == DType::Float32);
+    assert(promote_types(DType::Int64, DType::Float16) == DType::Float16);
+    assert(promote_types(DType::Int32, DType::Float32) == DType::Float32);
+    assert(promote_types(DType::UInt8, DType::Int32) == DType::Int32);
+    assert(promote_types(DType::Int64, DType::Int32) == DType::Int64);
+    assert(dtype_size(DType::Int64) == 8 && dtype_size(DType::UInt8) == 1);
+    assert(std::strcmp(dtype_name(DType::Float64), "float64") == 0);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_integer_tensors() {
+    std::cout << "[Test] Integer tensors keep exact values..." << std::endl;
+    // 2^24 + 1 在 float 中无法表示
+    Tensor a = Tensor::from_data<int64_t>({3}, {16777217, -7, 100});
+    Tensor b = Tensor::from_data<int64_t>({3}, {1, 2, 7});
+    assert(a.dtype() == DType::Int64);
+    assert(a.data().nbytes() == 24);
+
+    Tensor s = a + b;
+    assert(s.dtype() == DType::Int64 && s.data_ptr<int64_t>()[0] == 16777218);
+    Tensor q = a / b;
+    assert(q.data_ptr<int64_t>()[1] == -3 && q.data_ptr<int64_t>()[2] == 14); // 向 0 截断
+    Tensor n = -a;
+    assert(n.data_ptr<int64_t>()[1] == 7);
+
+    // int32 与 int64 混合提升为 int64；广播
+    Tensor c = Tensor::from_data<int32_t>({1}, {10});
+    Tensor d = a * c;
+    assert(d.dtype() == DType::Int64 && d.data_ptr<int64_t>()[0] == 167772170);
+
+    bool threw = false;
+    try { (void)a.data().data(); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    threw = false;
+    try { a / Tensor::from_data<int64_t>({3}, {1, 0, 1}); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    threw = false;
+    try { a.set_requires_grad(true); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+
+    // 整数 matmul
+    Tensor m1 = Tensor::from_data<int32_t>({2, 2}, {1, 2, 3, 4});
+    Tensor m2 = matmul(m1, m1);
+    assert(m2.dtype() == DType::Int32);
+    assert(m2.data_ptr<int32_t>()[0] == 7 && m2.data_ptr<int32_t>()[3] == 22);
+    Tensor mt = transpose(m1);
+    assert(mt.data_ptr<int32_t>()[1] == 3);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_cast() {
+    std::cout << "[Test] Casting between dtypes..." << std::endl;
+    Tensor x({4}, {1.7f, -2.5f, 3.0f, 250.0f}, true);
+    Tensor i = x.to(DType::Int64);
+    assert(i.dtype() == DType::Int64 && !i.requires_grad());
+    assert(i.data_ptr<int64_t>()[0] == 1 && i.data_ptr<int64_t>()[1] == -2);
+    Tensor u = x.to(DType::UInt8);
+    assert(u.data_ptr<uint8_t>()[3] == 250);
+
+    Tensor d = x.to(DType::Float64);
+    assert(d.dtype() == DType::Float64 && d.requires_grad());
+    assert(d.data_ptr<double>()[0] == double(1.7f));
+    Tensor h = i.to(DType::Float16).to(DType::Int32);
+    assert(h.data_ptr<int32_t>()[2] == 3);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_masks() {
+    std::cout << "[Test] Comparison masks and where..." << std::endl;
+    Tensor a({2, 3}, {1, 5, 3, -1, 0, 7}, true);
+    Tensor t({3}, {2, 2, 2});
+    Tensor m = gt(a, t);
+    assert(m.dtype() == DType::UInt8 && m.data().nbytes() == 6);
+    const uint8_t* mp = m.data_ptr<uint8_t>();
+    assert(mp[0] == 0 && mp[1] == 1 && mp[2] == 1 && mp[5] == 1);
+    assert(eq(a, a).data_ptr<uint8_t>()[4] == 1);
+    assert(le(Tensor::from_data<int64_t>({1}, {3}), Tensor::from_data<int64_t>({1}, {3})).data_ptr<uint8_t>()[0] == 1);
+
+    Tensor b({1}, {0.0f}, true);
+    Tensor y = where(m, a, b); // relu-like 截断
+    assert(y.dtype() == DType::Float32);
+    assert(near(y[0], 0.0) && near(y[1], 5.0) && near(y[3], 0.0));
+    y.backward();
+    assert(near(a.grad()[0], 0.0) && near(a.grad()[1], 1.0) && near(a.grad()[5], 1.0));
+    assert(near(b.grad()[0], 3.0)); // 三个位置取 b，广播求和
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+// f(x, w) = sum((x * x + x / w) @ v)，全部在 Float64 中
+Tensor f64_graph(const Tensor& x, const Tensor& w, const Tensor& v) {
+    return matmul(x * x + x / w, v);
+}
+
+void test_float64_gradcheck() {
+    std::cout << "[Test] Float64 autograd passes a tight finite-difference check..." << std::endl;
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> dist(0.5, 1.5);
+    std::vector<double> xv(12), wv(4), vv(8);
+    for (auto& e : xv) e = dist(gen);
+    for (auto& e : wv) e = dist(gen);
+    for (auto& e : vv) e = dist(gen);
+    Tensor x = Tensor::from_data<double>({3, 4}, xv, true);
+    Tensor w = Tensor::from_data<double>({4}, wv, true); // 广播
+    Tensor v = Tensor::from_data<double>({4, 2}, vv);
+
+    Tensor y = f64_graph(x, w, v);
+    assert(y.dtype() == DType::Float64);
+    y.backward();
+    assert(x.grad().dtype() == DType::Float64 && w.grad().dtype() == DType::Float64);
+
+    auto total = [&](const Tensor& xx, const Tensor& ww) {
+        Tensor r = f64_graph(xx, ww, v);
+        double s = 0.0;
+        for (size_t i = 0; i < r.numel(); ++i) s += r.data_ptr<double>()[i];
+        return s;
+    };
+    const double eps = 1e-6;
+    for (Tensor* p : {&x, &w}) {
+        for (size_t i = 0; i < p->numel(); ++i) {
+            Tensor plus = Tensor::from_data<double>(p->shape(), std::vector<double>(p->data_ptr<double>(), p->data_ptr<double>() + p->numel()));
+            Tensor minus = Tensor::from_data<double>(p->shape(), std::vector<double>(p->data_ptr<double>(), p->data_ptr<double>() + p->numel()));
+            plus.data_ptr<double>()[i] += eps;
+            minus.data_ptr<double>()[i] -= eps;
+            double num = p == &x ? (total(plus, w) - total(minus, w)) / (2 * eps)
+                                 : (total(x, plus) - total(x, minus)) / (2 * eps);
+            double ana = p->grad().data_ptr<double>()[i];
+            assert(std::abs(num - ana) < 1e-7 * std::max(1.0, std::abs(ana)));
+        }
+    }
+
+    // Float32 与 Float64 混合：结果为 Float64，梯度按输入自己的类型回传
+    Tensor a({2}, {1.0f, 2.0f}, true);
+    Tensor b = Tensor::from_data<double>({2}, {3.0, 4.0}, true);
+    Tensor c = a * b;
+    assert(c.dtype() == DType::Float64);
+    c.backward();
+    assert(a.grad().dtype() == DType::Float32 && near(a.grad()[1], 4.0));
+    assert(near(b.grad().data_ptr<double>()[0], 1.0));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_integer_indices() {
+    std::cout << "[Test] Integer index tensors for embedding..." << std::endl;
+    Tensor w({5, 2}, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9}, true);
+    Tensor idx = Tensor::from_data<int64_t>({3}, {4, 0, 4});
+    Tensor e = embedding(w, idx);
+    assert(near(e[0], 8.0) && near(e[3], 1.0));
+    e.backward();
+    assert(near(w.grad()[8], 2.0));
+
+    Tensor bag = embedding_bag(w, Tensor::from_data<int32_t>({3}, {1, 2, 3}),
+                               Tensor::from_data<int32_t>({2}, {0, 1}), BagMode::Sum);
+    assert(near(bag[0], 2.0) && near(bag[2], 4.0 + 6.0));
+
+    bool threw = false;
+    try { embedding(w, Tensor({1}, {1.0f})); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_checkpoint_dtypes() {
+    std::cout << "[Test] Checkpoints keep integer / float64 dtypes..." << std::endl;
+    const char* path = "test_dtypes_ckpt.bin";
+    Tensor labels = Tensor::from_data<int64_t>({3}, {1LL << 40, 2, 3});
+    Tensor mask = Tensor::from_data<uint8_t>({2}, {0, 1});
+    Tensor d = Tensor::from_data<double>({1}, {0.1});
+    save_tensors(path, {{"labels", labels}, {"mask", mask}, {"d", d}});
+    auto loaded = load_tensors(path);
+    assert(loaded[0].second.dtype() == DType::Int64);
+    assert(loaded[0].second.data_ptr<int64_t>()[0] == (1LL << 40));
+    assert(loaded[1].second.data_ptr<uint8_t>()[1] == 1);
+    assert(loaded[2].second.data_ptr<double>()[0] == 0.1);
+    std::remove(path);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_promotion();
+        test_integer_tensors();
+        test_cast();
+        test_masks();
+        test_float64_gradcheck();
+        test_integer_indices();
+        test_checkpoint_dtypes();
+        std::cout << "\nAll dtype tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "module.hpp"
+#include "optim.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <memory>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-5f) {
+    return std::abs(a - b) < tol;
+}
+
+void test_embedding_dense_and_sparse() {
+    std::cout << "[Test] Embedding dense vs row-sparse grad..." << std::endl;
+    std::vector<float> table = {0, 1, 10, 11, 20, 21, 30, 31};
+    Tensor dense({4, 2}, table, true);
+    Tensor sparse({4, 2}, table);
+    sparse.set_sparse_grad(true);
+    sparse.set_requires_grad(true);
+    assert(sparse.grad().empty()); // 不分配整张表的梯度
+
+    std::vector<size_t> idx = {2, 0, 2, 2};
+    Tensor w({4, 2}, {1, 2, 3, 4, 5, 6, 7, 8});
+    Tensor yd = embedding(dense, idx);
+    assert(near(yd[0], 20.0f) && near(yd[3], 1.0f));
+    Tensor ld = yd * w;
+    ld.backward();
+
+    Tensor ls = embedding(sparse, idx) * w;
+    ls.backward();
+
+    // 重复的 index 2 被合并成一行
+    const auto& sg = sparse.sparse_grad();
+    assert(sg.indices.size() == 2 && sg.indices[0] == 0 && sg.indices[1] == 2);
+    assert(near(sg.values[0], 3.0f) && near(sg.values[1], 4.0f));
+    assert(near(sg.values[2], 1 + 5 + 7.0f) && near(sg.values[3], 2 + 6 + 8.0f));
+    assert(near(dense.grad()[4], 13.0f) && near(dense.grad()[2], 0.0f));
+
+    // 第二次使用同一张表：新行与已有行归并
+    Tensor l2 = embedding(sparse, {3, 0});
+    l2.backward();
+    assert(sg.indices.size() == 3 && sg.indices[2] == 3);
+    assert(near(sg.values[0], 4.0f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_embedding_bag() {
+    std::cout << "[Test] EmbeddingBag sum / mean..." << std::endl;
+    EmbeddingBag bag(5, 3, BagMode::Mean, true, 7);
+    std::vector<size_t> idx = {1, 4, 1, 0};
+    std::vector<size_t> off = {0, 3};
+    Tensor y = bag.forward(idx, off);
+    assert(y.shape()[0] == 2 && y.shape()[1] == 3);
+    const Tensor& W = bag.weight;
+    float expect = (W[1 * 3] * 2 + W[4 * 3]) / 3.0f;
+    assert(near(y[0], expect));
+    assert(near(y[3], W[0]));
+
+    y.backward();
+    const auto& sg = bag.weight.sparse_grad();
+    // 行 1 在第一个 bag 里出现两次：2 / 3
+    assert(sg.indices.size() == 3);
+    assert(near(sg.values[1 * 3], 2.0f / 3.0f));
+    assert(near(sg.values[0], 1.0f));
+
+    // offsets 必须从 0 开始覆盖全部 indices，否则前向跳过的位置在反向会拿到错误的梯度行
+    auto rejects = [&](const std::vector<size_t>& i, const std::vector<size_t>& o) {
+        try {
+            embedding_bag(bag.weight, i, o);
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    assert(rejects({1, 4, 1, 0}, {1, 3}));    // offsets[0] != 0：indices[0] 不属于任何 bag
+    assert(rejects({1, 4, 1, 0}, {}));        // 空 offsets 配非空 indices
+    assert(rejects({1, 4, 1, 0}, {0, 3, 2})); // 递减
+    assert(rejects({1, 4, 1, 0}, {0, 5}));    // 越过末尾
+    Tensor empty = embedding_bag(bag.weight, std::vector<size_t>{}, std::vector<size_t>{});
+    assert(empty.shape()[0] == 0);
+    Tensor with_empty_bags = embedding_bag(bag.weight, {2}, {0, 0, 1}); // 空 bag 输出零
+    assert(with_empty_bags.shape()[0] == 3 && near(with_empty_bags[0], 0.0f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_sparse_optimizers() {
+    std::cout << "[Test] SparseSGD / SparseAdagrad / SparseAdam touch only used rows..." << std::endl;
+    for (int kind = 0; kind < 3; ++kind) {
+        Embedding emb(6, 2, true, 3);
+        std::vector<float> before = emb.weight.data().to_vector();
+        std::unique_ptr<Optimizer> opt;
+        if (kind == 0) opt.reset(new SparseSGD(emb.parameters(), 0.1f));
+        if (kind == 1) opt.reset(new SparseAdagrad(emb.parameters(), 0.1f));
+        if (kind == 2) opt.reset(new SparseAdam(emb.parameters(), 0.1f));
+        opt->zero_grad();
+        Tensor y = emb.forward({4, 1, 4});
+        y.backward();
+        opt->step();
+
+        for (size_t r = 0; r < 6; ++r) {
+            bool touched = r == 1 || r == 4;
+            for (size_t j = 0; j < 2; ++j) {
+                float now = emb.weight[r * 2 + j], old = before[r * 2 + j];
+                assert(touched ? now < old : now == old);
+            }
+        }
+        if (kind == 0) assert(near(emb.weight[8], before[8] - 0.2f));
+        if (kind == 2) assert(near(emb.weight[2], before[2] - 0.1f, 1e-4f));
+        opt->zero_grad();
+        assert(emb.weight.sparse_grad().empty());
+    }
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_embedding_dense_and_sparse();
+        test_embedding_bag();
+        test_sparse_optimizers();
+        std::cout << "\nAll embedding tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
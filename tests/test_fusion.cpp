@@ -0,0 +1,159 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "module.hpp"
+#include "graph.hpp"
+#include "fusion.hpp"
+#include "memory_plan.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+std::vector<float> random_values(size_t n, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> v(n);
+    for (auto& x : v) x = dist(gen);
+    return v;
+}
+
+bool all_near(const Storage& a, const Storage& b, float tol = 1e-4f) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (!near(a[i], b[i], tol)) return false;
+    }
+    return true;
+}
+
+void test_relu() {
+    std::cout << "[Test] relu forward / backward..." << std::endl;
+    Tensor x({4}, {-1.0f, 0.0f, 2.0f, 3.0f}, true);
+    Tensor w({4}, {1.0f, 2.0f, 3.0f, 4.0f});
+    Tensor y = mul(relu(x), w);
+    y.backward();
+    assert(near(y[0], 0.0f) && near(y[2], 6.0f) && near(y[3], 12.0f));
+    assert(near(x.grad()[0], 0.0f) && near(x.grad()[1], 0.0f));
+    assert(near(x.grad()[2], 3.0f) && near(x.grad()[3], 4.0f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+struct Model {
+    Linear l1, l2, l3;
+    Tensor wts;
+    Model() : l1(6, 16, true, 1), l2(16, 16, true, 2), l3(16, 4, true, 3), wts({1, 4}, random_values(4, 4), true) {}
+
+    Tensor step(const Tensor& x, const Tensor& target) const {
+        Tensor h = relu(l1.forward(x));
+        h = relu(l2.forward(h));
+        Tensor z = l3.forward(h);
+        // sub -> mul (按行广播) -> relu -> neg 组成一条逐元素链
+        Tensor loss = neg(relu(mul(sub(target, z), wts)));
+        loss.backward();
+        return loss;
+    }
+    void zero_grad() {
+        l1.zero_grad();
+        l2.zero_grad();
+        l3.zero_grad();
+        wts.zero_grad();
+    }
+};
+
+void test_fused_training_step() {
+    std::cout << "[Test] Fused training step matches unfused replay..." << std::endl;
+    Model fused_model, ref_model;
+    Tensor x({10, 6}, random_values(60, 10)), target({10, 4}, random_values(40, 11));
+    Tensor rx({10, 6}, x.data().to_vector()), rt({10, 4}, target.data().to_vector());
+
+    CapturedGraph g = capture_graph([&] { return fused_model.step(x, target); });
+    CapturedGraph ref = capture_graph([&] { return ref_model.step(rx, rt); });
+    FusionStats st = fuse_graph(g);
+    assert(st.matmul_epilogues == 3);
+    assert(st.elementwise_chains == 1);
+    assert(st.nodes_after == 4);
+    assert(st.nodes_before == ref.nodes().size());
+    assert(g.backward_steps().size() == 4);
+
+    const GraphNode& first = g.nodes()[0];
+    assert(first.kind == OpKind::FusedMatMul);
+    assert(first.fused.size() == 3 && first.fused[1] == OpKind::Add && first.fused[2] == OpKind::Relu);
+    assert(g.nodes()[2].fused.size() == 2); // l3：matmul + bias，无激活
+    const GraphNode& chain = g.nodes()[3];
+    assert(chain.kind == OpKind::FusedElementwise);
+    assert(chain.fused.size() == 4 && chain.fused[0] == OpKind::Sub && chain.fused[3] == OpKind::Neg);
+    assert(chain.inputs.size() == 3); // target, z, wts
+
+    for (uint32_t rep = 0; rep < 3; ++rep) {
+        x.data() = random_values(60, 100 + rep);
+        target.data() = random_values(40, 200 + rep);
+        rx.data() = x.data();
+        rt.data() = target.data();
+        fused_model.zero_grad();
+        ref_model.zero_grad();
+        g.replay();
+        ref.replay();
+
+        assert(all_near(g.output().data(), ref.output().data()));
+        assert(all_near(fused_model.l1.weight.grad(), ref_model.l1.weight.grad()));
+        assert(all_near(fused_model.l1.bias.grad(), ref_model.l1.bias.grad()));
+        assert(all_near(fused_model.l2.weight.grad(), ref_model.l2.weight.grad()));
+        assert(all_near(fused_model.l3.weight.grad(), ref_model.l3.weight.grad()));
+        assert(all_near(fused_model.l3.bias.grad(), ref_model.l3.bias.grad()));
+        assert(all_near(fused_model.wts.grad(), ref_model.wts.grad()));
+    }
+
+    // 融合之后照常做内存规划
+    MemoryPlan plan = plan_memory(g);
+    assert(plan.planned_bytes <= plan.naive_bytes);
+    g.replay();
+    bool threw = false;
+    try {
+        fuse_graph(g);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_scalar_ops_and_grad_cut() {
+    std::cout << "[Test] Scalar ops fuse only when they do not cut gradients..." << std::endl;
+    Tensor b({1, 5}, random_values(5, 2));
+    Tensor x({3, 5}, random_values(15, 1));
+    CapturedGraph g = capture_graph([&] { return relu(add(mul(x, 2.0f), b)); });
+    FusionStats st = fuse_graph(g);
+    assert(st.elementwise_chains == 1 && st.nodes_after == 1);
+    x.data() = random_values(15, 3);
+    g.replay();
+    for (size_t i = 0; i < 15; ++i) {
+        float ref = std::max(0.0f, x[i] * 2.0f + b[i % 5]);
+        assert(near(g.output()[i], ref));
+    }
+
+    // x 需要梯度时 mul(x, 2) 截断了梯度，不参与融合，只融合 add -> relu
+    Tensor xg({3, 5}, random_values(15, 1), true);
+    CapturedGraph g2 = capture_graph([&] { return relu(add(mul(xg, 2.0f), b)); });
+    FusionStats st2 = fuse_graph(g2);
+    assert(st2.elementwise_chains == 1 && st2.nodes_after == 2);
+    assert(g2.nodes()[0].kind == OpKind::MulScalar);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_relu();
+        test_fused_training_step();
+        test_scalar_ops_and_grad_cut();
+        std::cout << "\nAll fusion tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "module.hpp"
+#include "graph.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+std::vector<float> random_values(size_t n, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> v(n);
+    for (auto& x : v) x = dist(gen);
+    return v;
+}
+
+bool all_near(const Storage& a, const Storage& b, float tol = 1e-4f) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (!near(a[i], b[i], tol)) return false;
+    }
+    return true;
+}
+
+// 两层 MLP + 平方误差，backward 的种子是全 1，相当于对 loss 求和
+Tensor mlp_step(const Linear& l1, const Linear& l2, const Tensor& x, const Tensor& target) {
+    Tensor h = layer_norm(l1.forward(x), Tensor({8}, std::vector<float>(8, 1.0f)),
+                          Tensor({8}, std::vector<float>(8, 0.0f)));
+    Tensor d = sub(l2.forward(mul(h, 0.5f)), target);
+    Tensor loss = mul(d, d);
+    loss.backward();
+    return loss;
+}
+
+void test_replay_matches_eager() {
+    std::cout << "[Test] Replayed MLP step matches eager execution..." << std::endl;
+    Linear l1(4, 8, true, 1), l2(8, 3, true, 2);
+    Linear e1(4, 8, true, 1), e2(8, 3, true, 2);
+
+    Tensor x({5, 4}, random_values(20, 10));
+    Tensor target({5, 3}, random_values(15, 11));
+    CapturedGraph g = capture_graph([&] { return mlp_step(l1, l2, x, target); });
+    assert(g.has_backward());
+    assert(!g.nodes().empty());
+    assert(g.backward_steps().size() > 0);
+
+    for (uint32_t step = 0; step < 3; ++step) {
+        // 新 batch 写进录制时固定的输入缓冲
+        x.data() = random_values(20, 100 + step);
+        target.data() = random_values(15, 200 + step);
+        l1.zero_grad();
+        l2.zero_grad();
+        g.replay();
+
+        e1.zero_grad();
+        e2.zero_grad();
+        Tensor ex({5, 4}, x.data().to_vector());
+        Tensor et({5, 3}, target.data().to_vector());
+        Tensor loss = mlp_step(e1, e2, ex, et);
+
+        assert(all_near(g.output().data(), loss.data()));
+        assert(all_near(l1.weight.grad(), e1.weight.grad()));
+        assert(all_near(l1.bias.grad(), e1.bias.grad()));
+        assert(all_near(l2.weight.grad(), e2.weight.grad()));
+        assert(all_near(l2.bias.grad(), e2.bias.grad()));
+    }
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_recorded_nodes() {
+    std::cout << "[Test] Recorded node sequence and forward-only replay..." << std::endl;
+    Tensor a({2, 3}, {1, 2, 3, 4, 5, 6});
+    Tensor b({3, 2}, {1, 0, 0, 1, 1, 1});
+    CapturedGraph g = capture_graph([&] { return add(matmul(a, b), 1.0f); });
+    assert(!g.has_backward());
+    assert(g.nodes().size() == 2);
+    assert(g.nodes()[0].kind == OpKind::MatMul);
+    assert(g.nodes()[1].kind == OpKind::AddScalar);
+    assert(g.nodes()[1].scalar == 1.0f);
+
+    const float* before = g.output().data().data();
+    a.data() = {0, 0, 0, 1, 1, 1};
+    g.replay();
+    // 输出缓冲不变，只是内容被重新计算
+    assert(g.output().data().data() == before);
+    std::vector<float> expect = {1, 1, 3, 3};
+    for (size_t i = 0; i < expect.size(); ++i) assert(near(g.output().data()[i], expect[i]));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_backward_ops_not_recorded() {
+    std::cout << "[Test] Ops called inside GradFns are not recorded as forward nodes..." << std::endl;
+    Tensor x({2, 3}, {1, 2, 3, 4, 5, 6});
+    Tensor w({3, 2}, {1, 0, 0, 1, 1, 1}, true);
+    // MatMulGradFn 内部会调用 transpose / matmul，这些不应成为前向节点
+    CapturedGraph g = capture_graph([&] {
+        Tensor y = matmul(x, w);
+        y.backward();
+        return y;
+    });
+    assert(g.nodes().size() == 1 && g.nodes()[0].kind == OpKind::MatMul);
+    assert(g.has_backward() && g.backward_steps().size() == 1);
+
+    for (int step = 0; step < 2; ++step) {
+        w.zero_grad();
+        g.replay();
+        // dW = x^T · 1：每行是 x 对应列之和
+        std::vector<float> expect = {5, 5, 7, 7, 9, 9};
+        for (size_t i = 0; i < expect.size(); ++i) assert(near(w.grad()[i], expect[i]));
+    }
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_unsupported_ops_throw() {
+    std::cout << "[Test] Unsupported ops and nested capture throw..." << std::endl;
+    Tensor q({1, 2, 4}, random_values(8, 3));
+    bool threw = false;
+    try {
+        capture_graph([&] { return scaled_dot_product_attention(q, q, q); });
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(!is_capturing());
+
+    threw = false;
+    try {
+        capture_graph([&] {
+            capture_graph([&] { return add(q, 1.0f); });
+            return q;
+        });
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(!is_capturing());
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_replay_matches_eager();
+        test_recorded_nodes();
+        test_backward_ops_not_recorded();
+        test_unsupported_ops_throw();
+        std::cout << "\nAll graph tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "module.hpp"
+#include "graph.hpp"
+#include "memory_plan.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+std::vector<float> random_values(size_t n, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> v(n);
+    for (auto& x : v) x = dist(gen);
+    return v;
+}
+
+bool all_near(const std::vector<float>& a, const Storage& b, float tol = 1e-4f) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (!near(a[i], b[i], tol)) return false;
+    }
+    return true;
+}
+
+void test_training_step_plan() {
+    std::cout << "[Test] Planned training step matches unplanned replay..." << std::endl;
+    Linear l1(16, 32, true, 1), l2(32, 32, true, 2), l3(32, 8, true, 3);
+    Tensor gamma({32}, std::vector<float>(32, 1.0f)), beta({32}, std::vector<float>(32, 0.0f));
+    Tensor x({12, 16}, random_values(12 * 16, 10));
+    Tensor target({12, 8}, random_values(12 * 8, 11));
+
+    CapturedGraph g = capture_graph([&] {
+        Tensor h = layer_norm(l1.forward(x), gamma, beta);
+        h = rms_norm(l2.forward(h), gamma);
+        Tensor d = sub(l3.forward(h), target);
+        Tensor loss = mul(d, d);
+        loss.backward();
+        return loss;
+    });
+
+    auto run = [&] {
+        l1.zero_grad();
+        l2.zero_grad();
+        l3.zero_grad();
+        g.replay();
+    };
+
+    // 未规划时的结果作为参考
+    x.data() = random_values(12 * 16, 20);
+    run();
+    std::vector<float> out = g.output().data().to_vector();
+    std::vector<float> gw1 = l1.weight.grad().to_vector();
+    std::vector<float> gb2 = l2.bias.grad().to_vector();
+    std::vector<float> gw3 = l3.weight.grad().to_vector();
+
+    MemoryPlan plan = plan_memory(g);
+    assert(g.is_memory_planned());
+    std::cout << "  naive " << plan.naive_bytes << " B, planned " << plan.planned_bytes
+              << " B, live lower bound " << plan.live_bytes << " B, in-place " << plan.num_inplace << std::endl;
+    assert(plan.num_buffers > 0);
+    assert(plan.planned_bytes < plan.naive_bytes);
+    assert(plan.planned_bytes >= plan.live_bytes);
+    // matmul 的输出只被加 bias 用到，且 Add 的反向不读输入，bias 加法直接写回
+    assert(plan.num_inplace >= 3);
+
+    // 两次重放都应与参考一致 (第二次验证按需清零的中间梯度没有残留)
+    for (int rep = 0; rep < 2; ++rep) {
+        run();
+        assert(all_near(out, g.output().data()));
+        assert(all_near(gw1, l1.weight.grad()));
+        assert(all_near(gb2, l2.bias.grad()));
+        assert(all_near(gw3, l3.weight.grad()));
+    }
+
+    bool threw = false;
+    try {
+        plan_memory(g);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_inference_chain_inplace() {
+    std::cout << "[Test] Elementwise chain reuses a single buffer..." << std::endl;
+    Tensor x({4, 8}, random_values(32, 1));
+    Tensor w({8, 8}, random_values(64, 2));
+    CapturedGraph g = capture_graph([&] {
+        Tensor y = matmul(x, w);
+        y = add(y, 1.0f);
+        y = mul(y, 2.0f);
+        y = sub(y, x);
+        return neg(y);
+    });
+    g.replay();
+    std::vector<float> ref = g.output().data().to_vector();
+
+    MemoryPlan plan = plan_memory(g);
+    // matmul 的输出缓冲被后面三个逐元素算子依次复用，图的输出自己单独一块 (不参与规划)
+    assert(plan.num_buffers == 1);
+    assert(plan.num_inplace == 3);
+    assert(plan.naive_bytes == 4 * 32 * sizeof(float));
+    assert(plan.planned_bytes == 32 * sizeof(float));
+
+    g.replay();
+    assert(all_near(ref, g.output().data()));
+
+    // 不允许原地时每个缓冲单独存在，但相邻两步以外的缓冲仍可错开复用
+    Tensor x2({4, 8}, x.data().to_vector());
+    CapturedGraph g2 = capture_graph([&] { return neg(mul(add(matmul(x2, w), 1.0f), 2.0f)); });
+    MemoryPlan no_inplace = plan_memory(g2, false);
+    assert(no_inplace.num_inplace == 0);
+    assert(no_inplace.num_buffers == 3);
+    assert(no_inplace.planned_bytes == 2 * 32 * sizeof(float));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_relu_backward_keeps_input() {
+    std::cout << "[Test] Relu input stays live until its backward runs..." << std::endl;
+    for (bool inplace : {true, false}) {
+        Tensor x({4, 8}, random_values(32, 3));
+        Tensor w({8, 6}, random_values(48, 4), true);
+        // ReluGradFn 读 matmul 的输出判断符号，这块缓冲不能被原地覆盖或提前复用
+        CapturedGraph g = capture_graph([&] {
+            Tensor y = relu(matmul(x, w));
+            y.backward();
+            return y;
+        });
+        w.zero_grad();
+        g.replay();
+        std::vector<float> ref = w.grad().to_vector();
+        bool nonzero = false;
+        for (float v : ref) nonzero |= v != 0.0f;
+        assert(nonzero);
+
+        plan_memory(g, inplace);
+        for (int rep = 0; rep < 2; ++rep) {
+            w.zero_grad();
+            g.replay();
+            assert(all_near(ref, w.grad()));
+        }
+    }
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_training_step_plan();
+        test_inference_chain_inplace();
+        test_relu_backward_keeps_input();
+        std::cout << "\nAll memory plan tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "memory_profiler.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+const LiveTensor* find_tensor(const MemorySnapshot& s, const std::vector<size_t>& shape) {
+    for (const LiveTensor& t : s.tensors) {
+        if (t.shape == shape) return &t;
+    }
+    return nullptr;
+}
+
+void test_current_and_peak() {
+    std::cout << "[Test] MemoryProfiler tracks data and grad buffers, current and peak..." << std::endl;
+    Tensor before({1000}, 1.0f); // 开启前分配的不计入
+    MemoryProfiler mp;
+    assert(mp.current_bytes() == 0);
+    {
+        Tensor a({64, 32}, 1.0f);
+        assert(mp.current_bytes() == 64 * 32 * sizeof(float));
+        Tensor w({32, 16}, 0.5f, true);
+        MemoryUsage u = mp.current_usage();
+        assert(u.bytes(MemoryKind::Data) == (64 * 32 + 32 * 16) * sizeof(float));
+        assert(u.bytes(MemoryKind::Grad) == 32 * 16 * sizeof(float));
+        assert(u.total == u.bytes(MemoryKind::Data) + u.bytes(MemoryKind::Grad));
+        Tensor d({8}, DType::Float64);
+        assert(mp.current_bytes() == u.total + 8 * sizeof(double));
+    }
+    // 全部释放：当前回到 0，峰值保留
+    assert(mp.current_bytes() == 0);
+    const size_t peak = (64 * 32 + 2 * 32 * 16) * sizeof(float) + 8 * sizeof(double);
+    assert(mp.peak_bytes() == peak);
+    assert(mp.peak_usage().bytes(MemoryKind::Grad) == 32 * 16 * sizeof(float));
+    before = Tensor(); // 开启前的块释放时被忽略
+    assert(mp.current_bytes() == 0);
+    mp.reset_peak();
+    assert(mp.peak_bytes() == 0);
+
+    auto tl = mp.timeline();
+    assert(!tl.empty() && tl.back().usage.total == 0);
+    size_t allocs = 0;
+    for (const MemoryEvent& e : tl) allocs += e.delta > 0;
+    assert(allocs == 4);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_op_attribution_and_graph_retention() {
+    std::cout << "[Test] Snapshot attributes buffers to ops and finds graph-retained tensors..." << std::endl;
+    Tensor x({16, 32}, 1.0f, true);
+    Tensor w({32, 24}, 0.1f, true);
+    MemoryProfiler mp;
+    Tensor y;
+    {
+        Tensor h = matmul(x, w); // 只有 relu 的反向节点还引用它
+        y = relu(h);
+    }
+    MemorySnapshot s = mp.snapshot();
+    const LiveTensor* h = find_tensor(s, {16, 24});
+    assert(h && s.tensors.size() == 2);
+    // h 与 y 形状相同，按登记顺序 h 在前
+    const LiveTensor* first = s.tensors[0].id < s.tensors[1].id ? &s.tensors[0] : &s.tensors[1];
+    const LiveTensor* second = first == &s.tensors[0] ? &s.tensors[1] : &s.tensors[0];
+    assert(first->data_op == "matmul" && first->grad_fn == "MatMulBackward" && first->graph_retained);
+    assert(second->data_op == "relu" && second->grad_fn == "ReluBackward" && !second->graph_retained);
+    assert(first->data_bytes == 16 * 24 * sizeof(float) && first->grad_bytes == 16 * 24 * sizeof(float));
+    assert(first->grad_op == "matmul");
+    assert(s.graph_retained_bytes == first->bytes());
+    assert(s.user_held_bytes == second->bytes());
+    assert(s.current.total == s.graph_retained_bytes + s.user_held_bytes);
+
+    std::string table = s.to_string();
+    assert(table.find("graph-retained") != std::string::npos);
+    assert(table.find("matmul") != std::string::npos && table.find("ReluBackward") != std::string::npos);
+    std::string json = s.to_json();
+    assert(json.find("\"graph_retained\":true") != std::string::npos);
+    assert(json.find("\"data_op\":\"relu\"") != std::string::npos);
+
+    // 反向中的临时缓冲记为 scratch，并归到执行它的反向节点
+    y.backward();
+    bool scratch = false;
+    for (const MemoryEvent& e : mp.timeline()) {
+        if (e.kind == MemoryKind::Scratch && e.delta > 0) {
+            assert(!e.op.empty());
+            scratch = true;
+        }
+    }
+    assert(scratch);
+    assert(mp.current_usage().bytes(MemoryKind::Scratch) == 0);
+    assert(near(w.grad()[0], 16.0f));
+
+    // 丢掉输出后整张图连同 h 一起释放
+    y = Tensor();
+    assert(mp.current_bytes() == 0);
+    assert(mp.snapshot().tensors.empty());
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_threads_and_lifecycle() {
+    std::cout << "[Test] MemoryProfiler counts every thread and stops cleanly..." << std::endl;
+    Tensor kept;
+    {
+        MemoryProfiler mp;
+        bool threw = false;
+        try {
+            MemoryProfiler second;
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+
+        std::thread t([&] { kept = add(Tensor({128}, 1.0f), Tensor({128}, 2.0f)); });
+        t.join();
+        assert(mp.current_bytes() == 128 * sizeof(float));
+        MemorySnapshot s = mp.snapshot();
+        assert(s.tensors.size() == 1 && s.tensors[0].data_op == "add");
+
+        std::string trace = mp.timeline_trace();
+        assert(trace.find("\"traceEvents\"") != std::string::npos);
+        assert(trace.find("\"ph\":\"C\"") != std::string::npos);
+        mp.stop();
+        assert(!memory_profiling_enabled());
+        Tensor later({64}, 1.0f);
+        assert(mp.current_bytes() == 128 * sizeof(float));
+        size_t events = mp.timeline().size();
+        kept = Tensor();
+        assert(mp.timeline().size() == events);
+    }
+    // 停止后可以重新开启
+    MemoryProfiler again;
+    Tensor z({4}, 1.0f);
+    assert(again.current_bytes() == 4 * sizeof(float));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_current_and_peak();
+        test_op_attribution_and_graph_retention();
+        test_threads_and_lifecycle();
+        std::cout << "\nAll memory profiler tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,233 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "module.hpp"
+#include "optim.hpp"
+#include "amp.hpp"
+#include "serialize.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+Tensor random_tensor(const std::vector<size_t>& shape, uint32_t seed, bool requires_grad = false) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    Tensor t(shape, requires_grad);
+    for (auto& v : t.data()) v = dist(gen);
+    return t;
+}
+
+float bits_to_float(uint32_t x) {
+    float f;
+    std::memcpy(&f, &x, 4);
+    return f;
+}
+
+void test_scalar_conversion() {
+    std::cout << "[Test] Scalar fp16 / bf16 conversion..." << std::endl;
+    assert(float_to_half(1.0f) == 0x3c00);
+    assert(float_to_half(-2.0f) == 0xc000);
+    assert(float_to_half(65504.0f) == 0x7bff);
+    assert(float_to_half(65520.0f) == 0x7c00);         // 舍入到 Inf
+    assert(float_to_half(std::ldexp(1.0f, -24)) == 0x0001); // 最小次正规数
+    assert(float_to_half(1.0f + std::ldexp(1.0f, -11)) == 0x3c00); // 平局舍入到偶数
+    assert(std::isnan(half_to_float(float_to_half(std::numeric_limits<float>::quiet_NaN()))));
+    assert(half_to_float(0x7c00) == std::numeric_limits<float>::infinity());
+    assert(half_to_float(0x0001) == std::ldexp(1.0f, -24));
+
+    assert(float_to_bf16(1.0f) == 0x3f80);
+    assert(float_to_bf16(bits_to_float(0x3f808000)) == 0x3f80); // 平局，偶数不进位
+    assert(float_to_bf16(bits_to_float(0x3f818000)) == 0x3f82); // 平局，奇数进位
+    assert(std::isnan(bf16_to_float(float_to_bf16(std::numeric_limits<float>::quiet_NaN()))));
+    assert(bf16_to_float(0x4049) == bits_to_float(0x40490000));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_bulk_conversion() {
+    std::cout << "[Test] Bulk conversion matches scalar path..." << std::endl;
+    const size_t n = 1003; // 不是向量宽度的整数倍
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dist(-1000.0f, 1000.0f);
+    std::vector<float> src(n);
+    for (auto& v : src) v = dist(gen);
+
+    std::vector<uint16_t> h(n), b(n);
+    convert(src.data(), DType::Float32, h.data(), DType::Float16, n);
+    convert(src.data(), DType::Float32, b.data(), DType::BFloat16, n);
+    std::vector<float> hf(n), bf(n);
+    convert(h.data(), DType::Float16, hf.data(), DType::Float32, n);
+    convert(b.data(), DType::BFloat16, bf.data(), DType::Float32, n);
+    for (size_t i = 0; i < n; ++i) {
+        assert(h[i] == float_to_half(src[i]));
+        assert(b[i] == float_to_bf16(src[i]));
+        assert(hf[i] == half_to_float(h[i]));
+        assert(bf[i] == bf16_to_float(b[i]));
+    }
+
+    // 半精度之间经 fp32 中转
+    std::vector<uint16_t> hb(n);
+    convert(h.data(), DType::Float16, hb.data(), DType::BFloat16, n);
+    for (size_t i = 0; i < n; ++i) assert(hb[i] == float_to_bf16(half_to_float(h[i])));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_half_storage() {
+    std::cout << "[Test] Half-precision storage and cast..." << std::endl;
+    Tensor x = random_tensor({4, 8}, 1, true);
+    Tensor h = x.to(DType::BFloat16);
+    assert(h.dtype() == DType::BFloat16);
+    assert(h.data().nbytes() == 4 * 8 * 2);
+    bool threw = false;
+    try { (void)h.data().data(); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw); // 不能把半精度存储当 float 读
+
+    Tensor back = h.to(DType::Float32);
+    for (size_t i = 0; i < x.numel(); ++i) assert(near(back[i], x[i], 1e-2f));
+    back.backward();
+    for (size_t i = 0; i < x.numel(); ++i) assert(near(x.grad()[i], 1.0f)); // 梯度是 fp32
+    assert(x.to(DType::Float32).data().data() == x.data().data());
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_mixed_elementwise() {
+    std::cout << "[Test] Elementwise ops on half inputs accumulate in fp32..." << std::endl;
+    Tensor a = random_tensor({3, 5}, 2, true);
+    Tensor b = random_tensor({3, 5}, 3, true);
+    Tensor ah = a.to(DType::Float16), bh = b.to(DType::Float16);
+
+    Tensor c = ah * bh;
+    assert(c.dtype() == DType::Float16);
+    Tensor c32 = c.to(DType::Float32);
+    for (size_t i = 0; i < a.numel(); ++i) assert(near(c32[i], a[i] * b[i], 2e-3f));
+
+    // 与 fp32 混合时提升为 fp32；广播也可用
+    Tensor bias = random_tensor({5}, 4, true);
+    Tensor d = ah + bias;
+    assert(d.dtype() == DType::Float32);
+    for (size_t i = 0; i < a.numel(); ++i) assert(near(d[i], a[i] + bias[i % 5], 2e-3f));
+
+    c32.backward();
+    for (size_t i = 0; i < a.numel(); ++i) {
+        assert(near(a.grad()[i], b[i], 2e-3f));
+        assert(near(b.grad()[i], a[i], 2e-3f));
+    }
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_mixed_matmul() {
+    std::cout << "[Test] Half-precision matmul with fp32 accumulation..." << std::endl;
+    Tensor a = random_tensor({37, 64}, 5, true);
+    Tensor b = random_tensor({64, 19}, 6, true);
+    Tensor ref = matmul(a, b);
+    Tensor y = matmul(a.to(DType::BFloat16), b.to(DType::BFloat16));
+    assert(y.dtype() == DType::BFloat16);
+    Tensor y32 = y.to(DType::Float32);
+    for (size_t i = 0; i < ref.numel(); ++i) assert(near(y32[i], ref[i], 0.1f));
+
+    y32.backward();
+    // dA = 1 * B^T：每行等于 B 的行和
+    for (size_t i = 0; i < 37; ++i) {
+        for (size_t p = 0; p < 64; ++p) {
+            float s = 0.0f;
+            for (size_t j = 0; j < 19; ++j) s += b[p * 19 + j];
+            assert(near(a.grad()[i * 64 + p], s, 0.1f));
+        }
+    }
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_autocast_linear() {
+    std::cout << "[Test] Autocast runs Linear in bf16 with fp32 master weights..." << std::endl;
+    Linear fc(16, 8, true, 11);
+    Tensor x = random_tensor({4, 16}, 12);
+    Tensor ref = fc.forward(x);
+    Tensor y;
+    {
+        AutocastGuard guard(DType::BFloat16);
+        y = fc.forward(x);
+        assert(autocast_dtype() == DType::BFloat16);
+    }
+    assert(autocast_dtype() == DType::Float32);
+    assert(y.dtype() == DType::BFloat16);
+    Tensor y32 = y.to(DType::Float32);
+    for (size_t i = 0; i < ref.numel(); ++i) assert(near(y32[i], ref[i], 0.05f));
+
+    y32.backward();
+    assert(fc.weight.dtype() == DType::Float32);
+    assert(fc.weight.grad().size() == fc.weight.numel());
+    for (size_t j = 0; j < 8; ++j) assert(near(fc.bias.grad()[j], 4.0f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_grad_scaler() {
+    std::cout << "[Test] GradScaler unscale / skip on overflow / growth..." << std::endl;
+    Tensor w({2}, {1.0f, 2.0f}, true);
+    SGD opt({w}, 0.1f);
+    GradScaler scaler(1024.0f, 2.0f, 0.5f, 2);
+
+    Tensor loss = scaler.scale(w * Tensor({2}, {3.0f, 4.0f}));
+    loss.backward();
+    assert(near(w.grad()[0], 3.0f * 1024.0f));
+    assert(scaler.step(opt));
+    scaler.update();
+    assert(near(w[0], 1.0f - 0.1f * 3.0f) && near(w[1], 2.0f - 0.1f * 4.0f));
+
+    // 梯度溢出：跳过更新，scale 减半
+    opt.zero_grad();
+    w.grad()[1] = std::numeric_limits<float>::infinity();
+    float w0 = w[0];
+    assert(!scaler.step(opt));
+    scaler.update();
+    assert(w[0] == w0);
+    assert(near(scaler.get_scale(), 512.0f));
+
+    // 连续 growth_interval 步正常后 scale 翻倍
+    for (int i = 0; i < 2; ++i) {
+        opt.zero_grad();
+        assert(scaler.step(opt));
+        scaler.update();
+    }
+    assert(near(scaler.get_scale(), 1024.0f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_half_checkpoint() {
+    std::cout << "[Test] Half-precision tensors in checkpoints..." << std::endl;
+    const char* path = "test_mixed_precision_ckpt.bin";
+    Tensor x = random_tensor({3, 7}, 13).to(DType::Float16);
+    save_tensors(path, {{"x", x}});
+    for (bool use_mmap : {true, false}) {
+        auto loaded = load_tensors(path, use_mmap);
+        assert(loaded[0].second.dtype() == DType::Float16);
+        assert(std::memcmp(loaded[0].second.data().raw(), x.data().raw(), x.data().nbytes()) == 0);
+    }
+    std::remove(path);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_scalar_conversion();
+        test_bulk_conversion();
+        test_half_storage();
+        test_mixed_elementwise();
+        test_mixed_matmul();
+        test_autocast_linear();
+        test_grad_scaler();
+        test_half_checkpoint();
+        std::cout << "\nAll mixed precision tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
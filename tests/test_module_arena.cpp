@@ -0,0 +1,106 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "module.hpp"
+#include "optim.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <memory>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-5f) {
+    return std::abs(a - b) < tol;
+}
+
+// 两层 MLP，用来检查子模块参数的收集与打包
+struct MLP : public Module {
+    std::shared_ptr<Linear> fc1, fc2;
+    MLP() : fc1(std::make_shared<Linear>(3, 4, true, 1)), fc2(std::make_shared<Linear>(4, 2, true, 2)) {
+        register_module("fc1", fc1);
+        register_module("fc2", fc2);
+    }
+    Tensor forward(const Tensor& x) const { return fc2->forward(fc1->forward(x)); }
+};
+
+void test_storage_semantics() {
+    std::cout << "[Test] Storage view / write semantics..." << std::endl;
+    Storage backing(4, 0.0f);
+    Storage v = Storage::view(backing.data() + 1, 2, backing.owner());
+    v = {7.0f, 8.0f}; // 长度相同：写穿到 backing
+    assert(v.is_view());
+    assert(near(backing[1], 7.0f) && near(backing[2], 8.0f));
+
+    Storage copy = v; // 拷贝构造总是深拷贝
+    copy[0] = -1.0f;
+    assert(!copy.is_view() && near(backing[1], 7.0f));
+
+    // 长度或 dtype 不同时视图不会悄悄重新分配 (那样会脱离 backing)，而是抛异常
+    auto throws = [](auto&& fn) {
+        try {
+            fn();
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    assert(throws([&] { v = {1.0f, 2.0f, 3.0f}; }));
+    assert(throws([&] { v = Storage(2, DType::Float64); }));
+    assert(throws([&] { v.assign(3, 0.0f); }));
+    assert(throws([&] { v.resize(1); }));
+    assert(v.is_view() && v.size() == 2 && near(backing[1], 7.0f));
+    Storage owned(2, 0.0f);
+    owned = {1.0f, 2.0f, 3.0f}; // 自有内存照常重新分配
+    assert(owned.size() == 3 && near(owned[2], 3.0f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_flatten_parameters() {
+    std::cout << "[Test] Module::flatten_parameters..." << std::endl;
+    MLP net;
+    auto named = net.named_parameters();
+    assert(named.size() == 4);
+    assert(named[0].first == "fc1.weight" && named[3].first == "fc2.bias");
+
+    float w0 = net.fc1->weight[0];
+    Tensor x({2, 3}, {1, 2, 3, -1, 0.5f, 2});
+    Tensor before = net.forward(x);
+
+    net.flatten_parameters();
+    ParamArena* arena = net.arena();
+    assert(arena && arena->params.size() == 4);
+    // 每个参数起点 64 字节对齐，数据保持不变
+    for (size_t off : arena->offsets) assert(off % 16 == 0);
+    assert(near(net.fc1->weight[0], w0));
+    assert(net.fc1->weight.data().data() == arena->data.data());
+
+    Tensor after = net.forward(x);
+    for (size_t i = 0; i < after.numel(); ++i) assert(near(after[i], before[i]));
+
+    // 反向梯度直接写进 arena
+    after.backward();
+    float* g = arena->grad.data() + arena->offsets[3];
+    assert(near(g[0], 2.0f) && near(net.fc2->bias.grad()[1], 2.0f));
+
+    // 优化器仍然按参数工作，更新也落在 arena 里
+    SGD opt(net.parameters(), 0.5f);
+    opt.step();
+    assert(near(arena->data[arena->offsets[3]], net.fc2->bias[0]));
+
+    // zero_grad 是对整块 arena 的一次 memset
+    net.zero_grad();
+    for (float v : arena->grad) assert(v == 0.0f);
+    assert(near(net.fc1->weight.grad()[0], 0.0f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_storage_semantics();
+        test_flatten_parameters();
+        std::cout << "\nAll module arena tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <functional>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-3f) {
+    return std::abs(a - b) < tol;
+}
+
+// loss = sum(w * f(x))，用中心差分检查 x 的梯度
+void check_grad(const std::function<Tensor(const Tensor&)>& f, Tensor x, const Tensor& w) {
+    Tensor y = f(x) * w;
+    y.backward();
+
+    const float h = 1e-2f;
+    for (size_t i = 0; i < x.numel(); ++i) {
+        Tensor xp({x.shape()}, x.data()), xm({x.shape()}, x.data());
+        xp[i] += h;
+        xm[i] -= h;
+        Tensor yp = f(xp) * w, ym = f(xm) * w;
+        float lp = 0.0f, lm = 0.0f;
+        for (size_t j = 0; j < yp.numel(); ++j) { lp += yp[j]; lm += ym[j]; }
+        float num = (lp - lm) / (2 * h);
+        assert(near(x.grad()[i], num, 2e-2f));
+    }
+}
+
+void test_layer_norm() {
+    std::cout << "[Test] LayerNorm..." << std::endl;
+    Tensor x({2, 4}, {1, 2, 3, 4, -1, 0, 5, 2}, true);
+    Tensor gamma({4}, {1.0f, 0.5f, 2.0f, 1.0f}, true);
+    Tensor beta({4}, {0.0f, 1.0f, 0.0f, -1.0f}, true);
+
+    auto y = layer_norm(x, gamma, beta);
+    // 第一行 mean = 2.5, var = 1.25
+    float rs = 1.0f / std::sqrt(1.25f + 1e-5f);
+    assert(near(y[0], (1 - 2.5f) * rs));
+    assert(near(y[1], (2 - 2.5f) * rs * 0.5f + 1.0f));
+
+    Tensor w({2, 4}, {0.3f, -1.0f, 2.0f, 0.7f, 1.5f, -0.2f, 0.1f, 0.9f});
+    check_grad([&](const Tensor& in) { return layer_norm(in, gamma, beta); },
+               Tensor({2, 4}, x.data(), true), w);
+
+    // dbeta = sum_rows(w)
+    beta.zero_grad();
+    Tensor loss = layer_norm(x, gamma, beta) * w;
+    loss.backward();
+    assert(near(beta.grad()[0], 1.8f));
+    assert(near(beta.grad()[1], -1.2f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_rms_norm() {
+    std::cout << "[Test] RMSNorm..." << std::endl;
+    Tensor x({2, 3}, {1, 2, 2, -3, 0, 4}, true);
+    Tensor gamma({3}, {1.0f, 2.0f, 0.5f}, true);
+
+    auto y = rms_norm(x, gamma);
+    // 第一行 rms = sqrt(9 / 3) = sqrt(3)
+    assert(near(y[0], 1.0f / std::sqrt(3.0f)));
+    assert(near(y[1], 4.0f / std::sqrt(3.0f)));
+
+    Tensor w({2, 3}, {1.0f, -0.5f, 0.25f, 2.0f, 0.3f, -1.0f});
+    check_grad([&](const Tensor& in) { return rms_norm(in, gamma); },
+               Tensor({2, 3}, x.data(), true), w);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_batch_norm() {
+    std::cout << "[Test] BatchNorm (train / eval)..." << std::endl;
+    // [N=2, C=2, L=2]
+    Tensor x({2, 2, 2}, {1, 3, 10, 20, 5, 7, 30, 40}, true);
+    Tensor gamma({2}, {1.0f, 2.0f}, true);
+    Tensor beta({2}, {0.0f, 1.0f}, true);
+    Tensor rm({2}, 0.0f), rv({2}, 1.0f);
+
+    auto y = batch_norm(x, gamma, beta, rm, rv, true);
+    // 通道 0: {1,3,5,7}，mean = 4，var = 5，无偏 var = 20/3
+    assert(near(y[0], (1 - 4) / std::sqrt(5.0f + 1e-5f)));
+    assert(near(rm[0], 0.4f));
+    assert(near(rv[0], 0.9f + 0.1f * 20.0f / 3.0f));
+
+    Tensor w({2, 2, 2}, {0.5f, -1.0f, 2.0f, 0.1f, 1.0f, 0.3f, -0.7f, 1.2f});
+    Tensor rm2({2}, 0.0f), rv2({2}, 1.0f);
+    check_grad([&](const Tensor& in) { return batch_norm(in, gamma, beta, rm2, rv2, true); },
+               Tensor({2, 2, 2}, x.data(), true), w);
+
+    // eval 模式：使用 running 统计量，且不再更新
+    Tensor ye = batch_norm(x, gamma, beta, rm, rv, false);
+    assert(near(ye[0], (1 - rm[0]) / std::sqrt(rv[0] + 1e-5f)));
+    assert(near(rm[0], 0.4f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_layer_norm();
+        test_rms_norm();
+        test_batch_norm();
+        std::cout << "\nAll norm tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "optim.hpp"
+#include "parallel.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-5f) {
+    return std::abs(a - b) < tol;
+}
+
+void test_sgd_momentum() {
+    std::cout << "[Test] SGD momentum / nesterov / weight decay..." << std::endl;
+    Tensor w({2}, {1.0f, -2.0f}, true);
+    SGD opt({w}, 0.1f, 0.9f);
+
+    // 两步，梯度恒为 {1, 1}
+    for (int s = 0; s < 2; ++s) {
+        opt.zero_grad();
+        w.grad().assign(2, 1.0f);
+        opt.step();
+    }
+    // buf: 1 -> 1.9，w = 1 - 0.1 - 0.19
+    assert(near(w[0], 0.71f));
+    assert(near(w[1], -2.29f));
+
+    Tensor u({1}, {1.0f}, true);
+    SGD nes({u}, 0.1f, 0.5f, 0.1f, true);
+    u.grad()[0] = 2.0f;
+    nes.step();
+    // d = 2 + 0.1 * 1 = 2.1, buf = 2.1, 更新量 = d + 0.5 * buf = 3.15
+    assert(near(u[0], 1.0f - 0.315f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_adam_adamw() {
+    std::cout << "[Test] Adam / AdamW..." << std::endl;
+    Tensor a({3}, {1.0f, 2.0f, 3.0f}, true);
+    Tensor b({3}, {1.0f, 2.0f, 3.0f}, true);
+    Adam adam({a}, 0.1f);
+    AdamW adamw({b}, 0.1f, 0.9f, 0.999f, 1e-8f, 0.5f);
+
+    a.grad() = {0.5f, -1.0f, 0.0f};
+    b.grad() = {0.5f, -1.0f, 0.0f};
+    adam.step();
+    adamw.step();
+
+    // 第一步偏差修正后 m_hat / sqrt(v_hat) = sign(g)
+    assert(near(a[0], 0.9f, 1e-4f));
+    assert(near(a[1], 2.1f, 1e-4f));
+    assert(near(a[2], 3.0f));
+    // AdamW 额外乘 (1 - lr * wd) = 0.95
+    assert(near(b[0], 0.95f - 0.1f, 1e-4f));
+    assert(near(b[2], 3.0f * 0.95f, 1e-4f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_grad_clip_and_training() {
+    std::cout << "[Test] Fused grad clipping + fit y = 2x..." << std::endl;
+    Tensor g({2}, {3.0f, 4.0f}, true);
+    SGD clip({g}, 1.0f);
+    clip.set_max_grad_norm(1.0f);
+    g.grad() = {3.0f, 4.0f};
+    clip.step();
+    assert(near(clip.last_grad_norm(), 5.0f));
+    assert(near(g[0], 3.0f - 0.6f, 1e-4f));
+    assert(near(g[1], 4.0f - 0.8f, 1e-4f));
+
+    // 大参数的平方和在 double 中累加：单线程时整段落在同一块里，float 累加会偏差约 1%
+    size_t saved_threads = get_num_threads();
+    set_num_threads(1);
+    const size_t n = 1 << 22;
+    Tensor big({n}, 0.0f, true);
+    SGD big_clip({big}, 0.0f);
+    big_clip.set_max_grad_norm(1.0f);
+    big.grad().assign(n, 0.1f);
+    big_clip.step();
+    const double expect = std::sqrt(static_cast<double>(n) * 0.1f * 0.1f);
+    assert(std::abs(big_clip.last_grad_norm() / expect - 1.0) < 1e-5);
+    set_num_threads(saved_threads);
+
+    Tensor x({4, 1}, {1, 2, 3, 4});
+    Tensor y({4, 1}, {2, 4, 6, 8});
+    Tensor w({1, 1}, {0.0f}, true);
+    Adam opt({w}, 0.1f);
+    for (int it = 0; it < 200; ++it) {
+        opt.zero_grad();
+        Tensor diff = matmul(x, w) - y;
+        Tensor loss = diff * diff;
+        loss.backward();
+        opt.step();
+    }
+    assert(near(w[0], 2.0f, 1e-2f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_sgd_momentum();
+        test_adam_adamw();
+        test_grad_clip_and_training();
+        std::cout << "\nAll optimizer tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
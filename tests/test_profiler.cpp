@@ -0,0 +1,198 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "profiler.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+const ProfileEvent* find_event(const std::vector<ProfileEvent>& evs, const std::string& name) {
+    for (const ProfileEvent& e : evs) {
+        if (e.name == name) return &e;
+    }
+    return nullptr;
+}
+
+size_t count_events(const std::vector<ProfileEvent>& evs, const std::string& name) {
+    size_t n = 0;
+    for (const ProfileEvent& e : evs) n += e.name == name;
+    return n;
+}
+
+void test_forward_and_backward_events() {
+    std::cout << "[Test] Profiler records forward ops and backward nodes..." << std::endl;
+    Tensor a({4, 3}, 1.0f, true);
+    Tensor b({3, 5}, 2.0f, true);
+    Tensor bias({5}, 0.5f, true);
+    Profiler prof;
+    Tensor y = relu(add(matmul(a, b), bias));
+    y.backward();
+    prof.stop();
+
+    auto evs = prof.events();
+    const ProfileEvent* mm = find_event(evs, "matmul");
+    assert(mm && std::string(mm->category) == "op");
+    assert(mm->input_shapes.size() == 2);
+    assert(mm->input_shapes[0] == std::vector<size_t>({4, 3}));
+    assert(mm->input_shapes[1] == std::vector<size_t>({3, 5}));
+    assert(mm->flops == 2 * 4 * 3 * 5);
+    assert(mm->bytes == (12 + 15 + 20) * sizeof(float));
+
+    const ProfileEvent* ad = find_event(evs, "add");
+    assert(ad && ad->flops == 20);
+    assert(find_event(evs, "relu"));
+
+    const ProfileEvent* mb = find_event(evs, "MatMulBackward");
+    assert(mb && std::string(mb->category) == "backward");
+    assert(mb->input_shapes[0] == std::vector<size_t>({4, 5}));
+    assert(mb->flops == 4 * 4 * 3 * 5);
+    assert(find_event(evs, "AddBackward") && find_event(evs, "ReluBackward"));
+
+    for (size_t i = 0; i < evs.size(); ++i) {
+        assert(evs[i].self_ns <= evs[i].dur_ns);
+        assert(evs[i].thread != 0);
+        if (i) assert(evs[i - 1].start_ns <= evs[i].start_ns);
+    }
+    // 反向节点在前向之后开始
+    assert(mb->start_ns >= mm->start_ns + mm->dur_ns);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_nested_self_time() {
+    std::cout << "[Test] Nested ops are subtracted from the parent's self time..." << std::endl;
+    Tensor x({2, 8}, 1.0f);
+    Profiler prof;
+    Tensor out = checkpoint([](const std::vector<Tensor>& in) { return matmul(in[0], transpose(in[0])); }, {x});
+    prof.stop();
+    auto evs = prof.events();
+    const ProfileEvent* ck = find_event(evs, "checkpoint");
+    const ProfileEvent* mm = find_event(evs, "matmul");
+    const ProfileEvent* tr = find_event(evs, "transpose");
+    assert(ck && mm && tr);
+    assert(ck->input_shapes.size() == 1 && ck->input_shapes[0] == std::vector<size_t>({2, 8}));
+    assert(ck->start_ns <= mm->start_ns && mm->start_ns + mm->dur_ns <= ck->start_ns + ck->dur_ns);
+    assert(ck->self_ns + mm->dur_ns + tr->dur_ns <= ck->dur_ns + 1);
+    assert(near(out[0], 8.0f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_quantized_and_view_ops() {
+    std::cout << "[Test] Quantized ops and zero-copy views show up in the trace..." << std::endl;
+    Tensor w({6, 8}, 0.25f);
+    QuantizedMatrix q = quantize_weight(w);
+    Tensor x({2, 1, 3}, 1.0f);
+    Tensor h0({1, 2}, 0.0f), c0({1, 2}, 0.0f);
+    Tensor w_ih({3, 8}, 0.1f), w_hh({2, 8}, 0.1f), bias({8}, 0.0f);
+    Profiler prof;
+    Tensor d = dequantize(q);
+    auto hc = lstm(x, h0, c0, w_ih, w_hh, bias); // 两个输出都是打包缓冲的视图
+    prof.stop();
+    auto evs = prof.events();
+    const ProfileEvent* dq = find_event(evs, "dequantize");
+    assert(dq && dq->input_shapes.size() == 1 && dq->input_shapes[0] == std::vector<size_t>({q.rows, q.cols}));
+    assert(dq->flops == 48 && dq->bytes == 48 * 5);
+    assert(count_events(evs, "slice_view") == 2);
+    const ProfileEvent* sv = find_event(evs, "slice_view");
+    assert(sv->flops == 0 && sv->bytes == 0);
+    assert(near(d[0], 0.25f, 1e-2f) && hc.first.shape() == std::vector<size_t>({2, 1, 2}));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_disabled_and_stopped() {
+    std::cout << "[Test] Nothing is recorded without an active profiler..." << std::endl;
+    assert(current_profiler() == nullptr);
+    Tensor a({8}, 1.0f);
+    mul(a, a);
+
+    Profiler prof;
+    assert(current_profiler() == &prof);
+    add(a, a);
+    prof.stop();
+    assert(current_profiler() == nullptr);
+    sub(a, a);
+    auto evs = prof.events();
+    assert(evs.size() == 1 && evs[0].name == "add");
+
+    // 其它线程默认不记录，ProfilerThreadScope 显式加入
+    Profiler prof2;
+    std::thread t1([&] { mul(a, a); });
+    t1.join();
+    std::thread t2([&] {
+        ProfilerThreadScope scope(prof2);
+        div(a, a);
+    });
+    t2.join();
+    neg(a);
+    prof2.stop();
+    evs = prof2.events();
+    assert(evs.size() == 2);
+    assert(find_event(evs, "div") && find_event(evs, "neg"));
+    assert(find_event(evs, "div")->thread != find_event(evs, "neg")->thread);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_chrome_trace_and_summary() {
+    std::cout << "[Test] Chrome trace export and self-time summary..." << std::endl;
+    Tensor a({64, 64}, 1.0f);
+    Profiler prof;
+    for (int i = 0; i < 3; ++i) matmul(a, a);
+    add(a, a);
+    prof.stop();
+
+    std::string trace = prof.chrome_trace();
+    assert(trace.find("\"traceEvents\"") != std::string::npos);
+    assert(trace.find("\"ph\":\"X\"") != std::string::npos);
+    assert(trace.find("\"name\":\"matmul\"") != std::string::npos);
+    assert(trace.find("\"shapes\":[[64,64],[64,64]]") != std::string::npos);
+    assert(trace.find("\"flops\":524288") != std::string::npos);
+
+    const std::string path = "profiler_test_trace.json";
+    prof.save_chrome_trace(path);
+    std::ifstream f(path);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    assert(ss.str() == trace);
+    std::remove(path.c_str());
+
+    std::string table = prof.summary();
+    assert(table.find("Name") == 0);
+    size_t mm = table.find("\nmatmul"), ad = table.find("\nadd");
+    assert(mm != std::string::npos && ad != std::string::npos);
+    // 3 次 64^3 的 matmul 一定比一次 64x64 的 add 占更多 self time
+    assert(mm < ad);
+    std::istringstream row(table.substr(mm + 1));
+    std::string name;
+    size_t calls = 0;
+    row >> name >> calls;
+    assert(name == "matmul" && calls == 3);
+
+    std::string top = prof.summary(1);
+    assert(top.find("\nadd") == std::string::npos);
+    assert(count_events(prof.events(), "matmul") == 3);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_forward_and_backward_events();
+        test_nested_self_time();
+        test_quantized_and_view_ops();
+        test_disabled_and_stopped();
+        test_chrome_trace_and_summary();
+        std::cout << "\nAll profiler tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
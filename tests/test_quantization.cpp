@@ -0,0 +1,150 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "module.hpp"
+#include "kernels.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+Tensor random_tensor(const std::vector<size_t>& shape, uint32_t seed, float lo = -1.0f, float hi = 1.0f) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(lo, hi);
+    Tensor t(shape);
+    for (auto& v : t.data()) v = dist(gen);
+    return t;
+}
+
+// 相对 fp32 结果的最大误差，按输出的最大幅值归一化
+float max_rel_error(const Tensor& y, const Tensor& ref) {
+    float max_ref = 0.0f, max_err = 0.0f;
+    for (size_t i = 0; i < ref.numel(); ++i) {
+        max_ref = std::max(max_ref, std::abs(ref[i]));
+        max_err = std::max(max_err, std::abs(y[i] - ref[i]));
+    }
+    return max_err / max_ref;
+}
+
+void test_quantize_roundtrip() {
+    std::cout << "[Test] Per-channel weight quantization round trip..." << std::endl;
+    // 每个输出通道的幅值差别很大，逐通道 scale 才能保持精度
+    Tensor w = random_tensor({40, 6}, 1);
+    for (size_t p = 0; p < 40; ++p)
+        for (size_t j = 0; j < 6; ++j) w.data()[p * 6 + j] *= std::pow(10.0f, float(j) - 3.0f);
+
+    QuantizedMatrix q = quantize_weight(w);
+    assert(q.rows == 6 && q.cols == 40 && q.k_padded == 64);
+    for (size_t j = 0; j < 6; ++j) {
+        for (size_t p = 40; p < 64; ++p) assert(q.data[j * 64 + p] == 0); // 补 0
+        for (size_t p = 0; p < 40; ++p) {
+            float x = w[p * 6 + j];
+            float r = q.data[j * 64 + p] * q.scales[j];
+            assert(std::abs(x - r) <= 0.5f * q.scales[j] + 1e-7f);
+        }
+    }
+    Tensor back = dequantize(q);
+    assert(back.shape() == (std::vector<size_t>{6, 40}));
+    assert(near(back[1 * 40 + 3], q.data[1 * 64 + 3] * q.scales[1], 1e-9f));
+
+    // 全 0 的行不会产生除零
+    QuantizedMatrix z = quantize_activations(Tensor({2, 3}), 0.0f);
+    assert(z.scales[0] == 1.0f && z.data[0] == 0);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_int8_gemm_exact() {
+    std::cout << "[Test] INT8 GEMM matches integer reference (" << qgemm_s8_kernel_name() << ")..." << std::endl;
+    // 覆盖 n 不是 4 的倍数、k 跨多个 32 字节块、极值 ±127 (检查 int16 不饱和)
+    const size_t m = 7, n = 131, k = 96;
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<int> dist(-127, 127);
+    std::vector<int8_t> a(m * k), b(n * k);
+    for (auto& v : a) v = static_cast<int8_t>(dist(gen));
+    for (auto& v : b) v = static_cast<int8_t>(dist(gen));
+    for (size_t p = 0; p < k; ++p) { a[p] = 127; b[p] = (p % 2) ? 127 : -127; b[k + p] = -127; }
+
+    std::vector<float> ones_m(m, 1.0f), ones_n(n, 1.0f), c(m * n);
+    qgemm_s8_dequant(m, n, k, a.data(), k, ones_m.data(), b.data(), k, ones_n.data(), nullptr, c.data(), n);
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            int32_t ref = 0;
+            for (size_t p = 0; p < k; ++p) ref += int32_t(a[i * k + p]) * int32_t(b[j * k + p]);
+            assert(c[i * n + j] == float(ref));
+        }
+    }
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_quantized_matmul() {
+    std::cout << "[Test] quantized_matmul approximates fp32 matmul..." << std::endl;
+    Tensor x = random_tensor({33, 70}, 4);
+    Tensor w = random_tensor({70, 45}, 5, -0.2f, 0.2f);
+    Tensor bias = random_tensor({45}, 6);
+    Tensor ref = matmul(x, w) + bias;
+
+    QuantizedMatrix qw = quantize_weight(w);
+    Tensor y = quantized_matmul(x, qw, bias); // 动态量化
+    assert(y.shape() == ref.shape());
+    assert(max_rel_error(y, ref) < 0.02f);
+
+    // 重量化输出可以直接喂给下一层
+    float out_scale = 0.0f;
+    for (size_t i = 0; i < ref.numel(); ++i) out_scale = std::max(out_scale, std::abs(ref[i]));
+    out_scale /= 127.0f;
+    QuantizedMatrix qy = quantized_matmul_requant(quantize_activations(x), qw, bias, out_scale);
+    assert(qy.rows == 33 && qy.cols == 45 && qy.k_padded == 64);
+    assert(max_rel_error(dequantize(qy), ref) < 0.03f);
+
+    Tensor w2 = random_tensor({45, 8}, 7, -0.2f, 0.2f);
+    Tensor ref2 = matmul(ref, w2);
+    Tensor y2 = quantized_matmul(qy, quantize_weight(w2));
+    assert(max_rel_error(y2, ref2) < 0.05f);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_quantized_linear() {
+    std::cout << "[Test] Calibrated QuantizedLinear from fp32 Linear..." << std::endl;
+    Linear fc(64, 32, true, 8);
+
+    MinMaxObserver obs;
+    for (uint32_t s = 0; s < 4; ++s) obs.observe(random_tensor({16, 64}, 100 + s));
+    assert(obs.num_batches() == 4);
+    assert(obs.max_abs() > 0.9f && obs.max_abs() <= 1.0f);
+    assert(near(obs.scale(), obs.max_abs() / 127.0f, 1e-7f));
+
+    QuantizedLinear qfc(fc, obs.scale());
+    QuantizedLinear qfc_dyn(fc);
+    assert(qfc.weight.data.size() * 4 == fc.weight.numel() * sizeof(float)); // 64 正好是 32 的倍数
+
+    Tensor x = random_tensor({10, 64}, 200);
+    Tensor ref = fc.forward(x);
+    assert(max_rel_error(qfc.forward(x), ref) < 0.02f);
+    assert(max_rel_error(qfc_dyn.forward(x), ref) < 0.02f);
+
+    // 滑动平均的 observer 不会被单个离群 batch 拉满
+    MinMaxObserver ema(0.1f);
+    ema.observe(random_tensor({4, 4}, 1));
+    ema.observe(random_tensor({4, 4}, 2, -100.0f, 100.0f));
+    assert(ema.max_abs() < 20.0f);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_quantize_roundtrip();
+        test_int8_gemm_exact();
+        test_quantized_matmul();
+        test_quantized_linear();
+        std::cout << "\nAll quantization tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "tensor.hpp"
+#include "records.hpp"
+#include "data.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-6f) {
+    return std::abs(a - b) < tol;
+}
+
+const std::vector<std::string> kShards = {"test_records_0.rec", "test_records_1.rec", "test_records_2.rec"};
+
+// 3 个分片分别有 4、0、7 条记录；第 g 条记录为 [g, g + 0.5, g + 0.25, -g]
+void write_shards() {
+    size_t counts[3] = {4, 0, 7};
+    size_t g = 0;
+    for (size_t s = 0; s < 3; ++s) {
+        RecordWriter w(kShards[s]);
+        for (size_t k = 0; k < counts[s]; ++k, ++g) {
+            float v = static_cast<float>(g);
+            w.write(Tensor({4}, {v, v + 0.5f, v + 0.25f, -v}));
+        }
+        assert(w.count() == counts[s]);
+    }
+}
+
+void cleanup() {
+    for (auto& p : kShards) {
+        std::remove(p.c_str());
+        std::remove((p + ".idx").c_str());
+    }
+}
+
+void test_random_access() {
+    std::cout << "[Test] RecordReader random access across shards..." << std::endl;
+    RecordReader reader(kShards);
+    assert(reader.num_shards() == 3);
+    assert(reader.size() == 11);
+    for (size_t g = 0; g < 11; ++g) {
+        RecordView r = reader.record(g);
+        assert(r.size == 4 * sizeof(float));
+        float first;
+        std::memcpy(&first, r.data, sizeof(float));
+        assert(near(first, static_cast<float>(g)));
+    }
+
+    // 零拷贝视图
+    Tensor t = reader.tensor(9, {2, 2});
+    assert(t.data().is_view());
+    assert(near(t[0], 9.0f) && near(t[1], 9.5f) && near(t[3], -9.0f));
+
+    bool threw = false;
+    try { reader.tensor(9, {3}); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    reader.advise(MappedFile::Advice::Random);
+    reader.prefetch(3);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_shuffle_and_sharding() {
+    std::cout << "[Test] Global shuffle and per-worker sharding..." << std::endl;
+    RecordReader reader(kShards);
+    auto a = reader.order(true, 7, 0);
+    auto b = reader.order(true, 7, 0);
+    auto c = reader.order(true, 7, 1);
+    assert(a == b && a != c);
+    assert(std::set<size_t>(a.begin(), a.end()).size() == 11);
+
+    // 3 个 worker：每个 3 条，互不重叠，且与全局排列一致
+    std::set<size_t> all;
+    for (size_t rank = 0; rank < 3; ++rank) {
+        auto part = reader.shard_indices(rank, 3, true, 7, 0);
+        assert(part.size() == 3);
+        for (size_t k = 0; k < part.size(); ++k) assert(part[k] == a[k * 3 + rank]);
+        all.insert(part.begin(), part.end());
+    }
+    assert(all.size() == 9);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_dataloader() {
+    std::cout << "[Test] RecordDataset feeds DataLoader..." << std::endl;
+    auto reader = std::make_shared<RecordReader>(kShards);
+    auto ds = std::make_shared<RecordDataset>(reader, std::vector<std::vector<size_t>>{{3}, {1}},
+                                              reader->shard_indices(1, 2, false));
+    assert(ds->size() == 5); // 全局记录 1, 3, 5, 7, 9
+
+    DataLoaderOptions opt;
+    opt.batch_size = 2;
+    opt.num_workers = 2;
+    DataLoader loader(ds, opt);
+    std::vector<float> firsts;
+    for (Batch batch; loader.next(batch);) {
+        for (size_t r = 0; r < batch.size(); ++r) {
+            float g = batch.fields[0][r * 3];
+            assert(near(batch.fields[0][r * 3 + 2], g + 0.25f));
+            assert(near(batch.fields[1][r], -g));
+            firsts.push_back(g);
+        }
+    }
+    assert(firsts == std::vector<float>({1, 3, 5, 7, 9}));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_bad_index() {
+    std::cout << "[Test] Corrupt index is rejected..." << std::endl;
+    FILE* f = std::fopen((kShards[1] + ".idx").c_str(), "wb");
+    std::fputs("garbage", f);
+    std::fclose(f);
+    bool threw = false;
+    try { RecordReader reader(kShards); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        write_shards();
+        test_random_access();
+        test_shuffle_and_sharding();
+        test_dataloader();
+        test_bad_index();
+        cleanup();
+        std::cout << "\nAll records tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        cleanup();
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "module.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <random>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+Tensor random_tensor(const std::vector<size_t>& shape, uint32_t seed, bool requires_grad) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    Tensor t(shape, requires_grad);
+    for (auto& v : t.data()) v = dist(gen);
+    return t;
+}
+
+float weighted_sum(const Tensor& y, const Tensor& w) {
+    float s = 0.0f;
+    for (size_t i = 0; i < y.numel(); ++i) s += y[i] * w[i];
+    return s;
+}
+
+// 中心差分检查 p 的梯度：loss() 必须只依赖 p 的当前数据
+void check_grad(Tensor& p, const std::function<float()>& loss) {
+    const float h = 1e-2f;
+    for (size_t i = 0; i < p.numel(); ++i) {
+        float old = p[i];
+        p[i] = old + h; float lp = loss();
+        p[i] = old - h; float lm = loss();
+        p[i] = old;
+        assert(near(p.grad()[i], (lp - lm) / (2 * h), 2e-2f));
+    }
+}
+
+void test_lstm_sequence_grad() {
+    std::cout << "[Test] Fused LSTM sequence forward/backward..." << std::endl;
+    size_t T = 3, B = 2, I = 3, H = 2;
+    LSTM net(I, H, 5);
+    Tensor x = random_tensor({T, B, I}, 1, true);
+    Tensor h0 = random_tensor({B, H}, 2, true);
+    Tensor c0 = random_tensor({B, H}, 3, true);
+    Tensor wy = random_tensor({T, B, H}, 4, false);
+    Tensor wc = random_tensor({B, H}, 6, false);
+
+    // output 与 c_n 分两次检查：每次重新前向，只对其中一个输出反传
+    for (int which = 0; which < 2; ++which) {
+        for (auto* t : {&x, &h0, &c0}) t->zero_grad();
+        net.zero_grad();
+        auto loss = [&]() {
+            auto res = net.forward(x, h0, c0);
+            return which == 0 ? weighted_sum(res.first, wy) : weighted_sum(res.second, wc);
+        };
+        auto res = net.forward(x, h0, c0);
+        Tensor l = which == 0 ? res.first * wy : res.second * wc;
+        l.backward();
+
+        check_grad(x, loss);
+        check_grad(h0, loss);
+        check_grad(c0, loss);
+        check_grad(net.w_ih, loss);
+        check_grad(net.w_hh, loss);
+        check_grad(net.bias, loss);
+    }
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_lstm_cell_matches_sequence() {
+    std::cout << "[Test] LSTMCell unrolled == LSTM sequence..." << std::endl;
+    size_t T = 4, B = 2, I = 3, H = 3;
+    LSTM net(I, H, 9);
+    Tensor x = random_tensor({T, B, I}, 11, false);
+    Tensor h({B, H}), c({B, H});
+
+    auto seq = net.forward(x, h, c);
+    for (size_t t = 0; t < T; ++t) {
+        Tensor xt({B, I});
+        std::copy(x.data().data() + t * B * I, x.data().data() + (t + 1) * B * I, xt.data().data());
+        auto hc = net.step(xt, h, c);
+        h = hc.first;
+        c = hc.second;
+        for (size_t k = 0; k < B * H; ++k) assert(near(h[k], seq.first[t * B * H + k]));
+    }
+    for (size_t k = 0; k < B * H; ++k) assert(near(c[k], seq.second[k]));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_gru_grad() {
+    std::cout << "[Test] Fused GRU sequence + cell..." << std::endl;
+    size_t T = 3, B = 2, I = 2, H = 3;
+    GRU net(I, H, 21);
+    Tensor x = random_tensor({T, B, I}, 22, true);
+    Tensor h0 = random_tensor({B, H}, 23, true);
+    Tensor wy = random_tensor({T, B, H}, 24, false);
+
+    auto loss = [&]() { return weighted_sum(net.forward(x, h0), wy); };
+    Tensor l = net.forward(x, h0) * wy;
+    l.backward();
+
+    check_grad(x, loss);
+    check_grad(h0, loss);
+    check_grad(net.w_ih, loss);
+    check_grad(net.w_hh, loss);
+    check_grad(net.b_ih, loss);
+    check_grad(net.b_hh, loss);
+
+    // 单步 GRUCell 与序列第一步一致
+    Tensor x0({B, I});
+    std::copy(x.data().data(), x.data().data() + B * I, x0.data().data());
+    Tensor h1 = net.step(x0, h0);
+    Tensor seq = net.forward(x, h0);
+    for (size_t k = 0; k < B * H; ++k) assert(near(h1[k], seq[k]));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_lstm_sequence_grad();
+        test_lstm_cell_matches_sequence();
+        test_gru_grad();
+        std::cout << "\nAll rnn tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "tensor.hpp"
+#include "module.hpp"
+#include "serialize.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-6f) {
+    return std::abs(a - b) < tol;
+}
+
+const std::string kPath = "test_serialize_ckpt.bin";
+
+void test_roundtrip() {
+    std::cout << "[Test] save_tensors / load_tensors round trip..." << std::endl;
+    Tensor a({2, 3}, {1, 2, 3, 4, 5, 6});
+    Tensor b({5}, 0.5f);
+    Tensor c({1, 2, 1, 3}, {-1, -2, -3, -4, -5, -6});
+    save_tensors(kPath, {{"a", a}, {"layer.b", b}, {"c", c}});
+
+    for (bool use_mmap : {true, false}) {
+        NamedTensors loaded = load_tensors(kPath, use_mmap);
+        assert(loaded.size() == 3);
+        assert(loaded[0].first == "a" && loaded[1].first == "layer.b" && loaded[2].first == "c");
+        assert(loaded[0].second.shape() == a.shape());
+        assert(loaded[2].second.shape() == c.shape());
+        for (size_t i = 0; i < 6; ++i) assert(near(loaded[0].second[i], a[i]));
+        for (size_t i = 0; i < 5; ++i) assert(near(loaded[1].second[i], 0.5f));
+        for (size_t i = 0; i < 6; ++i) assert(near(loaded[2].second[i], c[i]));
+        // 数据区 64 字节对齐
+        for (auto& kv : loaded) assert(reinterpret_cast<uintptr_t>(kv.second.data().data()) % 64 == 0);
+    }
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_mmap_copy_on_write() {
+    std::cout << "[Test] mmap load is zero-copy and private..." << std::endl;
+    Tensor a({4}, {1, 2, 3, 4});
+    save_tensors(kPath, {{"a", a}});
+    {
+        NamedTensors loaded = load_tensors(kPath);
+        assert(loaded[0].second.data().is_view()); // 直接以映射为存储
+        loaded[0].second[0] = 100.0f;              // 写时复制，不改文件
+    }
+    NamedTensors again = load_tensors(kPath);
+    assert(near(again[0].second[0], 1.0f));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_module_roundtrip() {
+    std::cout << "[Test] save_module / load_module..." << std::endl;
+    Linear src(4, 3, true, 1);
+    save_module(src, kPath);
+
+    Linear dst(4, 3, true, 2);
+    load_module(dst, kPath);
+    for (size_t i = 0; i < src.weight.numel(); ++i) assert(near(dst.weight[i], src.weight[i]));
+    for (size_t i = 0; i < src.bias.numel(); ++i) assert(near(dst.bias[i], src.bias[i]));
+    assert(dst.weight.data().is_view());
+
+    // 映射参数可以原地更新 (写时复制)
+    dst.weight[0] += 1.0f;
+    assert(near(dst.weight[0], src.weight[0] + 1.0f));
+
+    // 已打包的模块：拷贝进 arena，参数依然是 arena 视图
+    Linear flat(4, 3, true, 3);
+    flat.flatten_parameters();
+    const float* arena_ptr = flat.arena()->data.data();
+    load_module(flat, kPath);
+    assert(flat.arena()->data.data() == arena_ptr);
+    for (size_t i = 0; i < src.weight.numel(); ++i) assert(near(flat.weight[i], src.weight[i]));
+
+    Linear wrong(3, 3, true, 0);
+    bool threw = false;
+    try { load_module(wrong, kPath); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_corrupt_file() {
+    std::cout << "[Test] Corrupt checkpoint is rejected..." << std::endl;
+    FILE* f = std::fopen(kPath.c_str(), "wb");
+    std::fputs("not a checkpoint at all", f);
+    std::fclose(f);
+    bool threw = false;
+    try { load_tensors(kPath); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+
+    // 截断：header 完整但数据缺失
+    Tensor big({1024}, 1.0f);
+    save_tensors(kPath, {{"big", big}});
+    f = std::fopen(kPath.c_str(), "r+b");
+    std::fseek(f, 0, SEEK_END);
+    long full = std::ftell(f);
+    std::fclose(f);
+    std::vector<char> head(static_cast<size_t>(full) / 2);
+    f = std::fopen(kPath.c_str(), "rb");
+    size_t got = std::fread(head.data(), 1, head.size(), f);
+    std::fclose(f);
+    f = std::fopen(kPath.c_str(), "wb");
+    std::fwrite(head.data(), 1, got, f);
+    std::fclose(f);
+    threw = false;
+    try { load_tensors(kPath); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_roundtrip();
+        test_mmap_copy_on_write();
+        test_module_roundtrip();
+        test_corrupt_file();
+        std::remove(kPath.c_str());
+        std::cout << "\nAll serialize tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
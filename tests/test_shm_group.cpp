@@ -0,0 +1,141 @@
+#include "tensor.hpp"
+#include "distributed.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+// 每个 rank fork 一个子进程执行 fn(rank)，子进程里的 assert 失败或异常都会体现在退出码上
+template <typename F>
+void run_processes(size_t world, F fn) {
+    std::cout.flush();
+    std::vector<pid_t> pids;
+    for (size_t r = 0; r < world; ++r) {
+        pid_t pid = fork();
+        assert(pid >= 0);
+        if (pid == 0) {
+            int code = 0;
+            try {
+                fn(r);
+            } catch (const std::exception& e) {
+                std::cerr << "rank " << r << " failed: " << e.what() << std::endl;
+                code = 1;
+            }
+            _exit(code);
+        }
+        pids.push_back(pid);
+    }
+    for (pid_t pid : pids) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+}
+
+std::string group_name(const char* tag) {
+    return "/mini_dl_test_" + std::to_string(getpid()) + "_" + tag;
+}
+
+void test_collectives() {
+    std::cout << "[Test] ShmGroup all_reduce / broadcast / all_gather across processes..." << std::endl;
+    const size_t W = 4;
+    const std::string name = group_name("coll");
+    run_processes(W, [&](size_t r) {
+        // 暂存区只有 4KB (每格 512 个 float)，大缓冲要分很多片走环形格
+        ShmGroup pg(name, r, W, 4096, 10000);
+        assert(pg.rank() == r && pg.size() == W);
+        for (size_t n : {size_t(0), size_t(1), size_t(3), size_t(512), size_t(1003), size_t(10000)}) {
+            Storage buf{std::vector<float>(n)}, mean{std::vector<float>(n)};
+            for (size_t i = 0; i < n; ++i) buf[i] = mean[i] = float(r + 1) * float(i % 7);
+            pg.all_reduce(buf);
+            pg.all_reduce(mean, ReduceOp::Mean);
+            for (size_t i = 0; i < n; ++i) {
+                assert(near(buf[i], 10.0f * float(i % 7)));
+                assert(near(mean[i], 2.5f * float(i % 7)));
+            }
+        }
+
+        Storage d(700, DType::Float64);
+        for (size_t i = 0; i < 700; ++i) d.data_ptr<double>()[i] = double(r) + 0.25;
+        pg.all_reduce(d);
+        assert(std::abs(d.data_ptr<double>()[699] - 7.0) < 1e-12);
+
+        Storage b(std::vector<float>(1500, float(r)));
+        pg.broadcast(b, 2);
+        for (size_t i = 0; i < b.size(); ++i) assert(near(b[i], 2.0f));
+        pg.barrier();
+
+        Storage in(std::vector<float>(600)), out(std::vector<float>(600 * W));
+        for (size_t i = 0; i < 600; ++i) in[i] = float(r) * 1000.0f + float(i);
+        pg.all_gather(in, out);
+        for (size_t q = 0; q < W; ++q) {
+            for (size_t i = 0; i < 600; i += 37) assert(near(out[q * 600 + i], float(q) * 1000.0f + float(i)));
+        }
+
+        // 长度不一致、dtype 不支持时所有 rank 一起抛异常，之后组仍可使用
+        size_t threw = 0;
+        Storage bad(std::vector<float>(r == 1 ? 3 : 4));
+        try {
+            pg.all_reduce(bad);
+        } catch (const std::runtime_error&) {
+            ++threw;
+        }
+        Storage ints(4, DType::Int32);
+        try {
+            pg.broadcast(ints, 0);
+        } catch (const std::runtime_error&) {
+            ++threw;
+        }
+        assert(threw == 2);
+        Storage ok(std::vector<float>(5, 1.0f));
+        pg.all_reduce(ok);
+        assert(near(ok[4], float(W)));
+    });
+    // 所有 rank 连上后名字即被删除，不会留下段
+    assert(shm_open(name.c_str(), O_RDWR, 0600) < 0);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_missing_peer_times_out() {
+    std::cout << "[Test] ShmGroup times out when a peer never joins..." << std::endl;
+    const std::string name = group_name("lonely");
+    bool threw = false;
+    try {
+        ShmGroup pg(name, 0, 2, 4096, 200);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(shm_open(name.c_str(), O_RDWR, 0600) < 0);
+
+    // 同一个名字可以立即重新使用
+    run_processes(2, [&](size_t r) {
+        ShmGroup pg(name, r, 2, 4096, 10000);
+        Storage v(std::vector<float>{float(r), 1.0f});
+        pg.all_reduce(v);
+        assert(near(v[0], 1.0f) && near(v[1], 2.0f));
+    });
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_collectives();
+        test_missing_peer_times_out();
+        std::cout << "\nAll shm group tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
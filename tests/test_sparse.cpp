@@ -0,0 +1,169 @@
+#include "tensor.hpp"
+#include "ops.hpp"
+#include "sparse.hpp"
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+// 没有 pattern 的 CSRMatrix 无法构造 (访问器会解引用空指针)
+static_assert(!std::is_default_constructible<CSRMatrix>::value, "CSRMatrix must not be default-constructible");
+
+// 辅助函数：比较两个 float 是否足够接近
+bool near(float a, float b, float tol = 1e-4f) {
+    return std::abs(a - b) < tol;
+}
+
+Tensor random_tensor(const std::vector<size_t>& shape, uint32_t seed, bool requires_grad = false) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    Tensor t(shape, requires_grad);
+    for (auto& v : t.data()) v = dist(gen);
+    return t;
+}
+
+// 随机稀疏矩阵 (COO 中可能含重复坐标)
+CSRMatrix random_csr(size_t rows, size_t cols, size_t nnz, uint32_t seed, bool requires_grad) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<size_t> r(0, rows - 1), c(0, cols - 1);
+    std::uniform_real_distribution<float> v(-1.0f, 1.0f);
+    std::vector<size_t> ri(nnz), ci(nnz);
+    std::vector<float> vals(nnz);
+    for (size_t e = 0; e < nnz; ++e) { ri[e] = r(gen); ci[e] = c(gen); vals[e] = v(gen); }
+    return CSRMatrix::from_coo(rows, cols, ri, ci, vals, requires_grad);
+}
+
+void test_from_coo() {
+    std::cout << "[Test] COO -> CSR with unsorted and duplicate entries..." << std::endl;
+    // 3x4:
+    // [0 2 0 0]
+    // [0 0 0 0]
+    // [5 0 0 1]
+    CSRMatrix a = CSRMatrix::from_coo(3, 4, {2, 0, 2, 2}, {3, 1, 0, 3}, {0.5f, 2.0f, 5.0f, 0.5f});
+    const CSRPattern& p = *a.pattern();
+    assert(a.nnz() == 3);
+    assert((p.row_ptr == std::vector<size_t>{0, 1, 1, 3}));
+    assert((p.col_idx == std::vector<size_t>{1, 0, 3}));
+    assert(near(a.values()[0], 2.0f) && near(a.values()[1], 5.0f) && near(a.values()[2], 1.0f));
+
+    Tensor d = a.to_dense();
+    assert(near(d[0 * 4 + 1], 2.0f) && near(d[2 * 4 + 0], 5.0f) && near(d[2 * 4 + 3], 1.0f));
+    assert(near(d[1 * 4 + 2], 0.0f));
+
+    const CSRPattern& t = p.transposed();
+    assert(t.rows == 4 && t.cols == 3);
+    assert((t.row_ptr == std::vector<size_t>{0, 1, 2, 2, 3}));
+    assert((t.col_idx == std::vector<size_t>{2, 0, 2}));
+    assert((p.transpose_perm() == std::vector<size_t>{1, 0, 2}));
+
+    bool threw = false;
+    try { CSRMatrix::from_coo(2, 2, {2}, {0}); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_spmm() {
+    std::cout << "[Test] SpMM forward / backward vs dense matmul..." << std::endl;
+    const size_t n = 120, m = 90, f = 13;
+    CSRMatrix a = random_csr(n, m, 400, 1, true);
+    Tensor x = random_tensor({m, f}, 2, true);
+    Tensor w = random_tensor({n, f}, 3);
+
+    Tensor y = spmm(a, x);
+    (y * w).backward();
+
+    // 稠密参考
+    Tensor ad = a.to_dense();
+    ad.set_requires_grad(true);
+    Tensor x2 = random_tensor({m, f}, 2, true);
+    Tensor yd = matmul(ad, x2);
+    (yd * w).backward();
+
+    for (size_t i = 0; i < y.numel(); ++i) assert(near(y[i], yd[i]));
+    for (size_t i = 0; i < x.numel(); ++i) assert(near(x.grad()[i], x2.grad()[i]));
+    const CSRPattern& p = *a.pattern();
+    for (size_t i = 0; i < n; ++i)
+        for (size_t e = p.row_ptr[i]; e < p.row_ptr[i + 1]; ++e)
+            assert(near(a.values().grad()[e], ad.grad()[i * m + p.col_idx[e]]));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_sddmm() {
+    std::cout << "[Test] SDDMM forward / backward..." << std::endl;
+    const size_t n = 50, m = 70, d = 9;
+    CSRMatrix s = random_csr(n, m, 300, 4, false);
+    Tensor a = random_tensor({n, d}, 5, true);
+    Tensor b = random_tensor({m, d}, 6, true);
+    Tensor gw = random_tensor({s.nnz()}, 7);
+
+    Tensor v = sddmm(s, a, b);
+    assert(v.shape() == (std::vector<size_t>{s.nnz()}));
+    (v * gw).backward();
+
+    const CSRPattern& p = *s.pattern();
+    std::vector<float> da(n * d, 0.0f), db(m * d, 0.0f);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t e = p.row_ptr[i]; e < p.row_ptr[i + 1]; ++e) {
+            size_t j = p.col_idx[e];
+            float ref = 0.0f;
+            for (size_t c = 0; c < d; ++c) {
+                ref += a[i * d + c] * b[j * d + c];
+                da[i * d + c] += gw[e] * b[j * d + c];
+                db[j * d + c] += gw[e] * a[i * d + c];
+            }
+            assert(near(v[e], ref));
+        }
+    }
+    for (size_t i = 0; i < n * d; ++i) assert(near(a.grad()[i], da[i]));
+    for (size_t i = 0; i < m * d; ++i) assert(near(b.grad()[i], db[i]));
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+void test_sddmm_spmm_chain() {
+    std::cout << "[Test] Attention-style SDDMM -> SpMM chain on a large graph..." << std::endl;
+    // 10^5 个节点、约 4*10^5 条边：稠密邻接矩阵需要 40 GB，这里只与 nnz 成正比
+    const size_t n = 100000, e = 400000, d = 8;
+    std::mt19937 gen(8);
+    std::uniform_int_distribution<size_t> node(0, n - 1);
+    std::vector<size_t> src(e), dst(e);
+    for (size_t k = 0; k < e; ++k) { src[k] = node(gen); dst[k] = node(gen); }
+    CSRMatrix adj = CSRMatrix::from_coo(n, n, src, dst);
+
+    Tensor h = random_tensor({n, d}, 9, true);
+    Tensor scores = sddmm(adj, h, h);
+    Tensor out = spmm(adj.with_values(scores), h);
+    out.backward();
+    assert(out.shape() == (std::vector<size_t>{n, d}));
+    assert(h.grad().size() == n * d);
+
+    // 抽查一行：out[i] = sum_j (h_i . h_j) h_j
+    const CSRPattern& p = *adj.pattern();
+    size_t i = 12345;
+    for (size_t c = 0; c < d; ++c) {
+        float ref = 0.0f;
+        for (size_t k = p.row_ptr[i]; k < p.row_ptr[i + 1]; ++k) {
+            size_t j = p.col_idx[k];
+            float dot = 0.0f;
+            for (size_t t = 0; t < d; ++t) dot += h[i * d + t] * h[j * d + t];
+            ref += dot * h[j * d + c];
+        }
+        assert(near(out[i * d + c], ref, 1e-3f));
+    }
+    std::cout << "  -> Pass!" << std::endl;
+}
+
+int main() {
+    try {
+        test_from_coo();
+        test_spmm();
+        test_sddmm();
+        test_sddmm_spmm_chain();
+        std::cout << "\nAll sparse tests passed!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}